@@ -0,0 +1,63 @@
+/*
+ * BinarySerializer.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/BinarySerializer.hpp>
+
+#include <istream>
+#include <ostream>
+
+namespace rstudio {
+namespace core {
+namespace binary {
+
+void writeUInt(std::ostream& ostr, uint64_t value, std::size_t bytes)
+{
+   char buffer[8];
+   for (std::size_t i = 0; i < bytes; i++)
+      buffer[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+   ostr.write(buffer, bytes);
+}
+
+bool readUInt(std::istream& istr, std::size_t bytes, uint64_t* pValue)
+{
+   unsigned char buffer[8];
+   if (!istr.read(reinterpret_cast<char*>(buffer), bytes))
+      return false;
+
+   *pValue = 0;
+   for (std::size_t i = bytes; i > 0; i--)
+      *pValue = (*pValue << 8) | buffer[i - 1];
+   return true;
+}
+
+void writeString(std::ostream& ostr, const std::string& value)
+{
+   writeUInt(ostr, value.size(), 4);
+   ostr.write(value.data(), value.size());
+}
+
+bool readString(std::istream& istr, uint64_t maxSize, std::string* pValue)
+{
+   uint64_t size;
+   if (!readUInt(istr, 4, &size) || size > maxSize)
+      return false;
+
+   pValue->resize(static_cast<std::size_t>(size));
+   return size == 0 || istr.read(&(*pValue)[0], pValue->size());
+}
+
+} // namespace binary
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,118 @@
+/*
+ * BinarySerializerTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/BinarySerializer.hpp>
+
+#include <sstream>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace binary {
+namespace tests {
+
+TEST_CASE("Binary Serializer")
+{
+   SECTION("Integers of each width are written little-endian and read back")
+   {
+      std::ostringstream ostr;
+      writeUInt(ostr, 0xAB, 1);
+      writeUInt(ostr, 0x1234, 2);
+      writeUInt(ostr, 0xDEADBEEF, 4);
+      writeUInt(ostr, 0x0123456789ABCDEFULL, 8);
+      CHECK(ostr.str() == std::string("\xAB"
+                                      "\x34\x12"
+                                      "\xEF\xBE\xAD\xDE"
+                                      "\xEF\xCD\xAB\x89\x67\x45\x23\x01", 15));
+
+      std::istringstream istr(ostr.str());
+      uint64_t value;
+      REQUIRE(readUInt(istr, 1, &value));
+      CHECK(value == 0xAB);
+      REQUIRE(readUInt(istr, 2, &value));
+      CHECK(value == 0x1234);
+      REQUIRE(readUInt(istr, 4, &value));
+      CHECK(value == 0xDEADBEEF);
+      REQUIRE(readUInt(istr, 8, &value));
+      CHECK(value == 0x0123456789ABCDEFULL);
+      CHECK_FALSE(readUInt(istr, 1, &value));
+   }
+
+   SECTION("Integers are truncated to the width written")
+   {
+      std::ostringstream ostr;
+      writeUInt(ostr, 0x1FF, 1);
+
+      std::istringstream istr(ostr.str());
+      uint64_t value;
+      REQUIRE(readUInt(istr, 1, &value));
+      CHECK(value == 0xFF);
+   }
+
+   SECTION("Strings are prefixed with their length")
+   {
+      std::ostringstream ostr;
+      writeString(ostr, "abc");
+      writeString(ostr, "");
+      writeString(ostr, std::string("a\0b", 3));
+      CHECK(ostr.str().substr(0, 7) == std::string("\x03\x00\x00\x00" "abc", 7));
+
+      std::istringstream istr(ostr.str());
+      std::string value;
+      REQUIRE(readString(istr, 16, &value));
+      CHECK(value == "abc");
+      REQUIRE(readString(istr, 16, &value));
+      CHECK(value.empty());
+      REQUIRE(readString(istr, 16, &value));
+      CHECK(value == std::string("a\0b", 3));
+      CHECK_FALSE(readString(istr, 16, &value));
+   }
+
+   SECTION("Strings longer than the maximum aren't read")
+   {
+      std::ostringstream ostr;
+      writeString(ostr, "abcdef");
+
+      std::istringstream istr(ostr.str());
+      std::string value;
+      CHECK_FALSE(readString(istr, 5, &value));
+   }
+
+   SECTION("Truncated input fails to read")
+   {
+      std::ostringstream ostr;
+      writeUInt(ostr, 42, 8);
+      writeString(ostr, "abcdef");
+      std::string data = ostr.str();
+
+      uint64_t value;
+      std::istringstream truncatedUInt(data.substr(0, 5));
+      CHECK_FALSE(readUInt(truncatedUInt, 8, &value));
+
+      std::istringstream truncatedLength(data.substr(8, 2));
+      std::string stringValue;
+      CHECK_FALSE(readString(truncatedLength, 16, &stringValue));
+
+      std::istringstream truncatedString(data.substr(8, 7));
+      CHECK_FALSE(readString(truncatedString, 16, &stringValue));
+   }
+}
+
+} // namespace tests
+} // namespace binary
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,364 @@
+/*
+ * MultipartFormParser.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/MultipartFormParser.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// part headers are small (a content disposition and perhaps a content type)
+// so we refuse to buffer more than this while looking for their end
+const std::size_t kMaxHeadersSize = 16 * 1024;
+
+Error protocolError(const std::string& message, const ErrorLocation& location)
+{
+   return systemError(boost::system::errc::protocol_error,
+                      "Invalid form data received - " + message,
+                      location);
+}
+
+std::string unquote(const std::string& value)
+{
+   if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+      return value.substr(1, value.size() - 2);
+   return value;
+}
+
+// split header parameters on semicolons which aren't within quotes
+std::vector<std::string> splitParameters(const std::string& value)
+{
+   std::vector<std::string> params;
+   std::string current;
+   bool quoted = false;
+   for (char ch : value)
+   {
+      if (ch == '"')
+         quoted = !quoted;
+
+      if (ch == ';' && !quoted)
+      {
+         params.push_back(current);
+         current.clear();
+      }
+      else
+      {
+         current.push_back(ch);
+      }
+   }
+   params.push_back(current);
+   return params;
+}
+
+void parseContentDisposition(const std::string& value,
+                             MultipartFormParser::Part* pPart)
+{
+   for (std::string param : splitParameters(value))
+   {
+      boost::algorithm::trim(param);
+      std::string::size_type pos = param.find('=');
+      if (pos == std::string::npos)
+         continue;
+
+      std::string key = boost::algorithm::trim_copy(param.substr(0, pos));
+      std::string paramValue = unquote(boost::algorithm::trim_copy(param.substr(pos + 1)));
+      if (boost::algorithm::iequals(key, "name"))
+         pPart->name = paramValue;
+      else if (boost::algorithm::iequals(key, "filename"))
+         pPart->fileName = paramValue;
+   }
+}
+
+void parsePartHeaders(const std::string& headers, MultipartFormParser::Part* pPart)
+{
+   std::string::size_type lineStart = 0;
+   while (lineStart < headers.size())
+   {
+      std::string::size_type lineEnd = headers.find("\r\n", lineStart);
+      if (lineEnd == std::string::npos)
+         lineEnd = headers.size();
+
+      std::string line = headers.substr(lineStart, lineEnd - lineStart);
+      std::string::size_type pos = line.find(':');
+      if (pos != std::string::npos)
+      {
+         std::string name = boost::algorithm::trim_copy(line.substr(0, pos));
+         std::string value = boost::algorithm::trim_copy(line.substr(pos + 1));
+         if (boost::algorithm::iequals(name, "Content-Disposition"))
+            parseContentDisposition(value, pPart);
+         else if (boost::algorithm::iequals(name, "Content-Type"))
+            pPart->contentType = value;
+      }
+
+      lineStart = lineEnd + 2;
+   }
+}
+
+} // anonymous namespace
+
+MultipartFormParser::MultipartFormParser(const std::string& contentType,
+                                         const Callbacks& callbacks)
+   : callbacks_(callbacks),
+     state_(StatePreamble),
+     // the first boundary needn't be preceded by CRLF, so we start parsing
+     // as if one had been received
+     pending_("\r\n")
+{
+   std::string boundary = boundaryFromContentType(contentType);
+   if (!boundary.empty())
+      delimiter_ = "\r\n--" + boundary;
+}
+
+std::string MultipartFormParser::boundaryFromContentType(const std::string& contentType)
+{
+   for (std::string param : splitParameters(contentType))
+   {
+      boost::algorithm::trim(param);
+      if (boost::algorithm::istarts_with(param, "boundary="))
+         return unquote(param.substr(std::strlen("boundary=")));
+   }
+   return std::string();
+}
+
+Error MultipartFormParser::parse(const char* data, std::size_t size)
+{
+   if (delimiter_.empty())
+      return protocolError("boundary not specified", ERROR_LOCATION);
+
+   // anything after the closing boundary is ignored
+   if (state_ == StateComplete)
+      return Success();
+
+   std::size_t consumed = 0;
+   if (pending_.empty())
+   {
+      // common case: parse directly from the caller's buffer
+      Error error = parseChunk(data, size, &consumed);
+      if (error)
+         return error;
+
+      pending_.assign(data + consumed, size - consumed);
+   }
+   else
+   {
+      // bytes were held back from the previous chunk so parse the two
+      // together (this is rare, and pending_ is small when it happens)
+      std::string buffer;
+      buffer.swap(pending_);
+      buffer.append(data, size);
+
+      Error error = parseChunk(buffer.data(), buffer.size(), &consumed);
+      if (error)
+         return error;
+
+      pending_.assign(buffer.data() + consumed, buffer.size() - consumed);
+   }
+
+   return Success();
+}
+
+Error MultipartFormParser::finish()
+{
+   if (state_ != StateComplete)
+      return protocolError("final boundary not found", ERROR_LOCATION);
+
+   return Success();
+}
+
+Error MultipartFormParser::parseChunk(const char* data,
+                                      std::size_t size,
+                                      std::size_t* pConsumed)
+{
+   std::size_t pos = 0;
+   while (pos < size)
+   {
+      Error error;
+      std::size_t consumed = 0;
+      switch (state_)
+      {
+         case StatePreamble:
+            consumed = parsePreamble(data + pos, size - pos);
+            break;
+         case StateBoundaryEnd:
+            consumed = parseBoundaryEnd(data + pos, size - pos, &error);
+            break;
+         case StateHeaders:
+            consumed = parseHeaders(data + pos, size - pos, &error);
+            break;
+         case StateBody:
+            consumed = parseBody(data + pos, size - pos, &error);
+            break;
+         case StateComplete:
+            consumed = size - pos;
+            break;
+      }
+
+      if (error)
+         return error;
+
+      // more data is required to make progress
+      if (consumed == 0)
+         break;
+
+      pos += consumed;
+   }
+
+   *pConsumed = pos;
+   return Success();
+}
+
+std::size_t MultipartFormParser::parsePreamble(const char* data, std::size_t size)
+{
+   std::size_t pos = findDelimiter(data, size);
+   if (pos != std::string::npos)
+   {
+      state_ = StateBoundaryEnd;
+      return pos + delimiter_.size();
+   }
+
+   return size - partialDelimiterLength(data, size);
+}
+
+std::size_t MultipartFormParser::parseBoundaryEnd(const char* data,
+                                                  std::size_t size,
+                                                  Error* pError)
+{
+   // skip any transport padding
+   if (data[0] == ' ' || data[0] == '\t')
+      return 1;
+
+   if (size < 2)
+      return 0;
+
+   if (data[0] == '-' && data[1] == '-')
+   {
+      state_ = StateComplete;
+      return size;
+   }
+
+   if (data[0] == '\r' && data[1] == '\n')
+   {
+      // keep the line ending so that empty headers are found like any other
+      headers_ = "\r\n";
+      state_ = StateHeaders;
+      return 2;
+   }
+
+   *pError = protocolError("invalid boundary", ERROR_LOCATION);
+   return 0;
+}
+
+std::size_t MultipartFormParser::parseHeaders(const char* data,
+                                              std::size_t size,
+                                              Error* pError)
+{
+   std::size_t previousSize = headers_.size();
+   headers_.append(data, std::min(size, kMaxHeadersSize));
+
+   std::size_t searchPos = previousSize >= 3 ? previousSize - 3 : 0;
+   std::size_t endPos = headers_.find("\r\n\r\n", searchPos);
+   if (endPos == std::string::npos)
+   {
+      if (headers_.size() > kMaxHeadersSize)
+         *pError = protocolError("part headers too large", ERROR_LOCATION);
+      return size;
+   }
+
+   Part part;
+   if (endPos > 2)
+      parsePartHeaders(headers_.substr(2, endPos - 2), &part);
+   headers_.clear();
+
+   state_ = StateBody;
+   if (callbacks_.onPartBegin)
+      *pError = callbacks_.onPartBegin(part);
+
+   return endPos + 4 - previousSize;
+}
+
+std::size_t MultipartFormParser::parseBody(const char* data,
+                                           std::size_t size,
+                                           Error* pError)
+{
+   std::size_t pos = findDelimiter(data, size);
+   if (pos != std::string::npos)
+   {
+      if (pos > 0 && callbacks_.onPartData)
+      {
+         *pError = callbacks_.onPartData(data, pos);
+         if (*pError)
+            return 0;
+      }
+
+      state_ = StateBoundaryEnd;
+      if (callbacks_.onPartEnd)
+         *pError = callbacks_.onPartEnd();
+
+      return pos + delimiter_.size();
+   }
+
+   // deliver everything which can't be the start of a delimiter
+   std::size_t available = size - partialDelimiterLength(data, size);
+   if (available > 0 && callbacks_.onPartData)
+      *pError = callbacks_.onPartData(data, available);
+
+   return available;
+}
+
+std::size_t MultipartFormParser::findDelimiter(const char* data, std::size_t size) const
+{
+   const char* begin = data;
+   const char* end = data + size;
+   while (static_cast<std::size_t>(end - begin) >= delimiter_.size())
+   {
+      const char* candidate = static_cast<const char*>(
+               std::memchr(begin, '\r', (end - begin) - delimiter_.size() + 1));
+      if (candidate == nullptr)
+         break;
+
+      if (std::memcmp(candidate, delimiter_.data(), delimiter_.size()) == 0)
+         return candidate - data;
+
+      begin = candidate + 1;
+   }
+
+   return std::string::npos;
+}
+
+std::size_t MultipartFormParser::partialDelimiterLength(const char* data,
+                                                        std::size_t size) const
+{
+   std::size_t maxLength = std::min(size, delimiter_.size() - 1);
+   for (std::size_t length = maxLength; length > 0; length--)
+   {
+      const char* suffix = data + size - length;
+      if (*suffix == '\r' && std::memcmp(suffix, delimiter_.data(), length) == 0)
+         return length;
+   }
+
+   return 0;
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
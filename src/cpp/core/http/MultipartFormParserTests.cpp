@@ -0,0 +1,179 @@
+/*
+ * MultipartFormParserTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <map>
+#include <string>
+
+#include <boost/bind/bind.hpp>
+
+#include <core/http/MultipartFormParser.hpp>
+
+#include <tests/TestThat.hpp>
+
+using namespace boost::placeholders;
+
+namespace rstudio {
+namespace core {
+namespace http {
+namespace tests {
+
+namespace {
+
+const char* const kContentType = "multipart/form-data; boundary=----Boundary1234";
+
+struct ParsedForm
+{
+   Error onPartBegin(const MultipartFormParser::Part& part)
+   {
+      currentName = part.name;
+      if (!part.fileName.empty())
+         fileNames[part.name] = part.fileName;
+      values[part.name] = std::string();
+      return Success();
+   }
+
+   Error onPartData(const char* data, std::size_t size)
+   {
+      values[currentName].append(data, size);
+      return Success();
+   }
+
+   Error onPartEnd()
+   {
+      parts++;
+      return Success();
+   }
+
+   MultipartFormParser::Callbacks callbacks()
+   {
+      MultipartFormParser::Callbacks cb;
+      cb.onPartBegin = boost::bind(&ParsedForm::onPartBegin, this, _1);
+      cb.onPartData = boost::bind(&ParsedForm::onPartData, this, _1, _2);
+      cb.onPartEnd = boost::bind(&ParsedForm::onPartEnd, this);
+      return cb;
+   }
+
+   int parts = 0;
+   std::string currentName;
+   std::map<std::string, std::string> values;
+   std::map<std::string, std::string> fileNames;
+};
+
+std::string fileContents()
+{
+   // include text which is almost (but not quite) a delimiter
+   std::string contents = "first line\r\n--not the boundary\r\n";
+   contents += "\r\n------Boundary123 is close\r\n";
+   for (int i = 0; i < 1000; i++)
+      contents += std::string(1, static_cast<char>(i % 256));
+   contents += "\r";
+   return contents;
+}
+
+std::string formBody()
+{
+   return "------Boundary1234\r\n"
+          "Content-Disposition: form-data; name=\"file\"; filename=\"data; 1.csv\"\r\n"
+          "Content-Type: text/csv\r\n"
+          "\r\n" +
+          fileContents() +
+          "\r\n------Boundary1234\r\n"
+          "Content-Disposition: form-data; name=\"targetDirectory\"\r\n"
+          "\r\n"
+          "~/uploads"
+          "\r\n------Boundary1234--\r\n";
+}
+
+} // anonymous namespace
+
+test_context("MultipartFormParserTests")
+{
+   test_that("Boundary is read from content type")
+   {
+      CHECK(MultipartFormParser::boundaryFromContentType(kContentType) == "----Boundary1234");
+      CHECK(MultipartFormParser::boundaryFromContentType(
+               "multipart/form-data; boundary=\"a b\"; charset=utf-8") == "a b");
+      CHECK(MultipartFormParser::boundaryFromContentType("text/plain").empty());
+   }
+
+   test_that("Form is parsed regardless of how it is chunked")
+   {
+      std::string body = formBody();
+      std::size_t chunkSizes[] = { 1, 2, 7, 19, 64, body.size() };
+      for (std::size_t chunkSize : chunkSizes)
+      {
+         ParsedForm form;
+         MultipartFormParser parser(kContentType, form.callbacks());
+         for (std::size_t pos = 0; pos < body.size(); pos += chunkSize)
+         {
+            std::size_t size = std::min(chunkSize, body.size() - pos);
+            REQUIRE_FALSE(parser.parse(body.data() + pos, size));
+         }
+
+         REQUIRE_FALSE(parser.finish());
+         CHECK(form.parts == 2);
+         CHECK(form.fileNames["file"] == "data; 1.csv");
+         CHECK(form.values["file"] == fileContents());
+         CHECK(form.values["targetDirectory"] == "~/uploads");
+      }
+   }
+
+   test_that("Empty parts are parsed")
+   {
+      std::string body = "--b\r\n"
+                         "Content-Disposition: form-data; name=\"empty\"; filename=\"e.txt\"\r\n"
+                         "\r\n"
+                         "\r\n--b--";
+
+      ParsedForm form;
+      MultipartFormParser parser("multipart/form-data; boundary=b", form.callbacks());
+      REQUIRE_FALSE(parser.parse(body.data(), body.size()));
+      REQUIRE_FALSE(parser.finish());
+      CHECK(form.parts == 1);
+      CHECK(form.values.count("empty"));
+      CHECK(form.values["empty"].empty());
+   }
+
+   test_that("Truncated form is reported")
+   {
+      std::string body = formBody();
+      body.resize(body.size() / 2);
+
+      ParsedForm form;
+      MultipartFormParser parser(kContentType, form.callbacks());
+      REQUIRE_FALSE(parser.parse(body.data(), body.size()));
+      CHECK(parser.finish());
+   }
+
+   test_that("Callback errors stop parsing")
+   {
+      MultipartFormParser::Callbacks cb;
+      cb.onPartData = [](const char*, std::size_t)
+      {
+         return systemError(boost::system::errc::file_too_large, ERROR_LOCATION);
+      };
+
+      std::string body = formBody();
+      MultipartFormParser parser(kContentType, cb);
+      Error error = parser.parse(body.data(), body.size());
+      REQUIRE(error);
+      CHECK(error.getCode() == boost::system::errc::file_too_large);
+   }
+}
+
+} // namespace tests
+} // namespace http
+} // namespace core
+} // namespace rstudio
@@ -849,6 +849,21 @@ void Response::setStreamFile(const FilePath& filePath,
       setError(status::InternalServerError, error.getMessage());
 }
 
+void Response::setStreamResponse(const boost::shared_ptr<StreamResponse>& streamResponse)
+{
+   // streaming will be performed via chunked encoding
+   setHeader(kTransferEncoding, kChunkedTransferEncoding);
+
+   streamResponse_ = streamResponse;
+   Error error = streamResponse_->initialize();
+   if (error)
+   {
+      removeHeader(kTransferEncoding);
+      streamResponse_.reset();
+      setError(status::InternalServerError, error.getMessage());
+   }
+}
+
 } // namespacc http
 } // namespace core
 } // namespace rstudio
@@ -0,0 +1,574 @@
+/*
+ * ZipStreamResponse.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/ZipStreamResponse.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <set>
+
+#include <boost/cstdint.hpp>
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <shared_core/Error.hpp>
+#include <core/Log.hpp>
+
+#include "zlib.h"
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// record signatures
+const boost::uint32_t kLocalFileHeaderSignature      = 0x04034b50;
+const boost::uint32_t kDataDescriptorSignature       = 0x08074b50;
+const boost::uint32_t kCentralDirectorySignature     = 0x02014b50;
+const boost::uint32_t kZip64EndOfCentralDirSignature = 0x06064b50;
+const boost::uint32_t kZip64EndOfCentralDirLocatorSignature = 0x07064b50;
+const boost::uint32_t kEndOfCentralDirSignature      = 0x06054b50;
+
+// general purpose flags
+const boost::uint16_t kFlagDataDescriptor = 0x0008;
+const boost::uint16_t kFlagUtf8           = 0x0800;
+
+// compression methods
+const boost::uint16_t kMethodStored  = 0;
+const boost::uint16_t kMethodDeflate = 8;
+
+// version needed to extract (2.0 for deflate, 4.5 for zip64)
+const boost::uint16_t kVersionDefault = 20;
+const boost::uint16_t kVersionZip64   = 45;
+
+// version made by (unix, spec 4.5) -- lets unzip honor the external
+// attributes we record for directories
+const boost::uint16_t kVersionMadeBy = (3 << 8) | 45;
+
+const boost::uint16_t kZip64ExtraId = 0x0001;
+
+const boost::uint32_t kMax32 = 0xFFFFFFFF;
+const boost::uint16_t kMax16 = 0xFFFF;
+
+void appendUInt16(boost::uint16_t value, std::string* pOutput)
+{
+   pOutput->push_back(static_cast<char>(value & 0xFF));
+   pOutput->push_back(static_cast<char>((value >> 8) & 0xFF));
+}
+
+void appendUInt32(boost::uint32_t value, std::string* pOutput)
+{
+   for (int i = 0; i < 4; i++)
+      pOutput->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+void appendUInt64(boost::uint64_t value, std::string* pOutput)
+{
+   for (int i = 0; i < 8; i++)
+      pOutput->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+void toDosDateTime(std::time_t time,
+                   boost::uint16_t* pDosDate,
+                   boost::uint16_t* pDosTime)
+{
+   using namespace boost::posix_time;
+   typedef boost::date_time::c_local_adjustor<ptime> local_adjustor;
+
+   std::tm tm;
+   try
+   {
+      tm = to_tm(local_adjustor::utc_to_local(from_time_t(time)));
+   }
+   catch(...)
+   {
+      tm = to_tm(from_time_t(0));
+   }
+
+   // dos dates can't represent anything before 1980
+   if (tm.tm_year < 80)
+   {
+      *pDosDate = (1 << 5) | 1;
+      *pDosTime = 0;
+      return;
+   }
+
+   *pDosDate = static_cast<boost::uint16_t>(
+            ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+   *pDosTime = static_cast<boost::uint16_t>(
+            (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+}
+
+} // anonymous namespace
+
+struct ZipStreamResponse::Impl
+{
+   struct Entry
+   {
+      Entry()
+         : isDirectory(false), method(kMethodStored), crc(0),
+           compressedSize(0), size(0), offset(0), dosDate(0), dosTime(0)
+      {
+      }
+
+      std::string name;
+      bool isDirectory;
+      boost::uint16_t method;
+      boost::uint32_t crc;
+      boost::uint64_t compressedSize;
+      boost::uint64_t size;
+      boost::uint64_t offset;
+      boost::uint16_t dosDate;
+      boost::uint16_t dosTime;
+   };
+
+   Impl(const FilePath& parentPath,
+        const std::vector<std::string>& files,
+        std::streamsize bufferSize)
+      : parentPath(parentPath),
+        pending(files.begin(), files.end()),
+        bufferSize(std::max<std::streamsize>(bufferSize, 4096)),
+        inputBuffer(this->bufferSize),
+        deflateBuffer(this->bufferSize),
+        offset(0),
+        zip64Threshold(kMax32),
+        deflating(false),
+        finished(false)
+   {
+      std::memset(&zStream, 0, sizeof(zStream));
+   }
+
+   ~Impl()
+   {
+      try
+      {
+         endDeflate();
+      }
+      catch(...)
+      {
+      }
+   }
+
+   // append bytes to the output, tracking the archive offset
+   void emit(const std::string& bytes)
+   {
+      output.append(bytes);
+      offset += bytes.size();
+   }
+
+   void emit(const char* bytes, std::size_t size)
+   {
+      output.append(bytes, size);
+      offset += size;
+   }
+
+   void endDeflate()
+   {
+      if (deflating)
+      {
+         (void) deflateEnd(&zStream);
+         deflating = false;
+      }
+   }
+
+   // files are given zip64 extras in their local headers (see below), so
+   // they need 4.5 to extract, as both of their headers say
+   static boost::uint16_t versionNeeded(const Entry& entry)
+   {
+      return entry.isDirectory ? kVersionDefault : kVersionZip64;
+   }
+
+   // the value for a 32-bit size or offset field (which is saturated when
+   // the value is in the record's zip64 extra)
+   boost::uint32_t field32(boost::uint64_t value) const
+   {
+      return value >= zip64Threshold ? kMax32 : static_cast<boost::uint32_t>(value);
+   }
+
+   void writeLocalFileHeader(const Entry& entry)
+   {
+      boost::uint16_t flags = kFlagUtf8;
+      std::string extra;
+      if (!entry.isDirectory)
+      {
+         // file sizes aren't known until the file has been read, so any
+         // file could need zip64 sizes; a zip64 extra (with the sizes left
+         // for the data descriptor) tells readers to expect them there
+         flags |= kFlagDataDescriptor;
+         appendUInt16(kZip64ExtraId, &extra);
+         appendUInt16(16, &extra);
+         appendUInt64(0, &extra); // uncompressed size (in data descriptor)
+         appendUInt64(0, &extra); // compressed size (in data descriptor)
+      }
+
+      std::string header;
+      appendUInt32(kLocalFileHeaderSignature, &header);
+      appendUInt16(versionNeeded(entry), &header);
+      appendUInt16(flags, &header);
+      appendUInt16(entry.method, &header);
+      appendUInt16(entry.dosTime, &header);
+      appendUInt16(entry.dosDate, &header);
+      appendUInt32(0, &header); // crc (in data descriptor)
+      appendUInt32(extra.empty() ? 0 : kMax32, &header); // compressed size
+      appendUInt32(extra.empty() ? 0 : kMax32, &header); // uncompressed size
+      appendUInt16(static_cast<boost::uint16_t>(entry.name.size()), &header);
+      appendUInt16(static_cast<boost::uint16_t>(extra.size()), &header);
+      header.append(entry.name);
+      header.append(extra);
+      emit(header);
+   }
+
+   // (sizes are always 8 bytes, as the local header has a zip64 extra)
+   void writeDataDescriptor(const Entry& entry)
+   {
+      std::string descriptor;
+      appendUInt32(kDataDescriptorSignature, &descriptor);
+      appendUInt32(entry.crc, &descriptor);
+      appendUInt64(entry.compressedSize, &descriptor);
+      appendUInt64(entry.size, &descriptor);
+      emit(descriptor);
+   }
+
+   void writeCentralDirectory()
+   {
+      boost::uint64_t centralDirOffset = offset;
+
+      for (const Entry& entry : entries)
+      {
+         // zip64 extended information (only the fields which overflowed)
+         std::string zip64;
+         if (entry.size >= zip64Threshold)
+            appendUInt64(entry.size, &zip64);
+         if (entry.compressedSize >= zip64Threshold)
+            appendUInt64(entry.compressedSize, &zip64);
+         if (entry.offset >= zip64Threshold)
+            appendUInt64(entry.offset, &zip64);
+
+         std::string extra;
+         if (!zip64.empty())
+         {
+            appendUInt16(kZip64ExtraId, &extra);
+            appendUInt16(static_cast<boost::uint16_t>(zip64.size()), &extra);
+            extra.append(zip64);
+         }
+
+         boost::uint16_t flags = kFlagUtf8;
+         if (!entry.isDirectory)
+            flags |= kFlagDataDescriptor;
+
+         // unix mode in the high word, msdos directory bit in the low word
+         boost::uint32_t externalAttributes = entry.isDirectory ?
+                  ((040755u << 16) | 0x10) :
+                  (0100644u << 16);
+
+         std::string record;
+         appendUInt32(kCentralDirectorySignature, &record);
+         appendUInt16(kVersionMadeBy, &record);
+         appendUInt16(versionNeeded(entry), &record);
+         appendUInt16(flags, &record);
+         appendUInt16(entry.method, &record);
+         appendUInt16(entry.dosTime, &record);
+         appendUInt16(entry.dosDate, &record);
+         appendUInt32(entry.crc, &record);
+         appendUInt32(field32(entry.compressedSize), &record);
+         appendUInt32(field32(entry.size), &record);
+         appendUInt16(static_cast<boost::uint16_t>(entry.name.size()), &record);
+         appendUInt16(static_cast<boost::uint16_t>(extra.size()), &record);
+         appendUInt16(0, &record); // comment length
+         appendUInt16(0, &record); // disk number start
+         appendUInt16(0, &record); // internal attributes
+         appendUInt32(externalAttributes, &record);
+         appendUInt32(field32(entry.offset), &record);
+         record.append(entry.name);
+         record.append(extra);
+         emit(record);
+      }
+
+      boost::uint64_t centralDirSize = offset - centralDirOffset;
+      boost::uint64_t entryCount = entries.size();
+
+      bool needsZip64 = entryCount >= kMax16 ||
+                        centralDirSize >= zip64Threshold ||
+                        centralDirOffset >= zip64Threshold;
+      if (needsZip64)
+      {
+         boost::uint64_t zip64EndOffset = offset;
+
+         std::string end;
+         appendUInt32(kZip64EndOfCentralDirSignature, &end);
+         appendUInt64(44, &end); // size of the remainder of this record
+         appendUInt16(kVersionMadeBy, &end);
+         appendUInt16(kVersionZip64, &end);
+         appendUInt32(0, &end); // this disk
+         appendUInt32(0, &end); // disk with central directory
+         appendUInt64(entryCount, &end);
+         appendUInt64(entryCount, &end);
+         appendUInt64(centralDirSize, &end);
+         appendUInt64(centralDirOffset, &end);
+
+         appendUInt32(kZip64EndOfCentralDirLocatorSignature, &end);
+         appendUInt32(0, &end); // disk with zip64 end of central directory
+         appendUInt64(zip64EndOffset, &end);
+         appendUInt32(1, &end); // total disks
+         emit(end);
+      }
+
+      boost::uint16_t count16 = entryCount >= kMax16 ?
+               kMax16 : static_cast<boost::uint16_t>(entryCount);
+
+      std::string end;
+      appendUInt32(kEndOfCentralDirSignature, &end);
+      appendUInt16(0, &end); // this disk
+      appendUInt16(0, &end); // disk with central directory
+      appendUInt16(count16, &end);
+      appendUInt16(count16, &end);
+      appendUInt32(field32(centralDirSize), &end);
+      appendUInt32(field32(centralDirOffset), &end);
+      appendUInt16(0, &end); // comment length
+      emit(end);
+   }
+
+   // begin the next pending entry; returns false if there are none left
+   bool beginNextEntry()
+   {
+      while (!pending.empty())
+      {
+         std::string name = pending.front();
+         pending.pop_front();
+
+         FilePath filePath = parentPath.completePath(name);
+         if (!filePath.exists())
+         {
+            LOG_WARNING_MESSAGE("Skipping missing file in zip export: " +
+                                filePath.getAbsolutePath());
+            continue;
+         }
+
+         Entry entry;
+         entry.offset = offset;
+         toDosDateTime(filePath.getLastWriteTime(),
+                       &entry.dosDate,
+                       &entry.dosTime);
+
+         if (filePath.isDirectory())
+         {
+            entry.isDirectory = true;
+            entry.name = name + "/";
+            writeLocalFileHeader(entry);
+            entries.push_back(entry);
+
+            // directories are only descended into once, so that symlinks
+            // back to a parent don't recurse forever
+            if (!visitedDirectories.insert(filePath.getCanonicalPath()).second)
+            {
+               LOG_WARNING_MESSAGE("Not repeating directory contents in zip export: " +
+                                   filePath.getAbsolutePath());
+               continue;
+            }
+
+            // queue the directory's children ahead of the remaining entries
+            // so that each directory's contents are kept together
+            std::vector<FilePath> children;
+            Error error = filePath.getChildren(children);
+            if (error)
+               LOG_ERROR(error);
+
+            std::sort(children.begin(), children.end());
+            for (auto it = children.rbegin(); it != children.rend(); ++it)
+               pending.push_front(name + "/" + it->getFilename());
+
+            continue;
+         }
+
+         Error error = filePath.openForRead(pInput);
+         if (error)
+         {
+            LOG_ERROR(error);
+            continue;
+         }
+
+         std::memset(&zStream, 0, sizeof(zStream));
+         int result = deflateInit2(&zStream,
+                                   Z_DEFAULT_COMPRESSION,
+                                   Z_DEFLATED,
+                                   -MAX_WBITS, // raw deflate
+                                   8,
+                                   Z_DEFAULT_STRATEGY);
+         if (result != Z_OK)
+         {
+            LOG_ERROR(systemError(result, "ZLib initialization error", ERROR_LOCATION));
+            pInput.reset();
+            continue;
+         }
+         deflating = true;
+
+         entry.name = name;
+         entry.method = kMethodDeflate;
+         entry.crc = crc32(0L, Z_NULL, 0);
+         writeLocalFileHeader(entry);
+         current = entry;
+         return true;
+      }
+
+      return false;
+   }
+
+   // compress the next block of the current entry
+   Error deflateNextBlock()
+   {
+      pInput->read(&inputBuffer[0], bufferSize);
+      std::streamsize read = pInput->gcount();
+      bool eof = !pInput->good();
+      if (pInput->bad())
+      {
+         Error error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+         error.addProperty("path", parentPath.completePath(current.name));
+         return error;
+      }
+
+      current.size += read;
+      current.crc = crc32(current.crc,
+                          reinterpret_cast<const Bytef*>(&inputBuffer[0]),
+                          static_cast<uInt>(read));
+
+      zStream.next_in = reinterpret_cast<Bytef*>(&inputBuffer[0]);
+      zStream.avail_in = static_cast<uInt>(read);
+
+      int flush = eof ? Z_FINISH : Z_NO_FLUSH;
+      int result = Z_OK;
+      do
+      {
+         zStream.next_out = reinterpret_cast<Bytef*>(&deflateBuffer[0]);
+         zStream.avail_out = static_cast<uInt>(bufferSize);
+         result = deflate(&zStream, flush);
+         if (result == Z_STREAM_ERROR)
+         {
+            Error error = systemError(result, "ZLib compression error", ERROR_LOCATION);
+            error.addProperty("path", parentPath.completePath(current.name));
+            return error;
+         }
+
+         std::size_t written = bufferSize - zStream.avail_out;
+         current.compressedSize += written;
+         emit(&deflateBuffer[0], written);
+      } while (zStream.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+
+      if (eof)
+      {
+         endDeflate();
+         pInput.reset();
+         writeDataDescriptor(current);
+         entries.push_back(current);
+      }
+
+      return Success();
+   }
+
+   FilePath parentPath;
+   std::deque<std::string> pending;
+   std::set<std::string> visitedDirectories;
+   std::streamsize bufferSize;
+
+   // (reused for each block)
+   std::vector<char> inputBuffer;
+   std::vector<char> deflateBuffer;
+
+   std::string output;
+   boost::uint64_t offset;
+
+   // sizes and offsets from which zip64 records are used
+   boost::uint64_t zip64Threshold;
+
+   std::vector<Entry> entries;
+   Entry current;
+   std::shared_ptr<std::istream> pInput;
+   z_stream zStream;
+   bool deflating;
+   bool finished;
+   Error error;
+};
+
+ZipStreamResponse::ZipStreamResponse(const FilePath& parentPath,
+                                     const std::vector<std::string>& files,
+                                     std::streamsize bufferSize)
+   : pImpl_(new Impl(parentPath, files, bufferSize))
+{
+}
+
+ZipStreamResponse::~ZipStreamResponse()
+{
+}
+
+void ZipStreamResponse::setZip64Threshold(boost::uint64_t threshold)
+{
+   pImpl_->zip64Threshold = std::min<boost::uint64_t>(threshold, kMax32);
+}
+
+Error ZipStreamResponse::initialize()
+{
+   if (!pImpl_->parentPath.exists())
+      return fileNotFoundError(pImpl_->parentPath, ERROR_LOCATION);
+
+   return Success();
+}
+
+std::shared_ptr<StreamBuffer> ZipStreamResponse::nextBuffer()
+{
+   // fill the output until we have a full buffer (or run out of entries)
+   while (!pImpl_->finished &&
+          pImpl_->output.size() < static_cast<std::size_t>(pImpl_->bufferSize))
+   {
+      if (pImpl_->pInput)
+      {
+         Error error = pImpl_->deflateNextBlock();
+         if (error)
+         {
+            // we've already sent part of the archive so there is no way to
+            // report the error other than aborting the stream
+            pImpl_->endDeflate();
+            pImpl_->pInput.reset();
+            pImpl_->output.clear();
+            pImpl_->finished = true;
+            pImpl_->error = error;
+            return std::shared_ptr<StreamBuffer>();
+         }
+      }
+      else if (!pImpl_->beginNextEntry())
+      {
+         pImpl_->writeCentralDirectory();
+         pImpl_->finished = true;
+      }
+   }
+
+   if (pImpl_->output.empty())
+      return std::shared_ptr<StreamBuffer>();
+
+   std::size_t size = pImpl_->output.size();
+   char* buffer = new char[size];
+   std::memcpy(buffer, pImpl_->output.data(), size);
+   pImpl_->output.clear();
+   return std::make_shared<StreamBuffer>(buffer, size);
+}
+
+Error ZipStreamResponse::streamError() const
+{
+   return pImpl_->error;
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,321 @@
+/*
+ * ZipStreamResponseTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <boost/cstdint.hpp>
+
+#include <core/FileSerializer.hpp>
+#include <core/http/ZipStreamResponse.hpp>
+
+#include <tests/TestThat.hpp>
+
+#include "zlib.h"
+
+namespace rstudio {
+namespace core {
+namespace http {
+namespace tests {
+
+namespace {
+
+boost::uint64_t readUInt(const std::string& data, std::size_t offset, int bytes)
+{
+   boost::uint64_t value = 0;
+   for (int i = bytes - 1; i >= 0; i--)
+      value = (value << 8) | static_cast<unsigned char>(data[offset + i]);
+   return value;
+}
+
+std::string readArchive(ZipStreamResponse& response)
+{
+   std::string archive;
+   while (true)
+   {
+      std::shared_ptr<StreamBuffer> buffer = response.nextBuffer();
+      if (!buffer)
+         break;
+      archive.append(buffer->data, buffer->size);
+   }
+   return archive;
+}
+
+std::string inflateRaw(const std::string& compressed, std::size_t size)
+{
+   std::string output(size, '\0');
+
+   z_stream stream;
+   std::memset(&stream, 0, sizeof(stream));
+   inflateInit2(&stream, -MAX_WBITS);
+   stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+   stream.avail_in = static_cast<uInt>(compressed.size());
+   stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+   stream.avail_out = static_cast<uInt>(size);
+   inflate(&stream, Z_FINISH);
+   inflateEnd(&stream);
+
+   return output;
+}
+
+// read the value of a 32-bit field, from the zip64 extra (whose fields are
+// read in order) when it's saturated
+std::size_t readField(const std::string& data,
+                      std::size_t offset,
+                      std::size_t* pZip64Offset)
+{
+   std::size_t value = readUInt(data, offset, 4);
+   if (value != 0xFFFFFFFF)
+      return value;
+
+   value = readUInt(data, *pZip64Offset, 8);
+   *pZip64Offset += 8;
+   return value;
+}
+
+// the offset of the zip64 extended information in an extra field (or npos)
+std::size_t findZip64Extra(const std::string& data, std::size_t offset, std::size_t length)
+{
+   std::size_t end = offset + length;
+   while (offset + 4 <= end)
+   {
+      if (readUInt(data, offset, 2) == 0x0001)
+         return offset + 4;
+      offset += 4 + readUInt(data, offset + 2, 2);
+   }
+   return std::string::npos;
+}
+
+// read the entries of an archive through its central directory, checking
+// the local headers and data descriptors agree with it
+std::map<std::string, std::string> readEntries(const std::string& archive)
+{
+   std::map<std::string, std::string> entries;
+   if (archive.size() < 22)
+      return entries;
+
+   std::size_t endOffset = archive.size() - 22;
+   if (readUInt(archive, endOffset, 4) != 0x06054b50)
+      return entries;
+
+   std::size_t count = readUInt(archive, endOffset + 10, 2);
+   std::size_t offset = readUInt(archive, endOffset + 16, 4);
+   if (offset == 0xFFFFFFFF)
+   {
+      // follow the zip64 end of central directory locator
+      std::size_t locatorOffset = endOffset - 20;
+      if (readUInt(archive, locatorOffset, 4) != 0x07064b50)
+         return entries;
+
+      std::size_t zip64EndOffset = readUInt(archive, locatorOffset + 8, 8);
+      if (readUInt(archive, zip64EndOffset, 4) != 0x06064b50)
+         return entries;
+
+      count = readUInt(archive, zip64EndOffset + 32, 8);
+      offset = readUInt(archive, zip64EndOffset + 48, 8);
+   }
+
+   for (std::size_t i = 0; i < count; i++)
+   {
+      if (readUInt(archive, offset, 4) != 0x02014b50)
+         break;
+
+      std::size_t method = readUInt(archive, offset + 10, 2);
+      std::size_t crc = readUInt(archive, offset + 16, 4);
+      std::size_t nameLength = readUInt(archive, offset + 28, 2);
+      std::size_t extraLength = readUInt(archive, offset + 30, 2);
+      std::size_t commentLength = readUInt(archive, offset + 32, 2);
+      std::string name = archive.substr(offset + 46, nameLength);
+
+      std::size_t zip64Offset = findZip64Extra(archive, offset + 46 + nameLength, extraLength);
+      std::size_t size = readField(archive, offset + 24, &zip64Offset);
+      std::size_t compressedSize = readField(archive, offset + 20, &zip64Offset);
+      std::size_t localOffset = readField(archive, offset + 42, &zip64Offset);
+
+      std::size_t localNameLength = readUInt(archive, localOffset + 26, 2);
+      std::size_t localExtraLength = readUInt(archive, localOffset + 28, 2);
+      std::size_t dataOffset = localOffset + 30 + localNameLength + localExtraLength;
+
+      std::string contents;
+      if (method == 8)
+      {
+         contents = inflateRaw(archive.substr(dataOffset, compressedSize), size);
+
+         // file entries have a zip64 local extra, so their data descriptors
+         // have 8-byte sizes
+         std::size_t descriptorOffset = dataOffset + compressedSize;
+         bool localZip64 = findZip64Extra(archive,
+                                          localOffset + 30 + localNameLength,
+                                          localExtraLength) != std::string::npos;
+         if (!localZip64 ||
+             readUInt(archive, descriptorOffset, 4) != 0x08074b50 ||
+             readUInt(archive, descriptorOffset + 4, 4) != crc ||
+             readUInt(archive, descriptorOffset + 8, 8) != compressedSize ||
+             readUInt(archive, descriptorOffset + 16, 8) != size)
+         {
+            contents = "<bad descriptor>";
+         }
+      }
+
+      // the local header needs the same version to extract
+      if (readUInt(archive, localOffset + 4, 2) != readUInt(archive, offset + 6, 2))
+         contents = "<bad version>";
+
+      // flag corrupt entries so the comparison fails
+      std::size_t actualCrc = crc32(0L,
+                                    reinterpret_cast<const Bytef*>(contents.data()),
+                                    static_cast<uInt>(contents.size()));
+      if (actualCrc != crc)
+         contents = "<bad crc>";
+
+      entries[name] = contents;
+      offset += 46 + nameLength + extraLength + commentLength;
+   }
+
+   return entries;
+}
+
+} // anonymous namespace
+
+test_context("ZipStreamResponseTests")
+{
+   FilePath tempDir;
+   FilePath::tempFilePath(tempDir);
+   tempDir.ensureDirectory();
+
+   std::string largeContents;
+   for (int i = 0; i < 20000; i++)
+      largeContents += "line " + std::to_string(i) + " of a larger file\n";
+
+   writeStringToFile(tempDir.completePath("a.txt"), "hello, world\n");
+   writeStringToFile(tempDir.completePath("empty.txt"), "");
+   tempDir.completePath("dir/sub").ensureDirectory();
+   writeStringToFile(tempDir.completePath("dir/b.txt"), largeContents);
+   writeStringToFile(tempDir.completePath("dir/sub/c.txt"), "c");
+
+   test_that("Archive contains files and recursive directory contents")
+   {
+      std::vector<std::string> files;
+      files.push_back("a.txt");
+      files.push_back("empty.txt");
+      files.push_back("dir");
+
+      ZipStreamResponse response(tempDir, files, 4096);
+      REQUIRE_FALSE(response.initialize());
+
+      std::map<std::string, std::string> entries = readEntries(readArchive(response));
+      REQUIRE(entries.size() == 6);
+      CHECK(entries["a.txt"] == "hello, world\n");
+      CHECK(entries["empty.txt"] == "");
+      CHECK(entries.count("dir/"));
+      CHECK(entries.count("dir/sub/"));
+      CHECK(entries["dir/b.txt"] == largeContents);
+      CHECK(entries["dir/sub/c.txt"] == "c");
+   }
+
+   test_that("Missing files are skipped")
+   {
+      std::vector<std::string> files;
+      files.push_back("missing.txt");
+      files.push_back("a.txt");
+
+      ZipStreamResponse response(tempDir, files);
+      REQUIRE_FALSE(response.initialize());
+
+      std::map<std::string, std::string> entries = readEntries(readArchive(response));
+      REQUIRE(entries.size() == 1);
+      CHECK(entries["a.txt"] == "hello, world\n");
+      CHECK_FALSE(response.streamError());
+   }
+
+   test_that("Zip64 records are used past the threshold")
+   {
+      std::vector<std::string> files;
+      files.push_back("a.txt");
+      files.push_back("dir");
+
+      ZipStreamResponse response(tempDir, files, 4096);
+      response.setZip64Threshold(1000);
+      REQUIRE_FALSE(response.initialize());
+
+      std::string archive = readArchive(response);
+
+      // the end of central directory defers to the zip64 record
+      std::size_t endOffset = archive.size() - 22;
+      CHECK(readUInt(archive, endOffset + 16, 4) == 0xFFFFFFFF);
+
+      std::map<std::string, std::string> entries = readEntries(archive);
+      REQUIRE(entries.size() == 5);
+      CHECK(entries["a.txt"] == "hello, world\n");
+      CHECK(entries["dir/b.txt"] == largeContents);
+      CHECK(entries["dir/sub/c.txt"] == "c");
+   }
+
+#ifndef _WIN32
+   test_that("Symlinked directories are only descended into once")
+   {
+      FilePath loopPath = tempDir.completePath("dir/sub/loop");
+      REQUIRE(::symlink("..", loopPath.getAbsolutePath().c_str()) == 0);
+
+      std::vector<std::string> files;
+      files.push_back("dir");
+
+      ZipStreamResponse response(tempDir, files);
+      REQUIRE_FALSE(response.initialize());
+
+      std::map<std::string, std::string> entries = readEntries(readArchive(response));
+      REQUIRE(entries.size() == 5);
+      CHECK(entries.count("dir/sub/loop/"));
+      CHECK(entries["dir/sub/c.txt"] == "c");
+
+      loopPath.remove();
+   }
+#endif
+
+#ifdef __linux__
+   test_that("Read failures abort the stream")
+   {
+      // reading the start of our own address space fails (with EIO)
+      FilePath unreadablePath = tempDir.completePath("unreadable");
+      REQUIRE(::symlink("/proc/self/mem", unreadablePath.getAbsolutePath().c_str()) == 0);
+
+      std::vector<std::string> files;
+      files.push_back("a.txt");
+      files.push_back("unreadable");
+
+      ZipStreamResponse response(tempDir, files);
+      REQUIRE_FALSE(response.initialize());
+
+      std::string archive = readArchive(response);
+      CHECK(response.streamError());
+      CHECK(readEntries(archive).empty());
+
+      unreadablePath.remove();
+   }
+#endif
+
+   tempDir.removeIfExists();
+}
+
+} // namespace tests
+} // namespace http
+} // namespace core
+} // namespace rstudio
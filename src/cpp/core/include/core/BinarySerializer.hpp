@@ -0,0 +1,45 @@
+/*
+ * BinarySerializer.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_BINARY_SERIALIZER_HPP
+#define CORE_BINARY_SERIALIZER_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace rstudio {
+namespace core {
+namespace binary {
+
+// Reading and writing of compact binary files (such as caches): unsigned
+// integers are stored little-endian in the given number of bytes, and
+// strings are prefixed with their (4 byte) length. Reads return false
+// when the stream ends early.
+
+void writeUInt(std::ostream& ostr, uint64_t value, std::size_t bytes);
+
+bool readUInt(std::istream& istr, std::size_t bytes, uint64_t* pValue);
+
+void writeString(std::ostream& ostr, const std::string& value);
+
+// (strings longer than maxSize, as read from a corrupt file, aren't read)
+bool readString(std::istream& istr, uint64_t maxSize, std::string* pValue);
+
+} // namespace binary
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_BINARY_SERIALIZER_HPP
@@ -0,0 +1,107 @@
+/*
+ * MultipartFormParser.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_MULTIPART_FORM_PARSER_HPP
+#define CORE_HTTP_MULTIPART_FORM_PARSER_HPP
+
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+
+#include <shared_core/Error.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+// Incremental parser for multipart/form-data bodies. Body bytes may be fed
+// in arbitrarily sized chunks as they arrive from the connection; part
+// contents are passed to the data callback directly from the caller's
+// buffer (only the few bytes which might begin a boundary are held back
+// between chunks), so uploads of any size are parsed in constant memory.
+class MultipartFormParser : boost::noncopyable
+{
+public:
+   struct Part
+   {
+      std::string name;
+      std::string fileName;
+      std::string contentType;
+   };
+
+   // returning an error from a callback stops parsing (the error is
+   // returned from parse)
+   struct Callbacks
+   {
+      boost::function<Error(const Part&)> onPartBegin;
+      boost::function<Error(const char*, std::size_t)> onPartData;
+      boost::function<Error()> onPartEnd;
+   };
+
+   // the boundary is read from the request's content type
+   MultipartFormParser(const std::string& contentType,
+                       const Callbacks& callbacks);
+
+   Error parse(const char* data, std::size_t size);
+
+   // returns an error if the closing boundary hasn't been seen
+   Error finish();
+
+   bool complete() const { return state_ == StateComplete; }
+
+   // extract the boundary parameter from a multipart content type
+   static std::string boundaryFromContentType(const std::string& contentType);
+
+private:
+   std::size_t parsePreamble(const char* data, std::size_t size);
+   std::size_t parseBoundaryEnd(const char* data, std::size_t size, Error* pError);
+   std::size_t parseHeaders(const char* data, std::size_t size, Error* pError);
+   std::size_t parseBody(const char* data, std::size_t size, Error* pError);
+
+   std::size_t findDelimiter(const char* data, std::size_t size) const;
+   std::size_t partialDelimiterLength(const char* data, std::size_t size) const;
+
+   Error parseChunk(const char* data, std::size_t size, std::size_t* pConsumed);
+   Error beginPart();
+
+private:
+   enum State
+   {
+      StatePreamble,
+      StateBoundaryEnd,
+      StateHeaders,
+      StateBody,
+      StateComplete
+   };
+
+   Callbacks callbacks_;
+   State state_;
+
+   // CRLF followed by "--" and the boundary
+   std::string delimiter_;
+
+   // bytes which may be the start of a delimiter (or which otherwise
+   // couldn't be consumed) at the end of the previous chunk
+   std::string pending_;
+
+   std::string headers_;
+};
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_MULTIPART_FORM_PARSER_HPP
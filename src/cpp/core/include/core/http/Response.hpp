@@ -115,6 +115,11 @@ public:
 
    virtual Error initialize() = 0;
    virtual std::shared_ptr<StreamBuffer> nextBuffer() = 0;
+
+   // set when the stream failed part way through -- once nextBuffer returns
+   // no more data, a stream in error is aborted rather than ended, so the
+   // client doesn't take what was sent for the complete response
+   virtual Error streamError() const { return Success(); }
 };
 
 class Response : public Message
@@ -266,6 +271,9 @@ public:
                       const Request& request,
                       std::streamsize buffSize = 65536);
 
+   // stream a body produced incrementally (sent using chunked encoding)
+   void setStreamResponse(const boost::shared_ptr<StreamResponse>& streamResponse);
+
    Error setBody(const FilePath& filePath, std::streamsize buffSize = 512)
    {
       NullOutputFilter nullFilter;
@@ -110,6 +110,15 @@ private:
       }
       else
       {
+         Error error = response->streamError();
+         if (error)
+         {
+            // the stream failed - report the error (which closes the
+            // connection) without sending the final chunk
+            onError_(error);
+            return;
+         }
+
          // no more chunks to send - send final empty chunk
          writeFinalChunk();
       }
@@ -0,0 +1,68 @@
+/*
+ * ZipStreamResponse.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_ZIP_STREAM_RESPONSE_HPP
+#define CORE_HTTP_ZIP_STREAM_RESPONSE_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <shared_core/FilePath.hpp>
+
+#include <core/http/Response.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+// Streams a zip archive of a set of files and directories (given relative
+// to a common parent, directories are included recursively) as a chunked
+// response. Entries are deflated as the response is written, so the archive
+// is never materialized on disk or in memory. Data descriptors are used so
+// sizes needn't be known up front (with zip64 sizes, as any file might need
+// them), and the central directory has zip64 records when sizes, offsets or
+// entry counts exceed the limits of the classic format. If a file can't be
+// read or compressed part way through, the stream ends early with
+// streamError() set, so that the response is aborted rather than completed.
+class ZipStreamResponse : public StreamResponse
+{
+public:
+   ZipStreamResponse(const FilePath& parentPath,
+                     const std::vector<std::string>& files,
+                     std::streamsize bufferSize = 65536);
+
+   virtual ~ZipStreamResponse();
+
+   // use zip64 records for sizes and offsets from the given threshold (which
+   // is lowered from 4GB in tests, to produce zip64 archives from small files)
+   void setZip64Threshold(boost::uint64_t threshold);
+
+   Error initialize();
+   std::shared_ptr<StreamBuffer> nextBuffer();
+   Error streamError() const;
+
+private:
+   struct Impl;
+   boost::shared_ptr<Impl> pImpl_;
+};
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_ZIP_STREAM_RESPONSE_HPP
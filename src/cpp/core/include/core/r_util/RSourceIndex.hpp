@@ -194,8 +194,14 @@ public:
    //   - Must be UTF-8 encoded
    //   - Must use \n only for linebreaks
    //
+   // Packages inferred from the code are shared with all other indexes
+   // unless registerInferredPackages is false; the caller should then add
+   // them itself (via addGloballyInferredPackage). This allows indexes to
+   // be built on a background thread, as the shared state isn't thread safe.
+   //
    RSourceIndex(const std::string& context,
-                const std::string& code);
+                const std::string& code,
+                bool registerInferredPackages = true);
 
    const std::string& context() const { return context_; }
 
@@ -371,7 +377,8 @@ public:
    void addInferredPackage(const std::string& packageName)
    {
       inferredPkgNames_.push_back(packageName);
-      allInferredPkgNames().insert(packageName);
+      if (registerInferredPackages_)
+         allInferredPkgNames().insert(packageName);
    }
    
    static void addGloballyInferredPackage(const std::string& pkgName)
@@ -426,6 +433,7 @@ private:
    // but we share that state in a static variable (so that we can
    // cache and share across all indexes)
    std::vector<std::string> inferredPkgNames_;
+   bool registerInferredPackages_;
    
    static std::set<std::string>& importedPackages()
    {
@@ -39,16 +39,6 @@ using namespace core::r_util::token_utils;
 // tokens are valid.
 class RTokenCursor
 {
-private:
-   
-   RTokenCursor(const core::r_util::RTokens &rTokens,
-               std::size_t offset,
-               std::size_t n)
-      : rTokens_(rTokens),
-        offset_(offset),
-        n_(n)
-   {}
-   
 public:
    
    explicit RTokenCursor(const core::r_util::RTokens& rTokens)
@@ -58,6 +48,16 @@ public:
                std::size_t offset)
       : rTokens_(rTokens), offset_(offset), n_(rTokens.size()) {}
    
+   // a cursor which treats the token at 'n - 1' as the end of the
+   // document (e.g. to parse a single expression within a document)
+   RTokenCursor(const core::r_util::RTokens &rTokens,
+               std::size_t offset,
+               std::size_t n)
+      : rTokens_(rTokens),
+        offset_(offset),
+        n_(n)
+   {}
+   
    RTokenCursor clone() const
    {
       return RTokenCursor(rTokens_, offset_, n_);
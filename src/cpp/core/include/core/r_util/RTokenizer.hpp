@@ -16,7 +16,9 @@
 #ifndef CORE_R_UTIL_R_TOKENIZER_HPP
 #define CORE_R_UTIL_R_TOKENIZER_HPP
 
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 #include <deque>
 #include <algorithm>
@@ -52,6 +54,10 @@ namespace r_util {
 // which yielded them (RTokenizer or RTokens) is alive. This is because
 // they contain iterators into the original source data rather than their
 // own copy of their contents.
+//
+// Tokens are kept small (an iterator plus 32-bit lengths and positions)
+// as documents are tokenized into large vectors of them; positions are
+// limited to 4GB, which is well beyond any document we'd tokenize.
 class RToken final
 {
 public:
@@ -87,17 +93,21 @@ public:
           std::size_t offset,
           std::size_t row,
           std::size_t column)
-      : type_(type), begin_(begin), end_(end),
-        offset_(offset), row_(row), column_(column)
+      : begin_(begin),
+        length_(static_cast<uint32_t>(end - begin)),
+        offset_(static_cast<uint32_t>(offset)),
+        row_(static_cast<uint32_t>(row)),
+        column_(static_cast<uint32_t>(column)),
+        type_(type)
    {
    }
    
    // accessors
    TokenType type() const { return type_; }
-   std::wstring content() const { return std::wstring(begin_, end_); }
+   std::wstring content() const { return std::wstring(begin_, end()); }
    const std::string& contentAsUtf8() const;
    std::size_t offset() const { return offset_; }
-   std::size_t length() const { return end_ - begin_; }
+   std::size_t length() const { return length_; }
    std::size_t row() const { return row_; }
    std::size_t column() const { return column_; }
    
@@ -109,30 +119,29 @@ public:
    // efficient comparison operations
    bool contentEquals(const std::wstring& text) const
    {
-      std::size_t distance = std::distance(begin_, end_);
-      return distance == text.size() &&
-             std::equal(begin_, end_, text.begin());
+      return length_ == text.size() &&
+             std::equal(begin_, end(), text.begin());
    }
    
    bool contentEquals(wchar_t character) const
    {
-      return std::distance(begin_, end_) == 1 && *begin_ == character;
+      return length_ == 1 && *begin_ == character;
    }
    
    bool contentContains(const wchar_t character) const
    {
-      return std::find(begin_, end_, character) != end_;
+      return std::find(begin_, end(), character) != end();
    }
 
    bool contentStartsWith(const std::wstring& text) const
    {
-      return std::search(begin_, end_, text.begin(), text.end()) == begin_;
+      return std::search(begin_, end(), text.begin(), text.end()) == begin_;
    }
 
    bool isOperator(const std::wstring& op) const
    {
       return (type_ == RToken::OPER) &&
-              std::equal(begin_, end_, op.begin());
+              std::equal(begin_, end(), op.begin());
    }
 
    bool isType(TokenType type) const
@@ -143,7 +152,7 @@ public:
    // allow direct use in conditional statements (nullability)
    explicit operator bool() const
    {
-      return offset_ != static_cast<std::size_t>(-1);
+      return offset_ != kNoOffset;
    }
    
    std::wstring::const_iterator begin() const
@@ -153,12 +162,12 @@ public:
    
    std::wstring::const_iterator end() const
    {
-      return end_;
+      return begin_ + length_;
    }
    
    std::pair<std::wstring::const_iterator, std::wstring::const_iterator> range() const
    {
-      return std::make_pair(begin_, end_);
+      return std::make_pair(begin_, end());
    }
    
    std::string asString() const;
@@ -169,13 +178,21 @@ public:
    }
 
 private:
-   std::wstring emptyToken_;
+   static const uint32_t kNoOffset = static_cast<uint32_t>(-1);
+
+   // (null tokens refer to a shared empty string)
+   static const std::wstring& emptyContent()
+   {
+      static const std::wstring instance;
+      return instance;
+   }
+
+   std::wstring::const_iterator begin_ = emptyContent().cbegin();
+   uint32_t length_ = 0;
+   uint32_t offset_ = kNoOffset;
+   uint32_t row_ = 0;
+   uint32_t column_ = 0;
    TokenType type_ = TokenType::ERR;
-   std::wstring::const_iterator begin_ = emptyToken_.cbegin();
-   std::wstring::const_iterator end_ = emptyToken_.cend();
-   std::size_t offset_ = -1;
-   std::size_t row_ = 0;
-   std::size_t column_ = 0;
 };
 
 // Tokenize R code. Note that the RToken instances which are returned are
@@ -195,6 +212,17 @@ public:
    {
    }
 
+   // (takes the data rather than copying it)
+   explicit RTokenizer(std::wstring&& data)
+      : data_(std::move(data)),
+        begin_(data_.begin()),
+        end_(data_.end()),
+        pos_(data_.begin()),
+        row_(0),
+        column_(0)
+   {
+   }
+
    virtual ~RTokenizer() {}
 
    // COPYING: boost::noncopyable
@@ -277,16 +305,14 @@ public:
    explicit RTokens(const std::wstring& code, int flags = None)
       : tokenizer_(code)
    {
-      while (RToken token = tokenizer_.nextToken())
-      {
-         if ((flags & StripWhitespace) && token.type() == RToken::WHITESPACE)
-            continue;
-
-         if ((flags & StripComments) && token.type() == RToken::COMMENT)
-            continue;
+      tokenize(flags);
+   }
 
-         push_back(token);
-      }
+   // (takes the code rather than copying it, e.g. when converted from UTF-8)
+   explicit RTokens(std::wstring&& code, int flags = None)
+      : tokenizer_(std::move(code))
+   {
+      tokenize(flags);
    }
    
    friend std::ostream& operator <<(std::ostream& os,
@@ -298,6 +324,24 @@ public:
    }
 
 private:
+   void tokenize(int flags)
+   {
+      while (RToken token = tokenizer_.nextToken())
+      {
+         if ((flags & StripWhitespace) && token.type() == RToken::WHITESPACE)
+            continue;
+
+         if ((flags & StripComments) && token.type() == RToken::COMMENT)
+            continue;
+
+         push_back(token);
+      }
+
+      // tokens are kept for the lifetime of the document, so release the
+      // excess capacity left by growing the vector
+      tokens_.shrink_to_fit();
+   }
+
     RTokenizer tokenizer_;
     Tokens tokens_;
     RToken dummyToken_;
@@ -218,6 +218,24 @@ public:
    // has it exited?
    virtual bool exited();
 
+   // get the descriptors which become ready when the process produces
+   // output or exits (used by the ProcessSupervisor to avoid polling idle
+   // children). returns false if the process can't be monitored this way
+   // (e.g. it hasn't been started by an initial call to poll)
+   bool getEventDescriptors(std::vector<int>* pFds) const;
+
+   // does the process need to be polled on every pass even when none of
+   // its event descriptors are ready? (e.g. to track subprocesses or the
+   // current working directory of a terminal)
+   bool requiresPeriodicPoll() const;
+
+   // is the process's output being left unread? (see
+   // ProcessCallbacks::shouldPauseOutput)
+   bool isOutputPaused() const
+   {
+      return callbacks_.shouldPauseOutput && callbacks_.shouldPauseOutput();
+   }
+
    // override of terminate (allow special handling for unix pty termination)
    virtual Error terminate();
 
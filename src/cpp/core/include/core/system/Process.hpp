@@ -322,6 +322,12 @@ struct ProcessCallbacks
    // Streaming callback for standard output
    boost::function<void(ProcessOperations&, const std::string&)> onStdout;
 
+   // Called before output is read; if it returns true then the output is
+   // left unread until a later poll (so a child whose output can't be
+   // consumed as fast as it's produced blocks once its pipe or pseudoterminal
+   // fills, rather than having its output buffered without limit)
+   boost::function<bool()> shouldPauseOutput;
+
    // Streaming callback for standard error
    boost::function<void(ProcessOperations&, const std::string&)> onStderr;
 
@@ -416,13 +422,16 @@ public:
    bool hasActiveChildren();
 
    // Poll for child (output and exit) events. returns true if there
-   // are still children being supervised after the poll
+   // are still children being supervised after the poll. where supported
+   // (Linux) only children with pending output or exit events are polled;
+   // idle children are checked at a reduced rate
    bool poll();
 
    // Terminate all running children
    void terminateAll();
 
-   // Wait for all children to exit. Returns false if the operation timed out
+   // Wait for all children to exit. Returns false if the operation timed out.
+   // Output and exit events wake the wait before the polling interval elapses.
    bool wait(
       const boost::posix_time::time_duration& pollingInterval =
          boost::posix_time::milliseconds(100),
@@ -16,6 +16,7 @@
 #ifndef TERM_BUFFER_PARSER_HPP
 #define TERM_BUFFER_PARSER_HPP
 
+#include <cstddef>
 #include <string>
 
 namespace rstudio {
@@ -39,6 +40,37 @@ std::string stripSecondaryBuffer(
       const std::string& str, // string to parse
       bool* pAltModeActive); // (optional in/out) is string "in" alt-buffer mode?
 
+// Removes alt-buffer text (as stripSecondaryBuffer does) from a stream of
+// output given in chunks. Escape sequences may be split between chunks: the
+// start of an escape sequence at the end of a chunk is held until the next
+// chunk shows whether it's an alt-buffer sequence. Text between escapes is
+// found with memchr and copied in runs.
+class SecondaryBufferFilter
+{
+public:
+   explicit SecondaryBufferFilter(bool altBufferActive = false);
+
+   // appends the text of the chunk which isn't in the alt-buffer to pOutput
+   void filter(const char* pData, std::size_t size, std::string* pOutput);
+   void filter(const std::string& str, std::string* pOutput)
+   {
+      filter(str.data(), str.size(), pOutput);
+   }
+
+   // appends the start of an escape sequence held from the last chunk
+   // (e.g. at the end of the output)
+   void flush(std::string* pOutput);
+
+   bool altBufferActive() const { return altBufferActive_; }
+   void setAltBufferActive(bool altBufferActive);
+
+private:
+   bool altBufferActive_;
+
+   // the start of an escape sequence (ESC [ ? digits) held from the last chunk
+   std::string pending_;
+};
+
 } // namespace text
 } // namespace core
 } // namespace rstudio
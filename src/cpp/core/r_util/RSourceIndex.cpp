@@ -550,8 +550,11 @@ std::vector<Indexer> makeIndexers()
 
 }  // anonymous namespace
 
-RSourceIndex::RSourceIndex(const std::string& context, const std::string& code)
-   : context_(context)
+RSourceIndex::RSourceIndex(const std::string& context,
+                           const std::string& code,
+                           bool registerInferredPackages)
+   : context_(context),
+     registerInferredPackages_(registerInferredPackages)
 {
    static std::vector<Indexer> indexers = makeIndexers();
    
@@ -559,8 +562,8 @@ RSourceIndex::RSourceIndex(const std::string& context, const std::string& code)
    inferredPkgNames_.clear();
 
    // tokenize and create token cursor
-   std::wstring wCode = string_utils::utf8ToWide(code, context);
-   RTokens rTokens(wCode, RTokens::StripWhitespace | RTokens::StripComments);
+   RTokens rTokens(string_utils::utf8ToWide(code, context),
+                   RTokens::StripWhitespace | RTokens::StripComments);
    if (rTokens.empty())
       return;
    
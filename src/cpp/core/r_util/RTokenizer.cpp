@@ -30,6 +30,7 @@
 #include <core/r_util/RTokenizer.hpp>
 
 #include <boost/regex.hpp>
+#include <boost/thread/tss.hpp>
 
 #include <iostream>
 #include <sstream>
@@ -655,8 +656,11 @@ private:
 
 ConversionCache& conversionCache()
 {
-   static ConversionCache instance;
-   return instance;
+   // one cache per thread, as R code may be tokenized on background threads
+   static boost::thread_specific_ptr<ConversionCache> s_pInstance;
+   if (s_pInstance.get() == nullptr)
+      s_pInstance.reset(new ConversionCache());
+   return *s_pInstance;
 }
 
 const std::string& RToken::contentAsUtf8() const
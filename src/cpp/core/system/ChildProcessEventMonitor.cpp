@@ -0,0 +1,244 @@
+/*
+ * ChildProcessEventMonitor.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ChildProcessEventMonitor.hpp"
+
+#include <set>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+
+#include <boost/thread/thread.hpp>
+
+#include <shared_core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/system/ChildProcess.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+namespace {
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+#ifdef __linux__
+
+// maximum number of events to collect in a single pass; if this many are
+// returned we conservatively poll every child
+const int kMaxEvents = 64;
+
+int toMilliseconds(const boost::posix_time::time_duration& duration)
+{
+   if (duration.is_special() || duration.is_negative())
+      return 0;
+   return static_cast<int>(duration.total_milliseconds());
+}
+
+#endif
+
+} // anonymous namespace
+
+ChildProcessEventMonitor::ChildProcessEventMonitor(
+      boost::posix_time::time_duration idlePollInterval)
+   : epollFd_(-1),
+     overflowed_(false),
+     nextId_(1),
+     idlePollInterval_(idlePollInterval)
+{
+#ifdef __linux__
+   epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+   if (epollFd_ == -1)
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+#endif
+}
+
+ChildProcessEventMonitor::~ChildProcessEventMonitor()
+{
+#ifdef __linux__
+   if (epollFd_ != -1)
+      ::close(epollFd_);
+#endif
+}
+
+bool ChildProcessEventMonitor::armDescriptors(AsyncChildProcess* pChild,
+                                              const Entry& entry,
+                                              int op)
+{
+#ifdef __linux__
+   // note that the returned descriptors are always open (the child resets
+   // them as it closes them) and exclude pipes which have reached EOF, so
+   // a finished pipe stops waking us once it has been reported
+   std::vector<int> fds;
+   if (!pChild->getEventDescriptors(&fds))
+      return false;
+
+   // registrations are never explicitly removed: the descriptors are closed
+   // by the child when it exits (which removes them from the epoll set) and
+   // stale events are ignored since they carry an id which is no longer in
+   // our table
+   std::set<int> armed;
+   for (int fd : fds)
+   {
+      if (!armed.insert(fd).second)
+         continue;
+
+      struct epoll_event event;
+      event.events = EPOLLIN | EPOLLONESHOT;
+      event.data.u64 = entry.id;
+      if (::epoll_ctl(epollFd_, op, fd, &event) == -1)
+      {
+         // a descriptor can be missing from the set if it was first
+         // reported after registration (e.g. nothing to re-arm)
+         if (op == EPOLL_CTL_MOD && errno == ENOENT)
+            continue;
+
+         Error error = systemError(errno, ERROR_LOCATION);
+         error.addProperty("fd", fd);
+         LOG_ERROR(error);
+         return false;
+      }
+   }
+
+   return true;
+#else
+   return false;
+#endif
+}
+
+void ChildProcessEventMonitor::collectEvents(int timeoutMs)
+{
+#ifdef __linux__
+   // events are one-shot so once collected they are held in pendingIds_
+   // until the corresponding children are selected
+   struct epoll_event events[kMaxEvents];
+   int count = ::epoll_wait(epollFd_, events, kMaxEvents, timeoutMs);
+   if (count == -1)
+   {
+      if (errno != EINTR)
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      overflowed_ = true;
+      return;
+   }
+
+   for (int i = 0; i < count; i++)
+      pendingIds_.insert(events[i].data.u64);
+   if (count == kMaxEvents)
+      overflowed_ = true;
+#endif
+}
+
+void ChildProcessEventMonitor::selectChildren(
+      const std::vector<boost::shared_ptr<AsyncChildProcess> >& children,
+      std::vector<boost::shared_ptr<AsyncChildProcess> >* pSelected)
+{
+   // without epoll everyone gets polled
+   if (epollFd_ == -1)
+   {
+      *pSelected = children;
+      return;
+   }
+
+   collectEvents(0);
+   bool pollAll = overflowed_;
+   overflowed_ = false;
+
+   boost::posix_time::ptime currentTime = now();
+   for (const boost::shared_ptr<AsyncChildProcess>& pChild : children)
+   {
+      Entry& entry = entries_[pChild.get()];
+      if (entry.id == 0)
+         entry.id = nextId_++;
+
+      bool ready = pendingIds_.erase(entry.id) > 0;
+
+      bool unregistered = !entry.registered;
+      if (unregistered && entry.paused)
+      {
+         entry.paused = pChild->isOutputPaused();
+         unregistered = !entry.paused;
+      }
+
+      bool select =
+            pollAll ||
+            ready ||
+            unregistered ||
+            pChild->requiresPeriodicPoll() ||
+            entry.lastPolled.is_not_a_date_time() ||
+            (currentTime - entry.lastPolled) >= idlePollInterval_;
+
+      if (!select)
+         continue;
+
+      // register children which have started since the last pass, and
+      // re-arm the descriptors of the others since they are about to be
+      // polled (any output that remains afterwards fires a new event)
+      if (!entry.registered)
+      {
+#ifdef __linux__
+         entry.registered = armDescriptors(pChild.get(), entry, EPOLL_CTL_ADD);
+         entry.paused = !entry.registered && pChild->isOutputPaused();
+#endif
+      }
+      else
+      {
+#ifdef __linux__
+         armDescriptors(pChild.get(), entry, EPOLL_CTL_MOD);
+#endif
+      }
+
+      entry.lastPolled = currentTime;
+      pSelected->push_back(pChild);
+   }
+
+   // anything left over was reported for a child which is no longer
+   // being supervised
+   pendingIds_.clear();
+}
+
+void ChildProcessEventMonitor::remove(AsyncChildProcess* pChild)
+{
+   std::map<AsyncChildProcess*, Entry>::iterator it = entries_.find(pChild);
+   if (it != entries_.end())
+   {
+      pendingIds_.erase(it->second.id);
+      entries_.erase(it);
+   }
+}
+
+void ChildProcessEventMonitor::waitForEvents(
+      const boost::posix_time::time_duration& timeout)
+{
+#ifdef __linux__
+   if (epollFd_ != -1)
+   {
+      if (pendingIds_.empty() && !overflowed_)
+         collectEvents(toMilliseconds(timeout));
+      return;
+   }
+#endif
+
+   boost::this_thread::sleep(timeout);
+}
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
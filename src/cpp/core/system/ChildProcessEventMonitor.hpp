@@ -0,0 +1,96 @@
+/*
+ * ChildProcessEventMonitor.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_SYSTEM_CHILD_PROCESS_EVENT_MONITOR_HPP
+#define CORE_SYSTEM_CHILD_PROCESS_EVENT_MONITOR_HPP
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+class AsyncChildProcess;
+
+// Decides which children of a ProcessSupervisor need to be polled.
+//
+// On Linux the output pipes and pidfd of each child are registered (one-shot)
+// with an epoll instance, so a child is only polled when it has output
+// pending or has exited; descriptors are re-armed each time the child is
+// polled. Children which require periodic work (subprocess and cwd
+// tracking for terminals) are polled on every pass, and idle children are
+// still polled every "idlePollInterval" so that onContinue callbacks,
+// recent-output tracking and exits which can't be observed through a
+// descriptor (no pidfd support and the pipes held open by a grandchild)
+// continue to work.
+//
+// On other platforms (or if epoll is unavailable) every child is polled on
+// every pass, which is the traditional ProcessSupervisor behavior.
+//
+class ChildProcessEventMonitor : boost::noncopyable
+{
+public:
+   explicit ChildProcessEventMonitor(
+         boost::posix_time::time_duration idlePollInterval);
+   virtual ~ChildProcessEventMonitor();
+
+   // determine which of the children should be polled now
+   void selectChildren(
+         const std::vector<boost::shared_ptr<AsyncChildProcess> >& children,
+         std::vector<boost::shared_ptr<AsyncChildProcess> >* pSelected);
+
+   // stop monitoring a child (call once it has exited)
+   void remove(AsyncChildProcess* pChild);
+
+   // block until one of the monitored children has an event or the timeout
+   // elapses (returns immediately if events are already pending)
+   void waitForEvents(const boost::posix_time::time_duration& timeout);
+
+private:
+   struct Entry
+   {
+      Entry() : id(0), registered(false), paused(false) {}
+      boost::uint64_t id;
+      bool registered;
+
+      // output was paused when the child was to be registered, so it's
+      // polled as an idle child until it's resumed (and registered)
+      bool paused;
+      boost::posix_time::ptime lastPolled;
+   };
+
+   bool armDescriptors(AsyncChildProcess* pChild, const Entry& entry, int op);
+   void collectEvents(int timeoutMs);
+
+   int epollFd_;
+   bool overflowed_;
+   std::set<boost::uint64_t> pendingIds_;
+   boost::uint64_t nextId_;
+   boost::posix_time::time_duration idlePollInterval_;
+   std::map<AsyncChildProcess*, Entry> entries_;
+};
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_SYSTEM_CHILD_PROCESS_EVENT_MONITOR_HPP
@@ -32,6 +32,10 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
 
@@ -920,13 +924,52 @@ struct AsyncChildProcess::AsyncImpl
       : calledOnStarted_(false),
         finishedStdout_(false),
         finishedStderr_(false),
-        exited_(false)
+        exited_(false),
+        pidFd_(-1)
+   {
+   }
+
+   ~AsyncImpl()
+   {
+      try
+      {
+         closePidFd();
+      }
+      catch(...)
+      {
+      }
+   }
+
+   // open a descriptor which becomes readable when the process exits. this
+   // requires Linux 5.3 or later; on other systems (or if the process was
+   // already reaped) the descriptor is left unset and exit is detected
+   // through the output pipes and periodic polling instead
+   void openPidFd(PidType pid)
    {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+      int fd = static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+      if (fd != -1)
+      {
+         ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+         pidFd_ = fd;
+      }
+#endif
    }
+
+   void closePidFd()
+   {
+      if (pidFd_ != -1)
+      {
+         closePipe(pidFd_, ERROR_LOCATION);
+         pidFd_ = -1;
+      }
+   }
+
    bool calledOnStarted_;
    bool finishedStdout_;
    bool finishedStderr_;
    bool exited_;
+   int pidFd_;
    boost::scoped_ptr<ChildProcessSubprocPoll> pSubprocPoll_;
 };
 
@@ -1027,6 +1070,9 @@ void AsyncChildProcess::poll()
       else
          setPipeNonBlocking(pImpl_->fdStderr);
 
+      // open a pidfd so the supervisor can be notified of exit
+      pAsyncImpl_->openPidFd(pImpl_->pid);
+
       // setup for subprocess polling
       pAsyncImpl_->pSubprocPoll_.reset(new ChildProcessSubprocPoll(
          pImpl_->pid,
@@ -1051,6 +1097,11 @@ void AsyncChildProcess::poll()
       }
    }
 
+   // leave the output unread if asked to; the exit is checked for once it's
+   // read again, so that none of the output is lost
+   if (isOutputPaused())
+      return;
+
    bool hasRecentOutput = false;
 
    // check stdout and fire event if we got output
@@ -1115,6 +1166,7 @@ void AsyncChildProcess::poll()
    {
       // close all of our pipes
       pImpl_->closeAll(ERROR_LOCATION);
+      pAsyncImpl_->closePidFd();
 
       // fire exit event
       if (callbacks_.onExit)
@@ -1161,6 +1213,37 @@ bool AsyncChildProcess::exited()
    return pAsyncImpl_->exited_;
 }
 
+bool AsyncChildProcess::getEventDescriptors(std::vector<int>* pFds) const
+{
+   // descriptors aren't configured for non-blocking reads until the
+   // first poll, so we can't be monitored until then
+   if (!pAsyncImpl_->calledOnStarted_ || pAsyncImpl_->exited_)
+      return false;
+
+   // while output is paused its descriptors stay ready, so the process is
+   // polled instead (until it's resumed)
+   if (isOutputPaused())
+      return false;
+
+   pFds->clear();
+   if (!pAsyncImpl_->finishedStdout_ && pImpl_->fdStdout != -1)
+      pFds->push_back(pImpl_->fdStdout);
+   if (!pAsyncImpl_->finishedStderr_ && pImpl_->fdStderr != -1)
+      pFds->push_back(pImpl_->fdStderr);
+   if (pAsyncImpl_->pidFd_ != -1)
+      pFds->push_back(pAsyncImpl_->pidFd_);
+
+   return true;
+}
+
+bool AsyncChildProcess::requiresPeriodicPoll() const
+{
+   // subprocess and cwd tracking are driven by the poll itself
+   return !pAsyncImpl_->calledOnStarted_ ||
+          options().reportHasSubprocs ||
+          options().trackCwd;
+}
+
 struct AsioAsyncChildProcess::Impl : public boost::enable_shared_from_this<AsioAsyncChildProcess::Impl>
 {
    Impl(AsioAsyncChildProcess* parent,
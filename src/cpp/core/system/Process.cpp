@@ -30,6 +30,8 @@
 
 #include <core/Thread.hpp>
 
+#include "ChildProcessEventMonitor.hpp"
+
 using namespace boost::placeholders;
 
 namespace rstudio {
@@ -79,11 +81,21 @@ Error runCommand(const std::string& command,
 }
 
 
+namespace {
+
+// how often children with no pending output or exit events are polled
+// anyway (e.g. to invoke onContinue and expire recent output state)
+const boost::posix_time::milliseconds kIdleChildPollInterval =
+                                         boost::posix_time::milliseconds(250);
+
+} // anonymous namespace
+
 struct ProcessSupervisor::Impl
 {
-   Impl() : isPolling(false) {}
+   Impl() : isPolling(false), eventMonitor(kIdleChildPollInterval) {}
    bool isPolling;
    std::vector<boost::shared_ptr<AsyncChildProcess> > children;
+   ChildProcessEventMonitor eventMonitor;
 };
 
 ProcessSupervisor::ProcessSupervisor()
@@ -338,14 +350,17 @@ bool ProcessSupervisor::poll()
       pImpl_->isPolling = true;
       scope::SetOnExit<bool> setOnExit(&pImpl_->isPolling, false);
 
-      // call poll on all of our children via a copy of the std::vector that
-      // holds all of the children. we do this because 'poll' can end up
-      // executing R code (e.g. via onContinue) which can in term end up
-      // executing background tasks that result in a call to processSupervisor
-      // runProgram or runCommand. This would then result in a push_back on
-      // the children vector and if this requried a realloc would invalidate
-      // all of the iterators currently pointing into the container
-      std::vector<boost::shared_ptr<AsyncChildProcess> > children = pImpl_->children;
+      // call poll on the children which have pending events (or otherwise
+      // need polling, see ChildProcessEventMonitor) via a copy of the
+      // std::vector that holds all of the children. we do this because 'poll'
+      // can end up executing R code (e.g. via onContinue) which can in term
+      // end up executing background tasks that result in a call to
+      // processSupervisor runProgram or runCommand. This would then result in
+      // a push_back on the children vector and if this requried a realloc
+      // would invalidate all of the iterators currently pointing into the
+      // container
+      std::vector<boost::shared_ptr<AsyncChildProcess> > children;
+      pImpl_->eventMonitor.selectChildren(pImpl_->children, &children);
       std::for_each(children.begin(),
                     children.end(),
                     boost::bind(&AsyncChildProcess::poll, _1));
@@ -354,6 +369,11 @@ bool ProcessSupervisor::poll()
       // in this case to use pImpl_->children directly because the call to
       // AsyncChildProcess::exited just checks a member variable rather than
       // executing code that could cause re-entry
+      for (const boost::shared_ptr<AsyncChildProcess>& pChild : children)
+      {
+         if (pChild->exited())
+            pImpl_->eventMonitor.remove(pChild.get());
+      }
       pImpl_->children.erase(std::remove_if(
                                 pImpl_->children.begin(),
                                 pImpl_->children.end(),
@@ -388,8 +408,9 @@ bool ProcessSupervisor::wait(
 
    while (poll())
    {
-      // wait the specified polling interval
-      boost::this_thread::sleep(pollingInterval);
+      // wait up to the specified polling interval (returns early if a
+      // child produces output or exits)
+      pImpl_->eventMonitor.waitForEvents(pollingInterval);
 
       // check for timeout if appropriate
       if (!timeoutTime.is_not_a_date_time())
@@ -590,6 +590,52 @@ test_context("ProcessTests")
 
       REQUIRE(exitCode == 1);
    }
+
+   test_that("ProcessSupervisor delivers output from idle children")
+   {
+      ProcessSupervisor supervisor;
+
+      ProcessOptions options;
+      ProcessCallbacks callbacks;
+
+      int exitCode = -1;
+      std::string output;
+      callbacks.onExit = boost::bind(&checkExitCode, _1, &exitCode);
+      callbacks.onStdout = boost::bind(&appendOutput, _2, &output);
+
+      // the child is idle (no output) for a while before writing
+      Error error = supervisor.runCommand("sleep 0.5; echo first; sleep 0.5; echo second",
+                                          options,
+                                          callbacks);
+      REQUIRE_FALSE(error);
+
+      bool success = supervisor.wait(boost::posix_time::milliseconds(10),
+                                     boost::posix_time::seconds(10));
+      CHECK(success);
+      CHECK(exitCode == 0);
+      CHECK(output == "first\nsecond\n");
+   }
+
+   test_that("ProcessSupervisor detects exit while output pipe is held open")
+   {
+      ProcessSupervisor supervisor;
+
+      ProcessOptions options;
+      ProcessCallbacks callbacks;
+
+      int exitCode = -1;
+      callbacks.onExit = boost::bind(&checkExitCode, _1, &exitCode);
+
+      // the backgrounded sleep inherits (and holds open) stdout after the
+      // shell itself exits, so exit can't be inferred from EOF
+      Error error = supervisor.runCommand("sleep 5 & exit 3", options, callbacks);
+      REQUIRE_FALSE(error);
+
+      bool success = supervisor.wait(boost::posix_time::milliseconds(10),
+                                     boost::posix_time::seconds(3));
+      CHECK(success);
+      CHECK(exitCode == 3);
+   }
 }
 
 } // end namespace tests
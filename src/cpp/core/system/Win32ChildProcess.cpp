@@ -708,6 +708,11 @@ void AsyncChildProcess::poll()
       }
    }
 
+   // leave the output unread if asked to; the exit is checked for once it's
+   // read again, so that none of the output is lost
+   if (isOutputPaused())
+      return;
+
    bool hasRecentOutput = false;
 
    // check stdout
@@ -806,6 +811,17 @@ bool AsyncChildProcess::exited()
    return pImpl_->hProcess == nullptr;
 }
 
+bool AsyncChildProcess::getEventDescriptors(std::vector<int>* pFds) const
+{
+   // pipe handles can't be waited on for readability so we always poll
+   return false;
+}
+
+bool AsyncChildProcess::requiresPeriodicPoll() const
+{
+   return true;
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
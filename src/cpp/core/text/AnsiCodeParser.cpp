@@ -36,9 +36,19 @@ void stripAnsiCodes(std::string* pStr)
    if (!pStr)
       return;
 
+   // most text has no escapes at all; it's returned as is rather than run
+   // through the expressions
+   if (pStr->find('\x1b') == std::string::npos &&
+       pStr->find('\x9b') == std::string::npos)
+      return;
+
+   static const boost::regex reAnsi(kAnsiMatch);
+   static const boost::regex reXTermTitle(kXTermTitleMatch);
+
    std::string replacement;
-   *pStr = boost::regex_replace(*pStr, boost::regex(kAnsiMatch), replacement);
-   *pStr = boost::regex_replace(*pStr, boost::regex(kXTermTitleMatch), replacement);
+   *pStr = boost::regex_replace(*pStr, reAnsi, replacement);
+   if (pStr->find('\x1b') != std::string::npos)
+      *pStr = boost::regex_replace(*pStr, reXTermTitle, replacement);
 }
 
 } // namespace text
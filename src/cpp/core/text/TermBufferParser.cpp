@@ -15,173 +15,88 @@
 
 #include <core/text/TermBufferParser.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 namespace rstudio {
 namespace core {
 namespace text {
 
 namespace {
 
-enum ParseState {
-   NORMAL,			// parsing regular text
-   HAVE_ESC,      // found an ESC
-   HAVE_BRACKET,  // found a [ after an ESC
-   HAVE_QM,       // found a ? after ESC[
-   HAVE_INT,      // finding one or more digits after ESC[?
-   HAVE_TERM      // found 'h' or 'l' after ESC[?nnnn
-};
-
-struct ParseMetadata
-{
-   ParseMetadata(bool altActive /*initial buffer state*/)
-      :
-        state(NORMAL),
-        haveSupportedSeq(false),
-        currentCh('\0'),
-        startCount(0)
-   {
-      if (altActive) // in alt-buffer mode from the start
-         startCount = 1;
-   }
-
-   void setNewState(ParseState newState, size_t index, char ch)
-   {
-      if (newState == state)
-         return;
-
-      state = newState;
-      currentCh = ch;
+const char kEsc = '\033';
 
-      switch(newState)
-      {
-      case NORMAL:
-         haveSupportedSeq = false;
-         break;
-
-      case HAVE_ESC:
-         escSequence.push_back(ch);
-         break;
-
-      case HAVE_BRACKET:
-      case HAVE_QM:
-         escSequence.push_back(ch);
-         break;
-
-      case HAVE_INT:
-         // start accumulating ints until we get a non-int
-         numberStr.clear();
-         numberStr.push_back(ch);
-         escSequence.push_back(ch);
-         break;
-
-      case HAVE_TERM:
-         escSequence.push_back(ch);
-         if (ch == 'h' || ch == 'l')
-         {
-            if (!numberStr.compare("1049") ||
-                 !numberStr.compare("1047") ||
-                 !numberStr.compare("47"))
-             {
-               // found a valid alt-buffer sequence
-               haveSupportedSeq = true;
-             }
-         }
-         break;
+// alt-buffer sequences have at most this many digits; longer runs of digits
+// aren't looked through
+const std::size_t kMaxDigits = 8;
 
-      default:
-         break;
-      }
-   }
-
-   void continueState(size_t index, char ch)
-   {
-      currentCh = ch;
-
-      switch (state)
-      {
-      case HAVE_INT:
-         numberStr.push_back(ch);
-         escSequence.push_back(ch);
-         break;
+enum SequenceType {
+   PartialSequence,   // the data ends before the sequence does
+   OtherSequence,     // not an alt-buffer sequence
+   AltStartSequence,  // ESC[?1049h, ESC[?1047h, ESC[?47h
+   AltEndSequence     // ESC[?1049l, ESC[?1047l, ESC[?47l
+};
 
-      default:
-         break;
-      }
-   }
+bool isDigit(char ch)
+{
+   return ch >= '0' && ch <= '9';
+}
 
-   void processState(bool lastCall)
+// the type of the escape sequence starting at pBegin (an ESC) and its length;
+// for other sequences, the length is that of the part which looked like it
+// could be an alt-buffer sequence
+SequenceType scanSequence(const char* pBegin, const char* pEnd, std::size_t* pLength)
+{
+   const char* p = pBegin + 1;
+   const char* prefix = "[?";
+   for (; *prefix; ++prefix, ++p)
    {
-      switch (state)
-      {
-      case HAVE_TERM:
-         if (!haveSupportedSeq)
-         {
-            // write out unknown sequence if we're not already inside
-            // alternate buffer
-            if (startCount == 0)
-               output.append(escSequence); // pass through ESC sequence
-         }
-         else
-         {
-            if (currentCh == 'h') // start alt-buffer
-               startCount++;
-            else
-               startCount = 0;
-         }
-
-         escSequence.clear();
-         state = NORMAL;
-         break;
-
-      case NORMAL:
-         if (startCount == 0 && !lastCall)
-         {
-            if (!escSequence.empty())
-            {
-               output.append(escSequence);
-               escSequence.clear();
-            }
-            output.push_back(currentCh);
-         }
-         break;
-
-      default:
-         break;
-      }
-
-      if (lastCall)
+      if (p == pEnd)
+         return PartialSequence;
+      if (*p != *prefix)
       {
-         if (startCount == 0 && !escSequence.empty())
-         {
-            output.append(escSequence);
-         }
+         *pLength = p - pBegin;
+         return OtherSequence;
       }
    }
 
-   ParseState state;
-
-   // output buffer
-   std::string output;
+   const char* pDigits = p;
+   while (p < pEnd && isDigit(*p) && static_cast<std::size_t>(p - pDigits) < kMaxDigits)
+      ++p;
+   if (p == pEnd)
+      return PartialSequence;
 
-   // escape sequence buffer
-   std::string escSequence;
+   *pLength = p - pBegin;
+   if (p == pDigits || (*p != 'h' && *p != 'l'))
+      return OtherSequence;
 
-   // was a supported escape sequence found?
-   bool haveSupportedSeq;
+   std::string number(pDigits, p);
+   if (number != "1049" && number != "1047" && number != "47")
+      return OtherSequence;
 
-   // number string as it is extraced from sequence
-   std::string numberStr;
+   *pLength = p + 1 - pBegin;
+   return *p == 'h' ? AltStartSequence : AltEndSequence;
+}
 
-   // current character
-   char currentCh;
+// the longest a sequence can be before it's known whether it's an alt-buffer
+// sequence (ESC [ ? digits terminator)
+const std::size_t kMaxSequenceLength = 4 + kMaxDigits;
 
-   // number of start-alt-buffer sequences encountered with an end sequence
-   int startCount;
-};
+} // anonymous namespace
 
+SecondaryBufferFilter::SecondaryBufferFilter(bool altBufferActive)
+   : altBufferActive_(altBufferActive)
+{
+}
 
-} // anonymous namespace
+void SecondaryBufferFilter::setAltBufferActive(bool altBufferActive)
+{
+   altBufferActive_ = altBufferActive;
+}
 
-std::string stripSecondaryBuffer(const std::string& strInput, bool* pAltBufferActive)
+void SecondaryBufferFilter::filter(const char* pData,
+                                   std::size_t size,
+                                   std::string* pOutput)
 {
    // XTerm.js supported alt-buffer start sequences:
    //
@@ -194,77 +109,87 @@ std::string stripSecondaryBuffer(const std::string& strInput, bool* pAltBufferAc
    // first end sequence closes them all (no nesting, as the terminal only
    // supports a single alt-buffer).
    //
-   // Implemented as a 1-pass parser. If we see any of the start sequences
-   // (or are already "inside" an unclosed start sequence from a previous call)
-   // discard the text up to and including the first end-sequence (or the end
-   // of the string).
-   //
-   // At completion, the passed-in bool is updated to reflect which buffer
-   // we were left in.
+   // Outside of the alt-buffer, the text up to the next ESC is copied to the
+   // output; inside it, the text up to the next ESC is skipped.
 
-   // initial state
-   bool altActive = pAltBufferActive ? *pAltBufferActive : false;
-   size_t origLength = strInput.length();
+   const char* p = pData;
+   const char* pEnd = pData + size;
 
-   ParseMetadata parse(altActive);
-
-   // Single pass through the original string. Look for the escape sequences,
-   // and when we have a confirmed run of text that isn't between them,
-   // append it to the output.
-   for (size_t i = 0; i < origLength; i++)
+   if (!pending_.empty())
    {
-      char ch = strInput[i];
-      switch (parse.state)
-      {
-      case NORMAL:
-         if (ch == '\033')
-            parse.setNewState(HAVE_ESC, i, ch);
-         else
-            parse.continueState(i, ch);
-         break;
+      // complete the sequence held from the last chunk with the start of
+      // this one (if it's still incomplete, the chunk was short and is held
+      // along with it)
+      std::size_t held = pending_.size();
+      pending_.append(p, std::min(size, kMaxSequenceLength));
+
+      std::size_t length = 0;
+      SequenceType type = scanSequence(pending_.data(),
+                                       pending_.data() + pending_.size(),
+                                       &length);
+      if (type == PartialSequence)
+         return;
 
-      case HAVE_ESC:
-         if (ch == '[')
-            parse.setNewState(HAVE_BRACKET, i, ch);
-         else
-            parse.setNewState(NORMAL, i, ch);
-         break;
+      if (type == OtherSequence && !altBufferActive_)
+         pOutput->append(pending_, 0, length);
+      else if (type != OtherSequence)
+         altBufferActive_ = type == AltStartSequence;
 
-      case HAVE_BRACKET:
-         if (ch == '?')
-            parse.setNewState(HAVE_QM, i, ch);
-         else
-            parse.setNewState(NORMAL, i, ch);
-         break;
+      p += length - held;
+      pending_.clear();
+   }
 
-      case HAVE_QM:
-         if (isdigit(ch))
-            parse.setNewState(HAVE_INT, i, ch);
-         else
-            parse.setNewState(NORMAL, i, ch);
-         break;
+   while (p < pEnd)
+   {
+      const char* pEsc = static_cast<const char*>(::memchr(p, kEsc, pEnd - p));
+      if (pEsc == nullptr)
+         pEsc = pEnd;
 
-      case HAVE_INT:
-         if (isdigit(ch))
-            parse.continueState(i, ch);
-         else
-            parse.setNewState(HAVE_TERM, i, ch);
+      if (!altBufferActive_)
+         pOutput->append(p, pEsc);
+      if (pEsc == pEnd)
          break;
 
-      default:
+      std::size_t length = 0;
+      SequenceType type = scanSequence(pEsc, pEnd, &length);
+      if (type == PartialSequence)
+      {
+         pending_.assign(pEsc, pEnd);
          break;
       }
 
-      parse.processState(false);
+      if (type == OtherSequence && !altBufferActive_)
+         pOutput->append(pEsc, length);
+      else if (type != OtherSequence)
+         altBufferActive_ = type == AltStartSequence;
+
+      p = pEsc + length;
    }
+}
 
-   parse.processState(true);
+void SecondaryBufferFilter::flush(std::string* pOutput)
+{
+   if (!altBufferActive_)
+      pOutput->append(pending_);
+   pending_.clear();
+}
+
+std::string stripSecondaryBuffer(const std::string& strInput, bool* pAltBufferActive)
+{
+   // At completion, the passed-in bool is updated to reflect which buffer
+   // we were left in.
+   SecondaryBufferFilter filter(pAltBufferActive ? *pAltBufferActive : false);
+
+   std::string output;
+   if (!filter.altBufferActive())
+      output.reserve(strInput.size());
+   filter.filter(strInput, &output);
+   filter.flush(&output);
 
-   // set output mode
    if (pAltBufferActive)
-      *pAltBufferActive = parse.startCount > 0;;
+      *pAltBufferActive = filter.altBufferActive();
 
-   return parse.output;
+   return output;
 }
 
 } // namespace text
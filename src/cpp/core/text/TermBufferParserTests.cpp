@@ -298,6 +298,60 @@ TEST_CASE("Terminal Buffer Mode Parsing")
    }
 }
 
+TEST_CASE("Terminal Buffer Mode Filtering")
+{
+   // output switching in and out of the alt-buffer, with other escapes
+   std::string input = "Once upon ";
+   input.append(pStart1);
+   input.append("a bunch of random stuff \033[?freddy");
+   input.append(pEnd1);
+   input.append("a \033[31mtime\033[0m.\033[?25l");
+   input.append(pStart3);
+   input.append("Meow");
+   input.append(pEnd3);
+   input.append(" The end.\033[?12");
+   std::string expect("Once upon a \033[31mtime\033[0m.\033[?25l The end.\033[?12");
+
+   SECTION("Escapes split between chunks are found")
+   {
+      for (std::size_t split = 0; split <= input.size(); split++)
+      {
+         core::text::SecondaryBufferFilter filter;
+         std::string output;
+         filter.filter(input.substr(0, split), &output);
+         filter.filter(input.substr(split), &output);
+         filter.flush(&output);
+         INFO("split at " << split);
+         CHECK(output == expect);
+      }
+   }
+
+   SECTION("Escapes split across several chunks are found")
+   {
+      core::text::SecondaryBufferFilter filter;
+      std::string output;
+      for (char ch : input)
+         filter.filter(&ch, 1, &output);
+      CHECK(output == "Once upon a \033[31mtime\033[0m.\033[?25l The end.");
+      CHECK_FALSE(filter.altBufferActive());
+
+      filter.flush(&output);
+      CHECK(output == expect);
+   }
+
+   SECTION("The alt-buffer can be left in another chunk")
+   {
+      core::text::SecondaryBufferFilter filter;
+      std::string output;
+      filter.filter("text\033[?10", &output);
+      filter.filter(std::string("49hhidden\033[?1049"), &output);
+      CHECK(filter.altBufferActive());
+      filter.filter(std::string("l shown"), &output);
+      CHECK_FALSE(filter.altBufferActive());
+      CHECK(output == "text shown");
+   }
+}
+
 } // end namespace tests
 } // end namespace core
 } // end namespace rstudio
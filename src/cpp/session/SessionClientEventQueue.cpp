@@ -20,7 +20,6 @@
 #include <core/BoostThread.hpp>
 #include <core/Thread.hpp>
 #include <shared_core/json/Json.hpp>
-#include <core/StringUtils.hpp>
 
 #include <r/session/RConsoleActions.hpp>
 
@@ -49,6 +48,7 @@ ClientEventQueue& clientEventQueue()
 ClientEventQueue::ClientEventQueue()
    :  pMutex_(new boost::mutex()),
       pWaitForEventCondition_(new boost::condition()),
+      pendingConsoleOutput_(r::session::consoleActions().capacity() + 1),
       lastEventAddTime_(boost::posix_time::not_a_date_time)
 {
 }
@@ -83,17 +83,17 @@ void ClientEventQueue::add(const ClientEvent& event)
    }
    LOCK_MUTEX(*pMutex_)
    {
-      // console output is batched up for compactness/efficiency.
-      if (event.type() == client_events::kConsoleWriteOutput)
+      // console output is batched up for compactness/efficiency (and
+      // bounded to what the client can show)
+      if (event.type() == client_events::kConsoleWriteOutput ||
+          event.type() == client_events::kConsoleWriteError)
       {
          if (event.data().getType() == json::Type::STRING)
-            pendingConsoleOutput_ += event.data().getString();
-      }
-      else if (event.type() == client_events::kConsoleWriteError &&
-               event.data().getType() == json::Type::STRING)
-      {
-         flushPendingConsoleOutput();
-         enqueueClientOutputEvent(event.type(), event.data().getString());
+         {
+            pendingConsoleOutput_.setMaxLines(
+                     r::session::consoleActions().capacity() + 1);
+            pendingConsoleOutput_.append(event.type(), event.data().getString());
+         }
       }
       else
       {
@@ -117,7 +117,7 @@ bool ClientEventQueue::hasEvents()
 {
    LOCK_MUTEX(*pMutex_)
    {
-      return pendingEvents_.size() > 0 || pendingConsoleOutput_.length() > 0;
+      return pendingEvents_.size() > 0 || !pendingConsoleOutput_.empty();
    }
    END_LOCK_MUTEX
    
@@ -194,18 +194,11 @@ void ClientEventQueue::flushPendingConsoleOutput()
 {
    // NOTE: private helper so no lock required (mutex is not recursive) 
    
-   if ( !pendingConsoleOutput_.empty() )
-   {
-      // If there's more console output than the client can even show, then
-      // truncate it to the amount that the client can show. Too much output
-      // can overwhelm the client, causing it to become unresponsive.
-      int limit = r::session::consoleActions().capacity() + 1;
-      string_utils::trimLeadingLines(limit, &pendingConsoleOutput_);
-
-      enqueueClientOutputEvent(client_events::kConsoleWriteOutput, 
-            pendingConsoleOutput_);
-      pendingConsoleOutput_.clear();
-   }
+   // (output beyond what the client can show has already been dropped)
+   std::vector<ConsoleOutputBuffer::Chunk> chunks;
+   pendingConsoleOutput_.take(&chunks);
+   for (const ConsoleOutputBuffer::Chunk& chunk : chunks)
+      enqueueClientOutputEvent(chunk.type, chunk.text);
 }
 
 void ClientEventQueue::enqueueClientOutputEvent(
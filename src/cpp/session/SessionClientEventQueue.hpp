@@ -27,6 +27,8 @@
 
 #include <session/SessionClientEvent.hpp>
 
+#include "SessionConsoleOutputBuffer.hpp"
+
 namespace rstudio {
 namespace session {
    
@@ -83,7 +85,7 @@ private:
    boost::condition* pWaitForEventCondition_;
 
    // instance data
-   std::string pendingConsoleOutput_;
+   ConsoleOutputBuffer pendingConsoleOutput_;
    std::string activeConsole_;
    std::vector<ClientEvent> pendingEvents_;
    boost::posix_time::ptime lastEventAddTime_;
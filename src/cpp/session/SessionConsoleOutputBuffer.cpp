@@ -0,0 +1,179 @@
+/*
+ * SessionConsoleOutputBuffer.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionConsoleOutputBuffer.hpp"
+
+#include <algorithm>
+
+#include <shared_core/SafeConvert.hpp>
+
+namespace rstudio {
+namespace session {
+
+namespace {
+
+// the SGR escapes kept for dropped text are cut to (roughly) this long;
+// output which changes styles that often without resetting them is rare
+const std::size_t kMaxDroppedStyleSize = 256;
+
+const char* const kStyleReset = "\033[0m";
+
+int countLines(const std::string& text, std::size_t begin, std::size_t end)
+{
+   return static_cast<int>(std::count(text.begin() + begin, text.begin() + end, '\n'));
+}
+
+// the position just past the count-th newline in text
+std::size_t afterLines(const std::string& text, int count)
+{
+   std::size_t pos = 0;
+   while (count-- > 0)
+   {
+      pos = text.find('\n', pos);
+      if (pos == std::string::npos)
+         return text.size();
+      pos++;
+   }
+   return pos;
+}
+
+// is the SGR escape with the given parameters a reset?
+bool isStyleReset(const std::string& params)
+{
+   return params.find_first_not_of("0;") == std::string::npos;
+}
+
+} // anonymous namespace
+
+ConsoleOutputBuffer::ConsoleOutputBuffer(int maxLines)
+   : maxLines_(std::max(maxLines, 1)),
+     lines_(0),
+     droppedLines_(0)
+{
+}
+
+void ConsoleOutputBuffer::setMaxLines(int maxLines)
+{
+   maxLines_ = std::max(maxLines, 1);
+}
+
+void ConsoleOutputBuffer::append(int type, const std::string& text)
+{
+   if (text.empty())
+      return;
+
+   if (!chunks_.empty() && chunks_.back().type == type)
+      chunks_.back().text.append(text);
+   else
+      chunks_.push_back(Chunk(type, text));
+
+   lines_ += countLines(text, 0, text.size());
+
+   // lines are dropped once there are twice as many as are kept, so that
+   // output added a line at a time isn't moved each time
+   if (lines_ > maxLines_ * 2)
+      trim(maxLines_);
+}
+
+bool ConsoleOutputBuffer::empty() const
+{
+   return chunks_.empty();
+}
+
+void ConsoleOutputBuffer::take(std::vector<Chunk>* pChunks)
+{
+   trim(maxLines_);
+
+   if (droppedLines_ > 0 && !chunks_.empty())
+   {
+      std::string marker =
+            "[... " + core::safe_convert::numberToString(droppedLines_) +
+            (droppedLines_ == 1 ? " line" : " lines") +
+            " of output omitted ...]\n";
+      chunks_.front().text.insert(0, marker + droppedStyle_);
+   }
+
+   pChunks->insert(pChunks->end(), chunks_.begin(), chunks_.end());
+   clear();
+}
+
+void ConsoleOutputBuffer::clear()
+{
+   chunks_.clear();
+   lines_ = 0;
+   droppedLines_ = 0;
+   droppedStyle_.clear();
+}
+
+void ConsoleOutputBuffer::trim(int maxLines)
+{
+   while (lines_ > maxLines && !chunks_.empty())
+   {
+      Chunk& chunk = chunks_.front();
+      int excess = lines_ - maxLines;
+      int chunkLines = countLines(chunk.text, 0, chunk.text.size());
+      if (chunkLines <= excess)
+      {
+         drop(chunk.text, chunk.text.size());
+         lines_ -= chunkLines;
+         droppedLines_ += chunkLines;
+         chunks_.pop_front();
+      }
+      else
+      {
+         std::size_t length = afterLines(chunk.text, excess);
+         drop(chunk.text, length);
+         chunk.text.erase(0, length);
+         lines_ -= excess;
+         droppedLines_ += excess;
+      }
+   }
+}
+
+void ConsoleOutputBuffer::drop(const std::string& text, std::size_t length)
+{
+   // note the SGR escapes (ESC [ params m) in the dropped text, so that the
+   // text which remains is shown in the styles it would have been
+   std::size_t pos = text.find('\033');
+   while (pos < length)
+   {
+      std::size_t paramsBegin = pos + 2;
+      std::size_t end = text.find_first_not_of("0123456789;", paramsBegin);
+      if (pos + 1 < length && text[pos + 1] == '[' && end < length && text[end] == 'm')
+      {
+         std::string params = text.substr(paramsBegin, end - paramsBegin);
+         if (isStyleReset(params))
+            droppedStyle_ = kStyleReset;
+         else
+            droppedStyle_.append(text, pos, end - pos + 1);
+         pos = end + 1;
+      }
+      else
+      {
+         pos++;
+      }
+      pos = text.find('\033', pos);
+   }
+
+   // (keeping the later escapes, which take precedence)
+   if (droppedStyle_.size() > kMaxDroppedStyleSize)
+   {
+      std::size_t start = droppedStyle_.find('\033', droppedStyle_.size() - kMaxDroppedStyleSize);
+      droppedStyle_.erase(0, start);
+   }
+}
+
+} // namespace session
+} // namespace rstudio
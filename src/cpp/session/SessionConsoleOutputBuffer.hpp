@@ -0,0 +1,79 @@
+/*
+ * SessionConsoleOutputBuffer.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_CONSOLE_OUTPUT_BUFFER_HPP
+#define SESSION_CONSOLE_OUTPUT_BUFFER_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace rstudio {
+namespace session {
+
+// Console output (and error) text which hasn't yet been sent to the client.
+// Only as many lines as the client's console keeps are held: older lines
+// are dropped as output is added (rather than when it's sent), so that
+// runaway output doesn't pile up in the session while the client catches
+// up. When lines have been dropped, the text taken starts with a marker
+// saying how many, followed by the ANSI colors and styles that were in
+// effect at the end of the dropped text.
+class ConsoleOutputBuffer : boost::noncopyable
+{
+public:
+   struct Chunk
+   {
+      Chunk(int type, const std::string& text) : type(type), text(text) {}
+
+      int type;
+      std::string text;
+   };
+
+   explicit ConsoleOutputBuffer(int maxLines);
+
+   void setMaxLines(int maxLines);
+
+   // adds text of the given type (e.g. kConsoleWriteOutput); consecutive
+   // text of the same type is merged
+   void append(int type, const std::string& text);
+
+   bool empty() const;
+
+   // moves the text into pChunks (in the order it was added) and resets
+   // the buffer
+   void take(std::vector<Chunk>* pChunks);
+
+   void clear();
+
+private:
+   void trim(int maxLines);
+   void drop(const std::string& text, std::size_t length);
+
+   std::deque<Chunk> chunks_;
+   int maxLines_;
+   int lines_;
+
+   // the lines dropped since the text was last taken, and the SGR escapes
+   // (from the last reset on) in them
+   int droppedLines_;
+   std::string droppedStyle_;
+};
+
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_CONSOLE_OUTPUT_BUFFER_HPP
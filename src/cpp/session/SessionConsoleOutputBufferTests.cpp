@@ -0,0 +1,126 @@
+/*
+ * SessionConsoleOutputBufferTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionConsoleOutputBuffer.hpp"
+
+#include <shared_core/SafeConvert.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+const int kOutput = 1;
+const int kError = 2;
+
+std::string lines(int begin, int end)
+{
+   std::string text;
+   for (int i = begin; i < end; i++)
+      text += "line " + safe_convert::numberToString(i) + "\n";
+   return text;
+}
+
+} // anonymous namespace
+
+TEST_CASE("ConsoleOutputBuffer")
+{
+   ConsoleOutputBuffer buffer(10);
+   std::vector<ConsoleOutputBuffer::Chunk> chunks;
+
+   SECTION("Output of each type is merged")
+   {
+      CHECK(buffer.empty());
+      buffer.append(kOutput, "a");
+      buffer.append(kOutput, "b\n");
+      buffer.append(kError, "c\n");
+      buffer.append(kOutput, "d");
+      CHECK_FALSE(buffer.empty());
+
+      buffer.take(&chunks);
+      REQUIRE(chunks.size() == 3);
+      CHECK(chunks[0].type == kOutput);
+      CHECK(chunks[0].text == "ab\n");
+      CHECK(chunks[1].text == "c\n");
+      CHECK(chunks[2].text == "d");
+      CHECK(buffer.empty());
+   }
+
+   SECTION("Only the last lines are kept")
+   {
+      for (int i = 0; i < 1000; i++)
+         buffer.append(kOutput, lines(i, i + 1));
+      buffer.append(kOutput, "partial");
+
+      buffer.take(&chunks);
+      REQUIRE(chunks.size() == 1);
+      CHECK(chunks[0].text ==
+            "[... 990 lines of output omitted ...]\n" + lines(990, 1000) + "partial");
+
+      // (the count starts again once the output is taken)
+      buffer.append(kOutput, lines(0, 12));
+      chunks.clear();
+      buffer.take(&chunks);
+      CHECK(chunks[0].text == "[... 2 lines of output omitted ...]\n" + lines(2, 12));
+   }
+
+   SECTION("Whole chunks are dropped")
+   {
+      buffer.append(kError, lines(0, 5));
+      buffer.append(kOutput, lines(5, 20));
+      buffer.take(&chunks);
+      REQUIRE(chunks.size() == 1);
+      CHECK(chunks[0].type == kOutput);
+      CHECK(chunks[0].text == "[... 10 lines of output omitted ...]\n" + lines(10, 20));
+   }
+
+   SECTION("Styles in dropped lines are kept")
+   {
+      buffer.append(kOutput, "\033[1m\033[31mred\n");
+      buffer.append(kOutput, lines(0, 10));
+      buffer.take(&chunks);
+      CHECK(chunks[0].text ==
+            "[... 1 line of output omitted ...]\n\033[1m\033[31m" + lines(0, 10));
+
+      // (up to the last reset)
+      buffer.append(kOutput, "\033[1mbold\033[0m \033[32mgreen\n");
+      buffer.append(kOutput, lines(0, 10));
+      chunks.clear();
+      buffer.take(&chunks);
+      CHECK(chunks[0].text ==
+            "[... 1 line of output omitted ...]\n\033[0m\033[32m" + lines(0, 10));
+   }
+
+   SECTION("Cleared output isn't taken")
+   {
+      buffer.append(kOutput, lines(0, 20));
+      buffer.clear();
+      CHECK(buffer.empty());
+      buffer.append(kOutput, "a\n");
+      buffer.take(&chunks);
+      REQUIRE(chunks.size() == 1);
+      CHECK(chunks[0].text == "a\n");
+   }
+}
+
+} // end namespace tests
+} // end namespace session
+} // end namespace rstudio
@@ -625,6 +625,14 @@ void ConsoleProcess::onStdout(core::system::ProcessOperations& ops,
    }
 }
 
+bool ConsoleProcess::shouldPauseOutput()
+{
+   // the terminal's output is left unread while its websocket is behind,
+   // rather than being queued for it without limit
+   return procInfo_->getChannelMode() == Websocket &&
+          s_terminalSocket.isSendBacklogged(procInfo_->getHandle());
+}
+
 void ConsoleProcess::maybeConsolePrompt(core::system::ProcessOperations& ops,
                                         const std::string& output)
 {
@@ -673,6 +681,11 @@ void ConsoleProcess::handleConsolePrompt(core::system::ProcessOperations& ops,
 
 void ConsoleProcess::onExit(int exitCode)
 {
+   // output held back (e.g. the start of a character whose remainder was
+   // never written) is sent ahead of the exit
+   if (procInfo_->getChannelMode() == Websocket)
+      s_terminalSocket.flushText(procInfo_->getHandle());
+
    procInfo_->setExitCode(exitCode);
    procInfo_->setHasChildProcs(false);
 
@@ -772,6 +785,7 @@ core::system::ProcessCallbacks ConsoleProcess::createProcessCallbacks()
    core::system::ProcessCallbacks cb;
    cb.onContinue = boost::bind(&ConsoleProcess::onContinue, ConsoleProcess::shared_from_this(), _1);
    cb.onStdout = boost::bind(&ConsoleProcess::onStdout, ConsoleProcess::shared_from_this(), _1, _2);
+   cb.shouldPauseOutput = boost::bind(&ConsoleProcess::shouldPauseOutput, ConsoleProcess::shared_from_this());
    cb.onExit = boost::bind(&ConsoleProcess::onExit, ConsoleProcess::shared_from_this(), _1);
    if (options_.reportHasSubprocs)
    {
@@ -66,7 +66,7 @@ ConsoleProcessInfo::ConsoleProcessInfo(
    : caption_(caption), title_(title), handle_(handle),
      terminalSequence_(terminalSequence), allowRestart_(true),
      interactionMode_(InteractionAlways), maxOutputLines_(kDefaultTerminalMaxOutputLines),
-     altBufferActive_(altBufferActive), shellType_(shellType),
+     altBufferFilter_(altBufferActive), shellType_(shellType),
      cwd_(cwd), cols_(cols), rows_(rows),
      zombie_(zombie), trackEnv_(trackEnv)
 {
@@ -107,9 +107,10 @@ void ConsoleProcessInfo::appendToOutputBuffer(const std::string &str)
    }
 
    // For terminal tabs, store in a separate file, first removing any
-   // output targeting the alternate terminal buffer.
-   std::string mainBufferStr =
-         core::text::stripSecondaryBuffer(str, &altBufferActive_);
+   // output targeting the alternate terminal buffer (an escape sequence
+   // split across chunks of output is saved with the next chunk).
+   std::string mainBufferStr;
+   altBufferFilter_.filter(str, &mainBufferStr);
 
    console_persist::appendToOutputBuffer(handle_, mainBufferStr);
 }
@@ -122,37 +123,14 @@ void ConsoleProcessInfo::appendToOutputBuffer(char ch)
 std::string ConsoleProcessInfo::getSavedBufferChunk(
       int requestedChunk, bool* pMoreAvailable) const
 {
-   // We read the entire buffer into memory to return a given chunk. This is
-   // ok for our current usage pattern, where the buffer-size is bounded
-   // to a certain number of lines and is infrequently reloaded (only upon
-   // browser refresh or reloading a session). If this pattern becomes
-   // more frequent and/or we support much larger buffers, we'd want to
-   // reconsider this implementation.
-
-   // Read buffer (trims to maxOutputLines_ when chunk zero is requested)
-   std::string buffer = console_persist::getSavedBuffer(
+   // Only the requested chunk is read from the log (trims to
+   // maxOutputLines_ when chunk zero is requested)
+   return console_persist::getSavedBufferChunk(
             handle_,
-            requestedChunk == 0 ? maxOutputLines_ : 0);
-
-   *pMoreAvailable = false;
-
-   // Common case, entire buffer fits in chunk zero
-   if (requestedChunk == 0 && (buffer.length() <= kOutputBufferSize))
-      return buffer;
-
-   // Chunk requested past end of buffer?
-   if (requestedChunk * kOutputBufferSize >= buffer.length())
-      return std::string();
-
-   // Otherwise return substring for the chunk (substr doesn't mind if you ask
-   // for more characters than are available in the string, as long as the
-   // starting position is within the string)
-   std::string chunk = buffer.substr(
-            requestedChunk * kOutputBufferSize, kOutputBufferSize);
-   if (requestedChunk * kOutputBufferSize + chunk.length() < buffer.length())
-      *pMoreAvailable = true;
-
-   return chunk;
+            maxOutputLines_,
+            requestedChunk,
+            kOutputBufferSize,
+            pMoreAvailable);
 }
 
 std::string ConsoleProcessInfo::getFullSavedBuffer() const
@@ -211,7 +189,7 @@ core::json::Object ConsoleProcessInfo::toJson(SerializationMode serialMode) cons
    result["shell_type"] = TerminalShell::getShellId(shellType_);
    result["channel_mode"] = static_cast<int>(channelMode_);
    result["channel_id"] = channelId_;
-   result["alt_buffer"] = altBufferActive_;
+   result["alt_buffer"] = altBufferFilter_.altBufferActive();
    result["cwd"] = module_context::createAliasedPath(cwd_);
    result["cols"] = cols_;
    result["rows"] = rows_;
@@ -310,9 +288,11 @@ boost::shared_ptr<ConsoleProcessInfo> ConsoleProcessInfo::fromJson(const core::j
    if (error)
       LOG_ERROR(error);
 
-   error = json::getOptionalParam(obj, "alt_buffer", false, &pProc->altBufferActive_);
+   bool altBufferActive = false;
+   error = json::getOptionalParam(obj, "alt_buffer", false, &altBufferActive);
    if (error)
       LOG_ERROR(error);
+   pProc->altBufferFilter_.setAltBufferActive(altBufferActive);
 
    std::string cwd;
    error = json::getOptionalParam(obj, "cwd", std::string(), &cwd);
@@ -15,14 +15,20 @@
 
 #include <session/SessionConsoleProcessPersist.hpp>
 
+#include <map>
+
 #include <gsl/gsl>
 
+#include <boost/shared_ptr.hpp>
+
 #include <core/FileSerializer.hpp>
 
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionOptions.hpp>
 #include <session/projects/SessionProjects.hpp>
 
+#include "SessionConsoleProcessScrollback.hpp"
+
 using namespace rstudio::core;
 
 namespace rstudio {
@@ -63,6 +69,10 @@ FilePath s_consoleProcIndexPath;
 bool s_inited = false;
 const std::string s_envFileExt = ".env";
 
+// the scrollback log of each terminal (which keeps its files open while
+// output is appended, so each terminal's log is only used through this)
+std::map<std::string, boost::shared_ptr<ScrollbackLog> > s_scrollbackLogs;
+
 void initialize()
 {
    if (s_inited) return;
@@ -115,6 +125,25 @@ Error getLogFilePath(const std::string& handle, FilePath* pFile)
    return Success();
 }
 
+Error getScrollbackLog(const std::string& handle, boost::shared_ptr<ScrollbackLog>* ppLog)
+{
+   auto it = s_scrollbackLogs.find(handle);
+   if (it != s_scrollbackLogs.end())
+   {
+      *ppLog = it->second;
+      return Success();
+   }
+
+   FilePath log;
+   Error error = getLogFilePath(handle, &log);
+   if (error)
+      return error;
+
+   ppLog->reset(new ScrollbackLog(log));
+   s_scrollbackLogs[handle] = *ppLog;
+   return Success();
+}
+
 Error getEnvFilePath(const std::string& handle, FilePath* pFile)
 {
    initialize();
@@ -164,62 +193,102 @@ void saveConsoleProcesses(const std::string& metadata)
 std::string getSavedBuffer(const std::string& handle, int maxLines)
 {
    std::string content;
-   FilePath log;
-
-   Error error = getLogFilePath(handle, &log);
+   boost::shared_ptr<ScrollbackLog> pScrollback;
+   Error error = getScrollbackLog(handle, &pScrollback);
    if (error)
    {
       LOG_ERROR(error);
       return content;
    }
 
-   if (!log.exists())
+   if (!pScrollback->logPath().exists())
    {
       return "";
    }
 
-   error = core::readStringFromFile(log, &content);
+   // Trim the buffer based on maxLines. Otherwise it can grow without
+   // bound until the terminal is closed or cleared.
+   error = pScrollback->trim(maxLines);
+   if (error)
+      LOG_ERROR(error);
+
+   error = pScrollback->read(&content);
+   if (error)
+      LOG_ERROR(error);
+
+   return content;
+}
+
+std::string getSavedBufferChunk(const std::string& handle,
+                                int maxLines,
+                                int chunk,
+                                size_t chunkSize,
+                                bool* pMoreAvailable)
+{
+   std::string content;
+   *pMoreAvailable = false;
+
+   boost::shared_ptr<ScrollbackLog> pScrollback;
+   Error error = getScrollbackLog(handle, &pScrollback);
    if (error)
    {
       LOG_ERROR(error);
       return content;
    }
 
-   if (maxLines < 1)
+   if (!pScrollback->logPath().exists())
       return content;
 
-   // Trim the buffer based on maxLines. Otherwise it can grow without
-   // bound until the terminal is closed or cleared.
-   std::string trimmedOutput = content;
-   if (string_utils::trimLeadingLines(maxLines, &trimmedOutput))
+   // only trim when starting to fetch chunks, so that later chunks are read
+   // from the same offsets
+   if (chunk == 0)
    {
-      error = core::writeStringToFile(log, trimmedOutput);
+      error = pScrollback->trim(maxLines);
       if (error)
-      {
-          LOG_ERROR(error);
-          return content;
-      }
+         LOG_ERROR(error);
    }
-   return trimmedOutput;
-}
 
-int getSavedBufferLineCount(const std::string& handle, int maxLines)
-{
-   std::string buffer = getSavedBuffer(handle, maxLines);
-   return gsl::narrow_cast<int>(string_utils::countNewlines(buffer) + 1);
+   error = pScrollback->read(static_cast<uintmax_t>(chunk) * chunkSize,
+                             chunkSize,
+                             &content,
+                             pMoreAvailable);
+   if (error)
+      LOG_ERROR(error);
+
+   return content;
 }
 
-void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
+int getSavedBufferLineCount(const std::string& handle, int maxLines)
 {
-   FilePath log;
-   Error error = getLogFilePath(handle, &log);
+   boost::shared_ptr<ScrollbackLog> pScrollback;
+   Error error = getScrollbackLog(handle, &pScrollback);
    if (error)
    {
       LOG_ERROR(error);
-      return;
+      return 1;
    }
 
-   error = rstudio::core::appendToFile(log, buffer);
+   if (!pScrollback->logPath().exists())
+      return 1;
+
+   error = pScrollback->trim(maxLines);
+   if (error)
+      LOG_ERROR(error);
+
+   size_t newlines = 0;
+   error = pScrollback->newlineCount(&newlines);
+   if (error)
+      LOG_ERROR(error);
+
+   return gsl::narrow_cast<int>(newlines + 1);
+}
+
+void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
+{
+   boost::shared_ptr<ScrollbackLog> pScrollback;
+   Error error = getScrollbackLog(handle, &pScrollback);
+   if (!error)
+      error = pScrollback->append(buffer);
    if (error)
    {
       LOG_ERROR(error);
@@ -228,55 +297,28 @@ void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
 
 void deleteLogFile(const std::string &handle, bool lastLineOnly)
 {
-   FilePath log;
-   Error error = getLogFilePath(handle, &log);
+   boost::shared_ptr<ScrollbackLog> pScrollback;
+   Error error = getScrollbackLog(handle, &pScrollback);
    if (error)
    {
       LOG_ERROR(error);
       return;
    }
 
-   if (!log.exists())
-      return;
-
    if (!lastLineOnly)
    {
-      // blow away the file
-      error = log.removeIfExists();
-      if (error)
-      {
-         LOG_ERROR(error);
-         return;
-      }
+      // blow away the file (and its index), and close the log
+      error = pScrollback->remove();
+      s_scrollbackLogs.erase(handle);
    }
-   else
+   else if (pScrollback->logPath().exists())
    {
-      // read the file, remove last line and rewrite buffer
-      std::string content;
-      error = core::readStringFromFile(log, &content);
-      if (error)
-      {
-         LOG_ERROR(error);
-         return;
-      }
-
-      size_t lastNewline = content.find_last_of('\n');
-
-      // no complete line in buffer, just blow it away
-      if (lastNewline == std::string::npos)
-      {
-         deleteLogFile(handle, false);
-         return;
-      }
-
       // erase everything after the final newline
-      content.erase(++lastNewline);
-      error = core::writeStringToFile(log, content);
-      if (error)
-      {
-          LOG_ERROR(error);
-      }
+      error = pScrollback->removeLastLine();
    }
+
+   if (error)
+      LOG_ERROR(error);
 }
 
 void deleteOrphanedLogs(bool (*validHandle)(const std::string&))
@@ -302,6 +344,7 @@ void deleteOrphanedLogs(bool (*validHandle)(const std::string&))
 
       if (!validHandle(child.getStem()))
       {
+         s_scrollbackLogs.erase(child.getStem());
          error = child.remove();
          if (error)
             LOG_ERROR(error);
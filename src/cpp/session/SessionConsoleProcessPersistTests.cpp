@@ -20,8 +20,11 @@
 
 #include <sstream>
 
+#include <core/FileSerializer.hpp>
 #include <core/system/Environment.hpp>
 
+#include "SessionConsoleProcessScrollback.hpp"
+
 namespace rstudio {
 namespace session {
 namespace console_process {
@@ -168,6 +171,81 @@ TEST_CASE("ConsoleProcess Persistence")
       CHECK((loaded.compare(expect) == 0));
    }
 
+   SECTION("Read a buffer in chunks")
+   {
+      std::stringstream ss;
+      for (size_t i = 0; i < maxLines * 2; i++)
+         ss << i << '\n';
+      std::string orig = ss.str();
+      console_persist::appendToOutputBuffer(handle2, orig);
+
+      std::string expect = console_persist::getSavedBuffer(handle2, maxLines);
+      std::string loaded;
+      bool moreAvailable = true;
+      for (int chunk = 0; moreAvailable; chunk++)
+      {
+         std::string next = console_persist::getSavedBufferChunk(
+                  handle2, maxLines, chunk, 100, &moreAvailable);
+         CHECK(next.length() <= 100);
+         loaded += next;
+      }
+      CHECK((loaded.compare(expect) == 0));
+
+      bool more = true;
+      std::string pastEnd = console_persist::getSavedBufferChunk(
+               handle2, maxLines, 1000, 100, &more);
+      CHECK(pastEnd.empty());
+      CHECK_FALSE(more);
+   }
+
+   SECTION("Delete last line of a buffer")
+   {
+      console_persist::appendToOutputBuffer(handle1, "hello\nhow are\nyou");
+      console_persist::deleteLogFile(handle1, true);
+      std::string loaded = console_persist::getSavedBuffer(handle1, maxLines);
+      CHECK((loaded.compare("hello\nhow are\n") == 0));
+      CHECK(console_persist::getSavedBufferLineCount(handle1, maxLines) == 3);
+
+      console_persist::appendToOutputBuffer(handle1, "fine");
+      loaded = console_persist::getSavedBuffer(handle1, maxLines);
+      CHECK((loaded.compare("hello\nhow are\nfine") == 0));
+   }
+
+   SECTION("Trim a log written without an index")
+   {
+      core::FilePath logPath;
+      REQUIRE_FALSE(core::FilePath::tempFilePath(logPath));
+
+      std::stringstream ss;
+      std::stringstream ss_expect;
+      ss_expect << '\n';
+      for (size_t i = 0; i < 100; i++)
+      {
+         ss << i << '\n';
+         if (i >= 90)
+            ss_expect << i << '\n';
+      }
+      REQUIRE_FALSE(core::writeStringToFile(logPath, ss.str()));
+
+      ScrollbackLog scrollback(logPath);
+      CHECK_FALSE(scrollback.trim(10));
+
+      std::string loaded;
+      CHECK_FALSE(scrollback.read(&loaded));
+      CHECK((loaded.compare(ss_expect.str()) == 0));
+
+      size_t newlines = 0;
+      CHECK_FALSE(scrollback.newlineCount(&newlines));
+      CHECK(newlines == 11);
+
+      CHECK_FALSE(scrollback.append("more\n"));
+      CHECK_FALSE(scrollback.read(&loaded));
+      CHECK((loaded.compare(ss_expect.str() + "more\n") == 0));
+
+      CHECK_FALSE(scrollback.remove());
+      CHECK_FALSE(logPath.exists());
+   }
+
    SECTION("Delete unknown log files")
    {
       std::string orig1("hello how are you?\nthat is good\nhave a nice day");
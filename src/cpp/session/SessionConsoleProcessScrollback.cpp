@@ -0,0 +1,518 @@
+/*
+ * SessionConsoleProcessScrollback.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionConsoleProcessScrollback.hpp"
+
+#include <algorithm>
+#include <ostream>
+#include <sstream>
+
+#include <shared_core/Error.hpp>
+#include <core/FileSerializer.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+
+namespace {
+
+// sidecar files share the log's stem, so orphaned logs are cleaned up with them
+const char * const kIndexExt = ".lines";
+const char * const kHeadExt = ".head";
+const char * const kCompactExt = ".compact";
+
+// each newline offset is stored as a little-endian 64-bit integer
+const std::size_t kOffsetSize = 8;
+
+const std::size_t kCopyBufferSize = 64 * 1024;
+
+// space before the head is reclaimed once it's at least this large (and
+// larger than the retained output), so reclaiming is amortized over appends
+const uintmax_t kMinCompactSize = 1024 * 1024;
+
+void encodeOffset(uintmax_t offset, std::string* pEncoded)
+{
+   for (std::size_t i = 0; i < kOffsetSize; i++)
+      pEncoded->push_back(static_cast<char>((offset >> (8 * i)) & 0xff));
+}
+
+uintmax_t decodeOffset(const char* encoded)
+{
+   uintmax_t offset = 0;
+   for (std::size_t i = kOffsetSize; i > 0; i--)
+      offset = (offset << 8) | static_cast<unsigned char>(encoded[i - 1]);
+   return offset;
+}
+
+Error readBytes(const FilePath& filePath,
+                uintmax_t offset,
+                std::size_t length,
+                std::string* pBytes)
+{
+   pBytes->clear();
+   if (length == 0)
+      return Success();
+
+   std::shared_ptr<std::istream> pIfs;
+   Error error = filePath.openForRead(pIfs);
+   if (error)
+      return error;
+
+   pBytes->resize(length);
+   pIfs->seekg(static_cast<std::streamoff>(offset));
+   pIfs->read(&(*pBytes)[0], static_cast<std::streamsize>(length));
+   if (pIfs->bad())
+   {
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", filePath.getAbsolutePath());
+      return error;
+   }
+
+   pBytes->resize(static_cast<std::size_t>(pIfs->gcount()));
+   return Success();
+}
+
+Error ioError(const FilePath& filePath, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::io_error, location);
+   error.addProperty("path", filePath.getAbsolutePath());
+   return error;
+}
+
+} // anonymous namespace
+
+ScrollbackLog::ScrollbackLog(const FilePath& logPath)
+   : logPath_(logPath),
+     indexPath_(logPath.getAbsolutePath() + kIndexExt),
+     headPath_(logPath.getAbsolutePath() + kHeadExt),
+     size_(0)
+{
+}
+
+Error ScrollbackLog::append(const std::string& output)
+{
+   if (!pLog_)
+   {
+      Error error = openForAppend();
+      if (error)
+         return error;
+   }
+
+   std::string offsets;
+   for (std::size_t pos = output.find('\n');
+        pos != std::string::npos;
+        pos = output.find('\n', pos + 1))
+   {
+      encodeOffset(size_ + pos, &offsets);
+   }
+
+   // the index is written first: if the log append doesn't complete, the
+   // index refers past the end of the log and is rebuilt when next loaded.
+   // (each is flushed, so the output can be read while they're open)
+   pIndex_->write(offsets.data(), static_cast<std::streamsize>(offsets.size()));
+   pIndex_->flush();
+   if (pIndex_->fail())
+   {
+      closeForAppend();
+      return ioError(indexPath_, ERROR_LOCATION);
+   }
+
+   pLog_->write(output.data(), static_cast<std::streamsize>(output.size()));
+   pLog_->flush();
+   if (pLog_->fail())
+   {
+      closeForAppend();
+      return ioError(logPath_, ERROR_LOCATION);
+   }
+
+   size_ += output.size();
+   return Success();
+}
+
+Error ScrollbackLog::trim(int maxLines)
+{
+   closeForAppend();
+
+   if (maxLines < 1)
+      return Success();
+
+   State state;
+   Error error = loadState(&state);
+   if (error)
+      return error;
+
+   std::size_t retainedLines = state.lineCount - state.headLine;
+   if (state.size - state.head <= static_cast<uintmax_t>(maxLines) * 2 ||
+       retainedLines <= static_cast<std::size_t>(maxLines))
+   {
+      return Success();
+   }
+
+   // retain output from the newline preceding the last maxLines lines
+   std::size_t line = state.lineCount - maxLines - 1;
+   error = readLineOffset(line, &state.head);
+   if (error)
+      return error;
+   state.headLine = line;
+
+   if (state.head >= kMinCompactSize && state.head > state.size - state.head)
+      return compact(&state, state.size);
+
+   return writeHead(state);
+}
+
+Error ScrollbackLog::read(std::string* pOutput)
+{
+   closeForAppend();
+
+   State state;
+   Error error = loadState(&state);
+   if (error)
+      return error;
+
+   return readBytes(logPath_,
+                    state.head,
+                    static_cast<std::size_t>(state.size - state.head),
+                    pOutput);
+}
+
+Error ScrollbackLog::read(uintmax_t offset,
+                          std::size_t length,
+                          std::string* pOutput,
+                          bool* pMoreAvailable)
+{
+   closeForAppend();
+
+   pOutput->clear();
+   *pMoreAvailable = false;
+
+   State state;
+   Error error = loadState(&state);
+   if (error)
+      return error;
+
+   uintmax_t begin = state.head + offset;
+   if (begin >= state.size)
+      return Success();
+
+   uintmax_t available = state.size - begin;
+   *pMoreAvailable = available > length;
+   return readBytes(logPath_,
+                    begin,
+                    static_cast<std::size_t>(std::min<uintmax_t>(available, length)),
+                    pOutput);
+}
+
+Error ScrollbackLog::newlineCount(std::size_t* pCount)
+{
+   closeForAppend();
+
+   State state;
+   Error error = loadState(&state);
+   if (error)
+      return error;
+
+   *pCount = state.lineCount - state.headLine;
+   return Success();
+}
+
+Error ScrollbackLog::removeLastLine()
+{
+   closeForAppend();
+
+   State state;
+   Error error = loadState(&state);
+   if (error)
+      return error;
+
+   // no complete line, just blow it away
+   if (state.lineCount == state.headLine)
+      return remove();
+
+   uintmax_t lastNewline;
+   error = readLineOffset(state.lineCount - 1, &lastNewline);
+   if (error)
+      return error;
+
+   if (lastNewline + 1 == state.size)
+      return Success();
+
+   return compact(&state, lastNewline + 1);
+}
+
+Error ScrollbackLog::remove()
+{
+   closeForAppend();
+
+   Error error = logPath_.removeIfExists();
+   if (error)
+      return error;
+
+   error = indexPath_.removeIfExists();
+   if (error)
+      return error;
+
+   return headPath_.removeIfExists();
+}
+
+Error ScrollbackLog::openForAppend()
+{
+   State state;
+   state.size = 0;
+   if (!logPath_.exists())
+   {
+      // discard any sidecars left from a previous log
+      Error error = indexPath_.removeIfExists();
+      if (error)
+         return error;
+      error = headPath_.removeIfExists();
+      if (error)
+         return error;
+   }
+   else
+   {
+      // (this also indexes logs written before we kept an index)
+      Error error = loadState(&state);
+      if (error)
+         return error;
+   }
+
+   Error error = indexPath_.openForWrite(pIndex_, false);
+   if (!error)
+      error = logPath_.openForWrite(pLog_, false);
+   if (error)
+   {
+      closeForAppend();
+      return error;
+   }
+
+   size_ = state.size;
+   return Success();
+}
+
+void ScrollbackLog::closeForAppend()
+{
+   pLog_.reset();
+   pIndex_.reset();
+   size_ = 0;
+}
+
+Error ScrollbackLog::loadState(State* pState)
+{
+   pState->size = logPath_.exists() ? logPath_.getSize() : 0;
+   pState->head = 0;
+   pState->headLine = 0;
+   pState->lineCount = 0;
+
+   if (pState->size == 0)
+      return Success();
+
+   if (headPath_.exists())
+   {
+      std::string contents;
+      Error error = readStringFromFile(headPath_, &contents);
+      if (error)
+         return error;
+
+      std::istringstream istr(contents);
+      if (!(istr >> pState->head >> pState->headLine))
+      {
+         pState->head = 0;
+         pState->headLine = 0;
+      }
+   }
+
+   // validate the index against the log, rebuilding it if it's missing or
+   // doesn't correspond to the log (e.g. the log was modified externally)
+   if (!indexPath_.exists() || indexPath_.getSize() % kOffsetSize != 0)
+      return rebuildIndex(pState);
+
+   pState->lineCount = static_cast<std::size_t>(indexPath_.getSize() / kOffsetSize);
+   if (pState->head > pState->size || pState->headLine > pState->lineCount)
+      return rebuildIndex(pState);
+
+   if (pState->lineCount > 0)
+   {
+      uintmax_t lastNewline;
+      Error error = readLineOffset(pState->lineCount - 1, &lastNewline);
+      if (error)
+         return error;
+
+      if (lastNewline >= pState->size)
+         return rebuildIndex(pState);
+   }
+
+   if (pState->headLine < pState->lineCount)
+   {
+      uintmax_t headNewline;
+      Error error = readLineOffset(pState->headLine, &headNewline);
+      if (error)
+         return error;
+
+      if (headNewline < pState->head)
+         return rebuildIndex(pState);
+   }
+
+   return Success();
+}
+
+Error ScrollbackLog::rebuildIndex(State* pState)
+{
+   std::shared_ptr<std::istream> pIfs;
+   Error error = logPath_.openForRead(pIfs);
+   if (error)
+      return error;
+
+   if (pState->head > pState->size)
+      pState->head = 0;
+
+   std::string offsets;
+   std::size_t headLine = 0;
+   std::vector<char> buffer(kCopyBufferSize);
+   uintmax_t position = 0;
+   while (pIfs->read(&buffer[0], buffer.size()) || pIfs->gcount() > 0)
+   {
+      std::size_t count = static_cast<std::size_t>(pIfs->gcount());
+      for (std::size_t i = 0; i < count; i++)
+      {
+         if (buffer[i] == '\n')
+         {
+            if (position + i < pState->head)
+               headLine++;
+            encodeOffset(position + i, &offsets);
+         }
+      }
+      position += count;
+   }
+
+   pState->size = position;
+   pState->lineCount = offsets.size() / kOffsetSize;
+   pState->headLine = headLine;
+
+   error = writeStringToFile(indexPath_, offsets);
+   if (error)
+      return error;
+
+   return writeHead(*pState);
+}
+
+Error ScrollbackLog::readLineOffset(std::size_t line, uintmax_t* pOffset)
+{
+   std::string encoded;
+   Error error = readBytes(indexPath_, line * kOffsetSize, kOffsetSize, &encoded);
+   if (error)
+      return error;
+
+   if (encoded.size() != kOffsetSize)
+   {
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", indexPath_.getAbsolutePath());
+      return error;
+   }
+
+   *pOffset = decodeOffset(encoded.data());
+   return Success();
+}
+
+Error ScrollbackLog::writeHead(const State& state)
+{
+   if (state.head == 0 && state.headLine == 0)
+      return headPath_.removeIfExists();
+
+   std::ostringstream ostr;
+   ostr << state.head << " " << state.headLine;
+   return writeStringToFile(headPath_, ostr.str());
+}
+
+Error ScrollbackLog::compact(State* pState, uintmax_t end)
+{
+   // copy the retained output (up to end) into a new log
+   FilePath compactPath(logPath_.getAbsolutePath() + kCompactExt);
+   {
+      std::shared_ptr<std::istream> pIfs;
+      Error error = logPath_.openForRead(pIfs);
+      if (error)
+         return error;
+
+      std::shared_ptr<std::ostream> pOfs;
+      error = compactPath.openForWrite(pOfs);
+      if (error)
+         return error;
+
+      pIfs->seekg(static_cast<std::streamoff>(pState->head));
+      std::vector<char> buffer(kCopyBufferSize);
+      uintmax_t remaining = end - pState->head;
+      while (remaining > 0)
+      {
+         std::size_t count = static_cast<std::size_t>(
+                  std::min<uintmax_t>(remaining, buffer.size()));
+         if (!pIfs->read(&buffer[0], count) || !pOfs->write(&buffer[0], count))
+         {
+            compactPath.removeIfExists();
+            error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+            error.addProperty("path", logPath_.getAbsolutePath());
+            return error;
+         }
+         remaining -= count;
+      }
+
+      pOfs->flush();
+      if (pOfs->fail())
+      {
+         compactPath.removeIfExists();
+         return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      }
+   }
+
+   // rebase the retained newline offsets
+   std::string encoded;
+   Error error = readBytes(indexPath_,
+                           pState->headLine * kOffsetSize,
+                           (pState->lineCount - pState->headLine) * kOffsetSize,
+                           &encoded);
+   if (error)
+      return error;
+
+   std::string offsets;
+   for (std::size_t i = 0; i + kOffsetSize <= encoded.size(); i += kOffsetSize)
+   {
+      uintmax_t offset = decodeOffset(encoded.data() + i);
+      if (offset >= end)
+         break;
+      encodeOffset(offset - pState->head, &offsets);
+   }
+
+   // replace the log then its index (should we fail between the two, the
+   // index refers past the end of the log and is rebuilt when next loaded)
+   error = compactPath.move(logPath_, FilePath::MoveDirect, true);
+   if (error)
+      return error;
+
+   error = writeStringToFile(indexPath_, offsets);
+   if (error)
+      return error;
+
+   pState->size = end - pState->head;
+   pState->head = 0;
+   pState->headLine = 0;
+   pState->lineCount = offsets.size() / kOffsetSize;
+   return writeHead(*pState);
+}
+
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
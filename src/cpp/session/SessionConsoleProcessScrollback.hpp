@@ -0,0 +1,110 @@
+/*
+ * SessionConsoleProcessScrollback.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_CONSOLE_PROCESS_SCROLLBACK_HPP
+#define SESSION_CONSOLE_PROCESS_SCROLLBACK_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <shared_core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+
+// On-disk terminal scrollback. Output is appended to a log file, and the
+// offset of each newline is appended to a sidecar index, so that trimming
+// to a number of lines only moves a head pointer (persisted in a second,
+// tiny sidecar) and any range of the retained output is read with a single
+// seek. The dead space before the head is reclaimed once it outweighs the
+// retained output. Logs written without an index are indexed on first use.
+//
+// The log and its index are kept open between appends; any other operation
+// closes them first (they're reopened by the next append).
+class ScrollbackLog : boost::noncopyable
+{
+public:
+   explicit ScrollbackLog(const core::FilePath& logPath);
+
+   const core::FilePath& logPath() const { return logPath_; }
+
+   core::Error append(const std::string& output);
+
+   // discard leading lines so at most maxLines newlines are retained (as
+   // with string_utils::trimLeadingLines, small logs aren't trimmed)
+   core::Error trim(int maxLines);
+
+   // read the retained output
+   core::Error read(std::string* pOutput);
+
+   // read up to length bytes of retained output starting at offset
+   core::Error read(uintmax_t offset,
+                    std::size_t length,
+                    std::string* pOutput,
+                    bool* pMoreAvailable);
+
+   // number of newlines within the retained output
+   core::Error newlineCount(std::size_t* pCount);
+
+   // discard any output after the final newline (removing the log
+   // entirely if it contains no complete line)
+   core::Error removeLastLine();
+
+   core::Error remove();
+
+private:
+   struct State
+   {
+      uintmax_t size;
+      uintmax_t head;
+      std::size_t headLine;
+      std::size_t lineCount;
+   };
+
+   core::Error openForAppend();
+   void closeForAppend();
+
+   core::Error loadState(State* pState);
+   core::Error rebuildIndex(State* pState);
+   core::Error readLineOffset(std::size_t line, uintmax_t* pOffset);
+   core::Error writeHead(const State& state);
+   core::Error compact(State* pState, uintmax_t end);
+
+   core::FilePath logPath_;
+   core::FilePath indexPath_;
+   core::FilePath headPath_;
+
+   // while open for appending, the size of the log
+   std::shared_ptr<std::ostream> pLog_;
+   std::shared_ptr<std::ostream> pIndex_;
+   uintmax_t size_;
+};
+
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_CONSOLE_PROCESS_SCROLLBACK_HPP
@@ -37,6 +37,41 @@ namespace {
 // returned by rand; only an issue for unit tests, really
 bool s_didSeedRand = false;
 
+// output sent within this long of the last message is held for this long,
+// and batched with any that follows it (output after a quiet spell, such as
+// echoed keystrokes, is sent at once)
+const long kBatchWindowMs = 8;
+
+// batched output is sent once there's this much of it
+const std::size_t kMaxBatchSize = 64 * 1024;
+
+// the most output which should wait to be sent to a connection before the
+// terminal's output is left unread
+const std::size_t kMaxUnsentOutput = 1024 * 1024;
+
+// the length of the text up to any character left incomplete at its end
+// (by a read of the terminal's output which split it)
+std::size_t completeUtf8Length(const std::string& text)
+{
+   std::size_t size = text.size();
+   for (std::size_t i = 1; i <= 3 && i <= size; i++)
+   {
+      unsigned char ch = static_cast<unsigned char>(text[size - i]);
+      if ((ch & 0xC0) == 0x80)
+         continue;
+
+      std::size_t length = ch >= 0xF0 ? 4 : ch >= 0xE0 ? 3 : ch >= 0xC0 ? 2 : 1;
+      return length > i ? size - i : size;
+   }
+   return size;
+}
+
+Error unknownHandleError(const std::string& terminalHandle, const ErrorLocation& location)
+{
+   std::string msg = "Unknown handle: \"" + terminalHandle + "\"";
+   return systemError(boost::system::errc::not_connected, msg, location);
+}
+
 } // anonymous namespace
 
 ConsoleProcessSocket::ConsoleProcessSocket()
@@ -241,6 +276,8 @@ Error ConsoleProcessSocket::listen(
    ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
    details.handle_ = terminalHandle;
    details.connectionCallbacks_ = connectionCallbacks;
+   if (!details.pOutput_)
+      details.pOutput_ = boost::make_shared<ConsoleProcessSocketOutput>();
    connections_.set(terminalHandle, details);
    return Success();
 }
@@ -265,11 +302,98 @@ Error ConsoleProcessSocket::sendRawText(const std::string& terminalHandle,
    // do we know about this handle?
    ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
    if (details.handle_.compare(terminalHandle))
+      return unknownHandleError(terminalHandle, ERROR_LOCATION);
+
+   return send(details, message, websocketpp::frame::opcode::text);
+}
+
+Error ConsoleProcessSocket::sendText(const std::string& terminalHandle,
+                                     const std::string& message)
+{
+   ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
+   if (details.handle_.compare(terminalHandle) || !details.pOutput_)
+      return unknownHandleError(terminalHandle, ERROR_LOCATION);
+
+   ConsoleProcessSocketOutput& output = *details.pOutput_;
+   LOCK_MUTEX(output.mutex_)
    {
-      std::string msg = "Unknown handle: \"" + terminalHandle + "\"";
-      return systemError(boost::system::errc::not_connected, msg, ERROR_LOCATION);
+      output.pending_.append(message);
+      if (output.pending_.size() < kMaxBatchSize)
+      {
+         // a scheduled flush sends this output along with that before it
+         if (output.flushScheduled_)
+            return Success();
+
+         // output which closely follows the last is held briefly, so that a
+         // burst of output goes as a few large messages rather than many
+         // small ones
+         using namespace boost::posix_time;
+         if (!output.lastSent_.is_not_a_date_time() &&
+             microsec_clock::universal_time() - output.lastSent_ < milliseconds(kBatchWindowMs))
+         {
+            output.flushScheduled_ = true;
+            pwsServer_->set_timer(
+                     kBatchWindowMs,
+                     boost::bind(&ConsoleProcessSocket::onFlushOutput, this, terminalHandle, _1));
+            return Success();
+         }
+      }
+
+      return sendPendingOutput(details, &output);
+   }
+   END_LOCK_MUTEX
+
+   return Success();
+}
+
+Error ConsoleProcessSocket::flushText(const std::string& terminalHandle)
+{
+   ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
+   if (details.handle_.compare(terminalHandle) || !details.pOutput_)
+      return unknownHandleError(terminalHandle, ERROR_LOCATION);
+
+   ConsoleProcessSocketOutput& output = *details.pOutput_;
+   LOCK_MUTEX(output.mutex_)
+   {
+      std::size_t length = completeUtf8Length(output.pending_);
+      if (length < output.pending_.size())
+         output.pending_.replace(length, std::string::npos, "\xEF\xBF\xBD");
+
+      return sendPendingOutput(details, &output);
    }
+   END_LOCK_MUTEX
 
+   return Success();
+}
+
+bool ConsoleProcessSocket::isSendBacklogged(const std::string& terminalHandle)
+{
+   if (!serverRunning_)
+      return false;
+
+   ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
+   if (details.handle_.compare(terminalHandle) || !details.pOutput_)
+      return false;
+
+   websocketpp::lib::error_code ec;
+   terminalServer::connection_ptr con = pwsServer_->get_con_from_hdl(details.hdl_, ec);
+   if (ec || !con)
+      return false;
+
+   std::size_t unsent = con->get_buffered_amount();
+   LOCK_MUTEX(details.pOutput_->mutex_)
+   {
+      unsent += details.pOutput_->pending_.size();
+   }
+   END_LOCK_MUTEX
+
+   return unsent > kMaxUnsentOutput;
+}
+
+Error ConsoleProcessSocket::send(const ConsoleProcessSocketConnectionDetails& details,
+                                 const std::string& message,
+                                 websocketpp::frame::opcode::value opcode)
+{
    // make sure this handle still refers to a connection before we try to
    // send data over it
    websocketpp::lib::error_code ec;
@@ -280,7 +404,7 @@ Error ConsoleProcessSocket::sendRawText(const std::string& terminalHandle,
                          ec.message(), ERROR_LOCATION);
    }
 
-   pwsServer_->send(details.hdl_, message, websocketpp::frame::opcode::text, ec);
+   pwsServer_->send(details.hdl_, message, opcode, ec);
    if (ec)
    {
       return systemError(boost::system::errc::bad_message,
@@ -289,10 +413,47 @@ Error ConsoleProcessSocket::sendRawText(const std::string& terminalHandle,
    return Success();
 }
 
-Error ConsoleProcessSocket::sendText(const std::string& terminalHandle,
-                                     const std::string& message)
+Error ConsoleProcessSocket::sendPendingOutput(
+      const ConsoleProcessSocketConnectionDetails& details,
+      ConsoleProcessSocketOutput* pOutput)
 {
-   return sendRawText(terminalHandle, ConsoleProcessSocketPacket::textPacket(message));
+   // NOTE: called with the output's mutex held (so that batches are sent
+   // in order)
+
+   // a character split between reads of the output is sent with the rest
+   // of it, once that's been read
+   std::size_t length = completeUtf8Length(pOutput->pending_);
+   if (length == 0)
+      return Success();
+
+   std::string packet =
+         ConsoleProcessSocketPacket::textPacket(pOutput->pending_.substr(0, length));
+   pOutput->pending_.erase(0, length);
+   pOutput->lastSent_ = boost::posix_time::microsec_clock::universal_time();
+
+   return send(details, packet, websocketpp::frame::opcode::binary);
+}
+
+void ConsoleProcessSocket::onFlushOutput(const std::string& terminalHandle,
+                                         const websocketpp::lib::error_code& ec)
+{
+   // (the timer is cancelled if the server stops)
+   if (ec)
+      return;
+
+   ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
+   if (details.handle_.compare(terminalHandle) || !details.pOutput_)
+      return;
+
+   LOCK_MUTEX(details.pOutput_->mutex_)
+   {
+      details.pOutput_->flushScheduled_ = false;
+
+      // as with unbatched output, output for a connection which has gone
+      // is dropped
+      sendPendingOutput(details, details.pOutput_.get());
+   }
+   END_LOCK_MUTEX
 }
 
 Error ConsoleProcessSocket::sendPong(const std::string& terminalHandle)
@@ -361,6 +522,8 @@ void ConsoleProcessSocket::onOpen(terminalServer* s, websocketpp::connection_hdl
    ConsoleProcessSocketConnectionDetails details = connections_.get(handle);
    details.handle_ = handle;
    details.hdl_ = hdl;
+   if (!details.pOutput_)
+      details.pOutput_ = boost::make_shared<ConsoleProcessSocketOutput>();
    connections_.set(handle, details);
 
    // notify the specific connection, if available
@@ -84,6 +84,19 @@ public:
       return (!err);
    }
 
+   bool sendText(const std::string& terminalHandle,
+                 const std::string& message)
+   {
+      core::Error err = socket_.sendText(terminalHandle, message);
+      return (!err);
+   }
+
+   bool flushText(const std::string& terminalHandle)
+   {
+      core::Error err = socket_.flushText(terminalHandle);
+      return (!err);
+   }
+
    int port() { return socket_.port(); }
 
 private:
@@ -153,6 +166,18 @@ public:
       return pServerSocket_->sendRawText(handle_, msg);
    }
 
+   // send output to client of this connection (batched)
+   bool sendMessage(const std::string& msg)
+   {
+      return pServerSocket_->sendText(handle_, msg);
+   }
+
+   // send any output held back (as when the process exits)
+   bool flushMessages()
+   {
+      return pServerSocket_->flushText(handle_);
+   }
+
    std::string getReceived() const
    {
       blockingwait(50);
@@ -185,7 +210,8 @@ public:
         gotOpened_(false),
         gotClosed_(false),
         gotFailed_(false),
-        clientRunning_(false)
+        clientRunning_(false),
+        binaryMessages_(0)
    {}
 
    ~SocketClient()
@@ -203,6 +229,11 @@ public:
       {
          input_ += msg->get_payload();
       }
+      else if (msg->get_opcode() == websocketpp::frame::opcode::binary)
+      {
+         binaryInput_ += msg->get_payload();
+         binaryMessages_++;
+      }
       else
       {
          std::cerr << "Unsupported websocket message type" << std::endl;
@@ -311,6 +342,8 @@ public:
    }
 
    std::string getInput() { blockingwait(50); return input_; }
+   std::string getBinaryInput() { blockingwait(50); return binaryInput_; }
+   int binaryMessages() const { return binaryMessages_; }
    bool gotOpened() { return gotOpened_; }
    bool gotClosed() { return gotClosed_; }
    bool gotFailed() { return gotFailed_; }
@@ -334,6 +367,9 @@ private:
    boost::thread clientSocketThread_;
    bool clientRunning_;
    websocketpp::connection_hdl hdl_;
+
+   std::string binaryInput_;
+   int binaryMessages_;
 };
 
 } // anonymous namespace
@@ -435,6 +471,59 @@ test_context("websocket for interactive terminals")
       expect_true(pSocket->stopServer());
    }
 
+   test_that("server batches output sent to client in binary frames")
+   {
+      shared_ptr<SocketHarness> pSocket = make_shared<SocketHarness>();
+      expect_true(pSocket->ensureServerRunning());
+
+      shared_ptr<SocketConnection> pConnection = boost::make_shared<SocketConnection>(handle1, pSocket);
+      shared_ptr<SocketClient> pClient = boost::make_shared<SocketClient>(handle1, pSocket->port());
+      expect_true(pConnection->listen());
+      expect_true(pClient->connectToServer());
+
+      pClient->waitForConnectionOrError();
+
+      // the first output goes at once, and that which closely follows it
+      // (including the rest of a split character) is batched
+      expect_true(pConnection->sendMessage(msgString1 + "caf\xC3"));
+      expect_true(pConnection->sendMessage("\xA9 "));
+      expect_true(pConnection->sendMessage(msgString2));
+
+      std::string expect =
+            ConsoleProcessSocketPacket::textPacket(msgString1 + "caf") +
+            ConsoleProcessSocketPacket::textPacket("\xC3\xA9 " + msgString2);
+      expect_true(pClient->getBinaryInput() == expect);
+      expect_true(pClient->binaryMessages() == 2);
+
+      expect_true(pClient->disconnectFromServer());
+      expect_true(pSocket->stopServer());
+   }
+
+   test_that("server flushes a split character when output ends")
+   {
+      shared_ptr<SocketHarness> pSocket = make_shared<SocketHarness>();
+      expect_true(pSocket->ensureServerRunning());
+
+      shared_ptr<SocketConnection> pConnection = boost::make_shared<SocketConnection>(handle1, pSocket);
+      shared_ptr<SocketClient> pClient = boost::make_shared<SocketClient>(handle1, pSocket->port());
+      expect_true(pConnection->listen());
+      expect_true(pClient->connectToServer());
+
+      pClient->waitForConnectionOrError();
+
+      expect_true(pConnection->sendMessage(msgString1 + "caf\xC3"));
+      expect_true(pConnection->flushMessages());
+
+      std::string expect =
+            ConsoleProcessSocketPacket::textPacket(msgString1 + "caf") +
+            ConsoleProcessSocketPacket::textPacket("\xEF\xBF\xBD");
+      expect_true(pClient->getBinaryInput() == expect);
+      expect_true(pClient->binaryMessages() == 2);
+
+      expect_true(pClient->disconnectFromServer());
+      expect_true(pSocket->stopServer());
+   }
+
    test_that("client can make multiple connections to server")
    {
       // ---- one socket on server ----
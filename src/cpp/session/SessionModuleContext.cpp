@@ -2108,6 +2108,8 @@ void enqueFileChangedEvent(const core::system::FileChangeEvent &event)
    using namespace session::modules::source_control;
    auto pCtx = fileDecorationContext(filePath, true);
    enqueFileChangedEvent(event, pCtx);
+
+   events().onFilesChanged(std::vector<core::system::FileChangeEvent>(1, event));
 }
 
 void enqueFileChangedEvents(const core::FilePath& vcsStatusRoot,
@@ -2138,6 +2140,8 @@ void enqueFileChangedEvents(const core::FilePath& vcsStatusRoot,
    {
       enqueFileChangedEvent(event, pCtx);
    }
+
+   module_context::events().onFilesChanged(events);
 }
 
 Error enqueueConsoleInput(const std::string& consoleInput)
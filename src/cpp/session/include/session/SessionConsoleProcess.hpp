@@ -212,6 +212,7 @@ private:
    bool onContinue(core::system::ProcessOperations& ops);
    void onStdout(core::system::ProcessOperations& ops,
                  const std::string& output);
+   bool shouldPauseOutput();
    void onExit(int exitCode);
    void onHasSubprocs(bool hasNonIgnoredSubProcs, bool hasIgnoredSubprocs);
    void reportCwd(const core::FilePath& cwd);
@@ -22,6 +22,7 @@
 #include <core/json/JsonRpc.hpp>
 #include <core/system/Process.hpp>
 #include <core/system/Types.hpp>
+#include <core/text/TermBufferParser.hpp>
 
 #include <session/SessionTerminalShell.hpp>
 
@@ -167,8 +168,11 @@ public:
    }
 
    // Is terminal showing alt-buffer (a full-screen ncurses program)?
-   void setAltBufferActive(bool altBufferActive) { altBufferActive_ = altBufferActive; }
-   bool getAltBufferActive() const { return altBufferActive_; }
+   void setAltBufferActive(bool altBufferActive)
+   {
+      altBufferFilter_.setAltBufferActive(altBufferActive);
+   }
+   bool getAltBufferActive() const { return altBufferFilter_.altBufferActive(); }
 
    // Last-known current working directory
    void setCwd(const core::FilePath& cwd) { cwd_ = cwd; }
@@ -222,7 +226,8 @@ private:
 #else
    bool childProcs_ = true;
 #endif
-   bool altBufferActive_ = false;
+   // removes alt-buffer output (and tracks whether it's active) as it's saved
+   core::text::SecondaryBufferFilter altBufferFilter_;
    TerminalShell::ShellType shellType_ = TerminalShell::ShellType::Default;
    ChannelMode channelMode_ = Rpc;
    std::string channelId_;
@@ -43,6 +43,15 @@ void saveConsoleProcesses(const std::string& metadata);
 // then returns the trimmed buffer.
 std::string getSavedBuffer(const std::string& handle, int maxLines);
 
+// Get a chunk of the saved buffer for the given ConsoleProcess without
+// reading the rest of it. The buffer is trimmed to maxLines (as with
+// getSavedBuffer) only when chunk zero is requested.
+std::string getSavedBufferChunk(const std::string& handle,
+                                int maxLines,
+                                int chunk,
+                                size_t chunkSize,
+                                bool* pMoreAvailable);
+
 // Return number of lines in the saved buffer for given ConsoleProcess;
 // buffer will be trimmed to max number of lines and rewritten.
 int getSavedBufferLineCount(const std::string& handle, int maxLines);
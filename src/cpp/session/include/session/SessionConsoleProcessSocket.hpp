@@ -25,8 +25,11 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <shared_core/Error.hpp>
+#include <core/BoostThread.hpp>
 #include <core/Thread.hpp>
 
 #include <websocketpp/config/asio_no_tls.hpp>
@@ -52,11 +55,24 @@ namespace console_process {
 typedef websocketpp::server<websocketpp::config::asio> terminalServer;
 typedef terminalServer::message_ptr terminalMessage_ptr;
 
+// Output waiting to be sent to a connection (shared by the copies of its
+// details); output sent in quick succession is batched into one message
+struct ConsoleProcessSocketOutput
+{
+   ConsoleProcessSocketOutput() : flushScheduled_(false) {}
+
+   boost::mutex mutex_;
+   std::string pending_;
+   bool flushScheduled_;
+   boost::posix_time::ptime lastSent_;
+};
+
 struct ConsoleProcessSocketConnectionDetails
 {
    std::string handle_;
    ConsoleProcessSocketConnectionCallbacks connectionCallbacks_;
    websocketpp::connection_hdl hdl_;
+   boost::shared_ptr<ConsoleProcessSocketOutput> pOutput_;
 };
 
 // Manages a websocket that channels input and output from client for
@@ -85,10 +101,22 @@ public:
    core::Error sendRawText(const std::string& terminalHandle,
                            const std::string& message);
 
-   // send text packet to client
+   // send text packet to client; output sent within a few milliseconds of
+   // the last is batched, and goes in binary frames (so that the client
+   // decodes it, rather than the frame having to be valid UTF-8)
    core::Error sendText(const std::string& terminalHandle,
                         const std::string& message);
 
+   // send any output still held back, including a character left
+   // incomplete at its end (which is sent as U+FFFD, since the rest of it
+   // will never be read once the process has exited)
+   core::Error flushText(const std::string& terminalHandle);
+
+   // has the connection fallen behind, with more output waiting to be sent
+   // than it should buffer? (the terminal's output should be left unread
+   // until it catches up)
+   bool isSendBacklogged(const std::string& terminalHandle);
+
    // send keepalive response to client; we're not using low-level WebSocket
    // ping/pong as that isn't accessible from JavaScript apps; so we're just doing a
    // simple message exchange to keep proxies from killing an idle terminal
@@ -100,6 +128,14 @@ public:
 private:
    void watchSocket();
 
+   core::Error send(const ConsoleProcessSocketConnectionDetails& details,
+                    const std::string& message,
+                    websocketpp::frame::opcode::value opcode);
+   core::Error sendPendingOutput(const ConsoleProcessSocketConnectionDetails& details,
+                                 ConsoleProcessSocketOutput* pOutput);
+   void onFlushOutput(const std::string& terminalHandle,
+                      const websocketpp::lib::error_code& ec);
+
    void releaseAllConnections();
    std::string getHandle(terminalServer* s, websocketpp::connection_hdl hdl);
    void onMessage(terminalServer* s, websocketpp::connection_hdl hdl,
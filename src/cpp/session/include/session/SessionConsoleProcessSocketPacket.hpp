@@ -31,6 +31,8 @@ namespace console_process {
  *    "b" = ping/pong, e.g. "b"
  *
  * Only the "send text" method has a payload (everything after the "a").
+ * Text sent to the client goes in binary frames, which the client decodes as
+ * UTF-8.
  *
  * See TerminalSocketPacket in Java code for client-side of this.
  */
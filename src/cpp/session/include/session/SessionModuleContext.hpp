@@ -347,6 +347,7 @@ struct Events : boost::noncopyable
    RSTUDIO_BOOST_SIGNAL<void()>                                       onUserInterrupt;
    RSTUDIO_BOOST_SIGNAL<void(ChangeSource)>                           onDetectChanges;
    RSTUDIO_BOOST_SIGNAL<void(core::FilePath)>                         onSourceEditorFileSaved;
+   RSTUDIO_BOOST_SIGNAL<void(const std::vector<core::system::FileChangeEvent>&)> onFilesChanged;
    RSTUDIO_BOOST_SIGNAL<void(bool)>                                   onBackgroundProcessing;
    RSTUDIO_BOOST_SIGNAL<void(const std::vector<std::string>&)>        onLibPathsChanged;
    RSTUDIO_BOOST_SIGNAL<void(const std::string&)>                     onPackageLoaded;
@@ -17,6 +17,7 @@
 #define SESSION_JOBS_JOB_HPP
 
 #include <string>
+#include <boost/shared_ptr.hpp>
 #include <shared_core/json/Json.hpp>
 #include <r/RSexp.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -48,6 +49,8 @@ enum JobType {
    JobTypeLauncher = 2 // cluster job via job launcher
 };
 
+class JobOutputLog;
+
 typedef std::function<void(const std::string&)> JobAction;
 typedef std::vector<std::pair<std::string,JobAction>> JobActions;
 
@@ -160,6 +163,7 @@ public:
 private:
    core::FilePath jobCacheFolder();
    core::FilePath outputCacheFile();
+   JobOutputLog& outputLog();
 
    std::string id_;
    std::string name_;
@@ -187,6 +191,9 @@ private:
    JobActions cppActions_;
 
    std::vector<std::string> tags_;
+
+   // (created when first needed)
+   boost::shared_ptr<JobOutputLog> pOutputLog_;
 };
 
 
@@ -19,6 +19,8 @@
 #include "SessionCodeSearch.hpp"
 
 #include <iostream>
+#include <map>
+#include <memory>
 #include <vector>
 #include <set>
 #include <gsl/gsl>
@@ -27,6 +29,7 @@
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/regex.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/bind/bind.hpp>
@@ -50,6 +53,7 @@
 #include <r/RRoutines.hpp>
 
 #include <session/SessionModuleContext.hpp>
+#include <session/SessionOptions.hpp>
 #include <session/SessionAsyncRProcess.hpp>
 #include <session/SessionQuarto.hpp>
 #include <session/SessionRUtil.hpp>
@@ -57,6 +61,9 @@
 #include <session/projects/SessionProjects.hpp>
 
 #include "SessionAsyncPackageInformation.hpp"
+#include "SessionFuzzyMatcher.hpp"
+#include "SessionSourceIndexCache.hpp"
+#include "SessionSourceIndexer.hpp"
 
 #include "SessionSource.hpp"
 #include "clang/DefinitionIndex.hpp"
@@ -171,17 +178,21 @@ struct Entry
    }
 
    explicit Entry(const FileInfo& fileInfo)
-      : fileInfo(fileInfo)
+      : fileInfo(fileInfo), lowerFilename(lowerFilenameOf(fileInfo))
    {
    }
    
    Entry(const FileInfo& fileInfo,
          boost::shared_ptr<core::r_util::RSourceIndex> pIndex)
-      : fileInfo(fileInfo), pIndex(pIndex)
+      : fileInfo(fileInfo), lowerFilename(lowerFilenameOf(fileInfo)), pIndex(pIndex)
    {
    }
    
    FileInfo fileInfo;
+
+   // computed once so that searches needn't lower-case every file name
+   std::string lowerFilename;
+
    boost::shared_ptr<core::r_util::RSourceIndex> pIndex;
    
    bool hasIndex() const { return pIndex.get() != nullptr; }
@@ -201,6 +212,13 @@ struct Entry
       return lhs.fileInfo.absolutePath() ==
              rhs.fileInfo.absolutePath();
    }
+
+private:
+   static std::string lowerFilenameOf(const FileInfo& fileInfo)
+   {
+      const std::string& path = fileInfo.absolutePath();
+      return boost::algorithm::to_lower_copy(path.substr(path.rfind('/') + 1));
+   }
 };
 
 void print_tree(tree<Entry> const& tr)
@@ -458,7 +476,14 @@ class SourceFileIndex : boost::noncopyable
 {
 public:
    SourceFileIndex()
-      : pEntries_(new EntryTree()), indexing_(false)
+      : pEntries_(new EntryTree()),
+        indexing_(false),
+        indexed_(false),
+        nextJobId_(0),
+        collecting_(false),
+        generation_(0),
+        snapshotStale_(false),
+        pSnapshot_(emptySnapshot())
    {
    }
 
@@ -502,11 +527,49 @@ public:
          module_context::scheduleIncrementalWork(
                            boost::posix_time::milliseconds(200),
                            boost::posix_time::milliseconds(20),
-                           boost::bind(&SourceFileIndex::dequeAndIndex, this),
+                           boost::bind(&SourceFileIndex::dequeAndIndex, this, generation_),
                            false /* allow indexing even when non-idle */);
       }
    }
 
+   // load the indexes saved by the previous session, so that files which
+   // haven't changed since needn't be indexed again
+   void loadCache()
+   {
+      FilePath cachePath = cacheFilePath();
+      if (!cachePath.exists())
+         return;
+
+      Error error = cache_.read(cachePath, projects::projectContext().defaultEncoding());
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   void saveCache()
+   {
+      // only save a complete index
+      if (!indexed_)
+         return;
+
+      std::vector<SourceIndexCache::CachedFile> files;
+      for (const Entry& entry : *pEntries_)
+      {
+         if (entry.hasIndex())
+         {
+            SourceIndexCache::CachedFile file;
+            file.fileInfo = entry.fileInfo;
+            file.pIndex = entry.pIndex;
+            files.push_back(file);
+         }
+      }
+
+      Error error = SourceIndexCache::write(cacheFilePath(),
+                                            projects::projectContext().defaultEncoding(),
+                                            files);
+      if (error)
+         LOG_ERROR(error);
+   }
+
    void enqueFileChange(const core::system::FileChangeEvent& event)
    {
       // add to the queue
@@ -522,79 +585,28 @@ public:
 
          module_context::scheduleIncrementalWork(
                            boost::posix_time::milliseconds(20),
-                           boost::bind(&SourceFileIndex::dequeAndIndex, this),
+                           boost::bind(&SourceFileIndex::dequeAndIndex, this, generation_),
                            false /* allow indexing even when non-idle */);
       }
    }
 
+   // (the index snapshot is immutable, so these may be called from any thread)
    bool findGlobalFunction(const std::string& functionName,
                            const std::set<std::string>& excludeContexts,
-                           r_util::RSourceItem* pFunctionItem)
+                           r_util::RSourceItem* pFunctionItem) const
    {
-      std::vector<r_util::RSourceItem> sourceItems;
-      for (const Entry& entry : *pEntries_)
-      {
-         // bail if there is no index
-         if (!entry.hasIndex())
-            continue;
-
-         // bail if this is an exluded context
-         if (excludeContexts.find(entry.pIndex->context()) !=
-             excludeContexts.end())
-         {
-            continue;
-         }
-
-         // scan the next index
-         sourceItems.clear();
-         entry.pIndex->search(
-                  boost::bind(isGlobalFunctionNamed, _1, functionName),
-                  std::back_inserter(sourceItems));
-
-         // return if we got a hit
-         if (sourceItems.size() > 0)
-         {
-            *pFunctionItem = sourceItems[0];
-            return true;
-         }
-      }
-
-      // none found
-      return false;
+      return snapshot()->findGlobalFunction(functionName,
+                                            excludeContexts,
+                                            pFunctionItem);
    }
 
    void searchSource(const std::string& term,
                      std::size_t maxResults,
                      bool prefixOnly,
                      const std::set<std::string>& excludeContexts,
-                     std::vector<r_util::RSourceItem>* pItems)
+                     std::vector<r_util::RSourceItem>* pItems) const
    {
-      for (const Entry& entry : *pEntries_)
-      {
-         // skip if it has no index
-         if (!entry.hasIndex())
-            continue;
-
-         // bail if this is an exluded context
-         if (excludeContexts.find(entry.pIndex->context()) !=
-             excludeContexts.end())
-         {
-            continue;
-         }
-
-         // scan the next index
-         entry.pIndex->search(term,
-                              prefixOnly,
-                              false,
-                              std::back_inserter(*pItems));
-
-         // return if we are past maxResults
-         if (pItems->size() >= maxResults)
-         {
-            pItems->resize(maxResults);
-            return;
-         }
-      }
+      snapshot()->search(term, maxResults, prefixOnly, excludeContexts, pItems);
    }
    
    template <typename T>
@@ -612,6 +624,14 @@ public:
 
       // create wildcard pattern if the search has a '*'
       boost::regex pattern = regex_utils::regexIfWildcardPattern(term);
+
+      // We allow the user to submit queries of the form e.g.
+      // <query>:<row><column>; make sure we only take items
+      // on the query up to ':'
+      std::string::size_type queryEnd = term.find(":");
+      if (queryEnd == std::string::npos)
+         queryEnd = term.length();
+      FuzzyMatcher matcher(term, true);
       
       // get the start and end iterators -- default to all leaves
       EntryTree::leaf_iterator it = pEntries_->begin_leaf();
@@ -645,15 +665,12 @@ public:
          if (sourceFilesOnly && !isSourceFile(entry.fileInfo))
             continue;
          
-         // get file and name
-         FilePath filePath(entry.fileInfo.absolutePath());
-         std::string name = filePath.getFilename();
-
          // compare for match (wildcard or standard)
          bool matches = false;
          if (!pattern.empty())
          {
-            matches = regex_utils::textMatches(name,
+            FilePath filePath(entry.fileInfo.absolutePath());
+            matches = regex_utils::textMatches(filePath.getFilename(),
                                                pattern,
                                                prefixOnly,
                                                false);
@@ -661,26 +678,16 @@ public:
          else
          {
             if (prefixOnly)
-               matches = boost::algorithm::istarts_with(name, term);
+               matches = boost::algorithm::istarts_with(entry.lowerFilename, term);
             else
-            {
-               // We allow the user to submit queries of the form e.g.
-               // <query>:<row><column>; make sure we only take items
-               // on the query up to ':'
-               std::string::size_type queryEnd = term.find(":");
-               if (queryEnd == std::string::npos)
-                  queryEnd = term.length();
-
-               matches = string_utils::isSubsequence(name,
-                                                     term,
-                                                     queryEnd,
-                                                     true);
-            }
+               matches = matcher.matchesLowerCase(entry.lowerFilename, queryEnd);
          }
 
          // add the file if we found a match
          if (matches)
          {
+            FilePath filePath(entry.fileInfo.absolutePath());
+
             // name and aliased path
             pNames->push_back(filePath.getFilename());
             pPaths->push_back(module_context::createAliasedPath(filePath));
@@ -801,17 +808,55 @@ public:
    
    void clear()
    {
+      // work scheduled before now stops when it next runs (so that the
+      // cleared index isn't taken for a complete one, and saved)
+      generation_++;
+      collecting_ = false;
       indexing_ = false;
+      indexed_ = false;
       indexingQueue_ = std::queue<core::system::FileChangeEvent>();
       pEntries_->clear();
+      cache_.clear();
+      stopIndexer();
+      std::atomic_store(&pSnapshot_, emptySnapshot());
+      snapshotStale_ = false;
+   }
+
+   void stopIndexer()
+   {
+      if (pIndexer_)
+      {
+         pIndexer_->stop();
+         pIndexer_.reset();
+      }
+      pendingFiles_.clear();
    }
 
 private:
 
-   bool dequeAndIndex()
+   static FilePath cacheFilePath()
+   {
+      return projects::projectContext().scratchPath().completePath("source-index");
+   }
+
+   static std::shared_ptr<const SourceIndexSnapshot> emptySnapshot()
+   {
+      return std::make_shared<const SourceIndexSnapshot>(
+               std::vector<boost::shared_ptr<r_util::RSourceIndex> >());
+   }
+
+   std::shared_ptr<const SourceIndexSnapshot> snapshot() const
+   {
+      return std::atomic_load(&pSnapshot_);
+   }
+
+   bool dequeAndIndex(uint64_t generation)
    {
       using namespace rstudio::core::system;
 
+      if (generation != generation_)
+         return false;
+
       if (!indexingQueue_.empty())
       {
          // remove the event from the queue
@@ -825,7 +870,8 @@ private:
             case FileChangeEvent::FileAdded:
             case FileChangeEvent::FileModified:
             {
-               updateIndexEntry(fileInfo);
+               updateIndexEntry(fileInfo,
+                                event.type() == FileChangeEvent::FileAdded);
                break;
             }
 
@@ -842,62 +888,209 @@ private:
 
       // return status
       indexing_ = !indexingQueue_.empty();
+      checkIndexed();
       return indexing_;
    }
 
-   void updateIndexEntry(const FileInfo& fileInfo)
+   void checkIndexed()
    {
-      // index the source if necessary
-      boost::shared_ptr<r_util::RSourceIndex> pIndex;
+      // save the index once it's first built (so it can be reused should the
+      // session not shut down cleanly); any cached indexes not yet used are
+      // for files which no longer exist
+      if (!indexing_ && pendingFiles_.empty() && !indexed_)
+      {
+         indexed_ = true;
+         cache_.clear();
+         saveCache();
+      }
+   }
 
-      // read the file
+   void updateIndexEntry(const FileInfo& fileInfo, bool added)
+   {
       FilePath filePath(fileInfo.absolutePath());
 
       // filter certain directories (e.g. those that exist in build directories)
       if (isWithinIgnoredDirectory(filePath, module_context::ignoreContentDirs()))
          return;
 
-      if (isIndexableSourceFile(fileInfo))
+      // a file which isn't (or is no longer) indexable has no index
+      if (!isIndexableSourceFile(fileInfo))
+      {
+         pendingFiles_.erase(fileInfo.absolutePath());
+         insertEntry(Entry(fileInfo));
+         return;
+      }
+
+      // use the index from the previous session if the file hasn't changed
+      std::string context = module_context::createAliasedPath(filePath);
+      boost::shared_ptr<r_util::RSourceIndex> pIndex = cache_.take(fileInfo, context);
+      if (pIndex)
+      {
+         pendingFiles_.erase(fileInfo.absolutePath());
+         insertEntry(Entry(fileInfo, pIndex));
+         r_packages::AsyncPackageInformationProcess::update();
+         return;
+      }
+
+      // new files are listed right away; the index of a modified file is
+      // kept until its new index is ready
+      if (added)
+         insertEntry(Entry(fileInfo));
+
+      // index the file in the background
+      SourceIndexer::Job job;
+      job.id = ++nextJobId_;
+      job.path = fileInfo.absolutePath();
+      job.context = context;
+      job.encoding = projects::projectContext().defaultEncoding();
+      job.lineEnding = session::options().sourceLineEnding();
+      pendingFiles_[job.path] = std::make_pair(job.id, fileInfo);
+
+      if (!pIndexer_)
+         pIndexer_ = SourceIndexer::create();
+      pIndexer_->enqueue(job);
+      scheduleCollection();
+   }
+
+   void insertEntry(const Entry& entry)
+   {
+      pEntries_->insertEntry(entry);
+      snapshotStale_ = true;
+      scheduleCollection();
+   }
+
+   void scheduleCollection()
+   {
+      if (collecting_)
+         return;
+
+      collecting_ = true;
+      module_context::schedulePeriodicWork(
+               boost::posix_time::milliseconds(50),
+               boost::bind(&SourceFileIndex::collectIndexes, this, generation_),
+               false /* collect indexes even when non-idle */,
+               false /* not immediately */);
+   }
+
+   bool collectIndexes(uint64_t generation)
+   {
+      if (generation != generation_)
+         return false;
+
+      std::vector<SourceIndexer::Result> results;
+      if (pIndexer_)
+         pIndexer_->takeResults(&results);
+
+      bool updated = false;
+      for (SourceIndexer::Result& result : results)
       {
-         std::string code;
-         Error error = module_context::readAndDecodeFile(
-                                 filePath,
-                                 projects::projectContext().defaultEncoding(),
-                                 true,
-                                 &code);
-         if (error)
+         // skip results for files which have since been removed, or which
+         // have been changed again (and are being re-indexed)
+         auto it = pendingFiles_.find(result.job.path);
+         if (it == pendingFiles_.end() || it->second.first != result.job.id)
+            continue;
+
+         if (result.error)
          {
             // log if not path not found error (this can happen if the
             // file was removed after entering the indexing queue)
-            if (!core::isPathNotFoundError(error))
+            if (!core::isPathNotFoundError(result.error))
+            {
+               result.error.addProperty("src-file", result.job.path);
+               LOG_ERROR(result.error);
+            }
+            pendingFiles_.erase(it);
+            continue;
+         }
+
+         // files in other encodings are converted (by R) here, and then
+         // indexed in the background as usual
+         if (result.needsDecoding)
+         {
+            SourceIndexer::Job job = result.job;
+            Error error = module_context::convertToUtf8(result.contents,
+                                                        job.encoding,
+                                                        true,
+                                                        &job.code);
+            if (error)
             {
-               error.addProperty("src-file", filePath.getAbsolutePath());
+               error.addProperty("src-file", job.path);
                LOG_ERROR(error);
+               pendingFiles_.erase(it);
+               continue;
             }
-            return;
+
+            job.decoded = true;
+            pIndexer_->enqueue(job);
+            continue;
          }
 
-         // add index entry
-         std::string context = module_context::createAliasedPath(filePath);
-         pIndex.reset(new r_util::RSourceIndex(context, code));
+         // the shared set of inferred packages can only be updated here
+         if (result.pIndex)
+         {
+            for (const std::string& package : result.pIndex->getInferredPackages())
+               r_util::RSourceIndex::addGloballyInferredPackage(package);
+         }
+
+         pEntries_->insertEntry(Entry(it->second.second, result.pIndex));
+         pendingFiles_.erase(it);
+         updated = true;
       }
 
-      // attempt to add the entry
-      Entry entry(fileInfo, pIndex);
-      pEntries_->insertEntry(entry);
+      if (updated)
+      {
+         snapshotStale_ = true;
+
+         // kick off an update
+         r_packages::AsyncPackageInformationProcess::update();
+      }
+
+      // rebuilding the snapshot visits every index, so while many files are
+      // being indexed do so only every so often
+      using namespace boost::posix_time;
+      ptime now = microsec_clock::universal_time();
+      if (snapshotStale_ &&
+          (pendingFiles_.empty() || now - lastSnapshotTime_ >= seconds(1)))
+      {
+         updateSnapshot();
+         lastSnapshotTime_ = now;
+      }
+
+      checkIndexed();
+
+      collecting_ = !pendingFiles_.empty() || snapshotStale_;
+      return collecting_;
+   }
+
+   void updateSnapshot()
+   {
+      std::vector<boost::shared_ptr<r_util::RSourceIndex> > indexes;
+      for (const Entry& entry : *pEntries_)
+      {
+         if (entry.hasIndex())
+            indexes.push_back(entry.pIndex);
+      }
 
-      // kick off an update
-      r_packages::AsyncPackageInformationProcess::update();
+      std::atomic_store(&pSnapshot_,
+                        std::shared_ptr<const SourceIndexSnapshot>(
+                           new SourceIndexSnapshot(indexes)));
+      snapshotStale_ = false;
    }
 
    void removeIndexEntry(const FileInfo& fileInfo)
    {
+      pendingFiles_.erase(fileInfo.absolutePath());
+
       // create a fake entry with a null source index to pass to find
       Entry entry(fileInfo, boost::shared_ptr<r_util::RSourceIndex>());
 
       EntryTree::iterator it = pEntries_->find(entry);
       if (it != pEntries_->end())
+      {
          pEntries_->erase(it);
+         snapshotStale_ = true;
+         scheduleCollection();
+      }
       else
       {
          DEBUG("Failed to remove index entry for file: '" << fileInfo.getAbsolutePath() << "'");
@@ -969,6 +1162,27 @@ private:
    // indexing queue
    bool indexing_;
    std::queue<core::system::FileChangeEvent> indexingQueue_;
+
+   // has the initial indexing completed
+   bool indexed_;
+
+   // indexes saved by the previous session
+   SourceIndexCache cache_;
+
+   // files being indexed in the background (by path, with the id of the
+   // latest job for each)
+   boost::shared_ptr<SourceIndexer> pIndexer_;
+   std::map<std::string, std::pair<uint64_t, FileInfo> > pendingFiles_;
+   uint64_t nextJobId_;
+   bool collecting_;
+
+   // incremented when the index is cleared, ending the work scheduled for it
+   uint64_t generation_;
+
+   // the indexes as seen by searches (replaced, never modified)
+   bool snapshotStale_;
+   boost::posix_time::ptime lastSnapshotTime_;
+   std::shared_ptr<const SourceIndexSnapshot> pSnapshot_;
 };
 
 } // anonymous namespace
@@ -1293,73 +1507,6 @@ void searchFiles(const std::string& term,
    }
 }
 
-// NOTE: When modifying this code, you should ensure that corresponding
-// changes are made to the client side scoreMatch function as well
-// (See: CodeSearchOracle.java)
-int scoreMatch(std::string const& suggestion,
-               std::string const& query,
-               bool isFile)
-{
-   // No penalty for perfect matches
-   if (suggestion == query)
-      return 0;
-   
-   std::vector<int> matches =
-         string_utils::subsequenceIndices(suggestion, query);
-   
-   int totalPenalty = 0;
-
-   // Loop over the matches and assign a score
-   for (int j = 0, n = gsl::narrow_cast<int>(matches.size()); j < n; j++)
-   {
-      int matchPos = matches[j];
-      int penalty = matchPos;
-
-      // Less penalty if character follows special delim
-      if (matchPos >= 1)
-      {
-         char prevChar = suggestion[matchPos - 1];
-         if (prevChar == '_' || prevChar == '-' || (!isFile && prevChar == '.'))
-         {
-            penalty = j + 1;
-         }
-      }
-
-      // Less penalty for perfect match (ie, reward case-sensitive match)
-      penalty -= suggestion[matchPos] == query[j];
-      
-      // More penalty for 'uninteresting' files
-      if (suggestion == "RcppExports.R" ||
-          suggestion == "RcppExports.cpp")
-         penalty += 6;
-      
-      // More penalty for 'uninteresting' extensions (e.g. .Rd)
-      std::string extension = string_utils::getExtension(suggestion);
-      if (boost::algorithm::to_lower_copy(extension) == ".rd")
-         penalty += 6;
-
-      totalPenalty += penalty;
-   }
-   
-   // Penalize files
-   if (isFile)
-      ++totalPenalty;
-   
-   // Penalize unmatched characters
-   totalPenalty += gsl::narrow_cast<int>((query.size() - matches.size()) * query.size());
-
-   return totalPenalty;
-}
-
-struct ScorePairComparator
-{
-   inline bool operator()(const std::pair<int, int> lhs,
-                          const std::pair<int, int> rhs)
-   {
-      return lhs.second < rhs.second;
-   }
-};
-
 void filterScores(std::vector< std::pair<int, int> >* pScore1,
                   std::vector< std::pair<int, int> >* pScore2,
                   int maxAmount)
@@ -1762,18 +1909,13 @@ Error searchCode(const json::JsonRpcRequest& request,
    // typedef necessary for range-based-for to work with pairs
    typedef std::pair<int, int> PairIntInt;
 
-   // score matches -- returned as a pair, mapping index to score
+   // score matches, keeping only the best of each (lower is better) --
+   // returned as pairs, mapping index to score
    std::vector<PairIntInt> fileScores;
-   for (std::size_t i = 0; i < paths.size(); ++i)
-   {
-      fileScores.push_back(std::make_pair(gsl::narrow_cast<int>(i),
-                                          scoreMatch(names[i], term, true)));
-   }
-
-   // sort by score (lower is better)
-   std::sort(fileScores.begin(), fileScores.end(), ScorePairComparator());
+   FuzzyMatcher(term, true).bestMatches(names, maxResults, &fileScores);
 
-   std::vector<PairIntInt> srcItemScores;
+   std::vector<std::string> srcItemNames;
+   std::vector<int> srcItemIndices;
    for (std::size_t i = 0; i < srcItems.size(); ++i)
    {
       const SourceItem& item = srcItems[i];
@@ -1784,15 +1926,19 @@ Error searchCode(const json::JsonRpcRequest& request,
           boost::algorithm::ends_with(context, "RcppExports.cpp"))
          continue;
          
-      int score = scoreMatch(item.name(), term, false);
-      srcItemScores.push_back(std::make_pair(gsl::narrow_cast<int>(i), score));
+      srcItemNames.push_back(item.name());
+      srcItemIndices.push_back(gsl::narrow_cast<int>(i));
    }
-   std::sort(srcItemScores.begin(), srcItemScores.end(), ScorePairComparator());
+
+   std::vector<PairIntInt> srcItemScores;
+   FuzzyMatcher(term, false).bestMatches(srcItemNames, maxResults, &srcItemScores);
+   for (PairIntInt& pair : srcItemScores)
+      pair.first = srcItemIndices[pair.first];
 
    // filter so we keep only the top n results -- and proactively
    // update whether there are other entries we didn't report back
-   std::size_t srcItemScoresSizeBefore = srcItemScores.size();
-   std::size_t fileScoresSizeBefore = fileScores.size();
+   std::size_t srcItemScoresSizeBefore = srcItemNames.size();
+   std::size_t fileScoresSizeBefore = names.size();
 
    filterScores(&fileScores, &srcItemScores, gsl::narrow_cast<int>(maxResults));
 
@@ -2471,6 +2617,7 @@ Error findFunctionInSearchPath(const json::JsonRpcRequest& request,
 
 void onFileMonitorEnabled(const tree<core::FileInfo>& files)
 {
+   projectIndex().loadCache();
    projectIndex().enqueFiles(files.begin_leaf(), files.end_leaf());
 }
 
@@ -2482,6 +2629,13 @@ void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
          boost::bind(&SourceFileIndex::enqueFileChange, &projectIndex(), _1));
 }
 
+void onShutdown(bool terminatedNormally)
+{
+   if (terminatedNormally)
+      projectIndex().saveCache();
+   projectIndex().stopIndexer();
+}
+
 void onFileMonitorDisabled()
 {
    // clear the index so we don't ever get stale results
@@ -2500,8 +2654,9 @@ SEXP rs_scoreMatches(SEXP suggestionsSEXP,
    std::vector<int> scores;
    scores.reserve(n);
    
+   FuzzyMatcher matcher(query, false);
    for (int i = 0; i < n; i++)
-      scores.push_back(scoreMatch(suggestions[i], query, false));
+      scores.push_back(matcher.score(suggestions[i]));
    
    r::sexp::Protect protect;
    return r::sexp::create(scores, &protect);
@@ -2624,6 +2779,7 @@ Error initialize()
    cb.onMonitoringDisabled = onFileMonitorDisabled;
    projects::projectContext().subscribeToFileMonitor("R source file indexing",
                                                      cb);
+   module_context::events().onShutdown.connect(onShutdown);
 
    // register .Call methods
    RS_REGISTER_CALL_METHOD(rs_viewFunction);
@@ -22,8 +22,10 @@
 
 #include "SessionCodeSearch.hpp"
 #include "SessionAsyncPackageInformation.hpp"
+#include "SessionLintEngine.hpp"
 #include "SessionRParser.hpp"
 
+#include <cstring>
 #include <set>
 
 #include <core/Debug.hpp>
@@ -258,8 +260,40 @@ public:
                symbols.end());
    }
    
+   // the functions attached (on the search path) by a package which
+   // might perform non-standard evaluation
+   void fillNseFunctions(const std::string& pkgName,
+                         std::set<std::string>* pOutput)
+   {
+      if (!nseRegistry_.count(pkgName))
+      {
+         std::vector<std::string>& functions = nseRegistry_[pkgName];
+         
+         SEXP envSEXP = r::sexp::asEnvironment(pkgName);
+         if (envSEXP == R_EmptyEnv)
+            return;
+         
+         std::vector<std::string> symbols;
+         Error error = r::sexp::objects(envSEXP, false, &symbols);
+         if (error) LOG_ERROR(error);
+         
+         for (const std::string& symbol : symbols)
+         {
+            SEXP valueSEXP = r::sexp::forcePromise(r::sexp::findVar(symbol, envSEXP));
+            if (r::sexp::maybePerformsNSE(valueSEXP))
+               functions.push_back(symbol);
+         }
+      }
+      
+      const std::vector<std::string>& functions = nseRegistry_[pkgName];
+      pOutput->insert(
+               functions.begin(),
+               functions.end());
+   }
+   
 private:
    Registry registry_;
+   Registry nseRegistry_;
 };
 
 PackageSymbolRegistry& packageSymbolRegistry()
@@ -327,9 +361,7 @@ void addRcppExportedSymbols(const FilePath& filePath,
 //
 // We don't want to search for symbols on the search path here,
 // since they would not get properly resolved at runtime.
-Error getAvailableSymbolsForPackage(const FilePath& filePath,
-                                    const std::string& documentId,
-                                    std::set<std::string>* pSymbols)
+Error getAvailableSymbolsForPackage(std::set<std::string>* pSymbols)
 {
    // Add project symbols (ie, top-level symbols within an R package)
    code_search::addAllProjectSymbols(pSymbols);
@@ -337,13 +369,6 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
    // Symbols inferred from the NAMESPACE (importFrom, import)
    addNamespaceSymbols(pSymbols);
    
-   // Add symbols made available by explicit `library()` calls
-   // within this document.
-   addInferredSymbols(filePath, documentId, pSymbols);
-   
-   // Add in symbols that would be made available by `// [[Rcpp::export]]`
-   addRcppExportedSymbols(filePath, documentId, pSymbols);
-   
    // Symbols that are 'automatically' made available to packages. In other
    // words, symbols that packages can use without explicitly importing them.
    // In other words, symbols that `R CMD check` will silently resolve to one
@@ -360,23 +385,10 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
 // For a generic R project, we are less strict on where we attempt
 // to discover objects -- we simply consider all symbols available on
 // the current search path.
-Error getAvailableSymbolsForProject(const FilePath& filePath,
-                                    const std::string& documentId,
-                                    std::set<std::string>* pSymbols)
+Error getAvailableSymbolsForProject(std::set<std::string>* pSymbols)
 {
    // Get all available symbols on the search path.
-   Error error = r::exec::RFunction(".rs.availableRSymbols").call(pSymbols);
-   if (error)
-      return error;
-   
-   // Add in symbols that would be made available by `// [[Rcpp::export]]`
-   addRcppExportedSymbols(filePath, documentId, pSymbols);
-   
-   // Get all of the symbols made available by `library()` calls
-   // within this document.
-   addInferredSymbols(filePath, documentId, pSymbols);
-   
-   return Success();
+   return r::exec::RFunction(".rs.availableRSymbols").call(pSymbols);
 }
 
 void addTestPackageSymbols(std::set<std::string>* pSymbols)
@@ -403,44 +415,61 @@ void addTestPackageSymbols(std::set<std::string>* pSymbols)
       registry.fillNamespaceSymbols("assertthat", pSymbols, false);
 }
 
-Error getAllAvailableRSymbols(const FilePath& filePath,
-                              const std::string& documentId,
-                              const ParseResults& results,
-                              std::set<std::string>* pSymbols)
+bool isPackageFile(const FilePath& filePath)
+{
+   return projects::projectContext().isPackageProject() &&
+          filePath.isWithin(projects::projectContext().directory());
+}
+
+// The symbols available to every file within the package project (or,
+// for files outside of a package project, to every such file).
+Error getSharedRSymbols(const FilePath& filePath,
+                        std::set<std::string>* pSymbols)
 {
    // If this file lies within the current project, then
    // we want to pull symbols from specific places -- specifically,
    // _not_ the current search path. We want to infer whether the
    // functions in the package would work at runtime.
-   //
-   // For R package development, when linting a 'test' file, we can
-   // safely assume that the package itself will be loaded.
-   FilePath projDir = projects::projectContext().directory();
-   Error error;
-   
-   if (projects::projectContext().isPackageProject() && filePath.isWithin(projDir))
+   if (isPackageFile(filePath))
    {
       DEBUG("- Package file: '" << filePath.getAbsolutePath() << "'");
-      error = getAvailableSymbolsForPackage(filePath, documentId, pSymbols);
+      return getAvailableSymbolsForPackage(pSymbols);
    }
    else
    {
       DEBUG("- Project file: '" << filePath.getAbsolutePath() << "'");
-      error = getAvailableSymbolsForProject(filePath, documentId, pSymbols);
+      return getAvailableSymbolsForProject(pSymbols);
    }
+}
+
+// The symbols made available to a particular file (e.g. by its own
+// `library()` calls, or by where it lies within the project).
+void addFileRSymbols(const FilePath& filePath,
+                     const std::string& documentId,
+                     const ParseResults& results,
+                     std::set<std::string>* pSymbols)
+{
+   // Get all of the symbols made available by `library()` calls
+   // within this document.
+   addInferredSymbols(filePath, documentId, pSymbols);
    
-   if (error) LOG_ERROR(error);
+   // Add in symbols that would be made available by `// [[Rcpp::export]]`
+   addRcppExportedSymbols(filePath, documentId, pSymbols);
    
    // Add common 'testing' packages, based on the DESCRIPTION's
    // 'Imports' and 'Suggests' fields, and use that if we're within a
    // common 'test'ing directory.
+   //
+   // For R package development, when linting a 'test' file, we can
+   // safely assume that the package itself will be loaded.
+   FilePath projDir = projects::projectContext().directory();
    if (filePath.isWithin(projDir.completeChildPath("inst")) ||
        filePath.isWithin(projDir.completeChildPath("tests")))
    {
       addTestPackageSymbols(pSymbols);
    }
    
-   if (filePath.isWithin(projects::projectContext().directory().completeChildPath("tests/testthat")))
+   if (filePath.isWithin(projDir.completeChildPath("tests/testthat")))
    {
       PackageSymbolRegistry& registry = packageSymbolRegistry();
       registry.fillNamespaceSymbols("testthat", pSymbols, false);
@@ -460,42 +489,56 @@ Error getAllAvailableRSymbols(const FilePath& filePath,
    }
    
    pSymbols->insert(results.globals().begin(), results.globals().end());
-   
-   return error;
-      
 }
 
 void checkNoDefinitionInScope(const FilePath& origin,
                               const std::string& documentId,
+                              const std::set<std::string>& sharedSymbols,
                               ParseResults& results)
 {
    ParseNode* pRoot = results.parseTree();
    
    std::vector<ParseItem> unresolvedItems;
    pRoot->findAllUnresolvedSymbols(&unresolvedItems);
+   if (unresolvedItems.empty())
+      return;
    
-   // Now, find all available R symbols -- that is, objects on the search path,
+   // Now, find the rest of the available R symbols -- that is, those
+   // that would otherwise be made available to this file at runtime
+   std::set<std::string> fileSymbols;
+   addFileRSymbols(origin, documentId, results, &fileSymbols);
+   
+   // For each unresolved symbol, add it to the lint if it's not available.
+   for (const ParseItem& item : unresolvedItems)
+   {
+      if (r::util::isRKeyword(item.symbol) ||
+          r::util::isWindowsOnlyFunction(item.symbol))
+      {
+         continue;
+      }
+      
+      std::string symbol = string_utils::strippedOfBackQuotes(item.symbol);
+      if (sharedSymbols.count(symbol) == 0 && fileSymbols.count(symbol) == 0)
+         addUnreferencedSymbol(item, results.lint());
+   }
+}
+
+void checkNoDefinitionInScope(const FilePath& origin,
+                              const std::string& documentId,
+                              ParseResults& results)
+{
+   // Find the available R symbols -- that is, objects on the search path,
    // or symbols that would otherwise be made available at runtime (e.g.
    // package imports)
-   std::set<std::string> objects;
-   Error error = getAllAvailableRSymbols(origin, documentId, results, &objects);
+   std::set<std::string> sharedSymbols;
+   Error error = getSharedRSymbols(origin, &sharedSymbols);
    if (error)
    {
       LOG_ERROR(error);
       return;
    }
    
-   // For each unresolved symbol, add it to the lint if it's not on the search
-   // path.
-   for (const ParseItem& item : unresolvedItems)
-   {
-      if (!r::util::isRKeyword(item.symbol) &&
-          !r::util::isWindowsOnlyFunction(item.symbol) &&
-          objects.count(string_utils::strippedOfBackQuotes(item.symbol)) == 0)
-      {
-         addUnreferencedSymbol(item, results.lint());
-      }
-   }
+   checkNoDefinitionInScope(origin, documentId, sharedSymbols, results);
 }
 
 bool lintOptionValueAsBool(const std::string& value)
@@ -599,6 +642,8 @@ void applyOptions(const FileLocalLintOptions& fileOptions,
 
 #define kLintComment L"(?:^|\\n)#+\\s+\\!diagnostics"
 
+} // end anonymous namespace
+
 void setFileLocalParseOptions(const std::wstring& rCode,
                               ParseOptions* pOptions,
                               bool* pNoLint)
@@ -635,14 +680,63 @@ void setFileLocalParseOptions(const std::wstring& rCode,
    applyOptions(options, pOptions);
 }
 
-} // end anonymous namespace
+namespace {
 
-ParseResults parse(const std::wstring& rCode,
-                   const FilePath& origin,
-                   const std::string& documentId = std::string(),
-                   bool isExplicit = false)
+// parsers for open source documents, which keep the parse results for
+// each of the document's top-level expressions between lint requests
+std::map<std::string, boost::shared_ptr<IncrementalParser> > s_documentParsers;
+
+IncrementalParser& documentParser(const std::string& documentId)
+{
+   boost::shared_ptr<IncrementalParser>& pParser = s_documentParsers[documentId];
+   if (!pParser)
+      pParser.reset(new IncrementalParser());
+   return *pParser;
+}
+
+void onSourceDocRemoved(const std::string& id, const std::string& path)
+{
+   s_documentParsers.erase(id);
+}
+
+void onAllSourceDocsRemoved()
+{
+   s_documentParsers.clear();
+}
+
+// the lint the parsers keep depends on the search path (e.g. whether a
+// symbol is in scope, or a call's arguments match), so it's discarded when
+// packages are attached or detached
+std::vector<std::string> s_searchPath;
+
+void onDetectChanges(module_context::ChangeSource source)
+{
+   // (as for .libPaths(), the search path is only checked at the top level)
+   if (source != module_context::ChangeSourceREPL ||
+       !r::exec::isMainThread() ||
+       !r::exec::atTopLevelContext())
+   {
+      return;
+   }
+
+   std::vector<std::string> searchPath;
+   Error error = r::exec::RFunction("base:::search").call(&searchPath);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   if (searchPath == s_searchPath)
+      return;
+
+   s_searchPath = searchPath;
+   for (auto& entry : s_documentParsers)
+      entry.second->clear();
+}
+
+ParseOptions lintOptions(bool isExplicit)
 {
-   ParseResults results;
    ParseOptions options;
    
    options.setLintRFunctions(
@@ -663,12 +757,28 @@ ParseResults parse(const std::wstring& rCode,
    options.setRecordStyleLint(
             prefs::userPrefs().styleDiagnostics());
    
+   return options;
+}
+
+} // end anonymous namespace
+
+ParseResults parse(const std::wstring& rCode,
+                   const FilePath& origin,
+                   const std::string& documentId = std::string(),
+                   bool isExplicit = false)
+{
+   ParseResults results;
+   ParseOptions options = lintOptions(isExplicit);
+   
    bool noLint = false;
    setFileLocalParseOptions(rCode, &options, &noLint);
    if (noLint)
       return ParseResults();
    
-   results = rparser::parse(origin, rCode, options);
+   if (documentId.empty())
+      results = rparser::parse(origin, rCode, options);
+   else
+      results = documentParser(documentId).parse(origin, rCode, options);
    
    ParseNode* pRoot = results.parseTree();
    if (!pRoot)
@@ -975,35 +1085,159 @@ void afterSessionInitHook(bool newSession)
    }
 }
 
-bool collectLint(int depth,
-                 const FilePath& path,
-                 std::map<FilePath, LintItems>* pLint)
+bool collectRFile(int depth,
+                  const FilePath& path,
+                  std::vector<FilePath>* pFiles)
 {
-   if (path.getExtensionLowerCase() != ".r")
-      return true;
+   if (path.getExtensionLowerCase() == ".r")
+      pFiles->push_back(path);
+   return true;
+}
+
+// The functions through which calls might perform non-standard evaluation,
+// for parses run in the background (which can't ask R): those indexed
+// for the packages used by the project, and those attached (by packages)
+// to the search path.
+boost::shared_ptr<const std::set<std::string> > resolveBackgroundNseFunctions()
+{
+   boost::shared_ptr<std::set<std::string> > pFunctions(new std::set<std::string>());
    
-   std::string contents;
-   Error error = core::readStringFromFile(
-            path,
-            &contents,
-            string_utils::LineEndingPosix);
+   for (const PackageInformation& pkgInfo :
+           RSourceIndex::getPackageInformationDatabase() | boost::adaptors::map_values)
+   {
+      for (const FunctionInformationMap::value_type& entry : pkgInfo.functionInfo)
+      {
+         if (entry.second.performsNse())
+            pFunctions->insert(entry.first);
+      }
+   }
    
+   std::vector<std::string> searchPath;
+   Error error = r::exec::RFunction("base:::search").call(&searchPath);
    if (error)
-   {
       LOG_ERROR(error);
-      return true;
-   }
    
-   ParseResults results = diagnostics::parse(
-            string_utils::utf8ToWide(contents),
-            path,
-            std::string(),
-            true);
+   PackageSymbolRegistry& registry = packageSymbolRegistry();
+   for (const std::string& entry : searchPath)
+   {
+      if (boost::algorithm::starts_with(entry, "package:"))
+         registry.fillNseFunctions(entry.substr(std::strlen("package:")), pFunctions.get());
+   }
    
-   (*pLint)[path] = results.lint();
-   return true;
+   return pFunctions;
 }
 
+// Lints the R files within a directory: the files are parsed on background
+// threads, and their lint shown (as source markers) as it's collected. The
+// symbols available to the files are resolved once (when first needed by a
+// file's lint, as files may turn the check on or off), rather than for each
+// file.
+class DirectoryLint : boost::noncopyable
+{
+public:
+   
+   DirectoryLint()
+      : pEngine_(LintEngine::create()),
+        stopped_(false)
+   {
+   }
+   
+   void start(const std::vector<FilePath>& files,
+              const ParseOptions& options)
+   {
+      for (std::size_t i = 0; i < files.size(); i++)
+      {
+         LintEngine::Job job;
+         job.id = i;
+         job.path = files[i].getAbsolutePath();
+         job.options = options;
+         pEngine_->enqueue(job);
+      }
+   }
+   
+   void stop()
+   {
+      stopped_ = true;
+      pEngine_->stop();
+   }
+   
+   bool collect()
+   {
+      if (stopped_)
+         return false;
+      
+      std::vector<LintEngine::Result> results;
+      bool more = pEngine_->takeResults(&results);
+      for (LintEngine::Result& result : results)
+         collectLint(result);
+      
+      if (!results.empty() || !more)
+      {
+         using namespace module_context;
+         showSourceMarkers(asSourceMarkerSet(lint_), MarkerAutoSelectNone);
+      }
+      
+      return more;
+   }
+   
+private:
+   
+   void resolveSharedSymbols(const FilePath& file)
+   {
+      bool packageFile = isPackageFile(file);
+      if (sharedSymbols_.count(packageFile) || failedSymbols_.count(packageFile))
+         return;
+      
+      Error error = getSharedRSymbols(file, &sharedSymbols_[packageFile]);
+      if (error)
+      {
+         LOG_ERROR(error);
+         sharedSymbols_.erase(packageFile);
+         failedSymbols_.insert(packageFile);
+      }
+   }
+   
+   void collectLint(LintEngine::Result& result)
+   {
+      FilePath path(result.job.path);
+      if (result.error)
+      {
+         LOG_ERROR(result.error);
+         return;
+      }
+      
+      // (the options include those set within the file)
+      ParseResults& results = result.results;
+      if (!result.noLint)
+      {
+         if (result.options.warnIfNoSuchVariableInScope())
+         {
+            resolveSharedSymbols(path);
+            std::map<bool, std::set<std::string> >::const_iterator it =
+                  sharedSymbols_.find(isPackageFile(path));
+            if (it != sharedSymbols_.end())
+               checkNoDefinitionInScope(path, std::string(), it->second, results);
+         }
+         
+         if (result.options.warnIfVariableIsDefinedButNotUsed())
+            checkDefinedButNotUsed(results);
+      }
+      
+      lint_[path] = results.lint();
+   }
+   
+   boost::shared_ptr<LintEngine> pEngine_;
+   bool stopped_;
+   
+   // symbols available to files within a package, and to other files
+   std::map<bool, std::set<std::string> > sharedSymbols_;
+   std::set<bool> failedSymbols_;
+   
+   std::map<FilePath, LintItems> lint_;
+};
+
+boost::shared_ptr<DirectoryLint> s_pDirectoryLint;
+
 SEXP rs_lintDirectory(SEXP directorySEXP)
 {
    std::string directory = r::sexp::asString(directorySEXP);
@@ -1011,21 +1245,40 @@ SEXP rs_lintDirectory(SEXP directorySEXP)
    if (!dirPath.exists())
       return R_NilValue;
    
-   std::map<FilePath, LintItems> lint;
+   std::vector<FilePath> files;
    Error error = dirPath.getChildrenRecursive(
-            boost::bind(collectLint, _1, _2, &lint));
+            boost::bind(collectRFile, _1, _2, &files));
    if (error)
    {
       LOG_ERROR(error);
       return R_NilValue;
    }
    
-   using namespace module_context;
-   SourceMarkerSet markers = asSourceMarkerSet(lint);
-   showSourceMarkers(markers, MarkerAutoSelectNone);
+   // a new lint replaces any still in progress
+   if (s_pDirectoryLint)
+      s_pDirectoryLint->stop();
+   
+   ParseOptions options = lintOptions(true);
+   options.setBackgroundNseFunctions(resolveBackgroundNseFunctions());
+   
+   s_pDirectoryLint.reset(new DirectoryLint());
+   s_pDirectoryLint->start(files, options);
+   
+   module_context::schedulePeriodicWork(
+            boost::posix_time::milliseconds(250),
+            boost::bind(&DirectoryLint::collect, s_pDirectoryLint),
+            true /* collect lint when idle */,
+            false /* not immediately */);
+   
    return R_NilValue;
 }
 
+void onShutdown(bool terminatedNormally)
+{
+   if (s_pDirectoryLint)
+      s_pDirectoryLint->stop();
+}
+
 } // anonymous namespace
 
 core::Error initialize()
@@ -1035,6 +1288,11 @@ core::Error initialize()
    using namespace module_context;
    
    events().afterSessionInitHook.connect(afterSessionInitHook);
+   events().onShutdown.connect(onShutdown);
+   events().onDetectChanges.connect(onDetectChanges);
+   
+   source_database::events().onDocRemoved.connect(onSourceDocRemoved);
+   source_database::events().onRemoveAll.connect(onAllSourceDocsRemoved);
    
    session::projects::FileMonitorCallbacks cb;
    cb.onFilesChanged = onFilesChanged;
@@ -16,10 +16,19 @@
 #ifndef SESSION_MODULES_DIAGNOSTICS_HPP
 #define SESSION_MODULES_DIAGNOSTICS_HPP
 
+#include <string>
+
 namespace rstudio {
 namespace core {
    class Error;
 }
+namespace session {
+namespace modules {
+namespace rparser {
+   class ParseOptions;
+}
+}
+}
 }
 
 namespace rstudio {
@@ -27,6 +36,12 @@ namespace session {
 namespace modules {
 namespace diagnostics {
 
+// apply the options given in '# !diagnostics' comments within the code
+// (safe to call from any thread)
+void setFileLocalParseOptions(const std::wstring& rCode,
+                              rparser::ParseOptions* pOptions,
+                              bool* pNoLint);
+
 core::Error initialize();
 
 } // namespace diagnostics
@@ -17,7 +17,9 @@
 
 #include "SessionDiagnostics.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 #include <core/collection/Tree.hpp>
 #include <shared_core/FilePath.hpp>
@@ -115,6 +117,48 @@ void lintRFilesInSubdirectory(const FilePath& path)
    }
 }
 
+std::vector<std::string> lintAsStrings(const LintItems& lint)
+{
+   std::vector<std::string> strings;
+   for (const LintItem& item : lint)
+   {
+      std::stringstream ss;
+      ss << item.startRow << ":" << item.startColumn << "-"
+         << item.endRow << ":" << item.endColumn << " " << item.message;
+      strings.push_back(ss.str());
+   }
+   std::sort(strings.begin(), strings.end());
+   return strings;
+}
+
+// Parse the code incrementally, and verify that the results match those
+// of a full parse.
+std::size_t expectIncrementalParse(IncrementalParser& parser, const std::string& code)
+{
+   std::wstring wideCode = string_utils::utf8ToWide(code);
+   ParseResults incremental = parser.parse(FilePath(), wideCode, s_parseOptions);
+   ParseResults full = rparser::parse(FilePath(), wideCode, s_parseOptions);
+   
+   expect_true(lintAsStrings(incremental.lint()) == lintAsStrings(full.lint()));
+   
+   const ParseNode* pIncremental = incremental.parseTree();
+   const ParseNode* pFull = full.parseTree();
+   expect_true(pIncremental->getDefinedSymbols() == pFull->getDefinedSymbols());
+   expect_true(pIncremental->getReferencedSymbols() == pFull->getReferencedSymbols());
+   expect_true(pIncremental->getChildren().size() == pFull->getChildren().size());
+   for (std::size_t i = 0; i < pFull->getChildren().size(); i++)
+   {
+      const ParseNode& incrementalChild = *pIncremental->getChildren()[i];
+      const ParseNode& fullChild = *pFull->getChildren()[i];
+      expect_true(incrementalChild.name() == fullChild.name());
+      expect_true(incrementalChild.position() == fullChild.position());
+      expect_true(incrementalChild.getParent() == pIncremental);
+      expect_true(incrementalChild.getDefinedSymbols() == fullChild.getDefinedSymbols());
+   }
+   
+   return parser.expressionsParsed();
+}
+
 void lintRStudioRFiles()
 {
    lintRFilesInSubdirectory(options().coreRSourcePath());
@@ -296,6 +340,49 @@ test_context("Diagnostics")
       EXPECT_NO_LINT("x <- (1)");
    }
    
+   test_that("incremental parses match full parses")
+   {
+      IncrementalParser parser;
+      
+      std::string code =
+            "add <- function(x, y) {\n"
+            "   x + y\n"
+            "}\n"
+            "\n"
+            "z <- add(1, 2)\n"
+            "if (z > 2)\n"
+            "   print(z) else\n"
+            "   print(-z)\n"
+            "mtcars |>\n"
+            "   subset(cyl == 4)\n";
+      
+      expect_true(expectIncrementalParse(parser, code) == 4);
+      
+      // unchanged code isn't parsed again
+      expect_true(expectIncrementalParse(parser, code) == 0);
+      
+      // edits within an expression only parse that expression, even when
+      // they move the expressions following
+      boost::algorithm::replace_first(code, "x + y", "x + y + 1");
+      expect_true(expectIncrementalParse(parser, code) == 1);
+      boost::algorithm::replace_first(code, "\n\nz", "\n\n\n\nz");
+      expect_true(expectIncrementalParse(parser, code) == 1);
+      boost::algorithm::replace_first(code, "print(z)", "print(z, digits = 2)");
+      expect_true(expectIncrementalParse(parser, code) == 1);
+      
+      // edits which change top-level definitions parse the whole document
+      boost::algorithm::replace_first(code, "add(1, 2)", "add(1, w <- 2)");
+      expect_true(expectIncrementalParse(parser, code) == 4);
+      boost::algorithm::replace_first(code, "function(x, y)", "function(x, y, ...)");
+      expect_true(expectIncrementalParse(parser, code) == 4);
+      
+      // as do those following a version with unbalanced brackets
+      boost::algorithm::replace_first(code, "x + y + 1\n}", "x + y + 1\n");
+      expectIncrementalParse(parser, code);
+      boost::algorithm::replace_first(code, "x + y + 1\n", "x + y + 1\n}");
+      expect_true(expectIncrementalParse(parser, code) == 4);
+   }
+   
    lintRStudioRFiles();
 }
 
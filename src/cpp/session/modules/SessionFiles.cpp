@@ -26,6 +26,9 @@
 #include <gsl/gsl>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 
 #include <shared_core/Error.hpp>
 #include <core/Log.hpp>
@@ -39,7 +42,9 @@
 
 #include <core/http/Util.hpp>
 #include <core/http/Request.hpp>
+#include <core/http/MultipartFormParser.hpp>
 #include <core/http/Response.hpp>
+#include <core/http/ZipStreamResponse.hpp>
 
 #include <shared_core/json/Json.hpp>
 
@@ -59,11 +64,14 @@
 #include <session/SessionOptions.hpp>
 #include <session/SessionSourceDatabase.hpp>
 
+#include <session/jobs/JobsApi.hpp>
 #include <session/projects/SessionProjects.hpp>
 
 #include "SessionFilesQuotas.hpp"
+#include "SessionFilesListingCache.hpp"
 #include "SessionFilesListingMonitor.hpp"
 #include "SessionGit.hpp"
+#include "SessionVCS.hpp"
 
 using namespace rstudio::core;
 
@@ -78,6 +86,9 @@ namespace {
 // monitor for file listings
 FilesListingMonitor s_filesListingMonitor;
 
+// cached listings for paged requests
+FilesListingCache s_filesListingCache;
+
 // make sure that monitoring persists accross suspended sessions
 const char * const kFilesMonitoredPath = "files.monitored-path";
 
@@ -225,6 +236,20 @@ core::Error getFileContents(const json::JsonRpcRequest& request,
    return Success();
 }
    
+bool isParentBrowseable(const FilePath& targetPath)
+{
+   bool browseable = true;
+
+#ifndef _WIN32
+   // on *nix systems, see if browsing above this path is possible
+   Error error = targetPath.getParent().isReadable(browseable);
+   if (error && !core::isPathNotFoundError(error))
+      LOG_ERROR(error);
+#endif
+
+   return browseable;
+}
+
 Error listFiles(const json::JsonRpcRequest& request, json::JsonRpcResponse* pResponse)
 {
    // get args
@@ -267,17 +292,102 @@ Error listFiles(const json::JsonRpcRequest& request, json::JsonRpcResponse* pRes
    }
 
    result["files"] = jsonFiles;
+   result["is_parent_browseable"] = isParentBrowseable(targetPath);
 
-   bool browseable = true;
+   pResponse->setResult(result);
+   return Success();
+}
 
-#ifndef _WIN32
-   // on *nix systems, see if browsing above this path is possible
-   error = targetPath.getParent().isReadable(browseable);
-   if (error && !core::isPathNotFoundError(error))
-      LOG_ERROR(error);
-#endif
+// IN: String path, Boolean monitor, Boolean includeHidden, String sortBy,
+//     Boolean ascending, Int offset, Int count
+// OUT: { files, total_count, offset, is_parent_browseable }
+Error listFilesPage(const json::JsonRpcRequest& request, json::JsonRpcResponse* pResponse)
+{
+   // get args
+   std::string path, sortBy, after;
+   bool monitor, includeHidden, ascending;
+   int offset, count;
+   Error error = json::readParams(request.params,
+                                  &path,
+                                  &monitor,
+                                  &includeHidden,
+                                  &sortBy,
+                                  &ascending,
+                                  &offset,
+                                  &count,
+                                  &after);
+   if (error)
+      return error;
+
+   FilesListingSortKey sortKey;
+   if (!filesListingSortKeyFromString(sortBy, &sortKey) || offset < 0 || count < 0)
+      return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+
+   FilePath targetPath = module_context::resolveAliasedPath(path);
+
+   // determine whether the cached listing is kept current by a file monitor
+   // (paging within an already monitored directory leaves its monitor alone)
+   bool monitored = false;
+   bool startMonitor = false;
+   if (monitor)
+   {
+      if (session::projects::projectContext().isMonitoringDirectory(targetPath))
+      {
+         s_filesListingMonitor.stop();
+         monitored = true;
+      }
+      else if (s_filesListingMonitor.currentMonitoredPath() == targetPath &&
+               s_filesListingMonitor.includeHidden() == includeHidden)
+      {
+         monitored = true;
+      }
+      else
+      {
+         startMonitor = true;
+      }
+   }
+
+   std::vector<FileInfo> files;
+   std::size_t start = 0, totalCount = 0;
+   error = s_filesListingCache.listFiles(targetPath,
+                                         includeHidden,
+                                         monitored,
+                                         sortKey,
+                                         ascending,
+                                         after.empty() ? std::string() :
+                                            module_context::resolveAliasedPath(after).getAbsolutePath(),
+                                         offset,
+                                         count,
+                                         &files,
+                                         &start,
+                                         &totalCount);
+   if (error)
+      return error;
+
+   // monitor from the listing we just took; changes made in the meantime
+   // are reported (and applied to the cache) once registration completes
+   if (startMonitor)
+   {
+      std::vector<FileInfo> prevFiles;
+      s_filesListingCache.snapshot(targetPath, includeHidden, &prevFiles);
+      s_filesListingMonitor.start(targetPath, includeHidden, prevFiles);
+   }
+
+   // produce json for only the requested window
+   auto pCtx = source_control::fileDecorationContext(targetPath, false);
+   json::Array jsonFiles;
+   for (const FileInfo& fileInfo : files)
+   {
+      json::Object fileObject = module_context::createFileSystemItem(fileInfo);
+      pCtx->decorateFile(FilePath(fileInfo.absolutePath()), &fileObject);
+      jsonFiles.push_back(fileObject);
+   }
 
-   result["is_parent_browseable"] = browseable;
+   json::Object result;
+   result["files"] = jsonFiles;
+   result["total_count"] = static_cast<int>(totalCount);
+   result["offset"] = static_cast<int>(start);
+   result["is_parent_browseable"] = isParentBrowseable(targetPath);
 
    pResponse->setResult(result);
    return Success();
@@ -571,30 +681,164 @@ const char * const kUploadedTempFile = "uploadedTempFile";
 const char * const kUploadTargetDirectory = "targetDirectory";
 const char * const kIsZip = "isZip";
 const char * const kUnzipFound = "unzipFound";
+const char * const kZipEntries = "zipEntries";
+
+// state for expanding an uploaded zip archive in the background
+struct UnzipState
+{
+   UnzipState() : entries(0), extracted(0), cancelled(false) {}
+
+   std::string fileName;
+   FilePath zipFile;
+   FilePath targetDirectory;
+   int entries;
+   int extracted;
+   bool cancelled;
+   std::string partialLine;
+   std::string errorOutput;
+   boost::shared_ptr<jobs::Job> pJob;
+};
+
+bool onUnzipContinue(boost::shared_ptr<UnzipState> pState)
+{
+   return !pState->cancelled;
+}
 
-Error writeTmpData(const FilePath& tmpFile,
-                   const char* buffer,
-                   size_t beginOffset,
-                   size_t endOffset)
+void onUnzipStdout(boost::shared_ptr<UnzipState> pState, const std::string& output)
 {
-   Error error = tmpFile.ensureFile();
+   // unzip reports each entry on its own line (e.g. "  inflating: data/a.csv")
+   std::string lines = pState->partialLine + output;
+   std::size_t lineStart = 0;
+   std::size_t lineEnd = lines.find('\n');
+   int extracted = pState->extracted;
+   while (lineEnd != std::string::npos)
+   {
+      std::string line = boost::algorithm::trim_copy(
+               lines.substr(lineStart, lineEnd - lineStart));
+      if (boost::algorithm::starts_with(line, "inflating:") ||
+          boost::algorithm::starts_with(line, "extracting:") ||
+          boost::algorithm::starts_with(line, "creating:") ||
+          boost::algorithm::starts_with(line, "linking:"))
+      {
+         extracted++;
+      }
+
+      lineStart = lineEnd + 1;
+      lineEnd = lines.find('\n', lineStart);
+   }
+   pState->partialLine = lines.substr(lineStart);
+
+   if (extracted != pState->extracted)
+   {
+      pState->extracted = extracted;
+      jobs::setJobProgress(pState->pJob, std::min(extracted, pState->entries));
+   }
+}
+
+void onUnzipStderr(boost::shared_ptr<UnzipState> pState, const std::string& output)
+{
+   // retain the start of any error output for reporting
+   const std::size_t kMaxErrorOutput = 4096;
+   if (pState->errorOutput.size() < kMaxErrorOutput)
+      pState->errorOutput.append(output.substr(0, kMaxErrorOutput - pState->errorOutput.size()));
+}
+
+void onUnzipExit(boost::shared_ptr<UnzipState> pState, int exitStatus)
+{
+   // remove the __MACOSX folder if it exists
+   const std::string kMacOSXFolder("__MACOSX");
+   FilePath macOSXPath = pState->targetDirectory.completePath(kMacOSXFolder);
+   Error error = macOSXPath.removeIfExists();
    if (error)
-      return error;
+      LOG_ERROR(error);
 
-   std::shared_ptr<std::ostream> pOfs;
-   error = tmpFile.openForWrite(pOfs, false);
+   // remove the uploaded temp file
+   error = pState->zipFile.removeIfExists();
    if (error)
-      return error;
+      LOG_ERROR(error);
+
+   // unzip exits with status 1 when it succeeds with warnings
+   if (pState->cancelled)
+   {
+      jobs::setJobState(pState->pJob, jobs::JobCancelled);
+   }
+   else if (exitStatus == 0 || exitStatus == 1)
+   {
+      jobs::setJobProgress(pState->pJob, pState->entries);
+      jobs::setJobState(pState->pJob, jobs::JobSucceeded);
+   }
+   else
+   {
+      jobs::setJobState(pState->pJob, jobs::JobFailed);
+      module_context::showErrorMessage(
+               "Upload Error",
+               "Error extracting " + pState->fileName + ": " +
+               (pState->errorOutput.empty() ?
+                   "unzip exited with status " + std::to_string(exitStatus) :
+                   pState->errorOutput));
+   }
 
-   pOfs->seekp(tmpFile.getSize());
+   // check quota after uploads
+   quotas::checkQuotaStatus();
+}
 
-   if (!pOfs->write(buffer + beginOffset, endOffset - beginOffset + 1))
+// expand an uploaded archive using the system's unzip; this is run as a
+// child process (reporting progress as a job) so that large archives don't
+// block the session
+Error unzipUpload(const FilePath& zipFile,
+                  const FilePath& targetDirectory,
+                  const std::string& fileName,
+                  int entries)
+{
+   FilePath unzipPath;
+   Error error = core::system::findProgramOnPath("unzip", &unzipPath);
+   if (error)
    {
-      return systemError(boost::system::errc::io_error,
-                         "Could not write to destination file: " + tmpFile.getAbsolutePath(),
-                         ERROR_LOCATION);
+      unzipPath = FilePath("/usr/bin/unzip");
+      if (!unzipPath.exists())
+         return error;
    }
 
+   boost::shared_ptr<UnzipState> pState = boost::make_shared<UnzipState>();
+   pState->fileName = fileName;
+   pState->zipFile = zipFile;
+   pState->targetDirectory = targetDirectory;
+   pState->entries = std::max(entries, 1);
+
+   std::vector<std::string> args;
+   args.push_back("-o");
+   args.push_back(zipFile.getAbsolutePath());
+   args.push_back("-d");
+   args.push_back(targetDirectory.getAbsolutePath());
+
+   core::system::ProcessOptions options;
+   core::system::ProcessCallbacks cb;
+   cb.onContinue = boost::bind(onUnzipContinue, pState);
+   cb.onStdout = boost::bind(onUnzipStdout, pState, _2);
+   cb.onStderr = boost::bind(onUnzipStderr, pState, _2);
+   cb.onExit = boost::bind(onUnzipExit, pState, _1);
+
+   error = module_context::processSupervisor().runProgram(unzipPath.getAbsolutePath(),
+                                                         args,
+                                                         options,
+                                                         cb);
+   if (error)
+      return error;
+
+   // report progress as a job (the job holds its actions, and the state
+   // holds the job, so the stop action mustn't keep the state alive)
+   boost::weak_ptr<UnzipState> pWeakState = pState;
+   jobs::JobActions jobActions;
+   jobActions.push_back(std::make_pair("stop", [=](const std::string&)
+   {
+      boost::shared_ptr<UnzipState> pState = pWeakState.lock();
+      if (pState)
+         pState->cancelled = true;
+   }));
+   pState->pJob = jobs::addJob("Unzipping " + fileName, "", "",
+                               pState->entries, false, jobs::JobRunning, jobs::JobTypeSession,
+                               true, R_NilValue, jobActions, false, {});
+
    return Success();
 }
 
@@ -611,11 +855,13 @@ Error completeUpload(const core::json::JsonRpcRequest& request,
    // parse fields out of token object
    std::string filename, uploadedTempFile, targetDirectory;
    bool unzipFound = false;
+   int zipEntries = 0;
    error = json::readObject(token, 
                             kUploadFilename, filename,
                             kUploadedTempFile, uploadedTempFile,
                             kUploadTargetDirectory, targetDirectory,
-                            kUnzipFound, unzipFound);
+                            kUnzipFound, unzipFound,
+                            kZipEntries, zipEntries);
    if (error)
       return error;
    
@@ -629,11 +875,12 @@ Error completeUpload(const core::json::JsonRpcRequest& request,
 
       if (boost::ends_with(filename, "zip") && unzipFound)
       {
-         // expand the archive
-         r::exec::RFunction unzip("unzip");
-         unzip.addParam("zipfile", uploadedTempFilePath.getAbsolutePath());
-         unzip.addParam("exdir", targetDirectoryPath.getAbsolutePath());
-         Error unzipError = unzip.call();
+         // expand the archive in the background (the temp file is removed
+         // and quotas are checked once it's done)
+         Error unzipError = unzipUpload(uploadedTempFilePath,
+                                        targetDirectoryPath,
+                                        filename,
+                                        zipEntries);
          if (unzipError)
          {
             error = uploadedTempFilePath.remove();
@@ -642,18 +889,8 @@ Error completeUpload(const core::json::JsonRpcRequest& request,
 
             return unzipError;
          }
-         
-         // remove the __MACOSX folder if it exists
-         const std::string kMacOSXFolder("__MACOSX");
-         FilePath macOSXPath = targetDirectoryPath.completePath(kMacOSXFolder);
-         Error removeError = macOSXPath.removeIfExists();
-         if (removeError)
-            LOG_ERROR(removeError);
-
-         // remove the uploaded temp file
-         error = uploadedTempFilePath.removeIfExists();
-         if (error)
-            LOG_ERROR(error);
+
+         return Success();
       }
       else
       {
@@ -691,7 +928,8 @@ Error detectZipFileOverwrites(const FilePath& uploadedZipFile,
                               const FilePath& destDir,
                               const std::string& originalFilename,
                               json::Array* pOverwritesJson,
-                              bool* pUnzipfound)
+                              bool* pUnzipfound,
+                              int* pEntryCount)
 {
    // unable to use R's unzip here in worker thread, using system's unzip instead
    // try a couple locations for unzip, in case it's not on user's PATH
@@ -725,6 +963,8 @@ Error detectZipFileOverwrites(const FilePath& uploadedZipFile,
             // don't count empty lines
             if ((*it).empty()) continue;
 
+            (*pEntryCount)++;
+
             FilePath filePath = destDir.completePath(*it);
             if (filePath.exists())
                pOverwritesJson->push_back(module_context::createFileSystemItem(filePath));
@@ -760,20 +1000,25 @@ Error detectZipFileOverwrites(const FilePath& uploadedZipFile,
    return Success();
 }
 
-bool validateUploadedFile(uintmax_t fileSize, http::Response* pResponse)
+// maximum upload size in bytes (0 if uploads aren't limited)
+uintmax_t uploadByteLimit()
 {
    // get limit
    size_t mbLimit = session::options().limitFileUploadSizeMb();
 
    // don't enforce if no limit specified
    if (mbLimit <= 0)
-      return true;
+      return 0;
 
    // convert limit to bytes
-   uintmax_t byteLimit = mbLimit * 1024 * 1024;
+   return static_cast<uintmax_t>(mbLimit) * 1024 * 1024;
+}
 
+bool validateUploadedFile(uintmax_t fileSize, http::Response* pResponse)
+{
    // compare to file size
-   if (fileSize > byteLimit)
+   uintmax_t byteLimit = uploadByteLimit();
+   if (byteLimit > 0 && fileSize > byteLimit)
    {
       Error fileTooLargeError = systemError(boost::system::errc::file_too_large,
                                             ERROR_LOCATION);
@@ -794,86 +1039,129 @@ bool validateUploadedFile(const http::Request& request, http::Response* pRespons
    // we do not yet know how big it truly is - this heuristic checks the total
    // content length (which includes form metadata) against the limit and subtracts
    // a tolerance of 10k, which should be more than enough to account for the
-   // metadata overhead. a final check will be done once the file is fully received
-   // and written to disk
+   // metadata overhead. the limit is then enforced exactly as file data is
+   // written to disk
    constexpr uintmax_t tolerance = 10 * 1024;
    if (request.contentLength() < tolerance)
       return true;
    return validateUploadedFile(request.contentLength() - tolerance, pResponse);
 }
 
-bool validateUploadedFile(const FilePath& file, http::Response* pResponse)
-{
-   return validateUploadedFile(file.getSize(), pResponse);
-}
-
 struct UploadState
 {
-   UploadState() :
+   explicit UploadState(uintmax_t byteLimit) :
       totalWritten(0),
-      fileStartPos(0),
-      fileEndPos(0)
+      byteLimit(byteLimit),
+      inFile(false)
    {
    }
 
+   boost::scoped_ptr<http::MultipartFormParser> pParser;
    uintmax_t totalWritten;
-   size_t fileStartPos;
-   size_t fileEndPos;
+   uintmax_t byteLimit;
+   bool inFile;
+   std::string currentField;
    std::string fileName;
    std::string targetDirectory;
    FilePath tmpFile;
+   std::shared_ptr<std::ostream> pTmpStream;
 };
 
 boost::mutex s_uploadMutex;
 std::map<const http::Request*, boost::shared_ptr<UploadState>> s_uploadStateMap;
 
-void parseContentBuffer(const std::string& buffer,
-                        const boost::shared_ptr<UploadState>& pUploadState)
+Error onUploadPartBegin(UploadState* pUploadState,
+                        const http::MultipartFormParser::Part& part)
 {
-   std::string nameRegex("form-data; name=\"(.*)\"");
-   boost::smatch nameMatch;
-   if (regex_utils::search(buffer, nameMatch, boost::regex(nameRegex)))
+   pUploadState->currentField = part.name;
+   pUploadState->inFile = !part.fileName.empty();
+   if (!pUploadState->inFile)
+      return Success();
+
+   // only a single file may be uploaded per request
+   if (!pUploadState->tmpFile.isEmpty())
+      return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+
+   pUploadState->fileName = part.fileName;
+
+   // create a temporary file to store the form's file data
+   // we store this temporary file under the user's home directory to increase the odds
+   // that we can perform a fast move on the tmp file when the user confirms, as most
+   // uploads are within the user's home directory
+   FilePath tmpDir = module_context::userUploadedFilesScratchPath();
+   Error error = tmpDir.ensureDirectory();
+   if (error)
+      return error;
+
+   error = FilePath::uniqueFilePath(tmpDir.getAbsolutePath(), ".bin", pUploadState->tmpFile);
+   if (error)
+      return error;
+
+   // keep the file open for the duration of the upload
+   return pUploadState->tmpFile.openForWrite(pUploadState->pTmpStream);
+}
+
+Error onUploadPartData(UploadState* pUploadState, const char* data, std::size_t size)
+{
+   if (pUploadState->inFile)
    {
-      std::string filenameRegex(nameRegex + "; filename=\"");
-      boost::smatch fileMatch;
-      if (regex_utils::search(buffer, fileMatch, boost::regex(filenameRegex)))
+      // enforce the size limit as data arrives rather than once it's all on disk
+      if (pUploadState->byteLimit > 0 &&
+          pUploadState->totalWritten + size > pUploadState->byteLimit)
       {
-         std::string searchStr = "filename=\"";
-         size_t pos = buffer.find(searchStr) + searchStr.size();
-         size_t endPos = buffer.find("\"", pos);
-         pUploadState->fileName = buffer.substr(pos, endPos - pos);
+         return systemError(boost::system::errc::file_too_large, ERROR_LOCATION);
       }
-      else
+
+      if (!pUploadState->pTmpStream->write(data, size))
       {
-         if (nameMatch[1] == "targetDirectory")
-         {
-            // skip over to and record the value
-            size_t pos = buffer.find("targetDirectory");
-            size_t endPos = buffer.find("\r\n\r\n", pos);
+         return systemError(boost::system::errc::io_error,
+                            "Could not write to destination file: " +
+                               pUploadState->tmpFile.getAbsolutePath(),
+                            ERROR_LOCATION);
+      }
 
-            size_t valueStartPos = endPos + 4;
-            size_t valueEndPos = buffer.find("\r\n", valueStartPos);
+      pUploadState->totalWritten += size;
+   }
+   else if (pUploadState->currentField == kUploadTargetDirectory)
+   {
+      // guard against unreasonably large field values
+      if (pUploadState->targetDirectory.size() + size > 64 * 1024)
+         return Error(json::errc::ParamInvalid, ERROR_LOCATION);
 
-            pUploadState->targetDirectory = buffer.substr(valueStartPos, valueEndPos - valueStartPos);
-         }
-      }
+      pUploadState->targetDirectory.append(data, size);
    }
+
+   return Success();
 }
 
-std::string getBoundary(const http::Request& request)
+Error onUploadPartEnd(UploadState* pUploadState)
 {
-   std::string boundaryPrefix("boundary=");
-   std::string boundary;
-   size_t prefixLoc = request.contentType().find(boundaryPrefix);
-   if (prefixLoc != std::string::npos)
+   if (pUploadState->inFile)
    {
-      boundary = request.contentType().substr(prefixLoc + boundaryPrefix.size(),
-                                              std::string::npos);
-      boundary = "--" + boundary;
-      boost::algorithm::trim(boundary);
+      pUploadState->inFile = false;
+      if (!pUploadState->pTmpStream->flush())
+      {
+         return systemError(boost::system::errc::io_error,
+                            "Could not write to destination file: " +
+                               pUploadState->tmpFile.getAbsolutePath(),
+                            ERROR_LOCATION);
+      }
+      pUploadState->pTmpStream.reset();
    }
 
-   return boundary;
+   return Success();
+}
+
+// close and remove any partially written file
+void discardUpload(const boost::shared_ptr<UploadState>& pUploadState)
+{
+   pUploadState->pTmpStream.reset();
+   if (!pUploadState->tmpFile.isEmpty())
+   {
+      Error error = pUploadState->tmpFile.removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+   }
 }
 
 // note: this function is invoked on the thread pool and is not handled in an R context
@@ -895,8 +1183,8 @@ bool handleFileUploadRequestAsync(const http::Request& request,
       {
          // no state exists for this request
 
-         // preliminary file size validation - a final check will be performed
-         // once the file is actually written to disk and we know for sure how big it is
+         // preliminary file size validation - the limit is enforced exactly
+         // as the file is written to disk
          http::Response response;
          if (!validateUploadedFile(request, &response))
          {
@@ -904,8 +1192,17 @@ bool handleFileUploadRequestAsync(const http::Request& request,
             return false;
          }
 
-         // create new upload state
-         pUploadState = boost::make_shared<UploadState>();
+         // create new upload state, parsing the form as it streams in and
+         // writing file data directly to a temp file
+         pUploadState = boost::make_shared<UploadState>(uploadByteLimit());
+
+         http::MultipartFormParser::Callbacks callbacks;
+         callbacks.onPartBegin = boost::bind(onUploadPartBegin, pUploadState.get(), _1);
+         callbacks.onPartData = boost::bind(onUploadPartData, pUploadState.get(), _1, _2);
+         callbacks.onPartEnd = boost::bind(onUploadPartEnd, pUploadState.get());
+         pUploadState->pParser.reset(
+                  new http::MultipartFormParser(request.contentType(), callbacks));
+
          s_uploadStateMap[pRequest] = pUploadState;
       }
       else
@@ -926,182 +1223,38 @@ bool handleFileUploadRequestAsync(const http::Request& request,
 
    auto writeError = [&](const Error& error)
    {
-      LOG_ERROR(error);
-      json::setJsonRpcError(error, &response);
-      cleanupState();
-      cont(&response);
-   };
+      // exceeding the upload limit is a user error, not worth logging
+      if (error.getCode() != boost::system::errc::file_too_large)
+         LOG_ERROR(error);
 
-   auto writeParamError = [&]()
-   {
-      json::setJsonRpcError(Error(json::errc::ParamInvalid, ERROR_LOCATION), &response);
+      discardUpload(pUploadState);
+      json::setJsonRpcError(error, &response);
       cleanupState();
       cont(&response);
    };
 
-   if (pUploadState->tmpFile.isEmpty())
-   {
-      // create a temporary file to store the form's file data
-      // we store this temporary file under the user's home directory to increase the odds
-      // that we can perform a fast move on the tmp file when the user confirms, as most
-      // uploads are within the user's home directory
-      FilePath tmpDir = module_context::userUploadedFilesScratchPath();
-      Error error = tmpDir.ensureDirectory();
-      if (error)
-      {
-         writeError(error);
-         return false;
-      }
-
-      error = FilePath::uniqueFilePath(tmpDir.getAbsolutePath(), ".bin", pUploadState->tmpFile);
-      if (error)
-      {
-         writeError(error);
-         return false;
-      }
-   }
-
-   if (pUploadState->totalWritten == 0)
+   // parse this chunk of the form
+   Error error = pUploadState->pParser->parse(formData.data(), formData.size());
+   if (error)
    {
-      // check the first set of headers within the first chunk
-      // because of the buffering done upstream, we are guaranteed
-      // to have all of the necessary data within this chunk
-
-      // skip to the end of the first form header
-      size_t pos = formData.find("\r\n\r\n");
-      if (pos == std::string::npos)
-      {
-         writeError(systemError(boost::system::errc::protocol_error,
-                                "Invalid form data received - first end of header not found",
-                                ERROR_LOCATION));
-         return false;
-      }
-
-      // determine which form field we just read, file data or target directory
-      parseContentBuffer(formData, pUploadState);
-
-      if (pUploadState->targetDirectory.empty())
-      {
-         // we just read to the start of the file
-         pUploadState->fileStartPos = pos + 4;
-      }
-      else
-      {
-         // we just read the target directory
-         // skip over to the next headers and parse the filename
-         size_t posEnd = formData.find("\r\n\r\n", pos + 4);
-         if (posEnd == std::string::npos)
-         {
-            writeError(systemError(boost::system::errc::protocol_error,
-                                   "Invalid form data received - second end of header not found",
-                                   ERROR_LOCATION));
-            return false;
-         }
-
-         std::string headers = formData.substr(pos, posEnd - pos);
-         parseContentBuffer(headers, pUploadState);
-
-         if (pUploadState->fileName.empty())
-         {
-            // didn't find the file name - return an error
-            writeParamError();
-            return false;
-         }
-
-         pUploadState->fileStartPos += posEnd + 4;
-      }
+      writeError(error);
+      return false;
    }
 
-   if (complete)
-   {
-      if (pUploadState->targetDirectory.empty())
-      {
-         // now we need to read the target directory metadata field by reading backwords from the buffer
-         std::string searchStr = "\r\n" + getBoundary(request) + "\r\n";
-         size_t pos = formData.rfind(searchStr);
-         if (pos == std::string::npos)
-         {
-            pUploadState->tmpFile.removeIfExists();
-            writeError(systemError(boost::system::errc::protocol_error,
-                                   "Invalid form data received - final end of header not found",
-                                   ERROR_LOCATION));
-            return false;
-         }
-
-         std::string headers = formData.substr(pos + searchStr.size());
-         pUploadState->fileEndPos = pos - 1;
-
-         // read the target directory field
-         parseContentBuffer(headers, pUploadState);
-
-         if (pUploadState->targetDirectory.empty())
-         {
-            // didn't find target directory - return an error
-            pUploadState->tmpFile.removeIfExists();
-            writeParamError();
-            return false;
-         }
-      }
-      else
-      {
-         // read to the end of the file portion by reading to the final boundary start
-         std::string searchStr = "\r\n" + getBoundary(request) + "--\r\n";
-         size_t pos = formData.rfind(searchStr);
-         if (pos == std::string::npos)
-         {
-            pUploadState->tmpFile.removeIfExists();
-            writeError(systemError(boost::system::errc::protocol_error,
-                                   "Invalid form data received - final end of form not found",
-                                   ERROR_LOCATION));
-            return false;
-         }
-
-         pUploadState->fileEndPos = pos - 1;
-      }
-
-      // write the last chunk of file data
-      Error saveError = writeTmpData(pUploadState->tmpFile,
-                                     formData.c_str(),
-                                     pUploadState->fileStartPos,
-                                     pUploadState->fileEndPos);
-      if (saveError)
-      {
-         pUploadState->tmpFile.removeIfExists();
-         writeError(saveError);
-         return false;
-      }
+   if (!complete)
+      return true;
 
-      pUploadState->totalWritten += pUploadState->fileEndPos - pUploadState->fileStartPos + 1;
-   }
-   else
+   error = pUploadState->pParser->finish();
+   if (error)
    {
-      // write a chunk of data
-      Error saveError = writeTmpData(pUploadState->tmpFile,
-                                     formData.c_str(),
-                                     pUploadState->fileStartPos,
-                                     formData.size() - 1);
-      if (saveError)
-      {
-         pUploadState->tmpFile.removeIfExists();
-         writeError(saveError);
-         return false;
-      }
-
-      pUploadState->totalWritten += formData.size() - pUploadState->fileStartPos;
-      pUploadState->fileStartPos = 0;
-      return true;
+      writeError(error);
+      return false;
    }
 
-   // the full file has been written - validate it
-   if (!validateUploadedFile(pUploadState->tmpFile, &response))
+   // ensure we received both the file and its target directory
+   if (pUploadState->fileName.empty() || pUploadState->targetDirectory.empty())
    {
-      // user cannot upload files this large - delete the temp file
-      Error error = pUploadState->tmpFile.removeIfExists();
-      if (error)
-         LOG_ERROR(error);
-
-      cleanupState();
-      cont(&response);
+      writeError(Error(json::errc::ParamInvalid, ERROR_LOCATION));
       return false;
    }
 
@@ -1112,9 +1265,11 @@ bool handleFileUploadRequestAsync(const http::Request& request,
 
    json::Array overwritesJson;
    bool unzipFound = false;
+   int zipEntries = 0;
    if (isZip)
    {
-      Error error = detectZipFileOverwrites(pUploadState->tmpFile, destDir, pUploadState->fileName, &overwritesJson, &unzipFound);
+      error = detectZipFileOverwrites(pUploadState->tmpFile, destDir, pUploadState->fileName,
+                                      &overwritesJson, &unzipFound, &zipEntries);
       if (error)
       {
          writeError(error);
@@ -1134,6 +1289,7 @@ bool handleFileUploadRequestAsync(const http::Request& request,
    uploadTokenJson[kUploadTargetDirectory] = destDir.getAbsolutePath();
    uploadTokenJson[kUnzipFound] = unzipFound;
    uploadTokenJson[kIsZip] = isZip;
+   uploadTokenJson[kZipEntries] = zipEntries;
 
    json::Object uploadJson;
    uploadJson["token"] = uploadTokenJson;
@@ -1145,7 +1301,7 @@ bool handleFileUploadRequestAsync(const http::Request& request,
    uploadResponse.setResult(uploadJson);
    std::stringstream uploadResult;
    uploadResponse.write(uploadResult);
-   Error error = response.setBody(string_utils::jsonHtmlEscape(uploadResult.str()));
+   error = response.setBody(string_utils::jsonHtmlEscape(uploadResult.str()));
    if (error)
    {
       writeError(error);
@@ -1166,10 +1322,9 @@ bool handleFileUploadRequestAsync(const http::Request& request,
    return true;
 }
    
-void setAttachmentResponse(const http::Request& request,
-                           const std::string& filename,
-                           const FilePath& attachmentPath,
-                           http::Response* pResponse)
+void setAttachmentHeaders(const http::Request& request,
+                          const std::string& filename,
+                          http::Response* pResponse)
 {
    if (request.headerValue("User-Agent").find("MSIE") == std::string::npos)
    {
@@ -1189,6 +1344,14 @@ void setAttachmentResponse(const http::Request& request,
    pResponse->setHeader("Content-Disposition",
                         "attachment; filename*=UTF-8''"
                            + http::util::urlEncode(filename, false));
+}
+
+void setAttachmentResponse(const http::Request& request,
+                           const std::string& filename,
+                           const FilePath& attachmentPath,
+                           http::Response* pResponse)
+{
+   setAttachmentHeaders(request, filename, pResponse);
    pResponse->setStreamFile(attachmentPath, request);
 }
    
@@ -1240,28 +1403,19 @@ void handleMultipleFileExportRequest(const http::Request& request,
       files.push_back(file);
    }
    
-   // create the zip file
-   FilePath tempZipFilePath = module_context::tempFile("export", "zip");
-   Error error = r::exec::RFunction(".rs.createZipFile",
-                                    tempZipFilePath.getAbsolutePath(),
-                                    parentPath.getAbsolutePath(),
-                                    files).call();
-   if (error)
-   {
-      LOG_ERROR(error);
-      pResponse->setError(error);
-      return;
-   }
-
    for (std::string f: files)
    {
       // let the monitor client know the user has downloaded this file
       using namespace monitor;
       client().logEvent(Event(kSessionScope, kSessionDownloadEvent, f));
    }
-   
-   // return attachment
-   setAttachmentResponse(request, name, tempZipFilePath, pResponse);
+
+   // return the zip as an attachment. the archive is built as the response
+   // is written (on the connection's thread) so no temporary file is
+   // created and the main thread isn't blocked while compressing
+   setAttachmentHeaders(request, name, pResponse);
+   pResponse->setContentType("application/zip");
+   pResponse->setStreamResponse(boost::make_shared<http::ZipStreamResponse>(parentPath, files));
 }
    
 void handleFileExportRequest(const http::Request& request, 
@@ -1396,6 +1550,8 @@ Error initialize()
    
    // subscribe to events
    events().onClientInit.connect(bind(onClientInit));
+   events().onFilesChanged.connect(bind(&FilesListingCache::onFilesChanged,
+                                        &s_filesListingCache, _1));
 
    RS_REGISTER_CALL_METHOD(rs_readLines, 1);
    RS_REGISTER_CALL_METHOD(rs_pathInfo, 1);
@@ -1410,6 +1566,7 @@ Error initialize()
       (bind(registerRpcMethod, "is_package_directory", isPackageDirectory))
       (bind(registerRpcMethod, "get_file_contents", getFileContents))
       (bind(registerRpcMethod, "list_files", listFiles))
+      (bind(registerRpcMethod, "list_files_page", listFilesPage))
       (bind(registerRpcMethod, "create_folder", createFolder))
       (bind(registerRpcMethod, "delete_files", deleteFiles))
       (bind(registerRpcMethod, "copy_file", copyFile))
@@ -0,0 +1,471 @@
+/*
+ * SessionFilesListingCache.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFilesListingCache.hpp"
+
+#include <algorithm>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
+#include <shared_core/Error.hpp>
+#include <core/Log.hpp>
+
+#include <core/system/FileChangeEvent.hpp>
+
+#include <session/SessionModuleContext.hpp>
+
+#include <session/prefs/UserPrefs.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace files {
+
+namespace {
+
+// number of listings we always keep, and the total number of entries
+// beyond which we start evicting the least recently used listings
+const std::size_t kMinCachedListings = 1;
+const std::size_t kMaxCachedListings = 4;
+const std::size_t kMaxCachedEntries = 250000;
+
+bool pathLessThan(const FileInfo& lhs, const std::string& rhs)
+{
+   return lhs.absolutePath() < rhs;
+}
+
+std::string fileName(const std::string& absolutePath)
+{
+   std::string::size_type pos = absolutePath.find_last_of('/');
+   if (pos == std::string::npos)
+      return absolutePath;
+   return absolutePath.substr(pos + 1);
+}
+
+std::string fileExtension(const std::string& name)
+{
+   std::string::size_type pos = name.find_last_of('.');
+   if (pos == std::string::npos || pos == 0)
+      return std::string();
+   return name.substr(pos);
+}
+
+// orderings mirror those used by the Files pane: names are compared without
+// regard to case, the type column puts folders after files, and the size and
+// modified columns keep folders at the bottom in either direction (ties are
+// broken by path, so that each entry has a unique position)
+template <typename SortEntry>
+class SortEntryLessThan
+{
+public:
+   SortEntryLessThan(FilesListingSortKey sortKey, bool ascending)
+      : sortKey_(sortKey), ascending_(ascending)
+   {
+   }
+
+   bool operator()(const SortEntry& lhs, const SortEntry& rhs) const
+   {
+      if ((sortKey_ == SortBySize || sortKey_ == SortByModified) &&
+          lhs.isDirectory != rhs.isDirectory)
+      {
+         return !lhs.isDirectory;
+      }
+
+      int result = compare(lhs, rhs);
+      if (result == 0)
+         result = lhs.name.compare(rhs.name);
+      if (result == 0)
+         result = lhs.path.compare(rhs.path);
+
+      return ascending_ ? result < 0 : result > 0;
+   }
+
+private:
+   int compare(const SortEntry& lhs, const SortEntry& rhs) const
+   {
+      switch (sortKey_)
+      {
+         case SortByType:
+            if (lhs.isDirectory != rhs.isDirectory)
+               return lhs.isDirectory ? 1 : -1;
+            return lhs.extension.compare(rhs.extension);
+         case SortBySize:
+            return lhs.size == rhs.size ? 0 : (lhs.size < rhs.size ? -1 : 1);
+         case SortByModified:
+            return lhs.lastWriteTime == rhs.lastWriteTime ? 0 :
+                     (lhs.lastWriteTime < rhs.lastWriteTime ? -1 : 1);
+         case SortByName:
+         default:
+            return 0;
+      }
+   }
+
+   FilesListingSortKey sortKey_;
+   bool ascending_;
+};
+
+} // anonymous namespace
+
+bool filesListingSortKeyFromString(const std::string& name,
+                                   FilesListingSortKey* pSortKey)
+{
+   if (name == "name")
+      *pSortKey = SortByName;
+   else if (name == "type")
+      *pSortKey = SortByType;
+   else if (name == "size")
+      *pSortKey = SortBySize;
+   else if (name == "modified")
+      *pSortKey = SortByModified;
+   else
+      return false;
+
+   return true;
+}
+
+FilesListingCache::FilesListingCache()
+{
+}
+
+Error FilesListingCache::listFiles(const FilePath& rootPath,
+                                   bool includeHidden,
+                                   bool monitored,
+                                   FilesListingSortKey sortKey,
+                                   bool ascending,
+                                   const std::string& after,
+                                   std::size_t offset,
+                                   std::size_t count,
+                                   std::vector<FileInfo>* pFiles,
+                                   std::size_t* pStart,
+                                   std::size_t* pTotalCount)
+{
+   Listing* pListing = findListing(rootPath.getAbsolutePath(), includeHidden);
+
+   bool rescan = (pListing == nullptr);
+   if (pListing != nullptr)
+   {
+      // the object file filter is applied when scanning
+      if (pListing->hideObjectFiles != prefs::userPrefs().hideObjectFiles())
+         rescan = true;
+
+      // listings of monitored directories are kept current by file change
+      // events; for others, check whether the directory has been modified
+      // since (or during the same second as) the scan
+      if (!monitored)
+      {
+         std::time_t lastWriteTime = rootPath.getLastWriteTime();
+         if (lastWriteTime != pListing->lastWriteTime ||
+             lastWriteTime >= pListing->scanTime)
+         {
+            rescan = true;
+         }
+      }
+   }
+
+   if (pListing == nullptr)
+   {
+      listings_.push_front(Listing());
+      pListing = &listings_.front();
+      pListing->rootPath = rootPath;
+      pListing->includeHidden = includeHidden;
+   }
+
+   if (rescan)
+   {
+      Error error = scanListing(pListing);
+      if (error)
+      {
+         listings_.pop_front();
+         return error;
+      }
+
+      evict();
+   }
+
+   ensureSorted(pListing, sortKey, ascending);
+
+   // paging from the previous window's last file (rather than from an
+   // offset) means files added or removed ahead of it don't shift the window
+   if (!after.empty())
+   {
+      std::vector<FileInfo>::const_iterator it = std::lower_bound(pListing->files.begin(),
+                                                                  pListing->files.end(),
+                                                                  after,
+                                                                  pathLessThan);
+      if (it != pListing->files.end() && it->absolutePath() == after)
+      {
+         const std::vector<SortEntry>& entries = pListing->sortedEntries;
+         offset = std::upper_bound(entries.begin(),
+                                   entries.end(),
+                                   sortEntry(*it, sortKey),
+                                   SortEntryLessThan<SortEntry>(sortKey, ascending)) -
+                  entries.begin();
+      }
+   }
+
+   // copy out the requested window
+   pFiles->clear();
+   *pStart = offset;
+   *pTotalCount = pListing->sortedEntries.size();
+   if (offset < pListing->sortedEntries.size())
+   {
+      std::size_t end = std::min(offset + count, pListing->sortedEntries.size());
+      pFiles->reserve(end - offset);
+      for (std::size_t i = offset; i < end; i++)
+      {
+         const std::string& path = pListing->sortedEntries[i].path;
+         pFiles->push_back(*std::lower_bound(pListing->files.begin(),
+                                             pListing->files.end(),
+                                             path,
+                                             pathLessThan));
+      }
+   }
+
+   return Success();
+}
+
+void FilesListingCache::snapshot(const FilePath& rootPath,
+                                 bool includeHidden,
+                                 std::vector<FileInfo>* pFiles)
+{
+   pFiles->clear();
+   Listing* pListing = findListing(rootPath.getAbsolutePath(), includeHidden);
+   if (pListing != nullptr)
+      *pFiles = pListing->files;
+}
+
+void FilesListingCache::onFilesChanged(
+                     const std::vector<core::system::FileChangeEvent>& events)
+{
+   if (listings_.empty())
+      return;
+
+   for (const core::system::FileChangeEvent& event : events)
+   {
+      std::string parentPath =
+            FilePath(event.fileInfo().absolutePath()).getParent().getAbsolutePath();
+
+      for (Listing& listing : listings_)
+      {
+         if (listing.rootPath.getAbsolutePath() == parentPath)
+            applyEvent(&listing, event);
+      }
+   }
+}
+
+void FilesListingCache::clear()
+{
+   listings_.clear();
+}
+
+FilesListingCache::Listing* FilesListingCache::findListing(
+                                             const std::string& rootPath,
+                                             bool includeHidden)
+{
+   for (std::list<Listing>::iterator it = listings_.begin();
+        it != listings_.end();
+        ++it)
+   {
+      if (it->includeHidden == includeHidden &&
+          it->rootPath.getAbsolutePath() == rootPath)
+      {
+         // move to the front (most recently used)
+         if (it != listings_.begin())
+            listings_.splice(listings_.begin(), listings_, it);
+         return &listings_.front();
+      }
+   }
+
+   return nullptr;
+}
+
+Error FilesListingCache::scanListing(Listing* pListing)
+{
+   pListing->hideObjectFiles = prefs::userPrefs().hideObjectFiles();
+   pListing->lastWriteTime = pListing->rootPath.getLastWriteTime();
+   pListing->scanTime = std::time(nullptr);
+   pListing->sorted = false;
+   pListing->sortedEntries.clear();
+   pListing->files.clear();
+
+   std::vector<FilePath> children;
+   Error error = pListing->rootPath.getChildren(children);
+   if (error)
+      return error;
+
+   pListing->files.reserve(children.size());
+   for (const FilePath& child : children)
+   {
+      // skip files which were deleted after the listing
+      if (!child.exists())
+         continue;
+
+      FileInfo fileInfo(child);
+      if (includeFile(*pListing, fileInfo))
+         pListing->files.push_back(fileInfo);
+   }
+
+   std::sort(pListing->files.begin(),
+             pListing->files.end(),
+             [](const FileInfo& lhs, const FileInfo& rhs)
+   {
+      return lhs.absolutePath() < rhs.absolutePath();
+   });
+
+   return Success();
+}
+
+void FilesListingCache::ensureSorted(Listing* pListing,
+                                     FilesListingSortKey sortKey,
+                                     bool ascending)
+{
+   if (pListing->sorted &&
+       pListing->sortKey == sortKey &&
+       pListing->ascending == ascending)
+   {
+      return;
+   }
+
+   pListing->sorted = true;
+   pListing->sortKey = sortKey;
+   pListing->ascending = ascending;
+
+   std::vector<SortEntry>& entries = pListing->sortedEntries;
+   entries.clear();
+   entries.reserve(pListing->files.size());
+   for (const FileInfo& fileInfo : pListing->files)
+      entries.push_back(sortEntry(fileInfo, sortKey));
+
+   std::sort(entries.begin(),
+             entries.end(),
+             SortEntryLessThan<SortEntry>(sortKey, ascending));
+}
+
+FilesListingCache::SortEntry FilesListingCache::sortEntry(const FileInfo& fileInfo,
+                                                          FilesListingSortKey sortKey)
+{
+   SortEntry entry;
+   entry.path = fileInfo.absolutePath();
+   entry.isDirectory = fileInfo.isDirectory();
+   entry.name = boost::algorithm::to_lower_copy(fileName(entry.path));
+   if (sortKey == SortByType)
+      entry.extension = fileExtension(entry.name);
+   entry.size = fileInfo.size();
+   entry.lastWriteTime = fileInfo.lastWriteTime();
+   return entry;
+}
+
+void FilesListingCache::insertSorted(Listing* pListing, const FileInfo& fileInfo)
+{
+   if (!pListing->sorted)
+      return;
+
+   SortEntry entry = sortEntry(fileInfo, pListing->sortKey);
+   std::vector<SortEntry>& entries = pListing->sortedEntries;
+   entries.insert(std::upper_bound(entries.begin(),
+                                   entries.end(),
+                                   entry,
+                                   SortEntryLessThan<SortEntry>(pListing->sortKey,
+                                                                pListing->ascending)),
+                  entry);
+}
+
+void FilesListingCache::eraseSorted(Listing* pListing, const FileInfo& fileInfo)
+{
+   if (!pListing->sorted)
+      return;
+
+   // (fileInfo holds the attributes the entry was sorted by)
+   SortEntry entry = sortEntry(fileInfo, pListing->sortKey);
+   std::vector<SortEntry>& entries = pListing->sortedEntries;
+   std::vector<SortEntry>::iterator it =
+         std::lower_bound(entries.begin(),
+                          entries.end(),
+                          entry,
+                          SortEntryLessThan<SortEntry>(pListing->sortKey,
+                                                       pListing->ascending));
+   if (it != entries.end() && it->path == entry.path)
+      entries.erase(it);
+}
+
+void FilesListingCache::applyEvent(Listing* pListing,
+                                   const core::system::FileChangeEvent& event)
+{
+   std::string path = event.fileInfo().absolutePath();
+   std::vector<FileInfo>::iterator it = std::lower_bound(pListing->files.begin(),
+                                                         pListing->files.end(),
+                                                         path,
+                                                         pathLessThan);
+   bool found = it != pListing->files.end() && it->absolutePath() == path;
+
+   // the file's entry (if any) is removed from the sorted order, and the
+   // updated entry (if any) inserted in its new place
+   if (found)
+      eraseSorted(pListing, *it);
+
+   if (event.type() == core::system::FileChangeEvent::FileRemoved)
+   {
+      if (found)
+         pListing->files.erase(it);
+   }
+   else
+   {
+      // re-read the file's attributes rather than using those reported by
+      // the monitor, which doesn't traverse symlinks (our listings do)
+      FilePath filePath(path);
+      FileInfo fileInfo(filePath);
+      if (!filePath.exists() || !includeFile(*pListing, fileInfo))
+      {
+         if (found)
+            pListing->files.erase(it);
+      }
+      else
+      {
+         if (found)
+            *it = fileInfo;
+         else
+            pListing->files.insert(it, fileInfo);
+         insertSorted(pListing, fileInfo);
+      }
+   }
+}
+
+bool FilesListingCache::includeFile(const Listing& listing,
+                                    const FileInfo& fileInfo) const
+{
+   return listing.includeHidden ||
+          module_context::fileListingFilter(fileInfo, listing.hideObjectFiles);
+}
+
+void FilesListingCache::evict()
+{
+   std::size_t totalEntries = 0;
+   for (const Listing& listing : listings_)
+      totalEntries += listing.files.size();
+
+   while (listings_.size() > kMinCachedListings &&
+          (listings_.size() > kMaxCachedListings || totalEntries > kMaxCachedEntries))
+   {
+      totalEntries -= listings_.back().files.size();
+      listings_.pop_back();
+   }
+}
+
+} // namespace files
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,147 @@
+/*
+ * SessionFilesListingCache.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SESSION_FILES_LISTING_CACHE_HPP
+#define SESSION_SESSION_FILES_LISTING_CACHE_HPP
+
+#include <ctime>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <core/FileInfo.hpp>
+#include <shared_core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+   namespace system {
+      class FileChangeEvent;
+   }
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace files {
+
+enum FilesListingSortKey
+{
+   SortByName,
+   SortByType,
+   SortBySize,
+   SortByModified
+};
+
+// returns false if the name doesn't correspond to a sort key
+bool filesListingSortKeyFromString(const std::string& name,
+                                   FilesListingSortKey* pSortKey);
+
+// Caches the listings of recently viewed directories so that very large
+// directories can be paged through without re-reading (and re-sending) the
+// entire listing on every request. Listings of monitored directories are
+// kept current by applying file change events; unmonitored listings are
+// validated against the directory's modification time.
+class FilesListingCache : boost::noncopyable
+{
+public:
+   FilesListingCache();
+
+   // read a window of the (filtered and sorted) listing of a directory,
+   // scanning the directory only if it isn't cached or may be stale. the
+   // window starts just after the file with the path given as after (the
+   // last file of the previous window) or, if there's no such file (e.g.
+   // it has since been removed), at offset; pStart receives where it
+   // started
+   core::Error listFiles(const core::FilePath& rootPath,
+                         bool includeHidden,
+                         bool monitored,
+                         FilesListingSortKey sortKey,
+                         bool ascending,
+                         const std::string& after,
+                         std::size_t offset,
+                         std::size_t count,
+                         std::vector<core::FileInfo>* pFiles,
+                         std::size_t* pStart,
+                         std::size_t* pTotalCount);
+
+   // full (unsorted) snapshot of a cached listing, used to seed monitoring
+   void snapshot(const core::FilePath& rootPath,
+                 bool includeHidden,
+                 std::vector<core::FileInfo>* pFiles);
+
+   // apply file monitor events to any cached listings they affect
+   void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events);
+
+   void clear();
+
+private:
+   struct Listing;
+   struct SortEntry;
+
+   Listing* findListing(const std::string& rootPath, bool includeHidden);
+   core::Error scanListing(Listing* pListing);
+   void ensureSorted(Listing* pListing, FilesListingSortKey sortKey, bool ascending);
+   static SortEntry sortEntry(const core::FileInfo& fileInfo, FilesListingSortKey sortKey);
+   void insertSorted(Listing* pListing, const core::FileInfo& fileInfo);
+   void eraseSorted(Listing* pListing, const core::FileInfo& fileInfo);
+   void applyEvent(Listing* pListing, const core::system::FileChangeEvent& event);
+   bool includeFile(const Listing& listing, const core::FileInfo& fileInfo) const;
+   void evict();
+
+private:
+   // sort attributes are extracted once per entry rather than per comparison
+   struct SortEntry
+   {
+      std::string path;
+      bool isDirectory;
+      std::string name;
+      std::string extension;
+      uintmax_t size;
+      std::time_t lastWriteTime;
+   };
+
+   struct Listing
+   {
+      core::FilePath rootPath;
+      bool includeHidden;
+      bool hideObjectFiles;
+      std::time_t lastWriteTime;
+      std::time_t scanTime;
+
+      // entries ordered by absolute path (for event lookups)
+      std::vector<core::FileInfo> files;
+
+      // entries in the most recently requested sort order (kept current as
+      // file change events are applied)
+      bool sorted;
+      FilesListingSortKey sortKey;
+      bool ascending;
+      std::vector<SortEntry> sortedEntries;
+   };
+
+   // most recently used listings first
+   std::list<Listing> listings_;
+};
+
+} // namespace files
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SESSION_FILES_LISTING_CACHE_HPP
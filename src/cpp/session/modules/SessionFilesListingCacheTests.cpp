@@ -0,0 +1,191 @@
+/*
+ * SessionFilesListingCacheTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFilesListingCache.hpp"
+
+#include <shared_core/Error.hpp>
+
+#include <core/FileSerializer.hpp>
+#include <core/system/FileChangeEvent.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace files {
+namespace tests {
+
+using namespace rstudio::core;
+using namespace rstudio::core::system;
+
+namespace {
+
+// names of the files listed in a window
+std::vector<std::string> listedNames(const std::vector<FileInfo>& files)
+{
+   std::vector<std::string> names;
+   for (const FileInfo& fileInfo : files)
+      names.push_back(FilePath(fileInfo.absolutePath()).getFilename());
+   return names;
+}
+
+std::vector<std::string> names(std::initializer_list<std::string> names)
+{
+   return std::vector<std::string>(names);
+}
+
+FileChangeEvent writeFile(const FilePath& dir, const std::string& name, const std::string& contents)
+{
+   FilePath filePath = dir.completeChildPath(name);
+   REQUIRE_FALSE(writeStringToFile(filePath, contents));
+   return FileChangeEvent(FileChangeEvent::FileAdded, FileInfo(filePath));
+}
+
+FileChangeEvent removeFile(const FilePath& dir, const std::string& name)
+{
+   FilePath filePath = dir.completeChildPath(name);
+   FileInfo fileInfo(filePath);
+   REQUIRE_FALSE(filePath.remove());
+   return FileChangeEvent(FileChangeEvent::FileRemoved, fileInfo);
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionFilesListingCache")
+{
+   FilePath testDir;
+   REQUIRE_FALSE(FilePath::tempFilePath(testDir));
+   REQUIRE_FALSE(testDir.ensureDirectory());
+
+   // names and sizes sort in different orders
+   writeFile(testDir, "b.R", "1");
+   writeFile(testDir, "c.R", "12345");
+   writeFile(testDir, "d.R", "12");
+   writeFile(testDir, "e.R", "1234");
+   writeFile(testDir, "f.R", "123");
+
+   FilesListingCache cache;
+   std::vector<FileInfo> files;
+   std::size_t start = 0, totalCount = 0;
+
+   SECTION("Windows of the sorted listing are returned")
+   {
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, std::string(),
+                                    0, 2, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "b.R", "c.R" }));
+      CHECK(start == 0);
+      CHECK(totalCount == 5);
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, std::string(),
+                                    4, 2, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "f.R" }));
+      CHECK(start == 4);
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, std::string(),
+                                    6, 2, &files, &start, &totalCount));
+      CHECK(files.empty());
+      CHECK(totalCount == 5);
+   }
+
+   SECTION("The listing is sorted by the requested key and direction")
+   {
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortBySize, true, std::string(),
+                                    0, 5, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "b.R", "d.R", "f.R", "e.R", "c.R" }));
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortBySize, false, std::string(),
+                                    0, 5, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "c.R", "e.R", "f.R", "d.R", "b.R" }));
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, false, std::string(),
+                                    0, 5, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "f.R", "e.R", "d.R", "c.R", "b.R" }));
+   }
+
+   SECTION("File change events keep monitored listings in order")
+   {
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortBySize, true, std::string(),
+                                    0, 5, &files, &start, &totalCount));
+
+      std::vector<FileChangeEvent> events;
+      events.push_back(writeFile(testDir, "a.R", "123456"));
+      events.push_back(removeFile(testDir, "d.R"));
+      FileChangeEvent modified = writeFile(testDir, "b.R", "1234567");
+      events.push_back(FileChangeEvent(FileChangeEvent::FileModified, modified.fileInfo()));
+      cache.onFilesChanged(events);
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortBySize, true, std::string(),
+                                    0, 10, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "f.R", "e.R", "c.R", "a.R", "b.R" }));
+      CHECK(totalCount == 5);
+   }
+
+   SECTION("Pages continue from the last listed file")
+   {
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, std::string(),
+                                    0, 2, &files, &start, &totalCount));
+      REQUIRE(listedNames(files) == names({ "b.R", "c.R" }));
+      std::string after = files.back().absolutePath();
+
+      // a file added ahead of the page doesn't shift the next one
+      std::vector<FileChangeEvent> events;
+      events.push_back(writeFile(testDir, "a.R", "1"));
+      cache.onFilesChanged(events);
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, after,
+                                    2, 2, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "d.R", "e.R" }));
+      CHECK(start == 3);
+      CHECK(totalCount == 6);
+      after = files.back().absolutePath();
+
+      // nor does one removed ahead of it
+      events.clear();
+      events.push_back(removeFile(testDir, "b.R"));
+      cache.onFilesChanged(events);
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, after,
+                                    5, 2, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "f.R" }));
+      CHECK(start == 4);
+      CHECK(totalCount == 5);
+   }
+
+   SECTION("Pages start at the offset when the last listed file is gone")
+   {
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, std::string(),
+                                    0, 2, &files, &start, &totalCount));
+      std::string after = files.back().absolutePath();
+
+      std::vector<FileChangeEvent> events;
+      events.push_back(removeFile(testDir, "c.R"));
+      cache.onFilesChanged(events);
+
+      REQUIRE_FALSE(cache.listFiles(testDir, true, true, SortByName, true, after,
+                                    1, 2, &files, &start, &totalCount));
+      CHECK(listedNames(files) == names({ "d.R", "e.R" }));
+      CHECK(start == 1);
+   }
+
+   REQUIRE_FALSE(testDir.removeIfExists());
+}
+
+} // namespace tests
+} // namespace files
+} // namespace modules
+} // namespace session
+} // namespace rstudio
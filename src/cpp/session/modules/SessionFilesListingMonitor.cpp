@@ -55,9 +55,6 @@ Error FilesListingMonitor::start(const FilePath& filePath, bool includeHidden,
    // always stop existing
    stop();
 
-   // save include hidden setting
-   includeHidden_ = includeHidden;
-
    // scan the directory (populates pJsonFiles out parameter)
    std::vector<FilePath> files;
    Error error = listFiles(filePath, &files, includeHidden, pJsonFiles);
@@ -72,6 +69,20 @@ Error FilesListingMonitor::start(const FilePath& filePath, bool includeHidden,
                   std::back_inserter(prevFiles),
                   core::toFileInfo);
 
+   start(filePath, includeHidden, prevFiles);
+   return Success();
+}
+
+void FilesListingMonitor::start(const FilePath& filePath,
+                                bool includeHidden,
+                                const std::vector<FileInfo>& prevFiles)
+{
+   // always stop existing
+   stop();
+
+   // save include hidden setting
+   includeHidden_ = includeHidden;
+
    // kickoff new monitor
    core::system::file_monitor::Callbacks cb;
    cb.onRegistered = boost::bind(&FilesListingMonitor::onRegistered,
@@ -91,8 +102,6 @@ Error FilesListingMonitor::start(const FilePath& filePath, bool includeHidden,
                   prefs::userPrefs().hideObjectFiles()), 
             cb);
    }
-
-   return Success();
 }
 
 void FilesListingMonitor::stop()
@@ -54,11 +54,19 @@ public:
    core::Error start(const core::FilePath& filePath, 
          bool includeHidden, core::json::Array* pJsonFiles);
 
+   // kickoff monitoring using a listing the caller has already taken
+   void start(const core::FilePath& filePath,
+              bool includeHidden,
+              const std::vector<core::FileInfo>& prevFiles);
+
    void stop();
 
    // what path are we currently monitoring?
    const core::FilePath& currentMonitoredPath() const;
 
+   // are hidden files included in the current monitoring?
+   bool includeHidden() const { return includeHidden_; }
+
    // convenience method which is also called by listFiles for requests that
    // don't specify monitoring (e.g. file dialog listing)
    static core::Error listFiles(const core::FilePath& rootPath,
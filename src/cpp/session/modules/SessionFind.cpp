@@ -16,6 +16,10 @@
 #include "SessionFind.hpp"
 
 #include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+#include <unordered_set>
 #include <gsl/gsl>
 
 #include <boost/enable_shared_from_this.hpp>
@@ -36,6 +40,9 @@
 
 #include <session/prefs/UserPrefs.hpp>
 
+#include "SessionFindEngine.hpp"
+#include "SessionFindIndex.hpp"
+
 using namespace rstudio::core;
 using namespace boost::placeholders;
 
@@ -46,13 +53,6 @@ namespace find {
 
 namespace errc {
 
-enum errc_t
-{
-   Success = 0,
-   RegexError = 1,
-   PermissionsError = 2
-};
-
 const std::string& findCategory()
 {
    static const std::string findCategory = "find_error";
@@ -385,6 +385,20 @@ FindInFilesState& findResults()
    return *s_pFindResults;
 }
 
+bool shouldSkipFile(const std::string& file)
+{
+   return (file.find("/.Rproj.user/") != std::string::npos ||
+           file.find("/.quarto/") != std::string::npos ||
+           file.find("/.git/") != std::string::npos ||
+           file.find("/.svn/") != std::string::npos ||
+           file.find("/packrat/lib/") != std::string::npos ||
+           file.find("/packrat/src/") != std::string::npos ||
+           file.find("/renv/library/") != std::string::npos ||
+           file.find("/renv/python/") != std::string::npos ||
+           file.find("/renv/staging/") != std::string::npos ||
+           file.find("/.Rhistory") != std::string::npos);
+}
+
 class GrepOperation : public boost::enable_shared_from_this<GrepOperation>
 {
 public:
@@ -409,6 +423,20 @@ public:
       return handle_;
    }
 
+   // search in-process rather than with grep, collecting matches from the
+   // engine's threads periodically on the main thread
+   void startSearch(boost::shared_ptr<FindEngine> pEngine,
+                    const std::vector<FilePath>& directories)
+   {
+      pEngine_ = pEngine;
+      pEngine_->start(directories);
+      module_context::schedulePeriodicWork(
+               boost::posix_time::milliseconds(50),
+               boost::bind(&GrepOperation::collectMatches, shared_from_this()),
+               false /* collect matches even when non-idle */,
+               false /* wait for the first matches */);
+   }
+
    core::system::ProcessCallbacks createProcessCallbacks()
    {
       core::system::ProcessCallbacks callbacks;
@@ -428,6 +456,15 @@ public:
    }
 
 private:
+   // a matching line, with the byte offsets of its matches
+   struct GrepMatch
+   {
+      std::string file;
+      int lineNum;
+      std::string contents;
+      std::vector<std::pair<std::size_t, std::size_t> > matches;
+   };
+
    struct LineInfo
    {
       std::string leadingWhitespace;
@@ -437,11 +474,16 @@ private:
       std::string encodedContents;
    };
 
-   bool onContinue(const core::system::ProcessOperations& /*ops*/) const
+   bool isActive() const
    {
       return findResults().isRunning() && findResults().handle() == handle();
    }
 
+   bool onContinue(const core::system::ProcessOperations& /*ops*/) const
+   {
+      return isActive();
+   }
+
    void addReplaceErrorMessage(const std::string& contents,
                                std::set<std::string>* pErrorSet,
                                json::Array* pReplaceMatchOn,
@@ -598,7 +640,11 @@ private:
       return Success();
    }
 
-   void processContents(std::string* pContent,
+   // decode a line, converting the byte offsets of its matches to the
+   // (UTF-8) character offsets of the decoded line
+   void processContents(const std::string& encodedLine,
+                        const std::vector<std::pair<std::size_t, std::size_t> >& matches,
+                        std::string* pContent,
                         std::string* pFullLineContent,
                         json::Array* pMatchOn,
                         json::Array* pMatchOff)
@@ -606,20 +652,16 @@ private:
       // initialize some state
       std::string decodedLine;
       std::size_t nUtf8CharactersProcessed = 0;
+      std::size_t pos = 0;
 
-      const char* inputPos = pContent->c_str();
-      const char* end = inputPos + pContent->size();
-      boost::cmatch match;
-      while (regex_utils::search(
-               inputPos, match, getColorEncodingRegex(findResults().gitFlag())))
+      // decode the text up to the given offset, and append it
+      auto appendDecoded = [&](std::size_t end)
       {
-         // decode the current match, and append it
-         std::string matchedString(inputPos, inputPos + match.position());
-         std::string decoded = Replacer::decode(matchedString, encoding_, firstDecodeError_);
-
-         // append and update
+         std::string decoded = Replacer::decode(encodedLine.substr(pos, end - pos),
+                                                encoding_,
+                                                firstDecodeError_);
          decodedLine.append(decoded);
-         inputPos += match.position() + match.length();
+         pos = end;
 
          // count the number of UTF-8 characters processed
          std::size_t charSize;
@@ -629,18 +671,16 @@ private:
          if (error)
             charSize = decoded.size();
          nUtf8CharactersProcessed += charSize;
+      };
 
-         // update the match state
-         if ((match.size() > 2 && match[2] == "1" && findResults().gitFlag()) ||
-             (match[1] == "01" && !findResults().gitFlag()))
-            pMatchOn->push_back(gsl::narrow_cast<int>(nUtf8CharactersProcessed));
-         else
-            pMatchOff->push_back(gsl::narrow_cast<int>(nUtf8CharactersProcessed));
+      for (const auto& match : matches)
+      {
+         appendDecoded(match.first);
+         pMatchOn->push_back(gsl::narrow_cast<int>(nUtf8CharactersProcessed));
+         appendDecoded(match.second);
+         pMatchOff->push_back(gsl::narrow_cast<int>(nUtf8CharactersProcessed));
       }
-
-      if (inputPos != end)
-         decodedLine.append(
-            Replacer::decode(std::string(inputPos, end), encoding_, firstDecodeError_));
+      appendDecoded(encodedLine.size());
 
       *pFullLineContent = decodedLine;
       if (!findResults().replace())
@@ -724,43 +764,42 @@ private:
       return error;
    }
 
-   void cleanLineAndGetMatches(std::string* pEncodedLine,
-                               json::Array* pMatchOn, json::Array* pMatchOff)
+   void cleanLineAndGetMatches(const std::string& line,
+                               std::string* pCleanLine,
+                               std::vector<std::pair<std::size_t, std::size_t> >* pMatches)
    {
-      // The incoming string is assumed to have color encodings from the initial grep command.
-      // These encodings are parsed out and their positions are placed in pMatchOn and pMatchOff.
+      // The incoming string is assumed to have color encodings from the grep command.
+      // These encodings are parsed out and the byte offsets they delimit are placed in pMatches.
 
-      const char* inputPos = pEncodedLine->c_str();
-      const char* end = inputPos + pEncodedLine->size();
-      std::size_t charactersProcessed = 0;
+      const char* inputPos = line.c_str();
+      const char* end = inputPos + line.size();
       boost::cmatch match;
-      std::string cleanLine;
 
       while (regex_utils::search(inputPos, match, getColorEncodingRegex(findResults().gitFlag())))
       {
-         std::string matchedString(inputPos, inputPos + match.position());
+         pCleanLine->append(inputPos, inputPos + match.position());
          inputPos += match.position() + match.length();
-         
-         cleanLine.append(matchedString);
 
-         charactersProcessed += matchedString.size();
-   
          // Match now contains the regex results by capturing group. Depending on which color
          // encoding regex is used in the search, the first match will always contain '1' or '01'.
          if ((match.size() > 2 && match[2] == "1" && findResults().gitFlag()) ||
              (match[1] == "01" && !findResults().gitFlag()))
-            pMatchOn->push_back(json::Value(gsl::narrow_cast<int>(charactersProcessed)));
-         else
-            pMatchOff->push_back(json::Value(gsl::narrow_cast<int>(charactersProcessed)));
+            pMatches->push_back(std::make_pair(pCleanLine->size(), std::string::npos));
+         else if (!pMatches->empty() && pMatches->back().second == std::string::npos)
+            pMatches->back().second = pCleanLine->size();
       }
       if (inputPos != end)
-         cleanLine.append(std::string(inputPos, end));
-      *pEncodedLine = cleanLine;
+         pCleanLine->append(inputPos, end);
+
+      // (a match left open runs to the end of the line)
+      if (!pMatches->empty() && pMatches->back().second == std::string::npos)
+         pMatches->back().second = pCleanLine->size();
    }
 
    Error processReplace(const int& lineNum,
                         const json::Array& matchOnArray,
                         const json::Array& matchOffArray,
+                        const std::vector<std::pair<std::size_t, std::size_t> >& encodedMatches,
                         LineInfo* pLineInfo,
                         json::Array* pReplaceMatchOn,
                         json::Array* pReplaceMatchOff,
@@ -771,14 +810,11 @@ private:
       const std::string replacePattern = findResults().replacePattern();
       LocalProgress* pProgress = findResults().replaceProgress();
 
-      // when the system is not using utf8 we encoded the line before performing the replace
-      json::Array eMatchOnArray;
-      json::Array eMatchOffArray;
+      // the matches' byte offsets in the (encoded) line are used for the replace, and
+      // their character offsets in the decoded line for display
       size_t eMatchOn = 0;
       size_t eMatchOff = 0;
 
-      cleanLineAndGetMatches(&pLineInfo->encodedContents, &eMatchOnArray, &eMatchOffArray);
-
       while (findResults().isRunning() &&
              inputLineNum_ < lineNum && std::getline(*inputStream_, line))
       {
@@ -807,26 +843,8 @@ private:
                Error error;
                Replacer replacer(findResults().ignoreCase(), encoding_);
 
-               eMatchOn =
-                   static_cast<size_t>(eMatchOnArray.getValueAt(static_cast<size_t>(pos)).getInt());
-               eMatchOff =
-                   static_cast<size_t>(eMatchOffArray.getValueAt(static_cast<size_t>(pos)).getInt());
-
-
-               // If we found a different number of matches searching the encoded string,
-               // we shouldn't perform the replace as the expected vs actual results may differ.
-               if (eMatchOnArray.getSize() != matchOnArray.getSize())
-               {
-                  core::Error error(
-                     errc::findCategory(),
-                     errc::RegexError,
-                     "Found " + std::to_string(matchOnArray.getSize()) +  " matches in line but " + std::to_string(eMatchOnArray.getSize()) + " matches in encoded line; skipping replace.",
-                     ERROR_LOCATION);
-                  addReplaceErrorMessage(error.asString(), pErrorMessage, pReplaceMatchOn,
-                     pReplaceMatchOff, &lineSuccess);
-
-                  return error;
-               }
+               eMatchOn = encodedMatches[static_cast<size_t>(pos)].first;
+               eMatchOff = encodedMatches[static_cast<size_t>(pos)].second;
 
                // if previewing, we need to display the original and replacement text
                if (findResults().preview())
@@ -906,21 +924,86 @@ private:
       return Success();
    }
 
-   bool shouldSkipFile(std::string file)
+   void onStdout(const core::system::ProcessOperations& /*ops*/, const std::string& data)
    {
-      return (file.find("/.Rproj.user/") != std::string::npos ||
-              file.find("/.quarto/") != std::string::npos ||
-              file.find("/.git/") != std::string::npos ||
-              file.find("/.svn/") != std::string::npos ||
-              file.find("/packrat/lib/") != std::string::npos ||
-              file.find("/packrat/src/") != std::string::npos ||
-              file.find("/renv/library/") != std::string::npos ||
-              file.find("/renv/python/") != std::string::npos ||
-              file.find("/renv/staging/") != std::string::npos ||
-              file.find("/.Rhistory") != std::string::npos);
+      std::vector<GrepMatch> grepMatches;
+
+      stdOutBuf_.append(data);
+      size_t nextLineStart = 0;
+      size_t pos = -1;
+      while (std::string::npos != (pos = stdOutBuf_.find('\n', pos + 1)))
+      {
+         std::string line = stdOutBuf_.substr(nextLineStart, pos - nextLineStart);
+         nextLineStart = pos + 1;
+
+         boost::smatch match;
+         if (regex_utils::match(
+               line, match, getGrepOutputRegex(findResults().gitFlag())) &&
+             match.size() > 1)
+         {
+            GrepMatch grepMatch;
+            grepMatch.file = module_context::createAliasedPath(
+                  FilePath(string_utils::systemToUtf8(match[1])));
+            // git grep returns the path within the repo
+            // we use this combined with the find request's directory
+            // to locate the file on the user's system
+            if (findResults().gitFlag())
+            {
+               grepMatch.file.insert(0, "/");
+               grepMatch.file.insert(0, findResults().path());
+            }
+            grepMatch.lineNum = safe_convert::stringTo<int>(std::string(match[2]), -1);
+            cleanLineAndGetMatches(match[3], &grepMatch.contents, &grepMatch.matches);
+            grepMatches.push_back(grepMatch);
+         }
+      }
+
+      if (nextLineStart)
+      {
+         stdOutBuf_.erase(0, nextLineStart);
+      }
+
+      processMatches(grepMatches);
    }
 
-   void onStdout(const core::system::ProcessOperations& /*ops*/, const std::string& data)
+   bool collectMatches()
+   {
+      if (!isActive())
+      {
+         pEngine_->stop();
+         onExit(EXIT_SUCCESS);
+         return false;
+      }
+
+      std::vector<FindEngine::LineMatch> lineMatches;
+      bool ended = pEngine_->takeMatches(&lineMatches);
+
+      std::vector<GrepMatch> grepMatches;
+      grepMatches.reserve(lineMatches.size());
+      for (FindEngine::LineMatch& lineMatch : lineMatches)
+      {
+         GrepMatch grepMatch;
+         grepMatch.file = module_context::createAliasedPath(FilePath(lineMatch.file));
+         grepMatch.lineNum = lineMatch.lineNum;
+         grepMatch.contents.swap(lineMatch.contents);
+         grepMatch.matches.swap(lineMatch.matches);
+         grepMatches.push_back(grepMatch);
+      }
+
+      if (!grepMatches.empty())
+         processMatches(grepMatches);
+
+      if (ended || !isActive())
+      {
+         pEngine_->stop();
+         onExit(EXIT_SUCCESS);
+         return false;
+      }
+
+      return true;
+   }
+
+   void processMatches(const std::vector<GrepMatch>& grepMatches)
    {
       json::Array files;
       json::Array lineNums;
@@ -938,123 +1021,113 @@ private:
       // directories that should be ignored (e.g. virtual envs, website outpu
       std::vector<FilePath> ignoreDirs = module_context::ignoreContentDirs();
 
-      stdOutBuf_.append(data);
-      size_t nextLineStart = 0;
-      size_t pos = -1;
       std::set<std::string> errorMessage;
-      while (recordsToProcess &&
-             std::string::npos != (pos = stdOutBuf_.find('\n', pos + 1)))
+      for (auto it = grepMatches.begin(); recordsToProcess && it != grepMatches.end(); ++it)
       {
-         std::string line = stdOutBuf_.substr(nextLineStart, pos - nextLineStart);
-         nextLineStart = pos + 1;
-
          errorMessage.clear();
-         boost::smatch match;
-         if (regex_utils::match(
-               line, match, getGrepOutputRegex(findResults().gitFlag())) &&
-             match.size() > 1)
+         const std::string& file = it->file;
+
+         // normal skip heuristics
+         if (shouldSkipFile(file))
+            continue;
+
+         // contained in content dir
+         FilePath fullPath(module_context::resolveAliasedPath(file));
+         if (module_context::isIgnoredContent(fullPath, ignoreDirs))
+            continue;
+
+         int lineNum = it->lineNum;
+         LineInfo lineInfo;
+
+         // trim the line (but not its matches), keeping the match offsets
+         // relative to what's left
+         const std::string& line = it->contents;
+         std::size_t begin = 0;
+         std::size_t end = line.size();
+         while (begin < end && std::isspace(static_cast<unsigned char>(line[begin])))
+            begin++;
+         while (end > begin && std::isspace(static_cast<unsigned char>(line[end - 1])))
+            end--;
+         if (!it->matches.empty())
          {
-            std::string file = module_context::createAliasedPath(
-                  FilePath(string_utils::systemToUtf8(match[1])));
-            // git grep returns the path within the repo
-            // we use this combined with the find request's directory
-            // to locate the file on the user's system
-            if (findResults().gitFlag())
-            {
-               file.insert(0, "/");
-               file.insert(0, findResults().path());
-            }
+            begin = std::min(begin, it->matches.front().first);
+            end = std::max(end, std::min(it->matches.back().second, line.size()));
+         }
 
-            // normal skip heuristics
-            if (shouldSkipFile(file))
-               continue;
+         lineInfo.leadingWhitespace = line.substr(0, begin);
+         lineInfo.trailingWhitespace = line.substr(end);
+         lineInfo.encodedContents = line.substr(begin, end - begin);
 
-            // contained in content dir
-            FilePath fullPath(module_context::resolveAliasedPath(file));
-            if (module_context::isIgnoredContent(fullPath, ignoreDirs))
-               continue;
+         std::vector<std::pair<std::size_t, std::size_t> > matches;
+         for (const auto& match : it->matches)
+         {
+            std::size_t matchBegin = std::min(std::max(match.first, begin), end) - begin;
+            std::size_t matchEnd = std::min(std::max(match.second, begin), end) - begin;
+            matches.push_back(std::make_pair(matchBegin, matchEnd));
+         }
 
-            int lineNum = safe_convert::stringTo<int>(std::string(match[2]), -1);
-            LineInfo lineInfo;
-            lineInfo.encodedContents = match[3];
-            lineInfo.decodedPreview = match[3];
-            lineInfo.decodedContents = match[3];
+         json::Array matchOn, matchOff;
+         json::Array replaceMatchOn, replaceMatchOff;
+         processContents(lineInfo.encodedContents, matches,
+            &lineInfo.decodedPreview, &lineInfo.decodedContents,
+            &matchOn, &matchOff);
 
-            boost::algorithm::trim(lineInfo.decodedPreview);
-            if (lineInfo.encodedContents != lineInfo.decodedPreview)
+         if (findResults().replace() &&
+             !(findResults().preview() &&
+               findResults().replacePattern().empty()))
+         {
+            // check if we are looking at a new file
+            if (currentFile_.empty() || currentFile_ != fullPath.getAbsolutePath())
             {
-               std::string trimmed(lineInfo.encodedContents);
-               boost::algorithm::trim(trimmed);
-
-               size_t pos = lineInfo.encodedContents.find(trimmed);
-               lineInfo.leadingWhitespace =
-                  lineInfo.encodedContents.substr(0, pos);
-               lineInfo.trailingWhitespace =
-                  lineInfo.encodedContents.substr(pos + trimmed.length());
-               lineInfo.encodedContents = trimmed;
+               if (!currentFile_.empty())
+                  completeFileReplace(&errorMessage);
+               Error error = initializeFileForReplace(fullPath);
+               if (error)
+                  addReplaceErrorMessage(error.asString(), &errorMessage,
+                     &replaceMatchOn, &replaceMatchOff, &fileSuccess_);
             }
-
-            json::Array matchOn, matchOff;
-            json::Array replaceMatchOn, replaceMatchOff;
-            processContents(&lineInfo.decodedPreview, &lineInfo.decodedContents,
-               &matchOn, &matchOff);
-
-            if (findResults().replace() &&
-                !(findResults().preview() &&
-                  findResults().replacePattern().empty()))
+            else if (!fileSuccess_)
             {
-               // check if we are looking at a new file
-               if (currentFile_.empty() || currentFile_ != fullPath.getAbsolutePath())
-               {
-                  if (!currentFile_.empty())
-                     completeFileReplace(&errorMessage);
-                  Error error = initializeFileForReplace(fullPath);
-                  if (error)
-                     addReplaceErrorMessage(error.asString(), &errorMessage,
-                        &replaceMatchOn, &replaceMatchOff, &fileSuccess_);
-               }
-               else if (!fileSuccess_)
-               {
-                  // the first time a file is processed it gets a more detailed initialization error
-                  addReplaceErrorMessage("Cannot perform replace", &errorMessage,
-                     &replaceMatchOn, &replaceMatchOff, &fileSuccess_);
-               }
-               if (!fileSuccess_ || lineInfo.decodedPreview.length() > MAX_LINE_LENGTH)
-               {
-                  // if we failed for any reason, update the progress
-                  if (!findResults().preview())
-                     findResults().replaceProgress()->
-                        addUnits(gsl::narrow_cast<int>(matchOn.getSize()));
-                  if (fileSuccess_)
-                  {
-                     bool lineSuccess;
-                     addReplaceErrorMessage("Line exceeds maximum character length for replace",
-                        &errorMessage, &replaceMatchOn, &replaceMatchOff, &lineSuccess);
-                  }
-               }
-               else
+               // the first time a file is processed it gets a more detailed initialization error
+               addReplaceErrorMessage("Cannot perform replace", &errorMessage,
+                  &replaceMatchOn, &replaceMatchOff, &fileSuccess_);
+            }
+            if (!fileSuccess_ || lineInfo.decodedPreview.length() > MAX_LINE_LENGTH)
+            {
+               // if we failed for any reason, update the progress
+               if (!findResults().preview())
+                  findResults().replaceProgress()->
+                     addUnits(gsl::narrow_cast<int>(matchOn.getSize()));
+               if (fileSuccess_)
                {
-                   processReplace(lineNum,
-                                  matchOn, matchOff,
-                                  &lineInfo,
-                                  &replaceMatchOn, &replaceMatchOff,
-                                  &errorMessage);
-                  lineInfo.decodedPreview = lineInfo.decodedContents;
-                  adjustForPreview(&lineInfo.decodedPreview, &replaceMatchOn, &replaceMatchOff);
+                  bool lineSuccess;
+                  addReplaceErrorMessage("Line exceeds maximum character length for replace",
+                     &errorMessage, &replaceMatchOn, &replaceMatchOff, &lineSuccess);
                }
             }
-
-            files.push_back(file);
-            lineNums.push_back(lineNum);
-            contents.push_back(lineInfo.decodedPreview);
-            matchOns.push_back(matchOn);
-            matchOffs.push_back(matchOff);
-            replaceMatchOns.push_back(replaceMatchOn);
-            replaceMatchOffs.push_back(replaceMatchOff);
-            json::Array combinedErrors = json::toJsonArray(errorMessage);
-            errors.push_back(combinedErrors);
-            recordsToProcess--;
+            else
+            {
+                processReplace(lineNum,
+                               matchOn, matchOff,
+                               matches,
+                               &lineInfo,
+                               &replaceMatchOn, &replaceMatchOff,
+                               &errorMessage);
+               lineInfo.decodedPreview = lineInfo.decodedContents;
+               adjustForPreview(&lineInfo.decodedPreview, &replaceMatchOn, &replaceMatchOff);
+            }
          }
+
+         files.push_back(file);
+         lineNums.push_back(lineNum);
+         contents.push_back(lineInfo.decodedPreview);
+         matchOns.push_back(matchOn);
+         matchOffs.push_back(matchOff);
+         replaceMatchOns.push_back(replaceMatchOn);
+         replaceMatchOffs.push_back(replaceMatchOff);
+         json::Array combinedErrors = json::toJsonArray(errorMessage);
+         errors.push_back(combinedErrors);
+         recordsToProcess--;
       }
       // when doing a replace, we haven't completed the replace for the last file here
       if (findResults().replace() && !currentFile_.empty() && !findResults().preview())
@@ -1074,11 +1147,6 @@ private:
          }
       }
 
-      if (nextLineStart)
-      {
-         stdOutBuf_.erase(0, nextLineStart);
-      }
-
       if (files.getSize() > 0)
       {
          json::Object result;
@@ -1139,6 +1207,7 @@ private:
    bool firstDecodeError_;
    std::string encoding_;
    FilePath tempFile_;
+   boost::shared_ptr<FindEngine> pEngine_;
    std::string stdOutBuf_;
    std::string handle_;
    std::string currentFile_;
@@ -1150,6 +1219,303 @@ private:
    bool fileSuccess_;
 };
 
+// keeps a trigram index of the files within the project up to date with
+// the project's file monitor, so that searches within the project can skip
+// files which can't contain a match
+class ProjectFindIndex : boost::noncopyable
+{
+public:
+   ProjectFindIndex()
+      : nextJobId_(0), generation_(0), collecting_(false), ready_(false)
+   {
+   }
+
+   void onMonitoringEnabled(const tree<FileInfo>& files)
+   {
+      // start from the index saved by the previous session (if any), so
+      // that only files changed since then need to be indexed
+      FilePath indexPath = indexFilePath();
+      if (indexPath.exists())
+      {
+         Error error = index_.read(indexPath);
+         if (error)
+            LOG_ERROR(error);
+      }
+
+      std::set<std::string> paths;
+      for (auto it = files.begin_leaf(); it != files.end_leaf(); ++it)
+      {
+         const FileInfo& fileInfo = *it;
+         if (fileInfo.isDirectory())
+            continue;
+
+         paths.insert(fileInfo.absolutePath());
+         if (!index_.isIndexed(fileInfo))
+         {
+            enqueFileChange(core::system::FileChangeEvent(
+                               core::system::FileChangeEvent::FileAdded, fileInfo));
+         }
+      }
+
+      // forget files which have been removed
+      std::vector<std::string> indexed;
+      index_.listFiles(&indexed);
+      for (const std::string& path : indexed)
+      {
+         if (paths.count(path) == 0)
+            index_.removeFile(path);
+      }
+      pIndexedPaths_.reset();
+
+      if (pending_.empty())
+         onIndexingCompleted();
+   }
+
+   void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+   {
+      for (const core::system::FileChangeEvent& event : events)
+         enqueFileChange(event);
+   }
+
+   void onMonitoringDisabled()
+   {
+      // clear the index so we don't ever get stale results (and drop any
+      // indexing still to be done, or collected, for it)
+      index_.clear();
+      pIndexedPaths_.reset();
+      if (pIndexer_)
+      {
+         pIndexer_->stop();
+         pIndexer_.reset();
+      }
+      pending_.clear();
+      generation_++;
+      collecting_ = false;
+      ready_ = false;
+   }
+
+   void onShutdown()
+   {
+      if (ready_)
+         saveIndex();
+   }
+
+   // a predicate for the indexed files which can't contain a match for the
+   // pattern (these can be skipped when searching); it holds its own copies
+   // of what it needs, so can be called from the search threads
+   boost::function<bool(const std::string&)> skipFile(const std::string& pattern,
+                                                      bool asRegex,
+                                                      bool ignoreCase)
+   {
+      if (!ready_)
+         return boost::function<bool(const std::string&)>();
+
+      std::vector<uint32_t> trigrams;
+      if (!FindIndex::queryTrigrams(pattern, asRegex, ignoreCase, &trigrams))
+         return boost::function<bool(const std::string&)>();
+
+      boost::shared_ptr<std::set<std::string> > pCandidates(new std::set<std::string>());
+      index_.candidates(trigrams, pCandidates.get());
+
+      // files waiting to be re-indexed may have changed since they were
+      // indexed, so are always searched
+      for (const auto& pending : pending_)
+         pCandidates->insert(pending.first);
+
+      return boost::bind(isSkippable,
+                         indexedPaths(),
+                         boost::shared_ptr<const std::set<std::string> >(pCandidates),
+                         _1);
+   }
+
+private:
+   static FilePath indexFilePath()
+   {
+      return projects::projectContext().scratchPath().completePath("find-index");
+   }
+
+   static bool isSkippable(boost::shared_ptr<const std::unordered_set<std::string> > pIndexed,
+                           boost::shared_ptr<const std::set<std::string> > pCandidates,
+                           const std::string& path)
+   {
+      return pIndexed->count(path) && !pCandidates->count(path);
+   }
+
+   // the paths of the indexed files; searches share this, so it's replaced
+   // (when next needed) rather than updated as files are added and removed
+   boost::shared_ptr<const std::unordered_set<std::string> > indexedPaths()
+   {
+      if (!pIndexedPaths_)
+      {
+         std::vector<std::string> paths;
+         index_.listFiles(&paths);
+         pIndexedPaths_.reset(new std::unordered_set<std::string>(paths.begin(), paths.end()));
+      }
+      return pIndexedPaths_;
+   }
+
+   void saveIndex()
+   {
+      Error error = index_.write(indexFilePath());
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   void enqueFileChange(const core::system::FileChangeEvent& event)
+   {
+      using namespace rstudio::core::system;
+
+      const FileInfo& fileInfo = event.fileInfo();
+      switch (event.type())
+      {
+         case FileChangeEvent::FileAdded:
+         case FileChangeEvent::FileModified:
+         {
+            if (fileInfo.isDirectory())
+               break;
+
+            // files are read (and their trigrams extracted) in the
+            // background, and added to the index as they're collected
+            FindIndexer::Job job;
+            job.id = ++nextJobId_;
+            job.fileInfo = fileInfo;
+            pending_[fileInfo.absolutePath()] = job.id;
+
+            if (!pIndexer_)
+               pIndexer_ = FindIndexer::create();
+            pIndexer_->enqueue(job);
+            scheduleCollection();
+            break;
+         }
+
+         case FileChangeEvent::FileRemoved:
+         {
+            // (any indexing of the file, or of files within the directory,
+            // which is underway is ignored)
+            std::string path = fileInfo.absolutePath();
+            pending_.erase(path);
+            std::string prefix = path + "/";
+            auto begin = pending_.lower_bound(prefix);
+            auto end = begin;
+            while (end != pending_.end() && boost::algorithm::starts_with(end->first, prefix))
+               ++end;
+            pending_.erase(begin, end);
+
+            index_.removeFile(fileInfo.absolutePath());
+            pIndexedPaths_.reset();
+            break;
+         }
+
+         case FileChangeEvent::None:
+            break;
+      }
+   }
+
+   void scheduleCollection()
+   {
+      if (collecting_)
+         return;
+
+      collecting_ = true;
+      module_context::schedulePeriodicWork(
+               boost::posix_time::milliseconds(50),
+               boost::bind(&ProjectFindIndex::collectTrigrams, this, generation_),
+               false /* collect even when non-idle */,
+               false /* not immediately */);
+   }
+
+   bool collectTrigrams(uint64_t generation)
+   {
+      // bail if monitoring was disabled since collection was scheduled
+      if (generation != generation_)
+         return false;
+
+      std::vector<FindIndexer::Result> results;
+      if (pIndexer_)
+         pIndexer_->takeResults(&results);
+
+      for (const FindIndexer::Result& result : results)
+      {
+         // skip results for files which have since been removed, or which
+         // have been changed again (and are being re-indexed)
+         const std::string& path = result.fileTrigrams.fileInfo.absolutePath();
+         auto it = pending_.find(path);
+         if (it == pending_.end() || it->second != result.id)
+            continue;
+         pending_.erase(it);
+
+         // unreadable files are left out of the index (and so are searched
+         // by grep as if there were no index)
+         bool wasIndexed = index_.isIndexed(path);
+         if (result.error)
+            index_.removeFile(path);
+         else
+            index_.indexTrigrams(result.fileTrigrams);
+         if (wasIndexed != !result.error)
+            pIndexedPaths_.reset();
+      }
+
+      if (!pending_.empty())
+         return true;
+
+      collecting_ = false;
+      onIndexingCompleted();
+      return false;
+   }
+
+   void onIndexingCompleted()
+   {
+      // save the index once it's first built, so it can be reused should
+      // the session not shut down cleanly
+      if (!ready_)
+      {
+         ready_ = true;
+         saveIndex();
+      }
+   }
+
+   FindIndex index_;
+   boost::shared_ptr<const std::unordered_set<std::string> > pIndexedPaths_;
+   boost::shared_ptr<FindIndexer> pIndexer_;
+
+   // the files being indexed (and the id of the latest job for each)
+   std::map<std::string, uint64_t> pending_;
+   uint64_t nextJobId_;
+
+   // incremented when the index is cleared, so that collection scheduled
+   // before then stops
+   uint64_t generation_;
+
+   bool collecting_;
+   bool ready_;
+};
+
+ProjectFindIndex& projectFindIndex()
+{
+   static ProjectFindIndex instance;
+   return instance;
+}
+
+void onFileMonitorEnabled(const tree<core::FileInfo>& files)
+{
+   projectFindIndex().onMonitoringEnabled(files);
+}
+
+void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+{
+   projectFindIndex().onFilesChanged(events);
+}
+
+void onFileMonitorDisabled()
+{
+   projectFindIndex().onMonitoringDisabled();
+}
+
+void onShutdown(bool)
+{
+   projectFindIndex().onShutdown();
+}
+
 } // namespace
 
 class GrepOptions : public boost::noncopyable
@@ -1230,6 +1596,16 @@ public:
       return excludeArgs_;
    }
 
+   const std::vector<std::string>& includeGlobs() const
+   {
+      return includeGlobs_;
+   }
+
+   const std::vector<std::string>& excludeGlobs() const
+   {
+      return excludeGlobs_;
+   }
+
 private:
 
    bool asRegex_;
@@ -1242,11 +1618,13 @@ private:
 
    // derived from includeFilePatterns
    std::vector<std::string> includeArgs_;
+   std::vector<std::string> includeGlobs_;
    bool packageSourceFlag_;
    bool packageTestsFlag_;
 
    // derived from excludeFilePatterns
    std::vector<std::string> excludeArgs_;
+   std::vector<std::string> excludeGlobs_;
    bool gitFlag_;
 
    void processExcludeFilePatterns()
@@ -1262,7 +1640,10 @@ private:
             if (excludeText.compare("gitExclusions") == 0)
                gitFlag_ = true;
             else if (!excludeText.empty())
+            {
                excludeArgs_.push_back("--exclude=" + filePattern.getString());
+               excludeGlobs_.push_back(filePattern.getString());
+            }
          }
       }
    }
@@ -1283,7 +1664,10 @@ private:
             else if (includeText.compare("packageTests") == 0)
                packageTestsFlag_ = true;
             else if (!includeText.empty())
+            {
                includeArgs_.push_back("--include=" + filePattern.getString());
+               includeGlobs_.push_back(filePattern.getString());
+            }
          }
       }
    }
@@ -1338,8 +1722,44 @@ void addDirectoriesToCommand(
    }
 }
 
-core::Error runGrepOperation(const GrepOptions& grepOptions, const ReplaceOptions& replaceOptions,
-   LocalProgress* pProgress, json::JsonRpcResponse* pResponse)
+// the directories searched for the given options (as with
+// addDirectoriesToCommand)
+std::vector<FilePath> searchDirectories(
+   bool packageSourceFlag, bool packageTestsFlag, const FilePath& directoryPath)
+{
+   std::vector<FilePath> directories;
+   if (!(packageSourceFlag || packageTestsFlag))
+      directories.push_back(directoryPath);
+   else if (packageSourceFlag)
+   {
+      for (const char* name : { "R", "src" })
+      {
+         FilePath path = directoryPath.completeChildPath(name);
+         if (path.exists())
+            directories.push_back(path);
+      }
+   }
+   else
+   {
+      FilePath testsPath = directoryPath.completeChildPath("tests");
+      if (testsPath.exists())
+         directories.push_back(testsPath);
+   }
+   return directories;
+}
+
+bool skipSearchPath(const std::vector<FilePath>& ignoreDirs, const FilePath& path)
+{
+   // (trailing slash so that directories match the skip heuristics)
+   return shouldSkipFile(path.getAbsolutePath() + "/") ||
+          module_context::isIgnoredContent(path, ignoreDirs);
+}
+
+core::Error runGrepCommand(const GrepOptions& grepOptions,
+                           const std::string& encodedString,
+                           const FilePath& dirPath,
+                           const FilePath& tempFile,
+                           boost::shared_ptr<GrepOperation> ptrGrepOp)
 {
    core::system::ProcessOptions options;
 
@@ -1356,38 +1776,17 @@ core::Error runGrepOperation(const GrepOptions& grepOptions, const ReplaceOption
    options.environment = childEnv;
 
    // Put the grep pattern in a file
-   FilePath tempFile = module_context::tempFile("rs_grep", "txt");
    std::shared_ptr<std::ostream> pStream;
    Error error = tempFile.openForWrite(pStream);
    if (error)
       return error;
-   std::string encoding = projects::projectContext().hasProject() ?
-                          projects::projectContext().defaultEncoding() :
-                          prefs::userPrefs().defaultEncoding();
-   std::string encodedString;
-   error = r::util::iconvstr(grepOptions.searchPattern(),
-                             "UTF-8",
-                             encoding,
-                             false,
-                             &encodedString);
-   if (error)
-   {
-      LOG_ERROR(error);
-      encodedString = grepOptions.searchPattern();
-   }
 
    *pStream << encodedString << std::endl;
    pStream.reset(); // release file handle
 
-   boost::shared_ptr<GrepOperation> ptrGrepOp = GrepOperation::create(encoding,
-                                                                      tempFile);
    core::system::ProcessCallbacks callbacks =
                                        ptrGrepOp->createProcessCallbacks();
 
-   // Filepaths received from the client will be UTF-8 encoded;
-   // convert to system encoding here.
-   FilePath dirPath = module_context::resolveAliasedPath(grepOptions.directory());
-
 #ifdef _WIN32
    shell_utils::ShellCommand cmd(gnuGrepPath.completePath("grep"));
 #else
@@ -1420,14 +1819,6 @@ core::Error runGrepOperation(const GrepOptions& grepOptions, const ReplaceOption
          cmd << "-F";
       addDirectoriesToCommand(
          grepOptions.packageSourceFlag(), grepOptions.packageTestsFlag(), dirPath, &cmd);
-
-      if (grepOptions.anyPackageFlag() &&
-          !grepOptions.includeArgs().empty())
-      {
-         for (std::string arg : grepOptions.includeArgs())
-            LOG_DEBUG_MESSAGE(
-               "Unknown include argument(s): " + boost::join(grepOptions.includeArgs(), ", "));
-      }
    }
    else
    {
@@ -1453,14 +1844,90 @@ core::Error runGrepOperation(const GrepOptions& grepOptions, const ReplaceOption
          grepOptions.packageSourceFlag(), grepOptions.packageTestsFlag(), dirPath, &cmd);
    }
 
+   return module_context::processSupervisor().runCommand(cmd,
+                                                         options,
+                                                         callbacks);
+}
+
+core::Error runGrepOperation(const GrepOptions& grepOptions, const ReplaceOptions& replaceOptions,
+   LocalProgress* pProgress, json::JsonRpcResponse* pResponse)
+{
+   std::string encoding = projects::projectContext().hasProject() ?
+                          projects::projectContext().defaultEncoding() :
+                          prefs::userPrefs().defaultEncoding();
+   std::string encodedString;
+   Error error = r::util::iconvstr(grepOptions.searchPattern(),
+                                   "UTF-8",
+                                   encoding,
+                                   false,
+                                   &encodedString);
+   if (error)
+   {
+      LOG_ERROR(error);
+      encodedString = grepOptions.searchPattern();
+   }
+
+   // Filepaths received from the client will be UTF-8 encoded;
+   // convert to system encoding here.
+   FilePath dirPath = module_context::resolveAliasedPath(grepOptions.directory());
+
+   if (grepOptions.gitFlag() &&
+       grepOptions.anyPackageFlag() &&
+       !grepOptions.includeArgs().empty())
+   {
+      LOG_DEBUG_MESSAGE(
+         "Unknown include argument(s): " + boost::join(grepOptions.includeArgs(), ", "));
+   }
+
+   // search in-process where we can; the pattern is encoded as the files
+   // being searched are, and within the project the find index lets us
+   // skip files which can't contain a match
+   FindEngine::Options engineOptions;
+   engineOptions.pattern = encodedString;
+   engineOptions.asRegex = grepOptions.asRegex();
+   engineOptions.ignoreCase = grepOptions.ignoreCase();
+   engineOptions.useGit = grepOptions.gitFlag();
+   if (!grepOptions.gitFlag())
+   {
+      engineOptions.includeGlobs = grepOptions.includeGlobs();
+      engineOptions.excludeGlobs = grepOptions.excludeGlobs();
+   }
+   engineOptions.skipPath = boost::bind(skipSearchPath,
+                                        module_context::ignoreContentDirs(),
+                                        _1);
+   engineOptions.skipFile = projectFindIndex().skipFile(encodedString,
+                                                        grepOptions.asRegex(),
+                                                        grepOptions.ignoreCase());
+   engineOptions.maxMatches = MAX_COUNT + 1;
+
+   boost::shared_ptr<FindEngine> pEngine;
+   Error engineError = FindEngine::create(engineOptions, &pEngine);
+
+   // patterns the engine can't compile are left to grep (which reports
+   // any error itself)
+   FilePath tempFile;
+   if (engineError)
+      tempFile = module_context::tempFile("rs_grep", "txt");
+
+   boost::shared_ptr<GrepOperation> ptrGrepOp = GrepOperation::create(encoding,
+                                                                      tempFile);
+
    // Clear existing results
    findResults().clear();
 
-   error = module_context::processSupervisor().runCommand(cmd,
-                                                          options,
-                                                          callbacks);
-   if (error)
-      return error;
+   if (!engineError)
+   {
+      ptrGrepOp->startSearch(pEngine,
+                             searchDirectories(grepOptions.packageSourceFlag(),
+                                               grepOptions.packageTestsFlag(),
+                                               dirPath));
+   }
+   else
+   {
+      error = runGrepCommand(grepOptions, encodedString, dirPath, tempFile, ptrGrepOp);
+      if (error)
+         return error;
+   }
 
    findResults().onFindBegin(ptrGrepOp->handle(),
                              grepOptions.searchPattern(),
@@ -1637,6 +2104,15 @@ core::Error initialize()
    // register suspend handler
    addSuspendHandler(SuspendHandler(bind(onSuspend, _2), onResume));
 
+   // index project files to narrow searches within the project
+   // (note that if there is no project this will no-op)
+   projects::FileMonitorCallbacks cb;
+   cb.onMonitoringEnabled = onFileMonitorEnabled;
+   cb.onFilesChanged = onFilesChanged;
+   cb.onMonitoringDisabled = onFileMonitorDisabled;
+   projects::projectContext().subscribeToFileMonitor("Find in files indexing", cb);
+   events().onShutdown.connect(onShutdown);
+
    // install handlers
    ExecBlock initBlock;
    initBlock.addFunctions()
@@ -1753,7 +2229,7 @@ core::Error Replacer::replaceRegexIgnoreCase(size_t matchOn, size_t matchOff,
 {
    try
    {
-      boost::regex find(findRegex, boost::regex::grep | boost::regex::icase);
+      boost::regex find(findRegex, FindEngine::regexFlags(true, true));
       core::Error error = completeReplace(find, replaceRegex, matchOn, matchOff, pLine,
          pReplaceMatchOff);
       return error;
@@ -1778,7 +2254,7 @@ core::Error Replacer::replaceRegexWithCase(size_t matchOn, size_t matchOff,
 {
    try
    {
-      boost::regex find(findRegex, boost::regex::grep);
+      boost::regex find(findRegex, FindEngine::regexFlags(true, false));
       core::Error error = completeReplace(find, replaceRegex, matchOn, matchOff, pLine,
          pReplaceMatchOff);
       return error;
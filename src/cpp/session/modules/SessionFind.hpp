@@ -29,6 +29,19 @@ namespace session {
 namespace modules {
 namespace find {
 
+namespace errc {
+
+enum errc_t
+{
+   Success = 0,
+   RegexError = 1,
+   PermissionsError = 2
+};
+
+const std::string& findCategory();
+
+}
+
 core::json::Object findInFilesStateAsJson();
 
 core::Error initialize();
@@ -0,0 +1,563 @@
+/*
+ * SessionFindEngine.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFindEngine.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/algorithm/searching/boyer_moore_horspool.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <core/Thread.hpp>
+#include <core/system/Process.hpp>
+#include <core/system/ShellUtils.hpp>
+
+#include "SessionFind.hpp"
+#include "SessionFindIndex.hpp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+
+namespace {
+
+// files are read (and searched) in chunks of about this size, so that
+// memory use doesn't depend on the size of the files being searched
+const std::size_t kChunkSize = 1024 * 1024;
+
+// as with grep and git grep, files with a NUL byte near the start are
+// considered binary (and so are never searched)
+const std::size_t kBinaryCheckSize = 8000;
+
+const unsigned int kMaxSearchThreads = 8;
+
+// match a file name against a glob (as used by grep --include), supporting
+// '*', '?' and bracket expressions
+bool globMatches(const char* glob, const char* name)
+{
+   const char* starGlob = nullptr;
+   const char* starName = nullptr;
+   while (*name)
+   {
+      if (*glob == '*')
+      {
+         starGlob = ++glob;
+         starName = name;
+         continue;
+      }
+
+      bool matched = false;
+      const char* nextGlob = glob + 1;
+      if (*glob == '?')
+      {
+         matched = true;
+      }
+      else if (*glob == '[')
+      {
+         const char* pos = glob + 1;
+         bool negate = (*pos == '!' || *pos == '^');
+         if (negate)
+            pos++;
+
+         bool inSet = false;
+         bool first = true;
+         while (*pos && (first || *pos != ']'))
+         {
+            first = false;
+            if (pos[1] == '-' && pos[2] && pos[2] != ']')
+            {
+               if (*name >= pos[0] && *name <= pos[2])
+                  inSet = true;
+               pos += 3;
+            }
+            else
+            {
+               if (*name == *pos)
+                  inSet = true;
+               pos++;
+            }
+         }
+
+         if (*pos == ']')
+         {
+            matched = (inSet != negate);
+            nextGlob = pos + 1;
+         }
+         else
+         {
+            // unterminated, so treat '[' literally
+            matched = (*name == '[');
+         }
+      }
+      else if (*glob == '\\' && glob[1])
+      {
+         matched = (*name == glob[1]);
+         nextGlob = glob + 2;
+      }
+      else
+      {
+         matched = (*glob && *glob == *name);
+      }
+
+      if (matched)
+      {
+         glob = nextGlob;
+         name++;
+      }
+      else if (starGlob)
+      {
+         // let the last '*' consume another character
+         glob = starGlob;
+         name = ++starName;
+      }
+      else
+      {
+         return false;
+      }
+   }
+
+   while (*glob == '*')
+      glob++;
+   return *glob == '\0';
+}
+
+bool anyGlobMatches(const std::vector<std::string>& globs, const std::string& name)
+{
+   for (const std::string& glob : globs)
+   {
+      if (globMatches(glob.c_str(), name.c_str()))
+         return true;
+   }
+   return false;
+}
+
+} // anonymous namespace
+
+boost::regex::flag_type FindEngine::regexFlags(bool asRegex, bool ignoreCase)
+{
+   // basic regular expressions with the GNU extensions supported by grep
+   boost::regex::flag_type flags = asRegex ?
+            boost::regex::grep | boost::regex::bk_plus_qm | boost::regex::bk_vbar :
+            boost::regex::literal;
+   if (ignoreCase)
+      flags |= boost::regex::icase;
+   return flags;
+}
+
+Error FindEngine::create(const Options& options,
+                         boost::shared_ptr<FindEngine>* pEngine)
+{
+   boost::shared_ptr<FindEngine> pNewEngine(new FindEngine(options));
+   try
+   {
+      pNewEngine->regex_ = boost::regex(options.pattern,
+                                        regexFlags(options.asRegex, options.ignoreCase));
+   }
+   catch (const boost::regex_error& e)
+   {
+      Error error(errc::findCategory(),
+                  errc::RegexError,
+                  "Invalid search pattern: " + std::string(e.what()),
+                  ERROR_LOCATION);
+      error.addProperty("position", static_cast<int>(e.position()));
+      return error;
+   }
+
+   if (!options.ignoreCase)
+   {
+      // the longest literal run is the most selective
+      std::vector<std::string> literals;
+      if (FindIndex::requiredLiterals(options.pattern, options.asRegex, &literals))
+      {
+         for (const std::string& literal : literals)
+         {
+            if (literal.size() > pNewEngine->prefilter_.size())
+               pNewEngine->prefilter_ = literal;
+         }
+      }
+   }
+
+   *pEngine = pNewEngine;
+   return Success();
+}
+
+FindEngine::FindEngine(const Options& options)
+   : options_(options),
+     nextFile_(0),
+     enumerated_(false),
+     stopped_(false),
+     nextResult_(0),
+     matchCount_(0)
+{
+}
+
+void FindEngine::start(const std::vector<FilePath>& directories)
+{
+   using namespace boost::placeholders;
+
+   core::thread::safeLaunchThread(
+            boost::bind(&FindEngine::enumerateFiles, shared_from_this(), directories));
+
+   unsigned int threads = boost::thread::hardware_concurrency();
+   threads = std::max(1u, std::min(threads, kMaxSearchThreads));
+   for (unsigned int i = 0; i < threads; i++)
+      core::thread::safeLaunchThread(boost::bind(&FindEngine::searchFiles, shared_from_this()));
+}
+
+bool FindEngine::takeMatches(std::vector<LineMatch>* pMatches)
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+
+   // matches are returned in file order, so stop at the first file which
+   // hasn't been searched yet
+   for (auto it = results_.begin();
+        it != results_.end() && it->first == nextResult_;
+        it = results_.erase(it))
+   {
+      for (LineMatch& match : it->second)
+      {
+         if (options_.maxMatches > 0 && matchCount_ >= options_.maxMatches)
+            break;
+
+         pMatches->push_back(LineMatch());
+         std::swap(pMatches->back(), match);
+         matchCount_++;
+      }
+      nextResult_++;
+   }
+
+   if (options_.maxMatches > 0 && matchCount_ >= options_.maxMatches)
+   {
+      stopped_ = true;
+      filesAvailable_.notify_all();
+   }
+
+   return stopped_ || (enumerated_ && nextResult_ == files_.size());
+}
+
+void FindEngine::stop()
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   stopped_ = true;
+   filesAvailable_.notify_all();
+}
+
+bool FindEngine::isStopped()
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   return stopped_;
+}
+
+void FindEngine::enumerateFiles(const std::vector<FilePath>& directories)
+{
+   try
+   {
+      for (const FilePath& directory : directories)
+      {
+         if (isStopped())
+            break;
+
+         if (options_.useGit)
+            addGitFiles(directory);
+         else
+            addDirectory(directory);
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   enumerated_ = true;
+   filesAvailable_.notify_all();
+}
+
+void FindEngine::addDirectory(const FilePath& directory)
+{
+   std::vector<FilePath> children;
+   Error error = directory.getChildren(children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // search in name order, so results are the same from one search to the next
+   std::sort(children.begin(), children.end());
+
+   for (const FilePath& child : children)
+   {
+      if (isStopped())
+         return;
+
+      // as with grep -r, symlinks within directories aren't followed
+      if (child.isSymlink())
+         continue;
+
+      if (child.isDirectory())
+      {
+         if (!options_.skipPath || !options_.skipPath(child))
+            addDirectory(child);
+      }
+      else
+      {
+         std::string name = child.getFilename();
+         if (!options_.includeGlobs.empty() && !anyGlobMatches(options_.includeGlobs, name))
+            continue;
+         if (anyGlobMatches(options_.excludeGlobs, name))
+            continue;
+
+         addFile(child);
+      }
+   }
+}
+
+void FindEngine::addGitFiles(const FilePath& directory)
+{
+   // have git list tracked files along with untracked files which aren't
+   // ignored (paths are listed relative to the directory)
+   shell_utils::ShellCommand cmd("git");
+   cmd << "-C" << string_utils::utf8ToSystem(directory.getAbsolutePath());
+   cmd << "-c" << "core.quotePath=false";
+   cmd << "ls-files" << "-z" << "--cached" << "--others" << "--exclude-standard";
+
+   core::system::ProcessResult result;
+   Error error = core::system::runCommand(cmd, core::system::ProcessOptions(), &result);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   if (result.exitStatus != EXIT_SUCCESS)
+   {
+      LOG_ERROR_MESSAGE("git ls-files: " + result.stdErr);
+      return;
+   }
+
+   std::string previous;
+   std::size_t pos = 0;
+   while (pos < result.stdOut.size() && !isStopped())
+   {
+      std::size_t end = result.stdOut.find('\0', pos);
+      if (end == std::string::npos)
+         end = result.stdOut.size();
+
+      // files with conflicts are listed once for each stage
+      std::string relativePath = result.stdOut.substr(pos, end - pos);
+      pos = end + 1;
+      if (relativePath.empty() || relativePath == previous)
+         continue;
+      previous = relativePath;
+
+      FilePath filePath = directory.completeChildPath(relativePath);
+      if (filePath.isSymlink() || filePath.isDirectory())
+         continue;
+
+      addFile(filePath);
+   }
+}
+
+bool FindEngine::addFile(const FilePath& filePath)
+{
+   // as with grep --devices=skip, only regular files are searched
+   if (!filePath.isRegularFile())
+      return false;
+
+   if (options_.skipPath && options_.skipPath(filePath))
+      return false;
+
+   std::string path = filePath.getAbsolutePath();
+   if (options_.skipFile && options_.skipFile(path))
+      return false;
+
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   files_.push_back(path);
+   filesAvailable_.notify_one();
+   return true;
+}
+
+void FindEngine::searchFiles()
+{
+   try
+   {
+      std::string buffer;
+      for (;;)
+      {
+         std::size_t index;
+         std::string path;
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (!stopped_ && !enumerated_ && nextFile_ >= files_.size())
+               filesAvailable_.wait(lock);
+
+            if (stopped_ || nextFile_ >= files_.size())
+               break;
+
+            index = nextFile_++;
+            path = files_[index];
+         }
+
+         // a file which can't be searched (e.g. the regular expression
+         // proves too complex for one of its lines) has no matches
+         std::vector<LineMatch> matches;
+         try
+         {
+            searchFile(path, &buffer, &matches);
+         }
+         catch (const std::exception& e)
+         {
+            LOG_WARNING_MESSAGE("Error searching " + path + ": " + e.what());
+            matches.clear();
+         }
+
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         results_[index].swap(matches);
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+void FindEngine::searchFile(const std::string& path,
+                            std::string* pBuffer,
+                            std::vector<LineMatch>* pMatches) const
+{
+   // files are read rather than memory mapped: a mapped file which is
+   // truncated while being searched would crash the session
+   std::shared_ptr<std::istream> pIfs;
+   Error error = FilePath(path).openForRead(pIfs);
+   if (error)
+      return;
+
+   boost::algorithm::boyer_moore_horspool<std::string::const_iterator> prefilter(
+            prefilter_.begin(), prefilter_.end());
+
+   std::string& buffer = *pBuffer;
+   buffer.clear();
+   int lineNum = 1;
+   bool firstChunk = true;
+   for (;;)
+   {
+      // read the next chunk after any incomplete line from the last one
+      std::size_t carried = buffer.size();
+      buffer.resize(carried + kChunkSize);
+      pIfs->read(&buffer[carried], kChunkSize);
+      buffer.resize(carried + static_cast<std::size_t>(pIfs->gcount()));
+      bool eof = !*pIfs;
+
+      if (firstChunk)
+      {
+         firstChunk = false;
+         std::size_t checkSize = std::min(buffer.size(), kBinaryCheckSize);
+         if (std::memchr(buffer.data(), '\0', checkSize) != nullptr)
+            return;
+      }
+
+      // search complete lines (or everything, at the end of the file)
+      std::size_t searchEnd = buffer.rfind('\n');
+      searchEnd = (searchEnd == std::string::npos) ? 0 : searchEnd + 1;
+      if (eof)
+         searchEnd = buffer.size();
+
+      const char* data = buffer.data();
+      std::size_t lineStart = 0;
+      while (lineStart < searchEnd)
+      {
+         if (!prefilter_.empty())
+         {
+            // skip straight to the next line containing the literal
+            std::string::const_iterator begin = buffer.cbegin() + lineStart;
+            std::string::const_iterator end = buffer.cbegin() + searchEnd;
+            std::string::const_iterator found = prefilter(begin, end).first;
+            if (found == end)
+            {
+               lineNum += static_cast<int>(std::count(begin, end, '\n'));
+               break;
+            }
+
+            std::size_t foundPos = found - buffer.cbegin();
+            std::size_t newline = buffer.rfind('\n', foundPos);
+            std::size_t matchLineStart =
+                  (newline == std::string::npos || newline < lineStart) ? lineStart : newline + 1;
+            lineNum += static_cast<int>(std::count(begin, buffer.cbegin() + matchLineStart, '\n'));
+            lineStart = matchLineStart;
+         }
+
+         const char* lineEnd = static_cast<const char*>(
+                  std::memchr(data + lineStart, '\n', searchEnd - lineStart));
+         if (lineEnd == nullptr)
+            lineEnd = data + searchEnd;
+
+         searchLine(data + lineStart, lineEnd, path, lineNum, pMatches);
+
+         lineNum++;
+         lineStart = (lineEnd - data) + 1;
+      }
+
+      if (eof)
+         break;
+
+      buffer.erase(0, searchEnd);
+   }
+}
+
+void FindEngine::searchLine(const char* begin,
+                            const char* end,
+                            const std::string& path,
+                            int lineNum,
+                            std::vector<LineMatch>* pMatches) const
+{
+   LineMatch lineMatch;
+   bool lineMatched = false;
+
+   boost::match_flag_type flags = boost::match_default | boost::match_not_dot_newline;
+   const char* pos = begin;
+   boost::cmatch match;
+   while (pos <= end && boost::regex_search(pos, end, match, regex_, flags))
+   {
+      lineMatched = true;
+
+      std::size_t matchOn = match[0].first - begin;
+      std::size_t matchOff = match[0].second - begin;
+      if (matchOff > matchOn)
+      {
+         lineMatch.matches.push_back(std::make_pair(matchOn, matchOff));
+         pos = match[0].second;
+      }
+      else
+      {
+         // step past empty matches
+         pos = match[0].second + 1;
+      }
+
+      flags |= boost::match_prev_avail | boost::match_not_bob;
+   }
+
+   if (lineMatched)
+   {
+      lineMatch.file = path;
+      lineMatch.lineNum = lineNum;
+      lineMatch.contents.assign(begin, end);
+      pMatches->push_back(std::move(lineMatch));
+   }
+}
+
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,155 @@
+/*
+ * SessionFindEngine.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_FIND_ENGINE_HPP
+#define SESSION_FIND_ENGINE_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/regex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+
+// In-process replacement for grep -rn (and git grep). Files are enumerated
+// on one background thread and searched on a pool of others; matches are
+// collected by the caller (on the main thread) in the order the files were
+// enumerated, so results for each file are contiguous and in line order.
+class FindEngine : public boost::enable_shared_from_this<FindEngine>,
+                   boost::noncopyable
+{
+public:
+   struct Options
+   {
+      Options()
+         : asRegex(false), ignoreCase(false), useGit(false), maxMatches(0)
+      {
+      }
+
+      // the pattern (a basic regular expression as understood by grep, or a
+      // fixed string) encoded as the files being searched are
+      std::string pattern;
+      bool asRegex;
+      bool ignoreCase;
+
+      // file name globs, as with grep --include and --exclude
+      std::vector<std::string> includeGlobs;
+      std::vector<std::string> excludeGlobs;
+
+      // only search files known to git (tracked, or untracked and not
+      // ignored), as with git grep --untracked --exclude-standard
+      bool useGit;
+
+      // paths (files or directories) which shouldn't be searched; called on
+      // a background thread so must be thread-safe
+      boost::function<bool(const core::FilePath&)> skipPath;
+
+      // files (by absolute path) which are known not to match (e.g. from
+      // the find index); also called on a background thread
+      boost::function<bool(const std::string&)> skipFile;
+
+      // stop once this many matching lines have been collected (0 for no limit)
+      std::size_t maxMatches;
+   };
+
+   struct LineMatch
+   {
+      std::string file;
+      int lineNum;
+
+      // the line's contents (without its line ending) and the byte offsets
+      // of the (non-empty) matches within it
+      std::string contents;
+      std::vector<std::pair<std::size_t, std::size_t> > matches;
+   };
+
+   // the syntax used for patterns (shared with replace, so that replacing
+   // acts on the same matches as were found)
+   static boost::regex::flag_type regexFlags(bool asRegex, bool ignoreCase);
+
+   // returns an error if the pattern is not a valid regular expression
+   static core::Error create(const Options& options,
+                             boost::shared_ptr<FindEngine>* pEngine);
+
+   // begin searching the files within the directories
+   void start(const std::vector<core::FilePath>& directories);
+
+   // take the matches found so far; returns true once the search has ended
+   // and all matches have been taken
+   bool takeMatches(std::vector<LineMatch>* pMatches);
+
+   void stop();
+
+private:
+   explicit FindEngine(const Options& options);
+
+   void enumerateFiles(const std::vector<core::FilePath>& directories);
+   void addDirectory(const core::FilePath& directory);
+   void addGitFiles(const core::FilePath& directory);
+   bool addFile(const core::FilePath& filePath);
+
+   void searchFiles();
+   void searchFile(const std::string& path,
+                   std::string* pBuffer,
+                   std::vector<LineMatch>* pMatches) const;
+   void searchLine(const char* begin,
+                   const char* end,
+                   const std::string& path,
+                   int lineNum,
+                   std::vector<LineMatch>* pMatches) const;
+
+   bool isStopped();
+
+   const Options options_;
+   boost::regex regex_;
+
+   // literal text which every match must contain (searched for ahead of
+   // running the regular expression, for case-sensitive searches)
+   std::string prefilter_;
+
+   boost::mutex mutex_;
+   boost::condition_variable filesAvailable_;
+   std::vector<std::string> files_;
+   std::size_t nextFile_;
+   bool enumerated_;
+   bool stopped_;
+
+   // matches for each searched file, keyed by the file's index
+   std::map<std::size_t, std::vector<LineMatch> > results_;
+   std::size_t nextResult_;
+   std::size_t matchCount_;
+};
+
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_FIND_ENGINE_HPP
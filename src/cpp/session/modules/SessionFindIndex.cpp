@@ -0,0 +1,753 @@
+/*
+ * SessionFindIndex.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFindIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <core/FileInfo.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+
+namespace {
+
+// files larger than this aren't indexed (and so are always searched)
+const uintmax_t kMaxIndexedFileSize = 1024 * 1024;
+
+// as with grep and git grep, files with a NUL byte near the start are
+// considered binary (and so are never searched)
+const std::size_t kBinaryCheckSize = 8000;
+
+const char kIndexMagic[] = "RSFIND01";
+
+// only compact once a significant number of files have been removed
+const std::size_t kMinCompactCount = 1000;
+
+// indexing leaves most cores free for R (and everything else)
+const unsigned int kMaxIndexingThreads = 4;
+
+uint32_t trigramAt(const char* data)
+{
+   uint32_t trigram = 0;
+   for (int i = 0; i < 3; i++)
+   {
+      unsigned char ch = static_cast<unsigned char>(data[i]);
+      if (ch >= 'A' && ch <= 'Z')
+         ch = static_cast<unsigned char>(ch - 'A' + 'a');
+      trigram = (trigram << 8) | ch;
+   }
+   return trigram;
+}
+
+bool isAsciiTrigram(uint32_t trigram)
+{
+   return (trigram & 0x808080) == 0;
+}
+
+bool isBinary(const std::string& contents)
+{
+   std::size_t size = std::min(contents.size(), kBinaryCheckSize);
+   return std::memchr(contents.data(), '\0', size) != nullptr;
+}
+
+// extract runs of literal characters which any match for a basic regular
+// expression must contain. this is deliberately conservative: anything
+// optional, grouped, or otherwise hard to reason about ends the current run
+bool regexLiterals(const std::string& pattern,
+                   std::vector<std::string>* pLiterals)
+{
+   std::string current;
+   int depth = 0;
+   std::size_t i = 0;
+   while (i < pattern.size())
+   {
+      bool literal = false;
+      char ch = pattern[i];
+      std::size_t next = i + 1;
+
+      if (ch == '\\')
+      {
+         if (next >= pattern.size())
+            return false;
+
+         char escaped = pattern[next++];
+         if (escaped == '|')
+         {
+            // alternation: nothing is required
+            return false;
+         }
+         else if (escaped == '(' || escaped == ')')
+         {
+            depth += (escaped == '(') ? 1 : -1;
+            pLiterals->push_back(current);
+            current.clear();
+            i = next;
+            continue;
+         }
+         else if (std::ispunct(static_cast<unsigned char>(escaped)) &&
+                  escaped != '<' && escaped != '>' &&
+                  escaped != '`' && escaped != '\'' &&
+                  escaped != '{' && escaped != '}' &&
+                  escaped != '?' && escaped != '+')
+         {
+            literal = true;
+            ch = escaped;
+         }
+      }
+      else if (ch == '[')
+      {
+         // skip the bracket expression (a leading ']' is part of the set)
+         std::size_t pos = next;
+         if (pos < pattern.size() && pattern[pos] == '^')
+            pos++;
+         if (pos < pattern.size() && pattern[pos] == ']')
+            pos++;
+         while (pos < pattern.size() && pattern[pos] != ']')
+         {
+            if (pattern[pos] == '[' && pos + 1 < pattern.size() &&
+                (pattern[pos + 1] == ':' || pattern[pos + 1] == '.' || pattern[pos + 1] == '='))
+            {
+               std::size_t end = pattern.find(std::string(1, pattern[pos + 1]) + "]", pos + 2);
+               if (end == std::string::npos)
+                  return false;
+               pos = end + 2;
+            }
+            else
+            {
+               pos++;
+            }
+         }
+         if (pos >= pattern.size())
+            return false;
+         next = pos + 1;
+      }
+      else if (ch != '.' && ch != '*' && ch != '^' && ch != '$')
+      {
+         literal = true;
+      }
+
+      // check for a quantifier following the atom
+      bool optional = false;
+      bool repeated = false;
+      if (next < pattern.size() && pattern[next] == '*')
+      {
+         optional = true;
+         next++;
+      }
+      else if (next + 1 < pattern.size() && pattern[next] == '\\')
+      {
+         char quantifier = pattern[next + 1];
+         if (quantifier == '?')
+         {
+            optional = true;
+            next += 2;
+         }
+         else if (quantifier == '+')
+         {
+            repeated = true;
+            next += 2;
+         }
+         else if (quantifier == '{')
+         {
+            std::size_t end = pattern.find("\\}", next + 2);
+            if (end == std::string::npos)
+               return false;
+            optional = true;
+            next = end + 2;
+         }
+      }
+
+      if (literal && !optional && depth == 0)
+         current.push_back(ch);
+
+      if (!literal || optional || repeated || depth > 0)
+      {
+         pLiterals->push_back(current);
+         current.clear();
+      }
+
+      i = next;
+   }
+
+   pLiterals->push_back(current);
+   return true;
+}
+
+void writeUInt(std::ostream& ostr, uint64_t value, std::size_t bytes)
+{
+   char buffer[8];
+   for (std::size_t i = 0; i < bytes; i++)
+      buffer[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+   ostr.write(buffer, bytes);
+}
+
+bool readUInt(std::istream& istr, std::size_t bytes, uint64_t* pValue)
+{
+   unsigned char buffer[8];
+   if (!istr.read(reinterpret_cast<char*>(buffer), bytes))
+      return false;
+
+   *pValue = 0;
+   for (std::size_t i = bytes; i > 0; i--)
+      *pValue = (*pValue << 8) | buffer[i - 1];
+   return true;
+}
+
+Error invalidIndexError(const FilePath& indexPath, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::illegal_byte_sequence,
+                             "Invalid find index",
+                             location);
+   error.addProperty("path", indexPath.getAbsolutePath());
+   return error;
+}
+
+} // anonymous namespace
+
+FindIndex::FindIndex()
+   : removedCount_(0)
+{
+}
+
+Error FindIndex::indexFile(const FileInfo& fileInfo)
+{
+   FileTrigrams fileTrigrams;
+   Error error = readTrigrams(fileInfo, &fileTrigrams);
+   if (error)
+      return error;
+
+   indexTrigrams(fileTrigrams);
+   return Success();
+}
+
+void FindIndex::indexContents(const FileInfo& fileInfo, const std::string& contents)
+{
+   FileTrigrams fileTrigrams;
+   extractTrigrams(fileInfo, contents, &fileTrigrams);
+   indexTrigrams(fileTrigrams);
+}
+
+void FindIndex::indexTrigrams(const FileTrigrams& fileTrigrams)
+{
+   removeFile(fileTrigrams.fileInfo.absolutePath());
+
+   // ids are assigned in increasing order, so posting lists remain sorted
+   uint32_t id = addFile(fileTrigrams.fileInfo, fileTrigrams.flags);
+   for (uint32_t trigram : fileTrigrams.trigrams)
+      postings_[trigram].push_back(id);
+}
+
+Error FindIndex::readTrigrams(const FileInfo& fileInfo, FileTrigrams* pFileTrigrams)
+{
+   FilePath filePath(fileInfo.absolutePath());
+
+   if (fileInfo.size() > kMaxIndexedFileSize)
+   {
+      // check whether it's binary without reading the whole file
+      std::shared_ptr<std::istream> pIfs;
+      Error error = filePath.openForRead(pIfs);
+      if (error)
+         return error;
+
+      std::string prefix(kBinaryCheckSize, '\0');
+      pIfs->read(&prefix[0], prefix.size());
+      prefix.resize(static_cast<std::size_t>(pIfs->gcount()));
+
+      pFileTrigrams->fileInfo = fileInfo;
+      pFileTrigrams->flags = isBinary(prefix) ? FileBinary : FileTooLarge;
+      pFileTrigrams->trigrams.clear();
+      return Success();
+   }
+
+   std::string contents;
+   Error error = readStringFromFile(filePath, &contents);
+   if (error)
+      return error;
+
+   extractTrigrams(fileInfo, contents, pFileTrigrams);
+   return Success();
+}
+
+void FindIndex::extractTrigrams(const FileInfo& fileInfo,
+                                const std::string& contents,
+                                FileTrigrams* pFileTrigrams)
+{
+   pFileTrigrams->fileInfo = fileInfo;
+   pFileTrigrams->trigrams.clear();
+
+   if (isBinary(contents))
+   {
+      pFileTrigrams->flags = FileBinary;
+      return;
+   }
+
+   pFileTrigrams->flags = FileIndexed;
+
+   std::vector<uint32_t>& trigrams = pFileTrigrams->trigrams;
+   if (contents.size() >= 3)
+   {
+      trigrams.reserve(contents.size() - 2);
+      for (std::size_t i = 0; i + 3 <= contents.size(); i++)
+         trigrams.push_back(trigramAt(contents.data() + i));
+      std::sort(trigrams.begin(), trigrams.end());
+      trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+   }
+}
+
+void FindIndex::removeFile(const std::string& absolutePath)
+{
+   auto it = ids_.find(absolutePath);
+   if (it != ids_.end())
+   {
+      uint32_t id = it->second;
+      ids_.erase(it);
+      removeFileId(id);
+   }
+   else
+   {
+      // the path may be a directory
+      std::string prefix = absolutePath + "/";
+      for (auto idIt = ids_.begin(); idIt != ids_.end(); )
+      {
+         if (boost::algorithm::starts_with(idIt->first, prefix))
+         {
+            removeFileId(idIt->second);
+            idIt = ids_.erase(idIt);
+         }
+         else
+         {
+            ++idIt;
+         }
+      }
+   }
+
+   compactIfNecessary();
+}
+
+bool FindIndex::isIndexed(const std::string& absolutePath) const
+{
+   return ids_.count(absolutePath) != 0;
+}
+
+bool FindIndex::isIndexed(const FileInfo& fileInfo) const
+{
+   auto it = ids_.find(fileInfo.absolutePath());
+   if (it == ids_.end())
+      return false;
+
+   const File& file = files_[it->second];
+   return file.lastWriteTime == fileInfo.lastWriteTime() &&
+          file.size == fileInfo.size();
+}
+
+void FindIndex::listFiles(std::vector<std::string>* pPaths) const
+{
+   for (const auto& entry : ids_)
+      pPaths->push_back(entry.first);
+}
+
+bool FindIndex::requiredLiterals(const std::string& pattern,
+                                 bool asRegex,
+                                 std::vector<std::string>* pLiterals)
+{
+   // each line of the pattern is a separate pattern
+   if (pattern.find('\n') != std::string::npos)
+      return false;
+
+   if (asRegex)
+      return regexLiterals(pattern, pLiterals);
+
+   pLiterals->push_back(pattern);
+   return true;
+}
+
+bool FindIndex::queryTrigrams(const std::string& pattern,
+                              bool asRegex,
+                              bool ignoreCase,
+                              std::vector<uint32_t>* pTrigrams)
+{
+   std::vector<std::string> literals;
+   if (!requiredLiterals(pattern, asRegex, &literals))
+      return false;
+
+   for (const std::string& literal : literals)
+   {
+      for (std::size_t i = 0; i + 3 <= literal.size(); i++)
+      {
+         // case-insensitive matching of non-ASCII characters isn't
+         // reflected in the index, so such trigrams can't be used
+         uint32_t trigram = trigramAt(literal.data() + i);
+         if (ignoreCase && !isAsciiTrigram(trigram))
+            continue;
+         pTrigrams->push_back(trigram);
+      }
+   }
+
+   std::sort(pTrigrams->begin(), pTrigrams->end());
+   pTrigrams->erase(std::unique(pTrigrams->begin(), pTrigrams->end()), pTrigrams->end());
+   return !pTrigrams->empty();
+}
+
+void FindIndex::candidates(const std::vector<uint32_t>& trigrams,
+                           std::set<std::string>* pPaths) const
+{
+   // files too large to index may always match
+   for (const File& file : files_)
+   {
+      if (file.flags == FileTooLarge)
+         pPaths->insert(file.path);
+   }
+
+   // intersect posting lists, starting with the shortest
+   std::vector<const std::vector<uint32_t>*> lists;
+   for (uint32_t trigram : trigrams)
+   {
+      auto it = postings_.find(trigram);
+      if (it == postings_.end())
+         return;
+      lists.push_back(&it->second);
+   }
+
+   if (lists.empty())
+      return;
+
+   std::sort(lists.begin(), lists.end(),
+             [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b)
+   {
+      return a->size() < b->size();
+   });
+
+   std::vector<uint32_t> matches = *lists[0];
+   std::vector<uint32_t> intersection;
+   for (std::size_t i = 1; i < lists.size() && !matches.empty(); i++)
+   {
+      intersection.clear();
+      std::set_intersection(matches.begin(), matches.end(),
+                            lists[i]->begin(), lists[i]->end(),
+                            std::back_inserter(intersection));
+      matches.swap(intersection);
+   }
+
+   for (uint32_t id : matches)
+   {
+      if (files_[id].flags == FileIndexed)
+         pPaths->insert(files_[id].path);
+   }
+}
+
+Error FindIndex::read(const FilePath& indexPath)
+{
+   clear();
+
+   std::shared_ptr<std::istream> pIfs;
+   Error error = indexPath.openForRead(pIfs);
+   if (error)
+      return error;
+
+   std::istream& istr = *pIfs;
+   char magic[sizeof(kIndexMagic) - 1];
+   if (!istr.read(magic, sizeof(magic)) ||
+       std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0)
+   {
+      return invalidIndexError(indexPath, ERROR_LOCATION);
+   }
+
+   uint64_t fileCount;
+   if (!readUInt(istr, 4, &fileCount))
+      return invalidIndexError(indexPath, ERROR_LOCATION);
+
+   for (uint64_t i = 0; i < fileCount; i++)
+   {
+      uint64_t pathSize, lastWriteTime, size, flags;
+      if (!readUInt(istr, 4, &pathSize) || pathSize > 64 * 1024)
+      {
+         clear();
+         return invalidIndexError(indexPath, ERROR_LOCATION);
+      }
+
+      std::string path(static_cast<std::size_t>(pathSize), '\0');
+      if (!istr.read(&path[0], path.size()) ||
+          !readUInt(istr, 8, &lastWriteTime) ||
+          !readUInt(istr, 8, &size) ||
+          !readUInt(istr, 1, &flags) ||
+          flags > FileTooLarge)
+      {
+         clear();
+         return invalidIndexError(indexPath, ERROR_LOCATION);
+      }
+
+      FileInfo fileInfo(path,
+                        false,
+                        static_cast<uintmax_t>(size),
+                        static_cast<std::time_t>(lastWriteTime),
+                        false);
+      addFile(fileInfo, static_cast<uint8_t>(flags));
+   }
+
+   uint64_t trigramCount;
+   if (!readUInt(istr, 4, &trigramCount))
+   {
+      clear();
+      return invalidIndexError(indexPath, ERROR_LOCATION);
+   }
+
+   for (uint64_t i = 0; i < trigramCount; i++)
+   {
+      uint64_t trigram, idCount;
+      if (!readUInt(istr, 4, &trigram) ||
+          !readUInt(istr, 4, &idCount) ||
+          idCount > fileCount)
+      {
+         clear();
+         return invalidIndexError(indexPath, ERROR_LOCATION);
+      }
+
+      std::vector<uint32_t>& ids = postings_[static_cast<uint32_t>(trigram)];
+      ids.reserve(static_cast<std::size_t>(idCount));
+      for (uint64_t j = 0; j < idCount; j++)
+      {
+         uint64_t id;
+         if (!readUInt(istr, 4, &id) ||
+             id >= fileCount ||
+             (!ids.empty() && id <= ids.back()))
+         {
+            clear();
+            return invalidIndexError(indexPath, ERROR_LOCATION);
+         }
+         ids.push_back(static_cast<uint32_t>(id));
+      }
+   }
+
+   return Success();
+}
+
+Error FindIndex::write(const FilePath& indexPath)
+{
+   // removed files needn't be written
+   compact();
+
+   std::shared_ptr<std::ostream> pOfs;
+   Error error = indexPath.openForWrite(pOfs);
+   if (error)
+      return error;
+
+   std::ostream& ostr = *pOfs;
+   ostr.write(kIndexMagic, sizeof(kIndexMagic) - 1);
+
+   writeUInt(ostr, files_.size(), 4);
+   for (const File& file : files_)
+   {
+      writeUInt(ostr, file.path.size(), 4);
+      ostr.write(file.path.data(), file.path.size());
+      writeUInt(ostr, static_cast<uint64_t>(file.lastWriteTime), 8);
+      writeUInt(ostr, file.size, 8);
+      writeUInt(ostr, file.flags, 1);
+   }
+
+   writeUInt(ostr, postings_.size(), 4);
+   for (const auto& posting : postings_)
+   {
+      writeUInt(ostr, posting.first, 4);
+      writeUInt(ostr, posting.second.size(), 4);
+      for (uint32_t id : posting.second)
+         writeUInt(ostr, id, 4);
+   }
+
+   ostr.flush();
+   if (ostr.fail())
+   {
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", indexPath.getAbsolutePath());
+      return error;
+   }
+
+   return Success();
+}
+
+void FindIndex::clear()
+{
+   files_.clear();
+   ids_.clear();
+   postings_.clear();
+   removedCount_ = 0;
+}
+
+uint32_t FindIndex::addFile(const FileInfo& fileInfo, uint8_t flags)
+{
+   uint32_t id = static_cast<uint32_t>(files_.size());
+
+   File file;
+   file.path = fileInfo.absolutePath();
+   file.lastWriteTime = fileInfo.lastWriteTime();
+   file.size = fileInfo.size();
+   file.flags = flags;
+   files_.push_back(file);
+
+   ids_[file.path] = id;
+   return id;
+}
+
+void FindIndex::removeFileId(uint32_t id)
+{
+   // postings which refer to the file are dropped when compacting
+   files_[id].flags = FileRemoved;
+   files_[id].path.clear();
+   removedCount_++;
+}
+
+void FindIndex::compactIfNecessary()
+{
+   if (removedCount_ >= kMinCompactCount && removedCount_ > files_.size() / 2)
+      compact();
+}
+
+void FindIndex::compact()
+{
+   if (removedCount_ == 0)
+      return;
+
+   // assign new ids in the same order, so posting lists remain sorted
+   const uint32_t kRemoved = static_cast<uint32_t>(-1);
+   std::vector<uint32_t> newIds(files_.size(), kRemoved);
+   std::vector<File> files;
+   files.reserve(files_.size() - removedCount_);
+   for (std::size_t i = 0; i < files_.size(); i++)
+   {
+      if (files_[i].flags == FileRemoved)
+         continue;
+
+      newIds[i] = static_cast<uint32_t>(files.size());
+      files.push_back(files_[i]);
+   }
+
+   for (auto it = postings_.begin(); it != postings_.end(); )
+   {
+      std::vector<uint32_t> ids;
+      for (uint32_t id : it->second)
+      {
+         if (newIds[id] != kRemoved)
+            ids.push_back(newIds[id]);
+      }
+
+      if (ids.empty())
+      {
+         it = postings_.erase(it);
+      }
+      else
+      {
+         it->second.swap(ids);
+         ++it;
+      }
+   }
+
+   files_.swap(files);
+   for (auto& entry : ids_)
+      entry.second = newIds[entry.second];
+   removedCount_ = 0;
+}
+
+boost::shared_ptr<FindIndexer> FindIndexer::create()
+{
+   return boost::shared_ptr<FindIndexer>(new FindIndexer());
+}
+
+FindIndexer::FindIndexer()
+   : threads_(0),
+     stopped_(false)
+{
+   maxThreads_ = boost::thread::hardware_concurrency() / 2;
+   maxThreads_ = std::max(1u, std::min(maxThreads_, kMaxIndexingThreads));
+}
+
+void FindIndexer::enqueue(const Job& job)
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   if (stopped_)
+      return;
+
+   jobs_.push_back(job);
+
+   // start another thread if all of those running are busy
+   if (threads_ < maxThreads_ && threads_ < jobs_.size())
+   {
+      threads_++;
+      core::thread::safeLaunchThread(
+               boost::bind(&FindIndexer::indexFiles, shared_from_this()));
+   }
+}
+
+void FindIndexer::takeResults(std::vector<Result>* pResults)
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   pResults->clear();
+   pResults->swap(results_);
+}
+
+void FindIndexer::stop()
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   stopped_ = true;
+   jobs_.clear();
+   results_.clear();
+}
+
+void FindIndexer::indexFiles()
+{
+   try
+   {
+      for (;;)
+      {
+         Job job;
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            if (stopped_ || jobs_.empty())
+            {
+               threads_--;
+               break;
+            }
+
+            job = jobs_.front();
+            jobs_.pop_front();
+         }
+
+         Result result;
+         result.id = job.id;
+         result.error = FindIndex::readTrigrams(job.fileInfo, &result.fileTrigrams);
+
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         if (!stopped_)
+            results_.push_back(result);
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,204 @@
+/*
+ * SessionFindIndex.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_FIND_INDEX_HPP
+#define SESSION_FIND_INDEX_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+
+#include <core/FileInfo.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+
+// Trigram index of file contents used to narrow find-in-files searches to
+// the files which could possibly match. For each (ASCII lower-cased) run of
+// three bytes we keep a posting list of the files containing it; a search
+// need then only be run against files containing every trigram which any
+// match must contain.
+//
+// Files which look binary are recorded but never returned as candidates
+// (grep skips them); files too large to index are always returned.
+class FindIndex : boost::noncopyable
+{
+public:
+   // what the index records of a file's contents; these are computed by
+   // static functions, so may be read (from any thread) ahead of being added
+   // to an index
+   struct FileTrigrams
+   {
+      FileTrigrams() : flags(0) {}
+
+      core::FileInfo fileInfo;
+      uint8_t flags;
+
+      // sorted and unique
+      std::vector<uint32_t> trigrams;
+   };
+
+   FindIndex();
+
+   // index (or re-index) the file, reading its contents from disk
+   core::Error indexFile(const core::FileInfo& fileInfo);
+
+   // index (or re-index) the given contents
+   void indexContents(const core::FileInfo& fileInfo, const std::string& contents);
+
+   // index (or re-index) a file from its trigrams
+   void indexTrigrams(const FileTrigrams& fileTrigrams);
+
+   static core::Error readTrigrams(const core::FileInfo& fileInfo,
+                                   FileTrigrams* pFileTrigrams);
+
+   static void extractTrigrams(const core::FileInfo& fileInfo,
+                               const std::string& contents,
+                               FileTrigrams* pFileTrigrams);
+
+   // remove a file (or all files within a directory)
+   void removeFile(const std::string& absolutePath);
+
+   // is there an entry for this file (and, if a write time and size are
+   // given, does it reflect them)
+   bool isIndexed(const std::string& absolutePath) const;
+   bool isIndexed(const core::FileInfo& fileInfo) const;
+
+   // all indexed file paths
+   void listFiles(std::vector<std::string>* pPaths) const;
+
+   std::size_t fileCount() const { return ids_.size(); }
+
+   // runs of literal text which any match for the pattern (a basic regular
+   // expression as understood by grep, or a fixed string) must contain.
+   // returns false if these can't be determined
+   static bool requiredLiterals(const std::string& pattern,
+                                bool asRegex,
+                                std::vector<std::string>* pLiterals);
+
+   // compute the trigrams which any match for the pattern (a basic regular
+   // expression as understood by grep, or a fixed string) must contain.
+   // returns false if there are none, in which case the index can't help
+   static bool queryTrigrams(const std::string& pattern,
+                             bool asRegex,
+                             bool ignoreCase,
+                             std::vector<uint32_t>* pTrigrams);
+
+   // indexed files which contain all of the trigrams (along with indexed
+   // files which were too large to index)
+   void candidates(const std::vector<uint32_t>& trigrams,
+                   std::set<std::string>* pPaths) const;
+
+   core::Error read(const core::FilePath& indexPath);
+   core::Error write(const core::FilePath& indexPath);
+
+   void clear();
+
+private:
+   enum FileFlags
+   {
+      FileIndexed = 0,
+      FileBinary = 1,
+      FileTooLarge = 2,
+      FileRemoved = 4
+   };
+
+   struct File
+   {
+      std::string path;
+      std::time_t lastWriteTime;
+      uintmax_t size;
+      uint8_t flags;
+   };
+
+   uint32_t addFile(const core::FileInfo& fileInfo, uint8_t flags);
+   void removeFileId(uint32_t id);
+   void compactIfNecessary();
+   void compact();
+
+   std::vector<File> files_;
+   std::unordered_map<std::string, uint32_t> ids_;
+   std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;
+   std::size_t removedCount_;
+};
+
+// Reads files and extracts their trigrams on a pool of background threads
+// (which run only while there are jobs queued), so that the index itself
+// need only be updated by the caller, on the main thread.
+class FindIndexer : public boost::enable_shared_from_this<FindIndexer>,
+                    boost::noncopyable
+{
+public:
+   struct Job
+   {
+      Job() : id(0) {}
+
+      // identifies the job to the caller
+      uint64_t id;
+
+      core::FileInfo fileInfo;
+   };
+
+   struct Result
+   {
+      Result() : id(0) {}
+
+      uint64_t id;
+      core::Error error;
+      FindIndex::FileTrigrams fileTrigrams;
+   };
+
+   static boost::shared_ptr<FindIndexer> create();
+
+   void enqueue(const Job& job);
+
+   void takeResults(std::vector<Result>* pResults);
+
+   // stop indexing (jobs not yet started are discarded)
+   void stop();
+
+private:
+   FindIndexer();
+
+   void indexFiles();
+
+   boost::mutex mutex_;
+   std::deque<Job> jobs_;
+   std::vector<Result> results_;
+   unsigned int maxThreads_;
+   unsigned int threads_;
+   bool stopped_;
+};
+
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_FIND_INDEX_HPP
@@ -14,7 +14,13 @@
  */
 
 #include "SessionFind.hpp"
+#include "SessionFindEngine.hpp"
+#include "SessionFindIndex.hpp"
 
+#include <boost/thread/thread.hpp>
+
+#include <core/FileInfo.hpp>
+#include <core/FileSerializer.hpp>
 #include <core/system/ShellUtils.hpp>
 
 #define RSTUDIO_NO_TESTTHAT_ALIASES
@@ -47,6 +53,28 @@ const std::string kReplaceRegex("\\1\\2\\1\\2");
 
 const std::string kGrepPattern("aba \033[01m\033[KOOOkkk\033[m\033[K okab AAOO awesome aa abab");
 const std::string kGitGrepPattern("aba \033[1;31mOOOkkk\033[m okab AAOO awesome aa abab");
+
+void writeTestFile(const FilePath& dir, const std::string& name, const std::string& contents)
+{
+   FilePath filePath = dir.completeChildPath(name);
+   REQUIRE_FALSE(filePath.getParent().ensureDirectory());
+   REQUIRE_FALSE(writeStringToFile(filePath, contents));
+}
+
+std::vector<FindEngine::LineMatch> runSearch(const FindEngine::Options& options,
+                                             const FilePath& dir)
+{
+   boost::shared_ptr<FindEngine> pEngine;
+   Error error = FindEngine::create(options, &pEngine);
+   REQUIRE_FALSE(error);
+
+   std::vector<FindEngine::LineMatch> matches;
+   pEngine->start(std::vector<FilePath>(1, dir));
+   while (!pEngine->takeMatches(&matches))
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+   return matches;
+}
+
 } // anonymous namespace
 
 TEST_CASE("SessionFind")
@@ -248,6 +276,210 @@ TEST_CASE("SessionFind")
 
 }
 
+TEST_CASE("SessionFindIndex")
+{
+   FindIndex index;
+   index.indexContents(FileInfo("/project/a.R", false, 0, 0), "foo <- function(x) x + 1\n");
+   index.indexContents(FileInfo("/project/b.R", false, 0, 0), "bar <- FUNCTION(y) y * 2\n");
+   index.indexContents(FileInfo("/project/c.rds", false, 0, 0), std::string("fun\0ction", 9));
+
+   SECTION("Literal search finds candidate files")
+   {
+      std::vector<uint32_t> trigrams;
+      REQUIRE(FindIndex::queryTrigrams("function", false, false, &trigrams));
+
+      std::set<std::string> files;
+      index.candidates(trigrams, &files);
+      CHECK(files.size() == 2);
+      CHECK(files.count("/project/a.R"));
+      CHECK(files.count("/project/b.R"));
+
+      trigrams.clear();
+      files.clear();
+      REQUIRE(FindIndex::queryTrigrams("foo <-", false, false, &trigrams));
+      index.candidates(trigrams, &files);
+      CHECK(files.size() == 1);
+      CHECK(files.count("/project/a.R"));
+   }
+
+   SECTION("Required literals are extracted from regular expressions")
+   {
+      std::vector<uint32_t> trigrams;
+      std::set<std::string> files;
+      REQUIRE(FindIndex::queryTrigrams("bar.*FUNC\\(TION\\)\\?", true, false, &trigrams));
+      index.candidates(trigrams, &files);
+      CHECK(files.size() == 1);
+      CHECK(files.count("/project/b.R"));
+
+      // nothing is required of alternatives or short literals
+      trigrams.clear();
+      CHECK_FALSE(FindIndex::queryTrigrams("foo\\|bar", true, false, &trigrams));
+      CHECK_FALSE(FindIndex::queryTrigrams("fo*[a-z]x", true, false, &trigrams));
+      CHECK_FALSE(FindIndex::queryTrigrams("fo", false, false, &trigrams));
+   }
+
+   SECTION("Removed and re-indexed files are reflected")
+   {
+      index.removeFile("/project/a.R");
+      index.indexContents(FileInfo("/project/b.R", false, 0, 0), "baz <- 1\n");
+
+      std::vector<uint32_t> trigrams;
+      std::set<std::string> files;
+      REQUIRE(FindIndex::queryTrigrams("function", false, true, &trigrams));
+      index.candidates(trigrams, &files);
+      CHECK(files.empty());
+      CHECK(index.isIndexed("/project/b.R"));
+      CHECK_FALSE(index.isIndexed("/project/a.R"));
+   }
+
+   SECTION("Index is written and read")
+   {
+      FilePath indexPath;
+      REQUIRE_FALSE(FilePath::tempFilePath(indexPath));
+      REQUIRE_FALSE(index.write(indexPath));
+
+      FindIndex readIndex;
+      REQUIRE_FALSE(readIndex.read(indexPath));
+      CHECK(readIndex.fileCount() == 3);
+
+      std::vector<uint32_t> trigrams;
+      std::set<std::string> files;
+      REQUIRE(FindIndex::queryTrigrams("function", false, false, &trigrams));
+      readIndex.candidates(trigrams, &files);
+      CHECK(files.size() == 2);
+
+      indexPath.removeIfExists();
+   }
+
+   SECTION("Files are read in the background and indexed as collected")
+   {
+      FilePath dir;
+      REQUIRE_FALSE(FilePath::tempFilePath(dir));
+      writeTestFile(dir, "d.R", "qux <- function() NULL\n");
+
+      FileInfo fileInfo(dir.completeChildPath("d.R"));
+      FindIndexer::Job job;
+      job.id = 1;
+      job.fileInfo = fileInfo;
+
+      boost::shared_ptr<FindIndexer> pIndexer = FindIndexer::create();
+      pIndexer->enqueue(job);
+      job.id = 2;
+      job.fileInfo = FileInfo(dir.completeChildPath("missing.R"));
+      pIndexer->enqueue(job);
+
+      std::vector<FindIndexer::Result> results;
+      for (int i = 0; i < 500 && results.size() < 2; i++)
+      {
+         std::vector<FindIndexer::Result> taken;
+         pIndexer->takeResults(&taken);
+         results.insert(results.end(), taken.begin(), taken.end());
+         boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      }
+      REQUIRE(results.size() == 2);
+
+      for (const FindIndexer::Result& result : results)
+      {
+         CHECK(static_cast<bool>(result.error) == (result.id == 2));
+         if (!result.error)
+            index.indexTrigrams(result.fileTrigrams);
+      }
+
+      std::vector<uint32_t> trigrams;
+      std::set<std::string> files;
+      REQUIRE(FindIndex::queryTrigrams("qux <-", false, false, &trigrams));
+      index.candidates(trigrams, &files);
+      REQUIRE(files.size() == 1);
+      CHECK(files.count(fileInfo.absolutePath()));
+
+      dir.removeIfExists();
+   }
+}
+
+TEST_CASE("SessionFindEngine")
+{
+   FilePath dir;
+   REQUIRE_FALSE(FilePath::tempFilePath(dir));
+   writeTestFile(dir, "a.R", "x <- 1\nfoo(bar)\r\nFoo(foo)\n");
+   writeTestFile(dir, "b.txt", "foo");
+   writeTestFile(dir, "c.rds", std::string("foo\0bar\n", 8));
+   writeTestFile(dir, "sub/d.R", "y <- 2\n\nbarfoo\n");
+
+   SECTION("Literal search finds matches in file order")
+   {
+      FindEngine::Options options;
+      options.pattern = "foo";
+      std::vector<FindEngine::LineMatch> matches = runSearch(options, dir);
+      REQUIRE(matches.size() == 4);
+
+      CHECK(matches[0].file == dir.completeChildPath("a.R").getAbsolutePath());
+      CHECK(matches[0].lineNum == 2);
+      CHECK(matches[0].contents == "foo(bar)\r");
+      REQUIRE(matches[0].matches.size() == 1);
+      CHECK(matches[0].matches[0].first == 0);
+      CHECK(matches[0].matches[0].second == 3);
+
+      CHECK(matches[1].lineNum == 3);
+      REQUIRE(matches[1].matches.size() == 1);
+      CHECK(matches[1].matches[0].first == 4);
+
+      CHECK(matches[2].file == dir.completeChildPath("b.txt").getAbsolutePath());
+      CHECK(matches[2].lineNum == 1);
+
+      CHECK(matches[3].file == dir.completeChildPath("sub/d.R").getAbsolutePath());
+      CHECK(matches[3].lineNum == 3);
+   }
+
+   SECTION("Regular expressions ignoring case")
+   {
+      FindEngine::Options options;
+      options.pattern = "f\\(o\\)\\1(";
+      options.asRegex = true;
+      options.ignoreCase = true;
+      std::vector<FindEngine::LineMatch> matches = runSearch(options, dir);
+      REQUIRE(matches.size() == 2);
+      CHECK(matches[1].contents == "Foo(foo)");
+      REQUIRE(matches[1].matches.size() == 1);
+      CHECK(matches[1].matches[0].second == 4);
+   }
+
+   SECTION("Include and exclude globs are applied")
+   {
+      FindEngine::Options options;
+      options.pattern = "foo";
+      options.includeGlobs.push_back("*.R");
+      options.excludeGlobs.push_back("[d-z].R");
+      std::vector<FindEngine::LineMatch> matches = runSearch(options, dir);
+      REQUIRE(matches.size() == 2);
+      CHECK(matches[0].file == dir.completeChildPath("a.R").getAbsolutePath());
+      CHECK(matches[1].file == dir.completeChildPath("a.R").getAbsolutePath());
+   }
+
+   SECTION("Skipped files and the match limit are respected")
+   {
+      std::string skipPath = dir.completeChildPath("a.R").getAbsolutePath();
+
+      FindEngine::Options options;
+      options.pattern = "foo";
+      options.skipFile = [=](const std::string& path) { return path == skipPath; };
+      options.maxMatches = 1;
+      std::vector<FindEngine::LineMatch> matches = runSearch(options, dir);
+      REQUIRE(matches.size() == 1);
+      CHECK(matches[0].file == dir.completeChildPath("b.txt").getAbsolutePath());
+   }
+
+   SECTION("Invalid regular expressions are reported")
+   {
+      FindEngine::Options options;
+      options.pattern = "foo\\(";
+      options.asRegex = true;
+      boost::shared_ptr<FindEngine> pEngine;
+      CHECK(FindEngine::create(options, &pEngine));
+   }
+
+   dir.removeIfExists();
+}
+
 } // end namespace tests
 } // end namespace modules
 } // end namespace find
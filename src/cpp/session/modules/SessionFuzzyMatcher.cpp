@@ -0,0 +1,228 @@
+/*
+ * SessionFuzzyMatcher.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFuzzyMatcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+namespace {
+
+// candidates are scored across threads only when there are enough of them
+// to outweigh the cost of starting the threads
+const std::size_t kParallelThreshold = 20000;
+
+const unsigned int kMaxThreads = 8;
+
+// (score, index) pairs order by score, then by candidate order
+typedef std::pair<int, int> ScoreIndex;
+
+// the position of ch within data at or after pos (or -1 if none); memchr
+// scans a word (or vector register) at a time
+int findChar(const char* data, int size, int pos, char ch)
+{
+   if (pos >= size)
+      return -1;
+   const void* found = std::memchr(data + pos, ch, size - pos);
+   return found ? static_cast<int>(static_cast<const char*>(found) - data) : -1;
+}
+
+} // anonymous namespace
+
+FuzzyMatcher::FuzzyMatcher(const std::string& query, bool isFile)
+   : query_(query),
+     lowerQuery_(boost::algorithm::to_lower_copy(query)),
+     isFile_(isFile)
+{
+}
+
+bool FuzzyMatcher::matchesLowerCase(const std::string& lowerCandidate,
+                                    std::string::size_type queryEnd) const
+{
+   std::size_t queryLength = std::min(queryEnd, lowerQuery_.size());
+   if (queryLength > lowerCandidate.size())
+      return false;
+
+   const char* data = lowerCandidate.data();
+   int size = static_cast<int>(lowerCandidate.size());
+   int pos = 0;
+   for (std::size_t i = 0; i < queryLength; i++)
+   {
+      int index = findChar(data, size, pos, lowerQuery_[i]);
+      if (index == -1)
+         return false;
+      pos = index + 1;
+   }
+   return true;
+}
+
+// NOTE: When modifying this code, you should ensure that corresponding
+// changes are made to the client side scoreMatch function as well
+// (See: CodeSearchOracle.java)
+int FuzzyMatcher::score(const std::string& candidate) const
+{
+   // No penalty for perfect matches
+   if (candidate == query_)
+      return 0;
+
+   // More penalty for 'uninteresting' files and extensions (e.g. .Rd),
+   // charged for each matched character
+   int extraPenalty = 0;
+   if (candidate == "RcppExports.R" || candidate == "RcppExports.cpp")
+      extraPenalty += 6;
+   std::size_t lastDot = candidate.rfind('.');
+   if (lastDot != std::string::npos &&
+       boost::algorithm::iequals(candidate.c_str() + lastDot, ".rd"))
+   {
+      extraPenalty += 6;
+   }
+
+   const char* data = candidate.data();
+   int size = static_cast<int>(candidate.size());
+   int querySize = static_cast<int>(query_.size());
+
+   // match each character of the query in turn (characters which can't be
+   // matched are skipped, and penalized below)
+   int totalPenalty = 0;
+   int matchCount = 0;
+   int pos = 0;
+   for (int i = 0; i < querySize; i++)
+   {
+      int matchPos = findChar(data, size, pos, query_[i]);
+      if (matchPos == -1)
+         continue;
+      pos = matchPos + 1;
+
+      int penalty = matchPos;
+
+      // Less penalty if character follows special delim
+      if (matchPos >= 1)
+      {
+         char prevChar = data[matchPos - 1];
+         if (prevChar == '_' || prevChar == '-' || (!isFile_ && prevChar == '.'))
+            penalty = matchCount + 1;
+      }
+
+      // Less penalty for perfect match (ie, reward case-sensitive match)
+      penalty -= data[matchPos] == query_[matchCount];
+
+      totalPenalty += penalty + extraPenalty;
+      matchCount++;
+   }
+
+   // Penalize files
+   if (isFile_)
+      ++totalPenalty;
+
+   // Penalize unmatched characters
+   totalPenalty += (querySize - matchCount) * querySize;
+
+   return totalPenalty;
+}
+
+void FuzzyMatcher::bestMatches(const std::vector<std::string>& candidates,
+                               std::size_t maxMatches,
+                               std::vector<std::pair<int, int> >* pMatches) const
+{
+   pMatches->clear();
+   if (maxMatches == 0 || candidates.empty())
+      return;
+
+   unsigned int threads = std::min(boost::thread::hardware_concurrency(), kMaxThreads);
+   threads = std::min<std::size_t>(threads, candidates.size() / kParallelThreshold);
+   if (threads <= 1)
+   {
+      bestMatches(candidates, 0, candidates.size(), maxMatches, pMatches);
+      return;
+   }
+
+   // score a slice of the candidates on each thread, then merge the best of
+   // each slice
+   std::vector<std::vector<std::pair<int, int> > > threadMatches(threads);
+   boost::thread_group group;
+   std::size_t sliceSize = (candidates.size() + threads - 1) / threads;
+   for (unsigned int i = 0; i < threads; i++)
+   {
+      std::size_t begin = i * sliceSize;
+      std::size_t end = std::min(begin + sliceSize, candidates.size());
+      void (FuzzyMatcher::*pBestMatches)(const std::vector<std::string>&,
+                                         std::size_t,
+                                         std::size_t,
+                                         std::size_t,
+                                         std::vector<std::pair<int, int> >*) const =
+            &FuzzyMatcher::bestMatches;
+      group.create_thread(boost::bind(pBestMatches, this, boost::cref(candidates),
+                                      begin, end, maxMatches, &threadMatches[i]));
+   }
+   group.join_all();
+
+   // slices are in candidate order, so ties are still broken by index
+   std::vector<ScoreIndex> merged;
+   for (const std::vector<std::pair<int, int> >& matches : threadMatches)
+   {
+      for (const std::pair<int, int>& match : matches)
+         merged.push_back(ScoreIndex(match.second, match.first));
+   }
+
+   std::size_t count = std::min(maxMatches, merged.size());
+   std::partial_sort(merged.begin(), merged.begin() + count, merged.end());
+   for (std::size_t i = 0; i < count; i++)
+      pMatches->push_back(std::make_pair(merged[i].second, merged[i].first));
+}
+
+void FuzzyMatcher::bestMatches(const std::vector<std::string>& candidates,
+                               std::size_t begin,
+                               std::size_t end,
+                               std::size_t maxMatches,
+                               std::vector<std::pair<int, int> >* pMatches) const
+{
+   // keep the best matches in a max-heap, so the worst of them is the one
+   // displaced by a better match
+   std::priority_queue<ScoreIndex> best;
+   for (std::size_t i = begin; i < end; i++)
+   {
+      ScoreIndex scoreIndex(score(candidates[i]), static_cast<int>(i));
+      if (best.size() < maxMatches)
+         best.push(scoreIndex);
+      else if (scoreIndex < best.top())
+      {
+         best.pop();
+         best.push(scoreIndex);
+      }
+   }
+
+   pMatches->resize(best.size());
+   for (std::size_t i = best.size(); i > 0; i--)
+   {
+      (*pMatches)[i - 1] = std::make_pair(best.top().second, best.top().first);
+      best.pop();
+   }
+}
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,70 @@
+/*
+ * SessionFuzzyMatcher.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_FUZZY_MATCHER_HPP
+#define SESSION_FUZZY_MATCHER_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+// Fuzzy (subsequence) matching and scoring of names against a query, as used
+// by "Go to file/function". The query is prepared once, so that matching and
+// scoring each candidate allocates nothing; scores are identical to those
+// computed by the client (see CodeSearchOracle.java).
+class FuzzyMatcher
+{
+public:
+   // isFile selects the file scoring rules (files are penalized slightly,
+   // and '.' doesn't count as a word delimiter within file names)
+   FuzzyMatcher(const std::string& query, bool isFile);
+
+   // is the (lower-cased) query, up to queryEnd, a subsequence of the
+   // already lower-cased candidate
+   bool matchesLowerCase(const std::string& lowerCandidate,
+                         std::string::size_type queryEnd = std::string::npos) const;
+
+   // score a candidate (lower is better)
+   int score(const std::string& candidate) const;
+
+   // score the candidates, keeping only the best (at most maxMatches) as
+   // (index, score) pairs sorted by score; ties keep candidate order
+   void bestMatches(const std::vector<std::string>& candidates,
+                    std::size_t maxMatches,
+                    std::vector<std::pair<int, int> >* pMatches) const;
+
+private:
+   void bestMatches(const std::vector<std::string>& candidates,
+                    std::size_t begin,
+                    std::size_t end,
+                    std::size_t maxMatches,
+                    std::vector<std::pair<int, int> >* pMatches) const;
+
+   std::string query_;
+   std::string lowerQuery_;
+   bool isFile_;
+};
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_FUZZY_MATCHER_HPP
@@ -0,0 +1,185 @@
+/*
+ * SessionFuzzyMatcherTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFuzzyMatcher.hpp"
+
+#include <algorithm>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
+#include <core/StringUtils.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+// the scoring previously used by code search (one allocation per
+// candidate, plus two per matched character), kept for comparison
+int referenceScore(std::string const& suggestion,
+                   std::string const& query,
+                   bool isFile)
+{
+   if (suggestion == query)
+      return 0;
+
+   std::vector<int> matches =
+         string_utils::subsequenceIndices(suggestion, query);
+
+   int totalPenalty = 0;
+   for (int j = 0, n = static_cast<int>(matches.size()); j < n; j++)
+   {
+      int matchPos = matches[j];
+      int penalty = matchPos;
+
+      if (matchPos >= 1)
+      {
+         char prevChar = suggestion[matchPos - 1];
+         if (prevChar == '_' || prevChar == '-' || (!isFile && prevChar == '.'))
+            penalty = j + 1;
+      }
+
+      penalty -= suggestion[matchPos] == query[j];
+
+      if (suggestion == "RcppExports.R" ||
+          suggestion == "RcppExports.cpp")
+         penalty += 6;
+
+      std::string extension = string_utils::getExtension(suggestion);
+      if (boost::algorithm::to_lower_copy(extension) == ".rd")
+         penalty += 6;
+
+      totalPenalty += penalty;
+   }
+
+   if (isFile)
+      ++totalPenalty;
+
+   totalPenalty += static_cast<int>((query.size() - matches.size()) * query.size());
+
+   return totalPenalty;
+}
+
+// a reproducible set of symbol-like names
+std::vector<std::string> makeNames(std::size_t count)
+{
+   const char* parts[] = {
+      "read", "Write", "csv", "data", "frame", "plot", "gg", "Rcpp", "Exports",
+      "model", "fit", "summary", "x", "_", ".", "-", "test", "Rd", "R", "cpp"
+   };
+   const std::size_t partCount = sizeof(parts) / sizeof(parts[0]);
+
+   std::vector<std::string> names;
+   unsigned int state = 42;
+   for (std::size_t i = 0; i < count; i++)
+   {
+      std::string name;
+      std::size_t length = 1 + (i % 5);
+      for (std::size_t j = 0; j < length; j++)
+      {
+         state = state * 1103515245 + 12345;
+         name += parts[(state >> 16) % partCount];
+      }
+      names.push_back(name);
+   }
+
+   names.push_back("RcppExports.R");
+   names.push_back("RcppExports.cpp");
+   names.push_back("readCsv.Rd");
+   names.push_back("readcsv");
+   return names;
+}
+
+// the best matches as found by scoring and sorting every candidate
+std::vector<std::pair<int, int> > referenceBestMatches(const std::vector<std::string>& names,
+                                                       const std::string& query,
+                                                       bool isFile,
+                                                       std::size_t maxMatches)
+{
+   std::vector<std::pair<int, int> > scores;
+   for (std::size_t i = 0; i < names.size(); i++)
+      scores.push_back(std::make_pair(referenceScore(names[i], query, isFile),
+                                      static_cast<int>(i)));
+   std::sort(scores.begin(), scores.end());
+   scores.resize(std::min(scores.size(), maxMatches));
+
+   std::vector<std::pair<int, int> > matches;
+   for (const std::pair<int, int>& score : scores)
+      matches.push_back(std::make_pair(score.second, score.first));
+   return matches;
+}
+
+const char* const kQueries[] = { "readcsv", "rCsv", "RcppE", "plot.", "gg_m", "zzz", "" };
+
+} // anonymous namespace
+
+TEST_CASE("SessionFuzzyMatcher")
+{
+   std::vector<std::string> names = makeNames(5000);
+
+   SECTION("Scores match the reference implementation")
+   {
+      for (const char* query : kQueries)
+      {
+         for (bool isFile : { true, false })
+         {
+            FuzzyMatcher matcher(query, isFile);
+            for (const std::string& name : names)
+               REQUIRE(matcher.score(name) == referenceScore(name, query, isFile));
+         }
+      }
+   }
+
+   SECTION("Best matches are the lowest scores in candidate order")
+   {
+      for (const char* query : kQueries)
+      {
+         std::vector<std::pair<int, int> > matches;
+         FuzzyMatcher(query, false).bestMatches(names, 20, &matches);
+         CHECK(matches == referenceBestMatches(names, query, false, 20));
+      }
+   }
+
+   SECTION("Best matches are found across threads")
+   {
+      std::vector<std::string> manyNames = makeNames(100000);
+      std::vector<std::pair<int, int> > matches;
+      FuzzyMatcher("readcsv", true).bestMatches(manyNames, 50, &matches);
+      CHECK(matches == referenceBestMatches(manyNames, "readcsv", true, 50));
+   }
+
+   SECTION("Lower-cased candidates are matched as subsequences")
+   {
+      FuzzyMatcher matcher("ReadCSV:10", true);
+      CHECK(matcher.matchesLowerCase("read_csv.r", 7));
+      CHECK_FALSE(matcher.matchesLowerCase("read_csv.r"));
+      CHECK_FALSE(matcher.matchesLowerCase("readcs.r", 7));
+      CHECK(FuzzyMatcher("", true).matchesLowerCase("anything"));
+   }
+}
+
+} // end namespace tests
+} // end namespace code_search
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
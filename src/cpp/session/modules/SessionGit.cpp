@@ -63,6 +63,10 @@
 #include <session/prefs/UserPrefs.hpp>
 
 #include "SessionAskPass.hpp"
+#include "SessionGitCommitGraph.hpp"
+#include "SessionGitDiffCache.hpp"
+#include "SessionGitObjectReader.hpp"
+#include "SessionGitStatusCache.hpp"
 
 #include "SessionVCS.hpp"
 
@@ -152,19 +156,6 @@ enum PatchMode
    PatchModeStage = 1
 };
 
-struct CommitInfo
-{
-   std::string id;
-   std::string author;
-   std::string subject;
-   std::string description;
-   std::string parent;
-   boost::int64_t date; // millis since epoch, UTC
-   std::vector<std::string> refs;
-   std::vector<std::string> tags;
-   std::string graph;
-};
-
 struct RemoteBranchInfo
 {
    RemoteBranchInfo() : commitsBehind(0) {}
@@ -364,20 +355,12 @@ Error gitExec(const ShellArgs& args,
 }
 
 
-bool commitIsMatch(const std::vector<std::string>& patterns,
-                   const CommitInfo& commit)
+std::vector<std::string> searchTextPatterns(const std::string& searchText)
 {
-   for (std::string pattern : patterns)
-   {
-      if (!boost::algorithm::ifind_first(commit.author, pattern)
-          && !boost::algorithm::ifind_first(commit.description, pattern)
-          && !boost::algorithm::ifind_first(commit.id, pattern))
-      {
-         return false;
-      }
-   }
-
-   return true;
+   std::vector<std::string> patterns;
+   boost::algorithm::split(patterns, searchText,
+                           boost::algorithm::is_any_of(" \t\r\n"));
+   return patterns;
 }
 
 boost::function<bool(CommitInfo)> createSearchTextPredicate(
@@ -386,10 +369,7 @@ boost::function<bool(CommitInfo)> createSearchTextPredicate(
    if (searchText.empty())
       return boost::lambda::constant(true);
 
-   std::vector<std::string> results;
-   boost::algorithm::split(results, searchText,
-                           boost::algorithm::is_any_of(" \t\r\n"));
-   return boost::bind(commitIsMatch, results, _1);
+   return boost::bind(commitIsMatch, searchTextPatterns(searchText), _1);
 }
 
 bool isUntracked(const source_control::StatusResult& statusResult,
@@ -402,6 +382,10 @@ class Git : public boost::noncopyable
 {
 private:
    FilePath root_;
+   CommitGraph commitGraph_;
+   StatusCache statusCache_;
+   DiffCache diffCache_;
+   ObjectReader objectReader_;
 
 protected:
    core::Error runGit(const ShellArgs& args,
@@ -432,6 +416,46 @@ protected:
       return Success();
    }
 
+   core::Error runGitForOutput(const ShellArgs& args, std::string* pStdOut)
+   {
+      return runGit(args, pStdOut);
+   }
+
+   core::Error runGitForStatus(const ShellArgs& args, std::string* pStdOut)
+   {
+      std::string stdErr;
+      int exitCode;
+      Error error = runGit(args, pStdOut, &stdErr, &exitCode);
+      if (error)
+         return error;
+
+      if (exitCode != EXIT_SUCCESS)
+      {
+         error = systemError(boost::system::errc::operation_not_permitted,
+                             ERROR_LOCATION);
+         error.addProperty("stderr", stdErr);
+         return error;
+      }
+
+      return Success();
+   }
+
+   boost::shared_ptr<core::system::AsyncChildProcess> createCatFileProcess()
+   {
+      core::system::ProcessOptions options = procOptions();
+      options.workingDir = root_;
+
+      ShellArgs args = gitArgs() << "cat-file" << "--batch";
+#ifdef _WIN32
+      options.detachProcess = true;
+      return boost::make_shared<core::system::AsyncChildProcess>(
+               gitBin(), args.args(), options);
+#else
+      return boost::make_shared<core::system::AsyncChildProcess>(
+               git() << args.args(), options);
+#endif
+   }
+
    core::Error createConsoleProc(const ShellArgs& args,
                                  const std::string& caption,
                                  boost::shared_ptr<ConsoleProcess>* ppCP,
@@ -497,12 +521,25 @@ protected:
 
 public:
 
-   Git() : root_(FilePath())
+   Git()
+      : root_(FilePath()),
+        commitGraph_(boost::bind(&Git::runGitForOutput, this, _1, _2)),
+        statusCache_(boost::bind(&Git::runGitForStatus, this, _1, _2)),
+        diffCache_(boost::bind(&Git::runGitForStatus, this, _1, _2)),
+        objectReader_(boost::bind(&Git::createCatFileProcess, this))
    {
    }
 
-   Git(const FilePath& root) : root_(root)
+   Git(const FilePath& root)
+      : root_(root),
+        commitGraph_(boost::bind(&Git::runGitForOutput, this, _1, _2)),
+        statusCache_(boost::bind(&Git::runGitForStatus, this, _1, _2)),
+        diffCache_(boost::bind(&Git::runGitForStatus, this, _1, _2)),
+        objectReader_(boost::bind(&Git::createCatFileProcess, this))
    {
+      commitGraph_.setRoot(root, FilePath());
+      statusCache_.setRoot(root);
+      diffCache_.setRoot(root);
    }
 
    std::string name() { return kVcsId; }
@@ -515,6 +552,35 @@ public:
    void setRoot(const FilePath& path)
    {
       root_ = path;
+
+      // the commits read for the history viewer are kept between sessions
+      FilePath cachePath;
+      if (!path.isEmpty())
+         cachePath = module_context::scopedScratchPath().completeChildPath("git-commit-graph");
+      commitGraph_.setRoot(path, cachePath);
+      statusCache_.setRoot(path);
+      diffCache_.setRoot(path);
+      objectReader_.stop();
+   }
+
+   void saveCommitGraph()
+   {
+      commitGraph_.save();
+   }
+
+   void stopObjectReader()
+   {
+      objectReader_.stop();
+   }
+
+   void invalidateStatus()
+   {
+      statusCache_.invalidate();
+   }
+
+   void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+   {
+      statusCache_.onFilesChanged(events);
    }
 
    core::Error status(const FilePath& dir,
@@ -524,6 +590,20 @@ public:
 
       // objects to be populated from git's output
       std::vector<FileWithStatus> files;
+
+      // within a monitored project the status is kept up to date with the
+      // changes the file monitor reports, rather than being read again
+      if (projects::projectContext().isMonitoringDirectory(root_) &&
+          dir.isWithin(root_))
+      {
+         Error error = statusCache_.status(dir, &files);
+         if (!error)
+         {
+            *pStatusResult = StatusResult(files);
+            return Success();
+         }
+         LOG_ERROR(error);
+      }
       
       // build shell arguments
       ShellArgs arguments = gitArgs();
@@ -535,37 +615,9 @@ public:
       if (error)
          return error;
       
-      // split and parse each piece of status output
-      std::vector<std::string> pieces = core::algorithm::split(output, "\0");
-
-      for (std::vector<std::string>::iterator it = pieces.begin();
-           it != pieces.end();
-           it++)
-      {
-         std::string line = *it;
-         if (line.length() < 4)
-            continue;
-         FileWithStatus file;
-
-         std::string status = line.substr(0, 2);
-         std::string filePath = line.substr(3);
-         file.status = status;
-         
-         // if this was a git rename or copy, we need to capture the rename target from the next
-         // field. note that Git flips the order of filenames when running with '-z'
-         if (status == "R " || status == "C ")
-            filePath = *(++it) + " -> " + filePath;
-
-         // remove trailing slashes
-         if (filePath.length() > 1 && filePath[filePath.length() - 1] == '/')
-            filePath = filePath.substr(0, filePath.size() - 1);
-
-         // file paths are returned as UTF-8 encoded paths,
-         // so no need to re-encode here
-         file.path = root_.completeChildPath(filePath);
-
+      parseStatus(output, root_, [&](const std::string&, const FileWithStatus& file) {
          files.push_back(file);
-      }
+      });
 
       *pStatusResult = StatusResult(files);
 
@@ -1081,12 +1133,66 @@ public:
       return runGit(args, pOutput, nullptr, nullptr);
    }
 
+   core::Error diffChangedFile(const FilePath& filePath,
+                               PatchMode mode,
+                               int contextLines,
+                               bool ignoreWhitespace,
+                               std::string* pOutput)
+   {
+      StatusResult statusResult;
+      Error error = status(root_, &statusResult);
+      if (error)
+         return error;
+
+      // untracked files are compared with nothing
+      if (mode == PatchModeWorking &&
+          statusResult.getStatus(filePath).status() == "??")
+      {
+         return doDiffFile(filePath,
+                           &(shell_utils::devnull()),
+                           mode,
+                           contextLines,
+                           ignoreWhitespace,
+                           pOutput);
+      }
+
+      std::vector<std::string> changedPaths;
+      for (const FileWithStatus& file : statusResult.files())
+      {
+         std::string status = file.status.status();
+         if (status.size() < 2)
+            continue;
+
+         char state = (mode == PatchModeStage) ? status[0] : status[1];
+         if (state != ' ' && state != '?' && state != '!')
+            changedPaths.push_back(file.path.getRelativePath(root_));
+      }
+
+      return diffCache_.diff(filePath.getRelativePath(root_),
+                             changedPaths,
+                             mode == PatchModeStage,
+                             contextLines,
+                             ignoreWhitespace,
+                             pOutput);
+   }
+
    core::Error diffFile(const FilePath& filePath,
                         PatchMode mode,
                         int contextLines,
                         bool ignoreWhitespace,
                         std::string* pOutput)
    {
+      // within a monitored project the status is at hand, so the patches
+      // of the changed files are read (and kept) together
+      if (projects::projectContext().isMonitoringDirectory(root_) &&
+          filePath.isWithin(root_) && filePath != root_)
+      {
+         Error error = diffChangedFile(filePath, mode, contextLines, ignoreWhitespace, pOutput);
+         if (!error)
+            return Success();
+         LOG_ERROR(error);
+      }
+
       Error error = doDiffFile(filePath, nullptr, mode, contextLines, ignoreWhitespace, pOutput);
       if (error)
          return error;
@@ -1114,27 +1220,6 @@ public:
       return Success();
    }
 
-   boost::int64_t convertGitRawDate(const std::string& time,
-                          const std::string& timeZone)
-   {
-      boost::int64_t secs = safe_convert::stringTo<boost::int64_t>(time, 0);
-
-      int offset = safe_convert::stringTo<int>(timeZone, 0);
-
-      // Positive timezone offset means we have to SUBTRACT
-      // the offset to get UTC time, and vice versa
-      int factor = offset > 0 ? -1 : 1;
-
-      offset = abs(offset);
-      int hours = offset / 100;
-      int minutes = offset % 100;
-
-      secs += factor * (hours * 60*60);
-      secs += factor * (minutes * 60);
-
-      return secs;
-   }
-
    core::Error applyPatch(const FilePath& patchFile,
                           PatchMode patchMode)
    {
@@ -1147,56 +1232,27 @@ public:
       return runGit(args);
    }
 
-   void parseCommitValue(const std::string& value,
-                         CommitInfo* pCommitInfo)
-   {
-      static boost::regex commitRegex("^([a-z0-9]+)(\\s+\\((.*)\\))?");
-      boost::smatch smatch;
-      if (regex_utils::match(value, smatch, commitRegex))
-      {
-         pCommitInfo->id = smatch[1];
-         std::vector<std::string> refs;
-         if (smatch[3].matched)
-         {
-            boost::algorithm::split(refs,
-                                    static_cast<const std::string>(smatch[3]),
-                                    boost::algorithm::is_any_of(","));
-            for (std::string ref : refs)
-            {
-               boost::algorithm::trim(ref);
-               if (boost::algorithm::starts_with(ref, "tag: "))
-                  pCommitInfo->tags.push_back(ref.substr(5));
-               else if (boost::algorithm::starts_with(ref, "refs/tags/"))
-               {
-                  // Sometimes with git 1.7.0 tags appear without the "tags: "
-                  // prefix, e.g. plyr-1.6
-                  pCommitInfo->tags.push_back(ref);
-               }
-               else if (!boost::algorithm::starts_with(ref, "refs/bisect/"))
-                  pCommitInfo->refs.push_back(ref);
-            }
-         }
-      }
-      else
-      {
-         pCommitInfo->id = value;
-      }
-   }
-
    core::Error logLength(const std::string &rev,
                          const FilePath& fileFilter,
                          const std::string &searchText,
                          int *pLength)
    {
-      if (searchText.empty())
+      if (searchText.empty() && fileFilter.isEmpty())
+      {
+         return commitGraph_.length(rev, pLength);
+      }
+      else if (fileFilter.isEmpty())
+      {
+         return commitGraph_.searchLength(rev, searchTextPatterns(searchText), pLength);
+      }
+      else if (searchText.empty())
       {
          ShellArgs args = gitArgs() << "log";
          args << "--pretty=oneline";
          if (!rev.empty())
             args << rev;
 
-         if (!fileFilter.isEmpty())
-            args << "--" << fileFilter;
+         args << "--" << fileFilter;
 
          std::string output;
          Error error = runGit(args, &output);
@@ -1224,201 +1280,59 @@ public:
                    const std::string& searchText,
                    std::vector<CommitInfo>* pOutput)
    {
+      // the full history (with its graph) is served from the commit graph
+      if (searchText.empty() && fileFilter.isEmpty())
+      {
+         return commitGraph_.commits(
+                  rev,
+                  skip,
+                  maxentries < 0 ? std::numeric_limits<int>::max() : maxentries,
+                  pOutput);
+      }
+
+      // as are searches of it (using its index of the commits)
+      if (fileFilter.isEmpty())
+      {
+         return commitGraph_.search(
+                  rev,
+                  searchTextPatterns(searchText),
+                  skip,
+                  maxentries < 0 ? std::numeric_limits<int>::max() : maxentries,
+                  pOutput);
+      }
+
       ShellArgs args = gitArgs() << "log" << "--encoding=UTF-8"
                        << "--pretty=raw" << "--decorate=full"
                        << "--date-order";
 
-      ShellArgs revListArgs = gitArgs() << "rev-list" << "--date-order" << "--parents";
-      int revListSkip = skip;
-
       if (!fileFilter.isEmpty())
-      {
          args << "--" << fileFilter;
-         revListArgs << "--" << fileFilter;
-      }
-
-      if (searchText.empty() && fileFilter.isEmpty())
-      {
-         // This is a way more efficient way to implement skip and maxentries
-         // if we know that all commits are included.
-         if (skip > 0)
-         {
-            args << "--skip=" + safe_convert::numberToString(skip);
-            skip = 0;
-         }
-         if (maxentries >= 0)
-         {
-            args << "--max-count=" + safe_convert::numberToString(maxentries);
-            maxentries = -1;
-
-            revListArgs << "--max-count=" + safe_convert::numberToString(
-                  (skip < 0 ? 0 : skip) + maxentries);
-         }
-      }
 
       if (!rev.empty())
-      {
          args << rev;
-         revListArgs << rev;
-      }
-      else
-      {
-         revListArgs << "HEAD";
-      }
 
       if (maxentries < 0)
          maxentries = std::numeric_limits<int>::max();
 
-      std::vector<std::string> outLines;
       std::string output;
       Error error = runGit(args, &output);
       if (error)
          return error;
-      outLines = split(output);
-      output.clear();
-
-      std::vector<std::string> graphLines;
-      if (searchText.empty() && fileFilter.isEmpty())
-      {
-         std::vector<std::string> revOutLines;
-         std::string revOutput;
-         error = runGit(revListArgs, &revOutput);
-         if (error)
-            return error;
-         revOutLines = split(revOutput);
-         revOutput.clear();
-
-         gitgraph::GitGraph graph;
-         for (size_t i = 0; i < revOutLines.size(); i++)
-         {
-            typedef std::vector<std::string> find_vector_type;
-            find_vector_type parents;
-            boost::algorithm::split(parents, revOutLines[i],
-                                    boost::algorithm::is_any_of(" "));
-            if (parents.size() < 1)
-               break;
-
-            std::string commit = parents.front();
-            parents.erase(parents.begin());
-
-            gitgraph::Line line = graph.addCommit(commit, parents);
-            if (revListSkip <= 0 || gsl::narrow_cast<int>(i) >= revListSkip)
-               graphLines.push_back(line.string());
-         }
-      }
 
       boost::function<bool(CommitInfo)> filter = createSearchTextPredicate(searchText);
 
-      boost::regex kvregex("^(\\w+) (.*)$");
-      boost::regex authTimeRegex("^(.*?) (\\d+) ([+\\-]?\\d+)$");
-
-      size_t graphLineIndex = 0;
       int skipped = 0;
-      CommitInfo currentCommit;
-      
-      // are we currently parsing a GPG signature?
-      bool isPgpSignature = false;
-
-      for (std::vector<std::string>::const_iterator it = outLines.begin();
-           it != outLines.end() && pOutput->size() < static_cast<size_t>(maxentries);
-           it++)
-      {
-         // if we're within the body of a PGP signature, check for
-         // the end marker
-         if (isPgpSignature)
-         {
-            const char* endMarker = "-----END PGP SIGNATURE-----";
-            isPgpSignature = it->find(endMarker) == std::string::npos;
-            continue;
-         }
-         
-         boost::smatch smatch;
-         if (regex_utils::search(*it, smatch, kvregex))
+      parseRawLog(output, [&](const CommitInfo& commit) {
+         if (filter(commit))
          {
-            std::string key = smatch[1];
-            std::string value = smatch[2];
-            if (key == "commit")
-            {
-               if (!currentCommit.id.empty() && filter(currentCommit))
-               {
-                  if (skipped < skip)
-                     skipped++;
-                  else
-                  {
-                     if (graphLineIndex < graphLines.size())
-                        currentCommit.graph = graphLines[graphLineIndex];
-                     pOutput->push_back(currentCommit);
-                  }
-
-                  graphLineIndex++;
-               }
-
-               currentCommit = CommitInfo();
-               parseCommitValue(value, &currentCommit);
-            }
-            else if (key == "author" || key == "committer")
-            {
-               boost::smatch authTimeMatch;
-               if (regex_utils::search(value, authTimeMatch, authTimeRegex))
-               {
-                  std::string author = authTimeMatch[1];
-                  std::string time = authTimeMatch[2];
-                  std::string tz = authTimeMatch[3];
-
-                  if (key == "author")
-                     currentCommit.author = author;
-                  else // if (key == "committer")
-                     currentCommit.date = convertGitRawDate(time, tz);
-               }
-            }
-            else if (key == "parent")
-            {
-               if (!currentCommit.parent.empty())
-                  currentCommit.parent.push_back(' ');
-               currentCommit.parent.append(value);
-            }
-            else if (key == "gpgsig")
-            {
-               isPgpSignature = value == "-----BEGIN PGP SIGNATURE-----";
-            }
+            if (skipped < skip)
+               skipped++;
             else
-            {
-               // explicitly ignore other keys (e.g. 'tree')
-            }
-         }
-         else if (boost::starts_with(*it, "    "))
-         {
-            if (currentCommit.subject.empty())
-               currentCommit.subject = it->substr(4);
-
-            if (!currentCommit.description.empty())
-               currentCommit.description.append("\n");
-            currentCommit.description.append(it->substr(4));
-         }
-         else if (it->length() == 0)
-         {
-            // ignore empty lines
-         }
-         else
-         {
-            LOG_ERROR_MESSAGE("Unexpected git-log output");
+               pOutput->push_back(commit);
          }
-      }
 
-      if (pOutput->size() < static_cast<size_t>(maxentries)
-          && !currentCommit.id.empty()
-          && filter(currentCommit))
-      {
-         if (skipped < skip)
-            skipped++;
-         else
-         {
-            if (graphLineIndex < graphLines.size())
-               currentCommit.graph = graphLines[graphLineIndex];
-            pOutput->push_back(currentCommit);
-         }
-         graphLineIndex++;
-      }
+         return pOutput->size() < static_cast<size_t>(maxentries);
+      });
 
       return Success();
    }
@@ -1439,8 +1353,21 @@ public:
                                 std::string* pOutput)
    {
       boost::format fmt("%1%:%2%");
-      ShellArgs args =
-            gitArgs() << "show" << boost::str(fmt % rev % filename);
+      std::string object = boost::str(fmt % rev % filename);
+
+      // files at a revision are read by the long-lived cat-file process
+      // (others, e.g. those in the index, are left to git show)
+      if (!rev.empty())
+      {
+         std::string type;
+         Error error = objectReader_.read(object, &type, pOutput);
+         if (error)
+            LOG_ERROR(error);
+         else if (type == "blob")
+            return Success();
+      }
+
+      ShellArgs args = gitArgs() << "show" << object;
 
       return runGit(args, pOutput);
    }
@@ -2946,8 +2873,27 @@ Error detectAndSaveGitExePath()
 
 #endif
 
+void onFileMonitorEnabled(const tree<core::FileInfo>&)
+{
+   // changes made while we weren't monitoring went unreported
+   s_git_.invalidateStatus();
+}
+
+void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+{
+   s_git_.onFilesChanged(events);
+}
+
+void onFileMonitorDisabled()
+{
+   s_git_.invalidateStatus();
+}
+
 void onShutdown(bool)
 {
+   s_git_.saveCommitGraph();
+   s_git_.stopObjectReader();
+
    std::for_each(s_pidsToTerminate_.begin(), s_pidsToTerminate_.end(),
                  &core::system::terminateProcess);
    s_pidsToTerminate_.clear();
@@ -3316,6 +3262,13 @@ core::Error initialize()
 
    module_context::events().onShutdown.connect(onShutdown);
 
+   // keep the status up to date with changes to the project's files
+   projects::FileMonitorCallbacks cb;
+   cb.onMonitoringEnabled = onFileMonitorEnabled;
+   cb.onFilesChanged = onFilesChanged;
+   cb.onMonitoringDisabled = onFileMonitorDisabled;
+   projects::projectContext().subscribeToFileMonitor("Git status", cb);
+
    initGitBin();
 
    bool interceptAskPass;
@@ -0,0 +1,968 @@
+/*
+ * SessionGitCommitGraph.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitCommitGraph.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <unordered_set>
+
+#include <gsl/gsl>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/regex.hpp>
+
+#include <shared_core/Hash.hpp>
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/BinarySerializer.hpp>
+#include <core/Log.hpp>
+#include <core/RegexUtils.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::shell_utils;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+namespace {
+
+// identifies (this version of) saved commit graphs
+const char kCommitGraphMagic[] = "RSGITCG1";
+
+// sanity limits for reading saved commit graphs
+const uint64_t kMaxCount = 10000000;
+const uint64_t kMaxStringSize = 1024 * 1024;
+
+// the history is read this many commits at a time (at least)
+const std::size_t kHistoryChunkSize = 1000;
+
+// commits are read by id this many at a time (keeping command lines short)
+const std::size_t kCommitBatchSize = 200;
+
+// search patterns are split on (and so never contain) these
+const char kWhitespace[] = " \t\r\n";
+
+// (as in SessionGit.cpp) git understands UTF-8 paths natively
+ShellArgs gitArgs()
+{
+   return ShellArgs() << DefaultEncoding;
+}
+
+boost::int64_t convertGitRawDate(const std::string& time,
+                                 const std::string& timeZone)
+{
+   boost::int64_t secs = safe_convert::stringTo<boost::int64_t>(time, 0);
+
+   int offset = safe_convert::stringTo<int>(timeZone, 0);
+
+   // Positive timezone offset means we have to SUBTRACT
+   // the offset to get UTC time, and vice versa
+   int factor = offset > 0 ? -1 : 1;
+
+   offset = abs(offset);
+   int hours = offset / 100;
+   int minutes = offset % 100;
+
+   secs += factor * (hours * 60*60);
+   secs += factor * (minutes * 60);
+
+   return secs;
+}
+
+// parses decorations as given by `git log --decorate=full`, e.g.
+// "HEAD -> refs/heads/main, tag: refs/tags/v1.0"
+void parseDecorations(const std::string& decorations, CommitInfo* pCommitInfo)
+{
+   std::vector<std::string> refs;
+   boost::algorithm::split(refs, decorations, boost::algorithm::is_any_of(","));
+   for (std::string ref : refs)
+   {
+      boost::algorithm::trim(ref);
+      if (ref.empty())
+         continue;
+
+      if (boost::algorithm::starts_with(ref, "tag: "))
+         pCommitInfo->tags.push_back(ref.substr(5));
+      else if (boost::algorithm::starts_with(ref, "refs/tags/"))
+      {
+         // Sometimes with git 1.7.0 tags appear without the "tags: "
+         // prefix, e.g. plyr-1.6
+         pCommitInfo->tags.push_back(ref);
+      }
+      else if (!boost::algorithm::starts_with(ref, "refs/bisect/"))
+         pCommitInfo->refs.push_back(ref);
+   }
+}
+
+void parseCommitValue(const std::string& value, CommitInfo* pCommitInfo)
+{
+   static boost::regex commitRegex("^([a-z0-9]+)(\\s+\\((.*)\\))?");
+   boost::smatch smatch;
+   if (regex_utils::match(value, smatch, commitRegex))
+   {
+      pCommitInfo->id = smatch[1];
+      if (smatch[3].matched)
+         parseDecorations(smatch[3], pCommitInfo);
+   }
+   else
+   {
+      pCommitInfo->id = value;
+   }
+}
+
+std::vector<std::string> splitLines(const std::string& str)
+{
+   std::vector<std::string> output;
+   boost::algorithm::split(output, str, boost::algorithm::is_any_of("\r\n"));
+   return output;
+}
+
+void writeCommit(std::ostream& ostr, const CommitInfo& commit)
+{
+   using namespace core::binary;
+
+   writeString(ostr, commit.id);
+   writeString(ostr, commit.author);
+   writeString(ostr, commit.subject);
+   writeString(ostr, commit.description);
+   writeString(ostr, commit.parent);
+   writeUInt(ostr, static_cast<uint64_t>(commit.date), 8);
+}
+
+bool readCommit(std::istream& istr, CommitInfo* pCommit)
+{
+   using namespace core::binary;
+
+   uint64_t date;
+   bool valid = readString(istr, kMaxStringSize, &pCommit->id) &&
+                readString(istr, kMaxStringSize, &pCommit->author) &&
+                readString(istr, kMaxStringSize, &pCommit->subject) &&
+                readString(istr, kMaxStringSize, &pCommit->description) &&
+                readString(istr, kMaxStringSize, &pCommit->parent) &&
+                readUInt(istr, 8, &date);
+
+   pCommit->date = static_cast<boost::int64_t>(date);
+   return valid;
+}
+
+} // anonymous namespace
+
+bool commitIsMatch(const std::vector<std::string>& patterns,
+                   const CommitInfo& commit)
+{
+   for (const std::string& pattern : patterns)
+   {
+      // (every commit contains an empty pattern, e.g. from a doubled space)
+      if (pattern.empty())
+         continue;
+
+      if (!boost::algorithm::ifind_first(commit.author, pattern)
+          && !boost::algorithm::ifind_first(commit.description, pattern)
+          && !boost::algorithm::ifind_first(commit.id, pattern))
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void CommitIndex::add(const CommitInfo& commit)
+{
+   if (commit.id.empty() || contains(commit.id))
+      return;
+
+   boost::uint32_t ordinal = gsl::narrow_cast<boost::uint32_t>(ids_.size());
+   ids_.push_back(commit.id);
+   ordinals_[commit.id] = ordinal;
+
+   // (ifind_first compares characters by their upper case)
+   std::string text = boost::algorithm::to_upper_copy(
+            commit.id + " " + commit.author + " " + commit.description);
+
+   std::vector<std::string> words;
+   boost::algorithm::split(words, text, boost::algorithm::is_any_of(kWhitespace),
+                           boost::algorithm::token_compress_on);
+   for (const std::string& word : words)
+   {
+      if (word.empty())
+         continue;
+
+      boost::uint32_t wordIndex;
+      std::unordered_map<std::string, boost::uint32_t>::const_iterator it =
+            wordIndexes_.find(word);
+      if (it != wordIndexes_.end())
+      {
+         wordIndex = it->second;
+      }
+      else
+      {
+         wordIndex = gsl::narrow_cast<boost::uint32_t>(words_.size());
+         wordIndexes_[word] = wordIndex;
+         words_.push_back(word);
+         postings_.push_back(std::vector<boost::uint32_t>());
+      }
+
+      std::vector<boost::uint32_t>& postings = postings_[wordIndex];
+      if (postings.empty() || postings.back() != ordinal)
+         postings.push_back(ordinal);
+   }
+}
+
+bool CommitIndex::contains(const std::string& id) const
+{
+   return ordinals_.count(id) != 0;
+}
+
+void CommitIndex::clear()
+{
+   ids_.clear();
+   ordinals_.clear();
+   words_.clear();
+   wordIndexes_.clear();
+   postings_.clear();
+}
+
+void CommitIndex::find(const std::vector<std::string>& patterns,
+                       std::vector<std::string>* pIds) const
+{
+   pIds->clear();
+
+   std::vector<bool> matches(ids_.size(), true);
+   for (const std::string& pattern : patterns)
+   {
+      // patterns with whitespace could span words, so don't narrow the
+      // commits (and are left to be checked for by the caller)
+      if (pattern.empty() || pattern.find_first_of(kWhitespace) != std::string::npos)
+         continue;
+
+      std::string upperPattern = boost::algorithm::to_upper_copy(pattern);
+      std::vector<bool> patternMatches(ids_.size(), false);
+      for (std::size_t i = 0; i < words_.size(); i++)
+      {
+         if (words_[i].find(upperPattern) == std::string::npos)
+            continue;
+
+         for (boost::uint32_t ordinal : postings_[i])
+            patternMatches[ordinal] = true;
+      }
+
+      for (std::size_t i = 0; i < matches.size(); i++)
+         matches[i] = matches[i] && patternMatches[i];
+   }
+
+   for (std::size_t i = 0; i < matches.size(); i++)
+   {
+      if (matches[i])
+         pIds->push_back(ids_[i]);
+   }
+}
+
+void CommitIndex::write(std::ostream& ostr) const
+{
+   using namespace core::binary;
+
+   writeUInt(ostr, ids_.size(), 4);
+   for (const std::string& id : ids_)
+      writeString(ostr, id);
+
+   writeUInt(ostr, words_.size(), 4);
+   for (std::size_t i = 0; i < words_.size(); i++)
+   {
+      writeString(ostr, words_[i]);
+      writeUInt(ostr, postings_[i].size(), 4);
+      for (boost::uint32_t ordinal : postings_[i])
+         writeUInt(ostr, ordinal, 4);
+   }
+}
+
+bool CommitIndex::read(std::istream& istr)
+{
+   using namespace core::binary;
+
+   clear();
+
+   uint64_t idCount;
+   bool valid = readUInt(istr, 4, &idCount) && idCount <= kMaxCount;
+   for (uint64_t i = 0; valid && i < idCount; i++)
+   {
+      std::string id;
+      valid = readString(istr, kMaxStringSize, &id) && !contains(id);
+      ordinals_[id] = gsl::narrow_cast<boost::uint32_t>(ids_.size());
+      ids_.push_back(id);
+   }
+
+   uint64_t wordCount;
+   valid = valid && readUInt(istr, 4, &wordCount) && wordCount <= kMaxCount;
+   for (uint64_t i = 0; valid && i < wordCount; i++)
+   {
+      std::string word;
+      uint64_t postingCount;
+      valid = readString(istr, kMaxStringSize, &word) &&
+              readUInt(istr, 4, &postingCount) &&
+              postingCount <= idCount;
+
+      std::vector<boost::uint32_t> postings;
+      for (uint64_t j = 0; valid && j < postingCount; j++)
+      {
+         uint64_t ordinal;
+         valid = readUInt(istr, 4, &ordinal) && ordinal < idCount;
+         postings.push_back(gsl::narrow_cast<boost::uint32_t>(ordinal));
+      }
+
+      wordIndexes_[word] = gsl::narrow_cast<boost::uint32_t>(words_.size());
+      words_.push_back(word);
+      postings_.push_back(postings);
+   }
+
+   if (!valid)
+      clear();
+
+   return valid;
+}
+
+void parseRawLog(const std::string& output,
+                 const boost::function<bool(const CommitInfo&)>& onCommit)
+{
+   static boost::regex kvregex("^(\\w+) (.*)$");
+   static boost::regex authTimeRegex("^(.*?) (\\d+) ([+\\-]?\\d+)$");
+
+   CommitInfo currentCommit;
+
+   // are we currently parsing a GPG signature?
+   bool isPgpSignature = false;
+
+   std::vector<std::string> lines = splitLines(output);
+   for (const std::string& line : lines)
+   {
+      // if we're within the body of a PGP signature, check for
+      // the end marker
+      if (isPgpSignature)
+      {
+         const char* endMarker = "-----END PGP SIGNATURE-----";
+         isPgpSignature = line.find(endMarker) == std::string::npos;
+         continue;
+      }
+
+      boost::smatch smatch;
+      if (regex_utils::search(line, smatch, kvregex))
+      {
+         std::string key = smatch[1];
+         std::string value = smatch[2];
+         if (key == "commit")
+         {
+            if (!currentCommit.id.empty() && !onCommit(currentCommit))
+               return;
+
+            currentCommit = CommitInfo();
+            parseCommitValue(value, &currentCommit);
+         }
+         else if (key == "author" || key == "committer")
+         {
+            boost::smatch authTimeMatch;
+            if (regex_utils::search(value, authTimeMatch, authTimeRegex))
+            {
+               std::string author = authTimeMatch[1];
+               std::string time = authTimeMatch[2];
+               std::string tz = authTimeMatch[3];
+
+               if (key == "author")
+                  currentCommit.author = author;
+               else // if (key == "committer")
+                  currentCommit.date = convertGitRawDate(time, tz);
+            }
+         }
+         else if (key == "parent")
+         {
+            if (!currentCommit.parent.empty())
+               currentCommit.parent.push_back(' ');
+            currentCommit.parent.append(value);
+         }
+         else if (key == "gpgsig")
+         {
+            isPgpSignature = value == "-----BEGIN PGP SIGNATURE-----";
+         }
+         else
+         {
+            // explicitly ignore other keys (e.g. 'tree')
+         }
+      }
+      else if (boost::starts_with(line, "    "))
+      {
+         if (currentCommit.subject.empty())
+            currentCommit.subject = line.substr(4);
+
+         if (!currentCommit.description.empty())
+            currentCommit.description.append("\n");
+         currentCommit.description.append(line.substr(4));
+      }
+      else if (line.length() == 0)
+      {
+         // ignore empty lines
+      }
+      else
+      {
+         LOG_ERROR_MESSAGE("Unexpected git-log output");
+      }
+   }
+
+   if (!currentCommit.id.empty())
+      onCommit(currentCommit);
+}
+
+CommitGraph::CommitGraph(const RunGit& runGit)
+   : runGit_(runGit),
+     loaded_(false),
+     dirty_(false),
+     complete_(false),
+     length_(-1),
+     matched_(false)
+{
+}
+
+void CommitGraph::setRoot(const FilePath& root, const FilePath& cachePath)
+{
+   if (root == root_ && cachePath == cachePath_)
+      return;
+
+   save();
+
+   root_ = root;
+   cachePath_ = cachePath;
+   loaded_ = false;
+   dirty_ = false;
+   rev_.clear();
+   refsHash_.clear();
+   decorations_.clear();
+   commits_.clear();
+   index_.clear();
+   clearHistory();
+}
+
+Error CommitGraph::commits(const std::string& rev,
+                           int skip,
+                           int count,
+                           std::vector<CommitInfo>* pCommits)
+{
+   pCommits->clear();
+
+   Error error = update(rev);
+   if (error)
+      return error;
+
+   std::size_t begin = static_cast<std::size_t>(std::max(skip, 0));
+   std::size_t end = begin + static_cast<std::size_t>(std::max(count, 0));
+   error = extend(end);
+   if (error)
+      return error;
+
+   end = std::min(end, history_.size());
+   if (begin >= end)
+      return Success();
+
+   error = readCommits(begin, end);
+   if (error)
+      return error;
+
+   for (std::size_t i = begin; i < end; i++)
+   {
+      CommitInfo commit = decoratedCommit(history_[i].id);
+      commit.graph = graphLines_[i];
+      pCommits->push_back(commit);
+   }
+
+   return Success();
+}
+
+Error CommitGraph::length(const std::string& rev, int* pLength)
+{
+   Error error = update(rev);
+   if (error)
+      return error;
+
+   if (complete_)
+      length_ = gsl::narrow_cast<int>(history_.size());
+
+   if (length_ < 0)
+   {
+      std::string output;
+      error = runGit_(gitArgs() << "rev-list" << "--count" <<
+                      (rev_.empty() ? std::string("HEAD") : rev_),
+                      &output);
+      if (error)
+         return error;
+
+      length_ = safe_convert::stringTo<int>(boost::algorithm::trim_copy(output), 0);
+   }
+
+   *pLength = length_;
+   return Success();
+}
+
+Error CommitGraph::search(const std::string& rev,
+                          const std::vector<std::string>& patterns,
+                          int skip,
+                          int count,
+                          std::vector<CommitInfo>* pCommits)
+{
+   pCommits->clear();
+
+   Error error = findMatches(rev, patterns);
+   if (error)
+      return error;
+
+   std::size_t begin = std::min(static_cast<std::size_t>(std::max(skip, 0)),
+                                matches_.size());
+   std::size_t end = std::min(begin + static_cast<std::size_t>(std::max(count, 0)),
+                              matches_.size());
+   for (std::size_t i = begin; i < end; i++)
+      pCommits->push_back(decoratedCommit(history_[matches_[i]].id));
+
+   return Success();
+}
+
+Error CommitGraph::searchLength(const std::string& rev,
+                                const std::vector<std::string>& patterns,
+                                int* pLength)
+{
+   Error error = findMatches(rev, patterns);
+   if (error)
+      return error;
+
+   *pLength = gsl::narrow_cast<int>(matches_.size());
+   return Success();
+}
+
+void CommitGraph::clearHistory()
+{
+   history_.clear();
+   graphLines_.clear();
+   pGraph_.reset(new gitgraph::GitGraph());
+   complete_ = false;
+   length_ = -1;
+   patterns_.clear();
+   matches_.clear();
+   matched_ = false;
+}
+
+void CommitGraph::addNode(const Node& node)
+{
+   gitgraph::Line line = pGraph_->addCommit(node.id, node.parents);
+   history_.push_back(node);
+   graphLines_.push_back(line.string());
+}
+
+Error CommitGraph::update(const std::string& rev)
+{
+   if (!loaded_)
+   {
+      load();
+      loaded_ = true;
+   }
+
+   // the decorated commits: each of the refs (and HEAD), and so
+   // everything which determines the history of any rev
+   std::string output;
+   Error error = runGit_(gitArgs() << "log" << "--no-walk" << "--decorate=full"
+                                   << "--format=%H%d" << "--all" << "HEAD",
+                         &output);
+   if (error)
+      return error;
+
+   decorations_.clear();
+   for (const std::string& line : splitLines(output))
+   {
+      std::size_t pos = line.find(' ');
+      if (pos == std::string::npos)
+         continue;
+
+      // (decorations are given as " (HEAD -> refs/heads/main, ...)")
+      std::string decorations = boost::algorithm::trim_copy(line.substr(pos));
+      if (decorations.size() > 2 && decorations[0] == '(' &&
+          decorations[decorations.size() - 1] == ')')
+      {
+         decorations_[line.substr(0, pos)] =
+               decorations.substr(1, decorations.size() - 2);
+      }
+   }
+
+   // start over if the refs have moved (keeping the commits read)
+   std::string refsHash = core::hash::crc32HexHash(output);
+   if (rev != rev_ || refsHash != refsHash_)
+   {
+      rev_ = rev;
+      refsHash_ = refsHash;
+      clearHistory();
+      dirty_ = true;
+   }
+
+   return Success();
+}
+
+Error CommitGraph::extend(std::size_t count)
+{
+   while (!complete_ && history_.size() < count)
+   {
+      std::size_t chunkSize = std::max(count - history_.size(), kHistoryChunkSize);
+
+      ShellArgs args = gitArgs() << "rev-list" << "--date-order" << "--parents"
+            << "--skip=" + safe_convert::numberToString(history_.size())
+            << "--max-count=" + safe_convert::numberToString(chunkSize)
+            << (rev_.empty() ? std::string("HEAD") : rev_);
+
+      std::string output;
+      Error error = runGit_(args, &output);
+      if (error)
+         return error;
+
+      std::size_t added = 0;
+      for (const std::string& line : splitLines(output))
+      {
+         Node node;
+         boost::algorithm::split(node.parents, line, boost::algorithm::is_any_of(" "));
+         if (node.parents.empty() || node.parents.front().empty())
+            continue;
+
+         node.id = node.parents.front();
+         node.parents.erase(node.parents.begin());
+         addNode(node);
+         added++;
+      }
+
+      if (added < chunkSize)
+         complete_ = true;
+
+      dirty_ = true;
+   }
+
+   return Success();
+}
+
+Error CommitGraph::readCommits(std::size_t begin, std::size_t end)
+{
+   std::vector<std::string> missing;
+   for (std::size_t i = begin; i < end; i++)
+   {
+      if (commits_.count(history_[i].id) == 0)
+         missing.push_back(history_[i].id);
+   }
+
+   for (std::size_t i = 0; i < missing.size(); i += kCommitBatchSize)
+   {
+      ShellArgs args = gitArgs() << "log" << "--encoding=UTF-8"
+                                 << "--pretty=raw" << "--no-decorate"
+                                 << "--no-walk=unsorted";
+      std::size_t batchEnd = std::min(i + kCommitBatchSize, missing.size());
+      for (std::size_t j = i; j < batchEnd; j++)
+         args << missing[j];
+
+      std::string output;
+      Error error = runGit_(args, &output);
+      if (error)
+         return error;
+
+      parseRawLog(output, [&](const CommitInfo& commit) {
+         addCommit(commit);
+         return true;
+      });
+
+      dirty_ = true;
+   }
+
+   return Success();
+}
+
+Error CommitGraph::readHistory()
+{
+   Error error = extend(std::numeric_limits<int>::max());
+   if (error)
+      return error;
+
+   std::size_t missing = 0;
+   for (const Node& node : history_)
+   {
+      if (commits_.count(node.id) == 0)
+         missing++;
+   }
+
+   // reading much of the history by id would take many processes, so (as
+   // when it's first searched) it's read with the one instead
+   if (missing > kHistoryChunkSize)
+   {
+      ShellArgs args = gitArgs() << "log" << "--encoding=UTF-8"
+                                 << "--pretty=raw" << "--no-decorate"
+                                 << (rev_.empty() ? std::string("HEAD") : rev_);
+
+      std::string output;
+      error = runGit_(args, &output);
+      if (error)
+         return error;
+
+      parseRawLog(output, [&](const CommitInfo& commit) {
+         if (commits_.count(commit.id) == 0)
+            addCommit(commit);
+         return true;
+      });
+
+      dirty_ = true;
+   }
+
+   return readCommits(0, history_.size());
+}
+
+Error CommitGraph::findMatches(const std::string& rev,
+                               const std::vector<std::string>& patterns)
+{
+   Error error = update(rev);
+   if (error)
+      return error;
+
+   if (matched_ && patterns == patterns_)
+      return Success();
+
+   error = readHistory();
+   if (error)
+      return error;
+
+   std::vector<std::string> ids;
+   index_.find(patterns, &ids);
+   std::unordered_set<std::string> candidates(ids.begin(), ids.end());
+
+   // the candidates are checked (as the index doesn't, e.g., tell apart
+   // patterns with whitespace), in the order of the history
+   matches_.clear();
+   for (std::size_t i = 0; i < history_.size(); i++)
+   {
+      const std::string& id = history_[i].id;
+      if (index_.contains(id) && candidates.count(id) == 0)
+         continue;
+
+      std::unordered_map<std::string, CommitInfo>::const_iterator it =
+            commits_.find(id);
+      if (it != commits_.end() && commitIsMatch(patterns, it->second))
+         matches_.push_back(i);
+   }
+
+   patterns_ = patterns;
+   matched_ = true;
+   return Success();
+}
+
+void CommitGraph::addCommit(const CommitInfo& commit)
+{
+   commits_[commit.id] = commit;
+   index_.add(commit);
+}
+
+CommitInfo CommitGraph::decoratedCommit(const std::string& id) const
+{
+   std::unordered_map<std::string, CommitInfo>::const_iterator it =
+         commits_.find(id);
+   CommitInfo commit;
+   if (it != commits_.end())
+      commit = it->second;
+   else
+      commit.id = id;
+
+   std::unordered_map<std::string, std::string>::const_iterator decoIt =
+         decorations_.find(id);
+   if (decoIt != decorations_.end())
+      parseDecorations(decoIt->second, &commit);
+
+   return commit;
+}
+
+void CommitGraph::load()
+{
+   using namespace core::binary;
+
+   if (cachePath_.isEmpty() || !cachePath_.exists())
+      return;
+
+   std::shared_ptr<std::istream> pIfs;
+   Error error = cachePath_.openForRead(pIfs);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   std::istream& istr = *pIfs;
+   char magic[sizeof(kCommitGraphMagic) - 1];
+   std::string root, rev, refsHash;
+   uint64_t nodeCount;
+   if (!istr.read(magic, sizeof(magic)) ||
+       std::string(magic, sizeof(magic)) !=
+         std::string(kCommitGraphMagic, sizeof(magic)) ||
+       !readString(istr, kMaxStringSize, &root) ||
+       !readString(istr, kMaxStringSize, &rev) ||
+       !readString(istr, kMaxStringSize, &refsHash) ||
+       !readUInt(istr, 4, &nodeCount) ||
+       nodeCount > kMaxCount)
+   {
+      LOG_ERROR_MESSAGE("Error reading commit graph " +
+                        cachePath_.getAbsolutePath());
+      return;
+   }
+
+   // (saved for another repository)
+   if (root != root_.getAbsolutePath())
+      return;
+
+   std::vector<Node> history;
+   bool valid = true;
+   for (uint64_t i = 0; valid && i < nodeCount; i++)
+   {
+      Node node;
+      uint64_t parentCount;
+      valid = readString(istr, kMaxStringSize, &node.id) &&
+              readUInt(istr, 2, &parentCount);
+
+      for (uint64_t j = 0; valid && j < parentCount; j++)
+      {
+         std::string parent;
+         valid = readString(istr, kMaxStringSize, &parent);
+         node.parents.push_back(parent);
+      }
+
+      history.push_back(node);
+   }
+
+   uint64_t commitCount;
+   valid = valid &&
+           readUInt(istr, 4, &commitCount) &&
+           commitCount <= kMaxCount;
+
+   std::unordered_map<std::string, CommitInfo> commits;
+   for (uint64_t i = 0; valid && i < commitCount; i++)
+   {
+      CommitInfo commit;
+      valid = readCommit(istr, &commit);
+      commits[commit.id] = commit;
+   }
+
+   // (a truncated or corrupt file is discarded entirely)
+   if (!valid)
+   {
+      LOG_ERROR_MESSAGE("Error reading commit graph " +
+                        cachePath_.getAbsolutePath());
+      return;
+   }
+
+   // the index of the commits follows them (and is re-created if it's
+   // missing, e.g. in files saved before there was one)
+   CommitIndex index;
+   if (!index.read(istr) || index.size() != commits.size())
+   {
+      index.clear();
+      for (const auto& commit : commits)
+         index.add(commit.second);
+      dirty_ = true;
+   }
+
+   // the graph is cheap to re-create
+   rev_ = rev;
+   refsHash_ = refsHash;
+   clearHistory();
+   for (const Node& node : history)
+      addNode(node);
+   commits_.swap(commits);
+   index_ = index;
+}
+
+void CommitGraph::save()
+{
+   using namespace core::binary;
+
+   if (!dirty_ || cachePath_.isEmpty())
+      return;
+
+   dirty_ = false;
+
+   // write to a temporary file and then move it into place, so that a
+   // session which exits mid-write doesn't leave a truncated file
+   FilePath tempPath(cachePath_.getAbsolutePath() + ".tmp");
+   std::shared_ptr<std::ostream> pOfs;
+   Error error = tempPath.openForWrite(pOfs);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // save the history read along with its commits (rather than all
+   // commits ever read, e.g. those of other branches)
+   std::ostream& ostr = *pOfs;
+   ostr.write(kCommitGraphMagic, sizeof(kCommitGraphMagic) - 1);
+   writeString(ostr, root_.getAbsolutePath());
+   writeString(ostr, rev_);
+   writeString(ostr, refsHash_);
+   writeUInt(ostr, history_.size(), 4);
+
+   std::vector<const CommitInfo*> commits;
+   for (const Node& node : history_)
+   {
+      writeString(ostr, node.id);
+      writeUInt(ostr, node.parents.size(), 2);
+      for (const std::string& parent : node.parents)
+         writeString(ostr, parent);
+
+      std::unordered_map<std::string, CommitInfo>::const_iterator it =
+            commits_.find(node.id);
+      if (it != commits_.end())
+         commits.push_back(&it->second);
+   }
+
+   writeUInt(ostr, commits.size(), 4);
+   for (const CommitInfo* pCommit : commits)
+      writeCommit(ostr, *pCommit);
+
+   // (the index covers every commit read, so is re-created for those saved
+   // if there are others)
+   if (index_.size() == commits.size())
+   {
+      index_.write(ostr);
+   }
+   else
+   {
+      CommitIndex index;
+      for (const CommitInfo* pCommit : commits)
+         index.add(*pCommit);
+      index.write(ostr);
+   }
+
+   ostr.flush();
+   if (ostr.fail())
+   {
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", tempPath.getAbsolutePath());
+      LOG_ERROR(error);
+      return;
+   }
+   pOfs.reset();
+
+   error = tempPath.move(cachePath_, FilePath::MoveCrossDevice, true);
+   if (error)
+      LOG_ERROR(error);
+}
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,195 @@
+/*
+ * SessionGitCommitGraph.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_GIT_COMMIT_GRAPH_HPP
+#define SESSION_GIT_COMMIT_GRAPH_HPP
+
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+
+#include <core/GitGraph.hpp>
+#include <core/system/ShellUtils.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+struct CommitInfo
+{
+   CommitInfo() : date(0) {}
+
+   std::string id;
+   std::string author;
+   std::string subject;
+   std::string description;
+   std::string parent;
+   boost::int64_t date; // millis since epoch, UTC
+   std::vector<std::string> refs;
+   std::vector<std::string> tags;
+   std::string graph;
+};
+
+// parses the output of `git log --pretty=raw`, calling onCommit for each
+// commit (in order) until it returns false
+void parseRawLog(const std::string& output,
+                 const boost::function<bool(const CommitInfo&)>& onCommit);
+
+// does the commit's author, message or id contain each of the patterns
+// (ignoring case)?
+bool commitIsMatch(const std::vector<std::string>& patterns,
+                   const CommitInfo& commit);
+
+// An index of the words (runs of characters other than whitespace) of
+// commits' authors, messages and ids. Search patterns don't contain
+// whitespace, so a commit can only contain a pattern if one of its words
+// does; the words containing a pattern are found by scanning the (much
+// shorter) list of distinct words, rather than every commit.
+class CommitIndex
+{
+public:
+   CommitIndex() {}
+
+   void add(const CommitInfo& commit);
+   bool contains(const std::string& id) const;
+   std::size_t size() const { return ids_.size(); }
+   void clear();
+
+   // the ids of the commits which contain each of the patterns, ignoring
+   // case (as commitIsMatch does)
+   void find(const std::vector<std::string>& patterns,
+             std::vector<std::string>* pIds) const;
+
+   void write(std::ostream& ostr) const;
+   bool read(std::istream& istr);
+
+private:
+   // commits are numbered in the order they're added, so each word's
+   // postings are in ascending order
+   std::vector<std::string> ids_;
+   std::unordered_map<std::string, boost::uint32_t> ordinals_;
+   std::vector<std::string> words_;
+   std::unordered_map<std::string, boost::uint32_t> wordIndexes_;
+   std::vector<std::vector<boost::uint32_t> > postings_;
+};
+
+// The commits of a repository's history, in the (date) order shown by the
+// history viewer, along with the lines of its graph. Commits are read as
+// they're first needed and are kept by id, so when the refs move (e.g. with
+// a new commit) only commits which haven't been seen before are read; the
+// order of the history and its graph are re-derived from `git rev-list`,
+// which is cheap. The commits read are saved between sessions, along with
+// an index of them which answers searches of the history.
+class CommitGraph : boost::noncopyable
+{
+public:
+   typedef boost::function<core::Error(const core::shell_utils::ShellArgs&,
+                                       std::string*)> RunGit;
+
+   explicit CommitGraph(const RunGit& runGit);
+
+   // set the repository (with where to save its commits, if anywhere)
+   void setRoot(const core::FilePath& root, const core::FilePath& cachePath);
+
+   // the commits from skip to skip + count of the history of rev (HEAD if
+   // it's empty)
+   core::Error commits(const std::string& rev,
+                       int skip,
+                       int count,
+                       std::vector<CommitInfo>* pCommits);
+
+   // the number of commits in the history of rev
+   core::Error length(const std::string& rev, int* pLength);
+
+   // the commits from skip to skip + count of those in the history of rev
+   // which match each of the patterns (without graph lines, which don't
+   // apply to a part of the history)
+   core::Error search(const std::string& rev,
+                      const std::vector<std::string>& patterns,
+                      int skip,
+                      int count,
+                      std::vector<CommitInfo>* pCommits);
+
+   // the number of commits in the history of rev which match the patterns
+   core::Error searchLength(const std::string& rev,
+                            const std::vector<std::string>& patterns,
+                            int* pLength);
+
+   void save();
+
+private:
+   struct Node
+   {
+      std::string id;
+      std::vector<std::string> parents;
+   };
+
+   void clearHistory();
+   void addNode(const Node& node);
+   core::Error update(const std::string& rev);
+   core::Error extend(std::size_t count);
+   core::Error readCommits(std::size_t begin, std::size_t end);
+   core::Error readHistory();
+   core::Error findMatches(const std::string& rev,
+                           const std::vector<std::string>& patterns);
+   void addCommit(const CommitInfo& commit);
+   CommitInfo decoratedCommit(const std::string& id) const;
+   void load();
+
+   RunGit runGit_;
+   core::FilePath root_;
+   core::FilePath cachePath_;
+   bool loaded_;
+   bool dirty_;
+
+   // the history is for the given rev with the refs in a given state
+   std::string rev_;
+   std::string refsHash_;
+   std::unordered_map<std::string, std::string> decorations_;
+
+   // the (leading part of the) history and its graph lines
+   std::vector<Node> history_;
+   std::vector<std::string> graphLines_;
+   boost::scoped_ptr<core::gitgraph::GitGraph> pGraph_;
+   bool complete_;
+   int length_;
+
+   // commits by id (without refs or tags, which are given by decorations_)
+   std::unordered_map<std::string, CommitInfo> commits_;
+   CommitIndex index_;
+
+   // the positions in the history of the commits matching the last
+   // patterns searched for (kept for paging through them)
+   std::vector<std::string> patterns_;
+   std::vector<std::size_t> matches_;
+   bool matched_;
+};
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_GIT_COMMIT_GRAPH_HPP
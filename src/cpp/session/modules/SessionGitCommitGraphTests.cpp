@@ -0,0 +1,341 @@
+/*
+ * SessionGitCommitGraphTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitCommitGraph.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <shared_core/SafeConvert.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+// a repository (newest commit first) which answers the git commands
+// used by CommitGraph
+class FakeRepository
+{
+public:
+   FakeRepository() : commitsRead(0), logsRead(0) {}
+
+   void commit(const std::string& id,
+               const std::string& parents,
+               const std::string& subject = std::string())
+   {
+      ids_.insert(ids_.begin(), id);
+      parents_.insert(parents_.begin(), parents);
+      subjects_.insert(subjects_.begin(), subject.empty() ? "Subject " + id : subject);
+   }
+
+   Error runGit(const shell_utils::ShellArgs& shellArgs, std::string* pOutput)
+   {
+      std::vector<std::string> args = shellArgs.args();
+      pOutput->clear();
+
+      if (args[0] == "log" && args[1] == "--no-walk")
+      {
+         *pOutput = ids_.front() + " (HEAD -> refs/heads/main)\n";
+      }
+      else if (args[0] == "rev-list" && args[1] == "--count")
+      {
+         *pOutput = safe_convert::numberToString(ids_.size()) + "\n";
+      }
+      else if (args[0] == "rev-list")
+      {
+         std::size_t skip = safe_convert::stringTo<std::size_t>(args[3].substr(7), 0);
+         std::size_t count = safe_convert::stringTo<std::size_t>(args[4].substr(12), 0);
+         for (std::size_t i = skip; i < ids_.size() && i < skip + count; i++)
+         {
+            *pOutput += ids_[i];
+            if (!parents_[i].empty())
+               *pOutput += " " + parents_[i];
+            *pOutput += "\n";
+         }
+      }
+      else if (args[0] == "log")
+      {
+         logsRead++;
+         for (const std::string& arg : args)
+         {
+            if (boost::algorithm::starts_with(arg, "--"))
+               continue;
+
+            for (std::size_t i = 0; i < ids_.size(); i++)
+            {
+               if (ids_[i] != arg && arg != "HEAD")
+                  continue;
+
+               commitsRead++;
+               *pOutput += "commit " + ids_[i] + "\n";
+               if (!parents_[i].empty())
+                  *pOutput += "parent " + parents_[i] + "\n";
+               *pOutput += "author Jo <jo@example.com> 1600000000 +0100\n"
+                           "committer Jo <jo@example.com> 1600000000 +0100\n"
+                           "\n"
+                           "    " + subjects_[i] + "\n"
+                           "\n";
+            }
+         }
+      }
+
+      return Success();
+   }
+
+   int commitsRead;
+   int logsRead;
+
+private:
+   std::vector<std::string> ids_;
+   std::vector<std::string> parents_;
+   std::vector<std::string> subjects_;
+};
+
+CommitGraph::RunGit runGit(FakeRepository* pRepo)
+{
+   return [=](const shell_utils::ShellArgs& args, std::string* pOutput) {
+      return pRepo->runGit(args, pOutput);
+   };
+}
+
+std::vector<std::string> ids(const std::vector<CommitInfo>& commits)
+{
+   std::vector<std::string> ids;
+   for (const CommitInfo& commit : commits)
+      ids.push_back(commit.id);
+   return ids;
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionGitCommitGraph")
+{
+   SECTION("Raw logs are parsed")
+   {
+      std::string output =
+            "commit abc123 (HEAD -> refs/heads/main, tag: refs/tags/v1.0)\n"
+            "tree def456\n"
+            "parent 111111\n"
+            "parent 222222\n"
+            "author Jo Bloggs <jo@example.com> 1600000000 +0100\n"
+            "committer Jo Bloggs <jo@example.com> 1600000000 +0100\n"
+            "gpgsig -----BEGIN PGP SIGNATURE-----\n"
+            " abcdef\n"
+            " -----END PGP SIGNATURE-----\n"
+            "\n"
+            "    Merge branch 'feature'\n"
+            "    \n"
+            "    Details.\n"
+            "\n"
+            "commit 111111\n"
+            "author Jo Bloggs <jo@example.com> 1500000000 +0000\n"
+            "committer Jo Bloggs <jo@example.com> 1500000000 +0000\n"
+            "\n"
+            "    Initial commit\n";
+
+      std::vector<CommitInfo> commits;
+      parseRawLog(output, [&](const CommitInfo& commit) {
+         commits.push_back(commit);
+         return true;
+      });
+
+      REQUIRE(commits.size() == 2);
+      CHECK(commits[0].id == "abc123");
+      CHECK(commits[0].parent == "111111 222222");
+      CHECK(commits[0].author == "Jo Bloggs <jo@example.com>");
+      CHECK(commits[0].date == 1600000000 - 3600);
+      CHECK(commits[0].subject == "Merge branch 'feature'");
+      CHECK(commits[0].description == "Merge branch 'feature'\n\nDetails.");
+      REQUIRE(commits[0].refs.size() == 1);
+      CHECK(commits[0].refs[0] == "HEAD -> refs/heads/main");
+      REQUIRE(commits[0].tags.size() == 1);
+      CHECK(commits[0].tags[0] == "refs/tags/v1.0");
+      CHECK(commits[1].subject == "Initial commit");
+   }
+
+   SECTION("Pages of the history are read as needed")
+   {
+      FakeRepository repo;
+      std::vector<std::string> ids;
+      for (int i = 0; i < 50; i++)
+      {
+         std::string id = "c" + safe_convert::numberToString(i);
+         repo.commit(id, ids.empty() ? "" : ids.back());
+         ids.push_back(id);
+      }
+
+      CommitGraph graph(runGit(&repo));
+      graph.setRoot(FilePath("/repo"), FilePath());
+
+      std::vector<CommitInfo> commits;
+      REQUIRE_FALSE(graph.commits("", 10, 5, &commits));
+      REQUIRE(commits.size() == 5);
+      CHECK(commits[0].id == "c39");
+      CHECK(commits[0].subject == "Subject c39");
+      CHECK(commits[0].parent == "c38");
+      CHECK(repo.commitsRead == 5);
+
+      // the head of the history is decorated
+      REQUIRE_FALSE(graph.commits("", 0, 1, &commits));
+      REQUIRE(commits.size() == 1);
+      REQUIRE(commits[0].refs.size() == 1);
+      CHECK(commits[0].refs[0] == "HEAD -> refs/heads/main");
+
+      int length = 0;
+      REQUIRE_FALSE(graph.length("", &length));
+      CHECK(length == 50);
+
+      // after a new commit only that commit is read
+      repo.commitsRead = 0;
+      repo.commit("c50", "c49");
+      REQUIRE_FALSE(graph.commits("", 0, 2, &commits));
+      REQUIRE(commits.size() == 2);
+      CHECK(commits[0].id == "c50");
+      CHECK(commits[1].id == "c49");
+      CHECK(repo.commitsRead == 1);
+
+      // pages past the end of the history are empty
+      REQUIRE_FALSE(graph.commits("", 100, 10, &commits));
+      CHECK(commits.empty());
+   }
+
+   SECTION("Commits are found by the words containing the patterns")
+   {
+      CommitIndex index;
+      CommitInfo commit;
+      commit.id = "abc123";
+      commit.author = "Jo Bloggs <jo@example.com>";
+      commit.description = "Fix plotting\n\nOf large data.";
+      index.add(commit);
+      commit.id = "def456";
+      commit.description = "Add tests";
+      index.add(commit);
+
+      std::vector<std::string> found;
+      index.find({ "PLOT", "bloggs" }, &found);
+      CHECK(found == std::vector<std::string>({ "abc123" }));
+      index.find({ "456" }, &found);
+      CHECK(found == std::vector<std::string>({ "def456" }));
+      index.find({ "", "example.com" }, &found);
+      CHECK(found.size() == 2);
+      index.find({ "test", "plot" }, &found);
+      CHECK(found.empty());
+
+      // (patterns with whitespace are left to the caller)
+      index.find({ "large data" }, &found);
+      CHECK(found.size() == 2);
+   }
+
+   SECTION("Searches are answered from the index")
+   {
+      FakeRepository repo;
+      std::vector<std::string> commitIds;
+      for (int i = 0; i < 1200; i++)
+      {
+         std::string id = "c" + safe_convert::numberToString(i);
+         repo.commit(id, commitIds.empty() ? "" : commitIds.back(),
+                     i % 100 == 0 ? "Fix plot " + id : "");
+         commitIds.push_back(id);
+      }
+
+      FilePath cachePath;
+      REQUIRE_FALSE(FilePath::tempFilePath(cachePath));
+
+      CommitGraph graph(runGit(&repo));
+      graph.setRoot(FilePath("/repo"), cachePath);
+
+      // the history is read with one process
+      int length = 0;
+      REQUIRE_FALSE(graph.searchLength("", { "FIX", "plot" }, &length));
+      CHECK(length == 12);
+      CHECK(repo.logsRead == 1);
+      CHECK(repo.commitsRead == 1200);
+
+      // and pages of the matches are given in the order of the history
+      std::vector<CommitInfo> commits;
+      REQUIRE_FALSE(graph.search("", { "fix", "plot" }, 1, 3, &commits));
+      CHECK(ids(commits) == std::vector<std::string>({ "c1000", "c900", "c800" }));
+      REQUIRE_FALSE(graph.search("", { "fix", "plot" }, 10, 5, &commits));
+      CHECK(ids(commits) == std::vector<std::string>({ "c100", "c0" }));
+      REQUIRE_FALSE(graph.search("", { "fix", "c11" }, 0, 5, &commits));
+      CHECK(ids(commits) == std::vector<std::string>({ "c1100" }));
+      REQUIRE_FALSE(graph.search("", { "plot  fix" }, 0, 5, &commits));
+      CHECK(commits.empty());
+      CHECK(repo.commitsRead == 1200);
+
+      // matches are decorated
+      repo.commit("c1200", "c1199", "Fix plot again");
+      REQUIRE_FALSE(graph.search("", { "plot" }, 0, 1, &commits));
+      REQUIRE(commits.size() == 1);
+      CHECK(commits[0].id == "c1200");
+      REQUIRE(commits[0].refs.size() == 1);
+      CHECK(commits[0].refs[0] == "HEAD -> refs/heads/main");
+      CHECK(repo.commitsRead == 1201);
+
+      // the index is saved along with the commits
+      graph.save();
+      repo.commitsRead = 0;
+      CommitGraph savedGraph(runGit(&repo));
+      savedGraph.setRoot(FilePath("/repo"), cachePath);
+      REQUIRE_FALSE(savedGraph.searchLength("", { "plot" }, &length));
+      CHECK(length == 13);
+      CHECK(repo.commitsRead == 0);
+
+      cachePath.removeIfExists();
+   }
+
+   SECTION("Graph lines match those of the full history")
+   {
+      FakeRepository repo;
+      repo.commit("a", "");
+      repo.commit("b", "a");
+      repo.commit("c", "a");
+      repo.commit("d", "b c");
+      repo.commit("e", "d");
+
+      gitgraph::GitGraph fullGraph;
+      std::vector<std::string> lines;
+      lines.push_back(fullGraph.addCommit("e", { "d" }).string());
+      lines.push_back(fullGraph.addCommit("d", { "b", "c" }).string());
+      lines.push_back(fullGraph.addCommit("c", { "a" }).string());
+      lines.push_back(fullGraph.addCommit("b", { "a" }).string());
+      lines.push_back(fullGraph.addCommit("a", {}).string());
+
+      CommitGraph graph(runGit(&repo));
+      graph.setRoot(FilePath("/repo"), FilePath());
+
+      std::vector<CommitInfo> commits;
+      for (int i = 0; i < 5; i++)
+      {
+         REQUIRE_FALSE(graph.commits("", i, 1, &commits));
+         REQUIRE(commits.size() == 1);
+         CHECK(commits[0].graph == lines[i]);
+      }
+   }
+}
+
+} // end namespace tests
+} // end namespace git
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
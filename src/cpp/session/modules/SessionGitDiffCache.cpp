@@ -0,0 +1,276 @@
+/*
+ * SessionGitDiffCache.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitDiffCache.hpp"
+
+#include <algorithm>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/FileSerializer.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::shell_utils;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+namespace {
+
+// the number of files whose patches are read together
+const std::size_t kBatchSize = 20;
+
+// other files larger than this aren't read along with the file asked for
+const uintmax_t kMaxBatchedFileSize = 1024 * 1024;
+
+// patches read together aren't kept if there's more than this of them
+const std::size_t kMaxBatchOutputSize = 4 * 1024 * 1024;
+
+// patches begin with a header line "diff --git a/<path> b/<path>"
+const char kPatchStart[] = "\ndiff --git ";
+const char kDiffHeader[] = "diff --git a/";
+
+// (as in SessionGit.cpp) git understands UTF-8 paths natively
+ShellArgs gitArgs()
+{
+   return ShellArgs() << DefaultEncoding;
+}
+
+// can the patch for path be told apart from others by its header? (git
+// quotes paths with unusual characters in headers, and renames give two)
+bool isPlainPath(const std::string& path)
+{
+   if (path.empty() || path.find(" -> ") != std::string::npos)
+      return false;
+
+   for (char ch : path)
+   {
+      unsigned char uch = static_cast<unsigned char>(ch);
+      if (uch < 0x20 || uch >= 0x7f || ch == '"' || ch == '\\')
+         return false;
+   }
+
+   return true;
+}
+
+} // anonymous namespace
+
+std::map<std::string, std::string> splitDiff(const std::string& output)
+{
+   std::map<std::string, std::string> patches;
+
+   std::string::size_type begin = 0;
+   while (begin < output.size())
+   {
+      std::string::size_type end = output.find(kPatchStart, begin);
+      end = (end == std::string::npos) ? output.size() : end + 1;
+
+      std::string::size_type eol = output.find('\n', begin);
+      std::string header = output.substr(begin, std::min(eol, end) - begin);
+      std::size_t prefixSize = sizeof(kDiffHeader) - 1;
+      if (boost::algorithm::starts_with(header, kDiffHeader) &&
+          header.size() >= prefixSize + 3 &&
+          (header.size() - prefixSize - 3) % 2 == 0)
+      {
+         std::string path = header.substr(prefixSize, (header.size() - prefixSize - 3) / 2);
+         if (isPlainPath(path) && header == kDiffHeader + path + " b/" + path)
+            patches[path] = output.substr(begin, end - begin);
+      }
+
+      begin = end;
+   }
+
+   return patches;
+}
+
+DiffCache::DiffCache(const RunGit& runGit)
+   : runGit_(runGit)
+{
+}
+
+void DiffCache::setRoot(const FilePath& root)
+{
+   root_ = root;
+   gitDir_ = FilePath();
+   clear();
+}
+
+void DiffCache::clear()
+{
+   options_.clear();
+   stamp_.clear();
+   patches_.clear();
+}
+
+Error DiffCache::diff(const std::string& path,
+                      const std::vector<std::string>& changedPaths,
+                      bool cached,
+                      int contextLines,
+                      bool ignoreWhitespace,
+                      std::string* pPatch)
+{
+   pPatch->clear();
+
+   if (gitDir_.isEmpty())
+   {
+      std::string output;
+      Error error = runGit_(gitArgs() << "rev-parse" << "--git-dir", &output);
+      if (error)
+         return error;
+      gitDir_ = root_.completePath(boost::algorithm::trim_copy(output));
+   }
+
+   // patches depend on the index and (for staged changes) HEAD, and on the
+   // working copy of the file (for unstaged changes)
+   std::string options = (cached ? "cached:" : "working:") +
+                         safe_convert::numberToString(contextLines) +
+                         (ignoreWhitespace ? ":w" : "");
+   std::string stamp = readStamp();
+   if (options != options_ || stamp != stamp_ || stamp.empty())
+   {
+      patches_.clear();
+      options_ = options;
+      stamp_ = stamp;
+   }
+
+   std::map<std::string, Patch>::const_iterator it = patches_.find(path);
+   if (it != patches_.end() && (cached || it->second.fileStamp == fileStamp(path, 0)))
+   {
+      *pPatch = it->second.patch;
+      return Success();
+   }
+
+   // read the files after this one along with it
+   std::vector<std::string> batch;
+   batch.push_back(path);
+   if (isPlainPath(path))
+   {
+      std::vector<std::string> paths = changedPaths;
+      std::sort(paths.begin(), paths.end());
+      for (const std::string& changedPath : paths)
+      {
+         if (batch.size() == kBatchSize)
+            break;
+
+         if (changedPath <= path || !isPlainPath(changedPath))
+            continue;
+
+         FilePath filePath = root_.completeChildPath(changedPath);
+         if (filePath.isRegularFile() && filePath.getSize() > kMaxBatchedFileSize)
+            continue;
+
+         batch.push_back(changedPath);
+      }
+   }
+
+   // files changing as they're read aren't kept
+   std::time_t started = std::time(nullptr);
+   std::vector<std::string> fileStamps;
+   for (const std::string& batchPath : batch)
+      fileStamps.push_back(cached ? std::string() : fileStamp(batchPath, started));
+
+   ShellArgs args = gitArgs() << "diff" << "--no-renames";
+   args << "-U" + safe_convert::numberToString(contextLines);
+   if (cached)
+      args << "--cached";
+   if (ignoreWhitespace)
+      args << "-w";
+   args << "--";
+   for (const std::string& batchPath : batch)
+      args << batchPath;
+
+   std::string output;
+   Error error = runGit_(args, &output);
+   if (error)
+      return error;
+
+   std::map<std::string, std::string> patches;
+   if (batch.size() == 1)
+      patches[path] = output;
+   else
+      patches = splitDiff(output);
+
+   *pPatch = patches[path];
+
+   if (stamp_.empty() || readStamp() != stamp_ || output.size() > kMaxBatchOutputSize)
+      return Success();
+
+   for (std::size_t i = 0; i < batch.size(); i++)
+   {
+      if (!cached && fileStamps[i].empty())
+         continue;
+
+      Patch& patch = patches_[batch[i]];
+      patch.fileStamp = fileStamps[i];
+      patch.patch = patches[batch[i]];
+   }
+
+   return Success();
+}
+
+std::string DiffCache::readStamp()
+{
+   std::vector<FilePath> filePaths;
+   filePaths.push_back(gitDir_.completeChildPath("index"));
+   filePaths.push_back(gitDir_.completeChildPath("HEAD"));
+   filePaths.push_back(gitDir_.completeChildPath("packed-refs"));
+
+   std::string head;
+   Error error = readStringFromFile(filePaths[1], &head);
+   if (!error && boost::algorithm::starts_with(head, "ref: "))
+      filePaths.push_back(gitDir_.completeChildPath(boost::algorithm::trim_copy(head.substr(5))));
+
+   // (state which is changing isn't identified)
+   std::time_t now = std::time(nullptr);
+   std::string stamp;
+   for (const FilePath& filePath : filePaths)
+   {
+      if (filePath.exists())
+      {
+         std::time_t lastWriteTime = filePath.getLastWriteTime();
+         if (lastWriteTime >= now - 1)
+            return std::string();
+
+         stamp += safe_convert::numberToString(lastWriteTime) + ":" +
+                  safe_convert::numberToString(filePath.getSize());
+      }
+      stamp += ";";
+   }
+   return stamp;
+}
+
+std::string DiffCache::fileStamp(const std::string& path, std::time_t since) const
+{
+   FilePath filePath = root_.completeChildPath(path);
+   if (!filePath.exists())
+      return "-";
+
+   std::time_t lastWriteTime = filePath.getLastWriteTime();
+   if (since != 0 && lastWriteTime >= since - 1)
+      return std::string();
+
+   return safe_convert::numberToString(lastWriteTime) + ":" +
+          safe_convert::numberToString(filePath.getSize());
+}
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,97 @@
+/*
+ * SessionGitDiffCache.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_GIT_DIFF_CACHE_HPP
+#define SESSION_GIT_DIFF_CACHE_HPP
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+
+#include <core/system/ShellUtils.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+// splits the output of `git diff` into the patches of each file, by the
+// path given in each patch's header (files whose paths git would quote
+// aren't included)
+std::map<std::string, std::string> splitDiff(const std::string& output);
+
+// Patches for the changed files of a repository. The patch for a file is
+// read along with those of the changed files after it (with one `git diff`)
+// so that stepping through the changes, as the review dialog does, needn't
+// run git for each file. Patches are kept while the file, the index and
+// HEAD are unchanged.
+class DiffCache : boost::noncopyable
+{
+public:
+   // runs git within the repository, failing if it does
+   typedef boost::function<core::Error(const core::shell_utils::ShellArgs&,
+                                       std::string*)> RunGit;
+
+   explicit DiffCache(const RunGit& runGit);
+
+   void setRoot(const core::FilePath& root);
+
+   void clear();
+
+   // the patch for path (relative to the root), as given by `git diff
+   // [--cached] -- <path>`; changedPaths are the paths of the repository's
+   // changed files (which may be read along with it)
+   core::Error diff(const std::string& path,
+                    const std::vector<std::string>& changedPaths,
+                    bool cached,
+                    int contextLines,
+                    bool ignoreWhitespace,
+                    std::string* pPatch);
+
+private:
+   struct Patch
+   {
+      std::string fileStamp;
+      std::string patch;
+   };
+
+   std::string readStamp();
+   // (empty if the file was written since the given time, or just before)
+   std::string fileStamp(const std::string& path, std::time_t since) const;
+
+   RunGit runGit_;
+   core::FilePath root_;
+   core::FilePath gitDir_;
+
+   // the options and state of the index and HEAD the patches are for
+   std::string options_;
+   std::string stamp_;
+
+   std::map<std::string, Patch> patches_;
+};
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_GIT_DIFF_CACHE_HPP
@@ -0,0 +1,180 @@
+/*
+ * SessionGitDiffCacheTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitDiffCache.hpp"
+
+#include <ctime>
+
+#include <core/FileSerializer.hpp>
+#include <core/system/Process.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+Error runCommand(const std::string& command,
+                 const FilePath& workingDir,
+                 std::string* pOutput = nullptr)
+{
+   system::ProcessOptions options;
+   options.workingDir = workingDir;
+
+   system::ProcessResult result;
+   Error error = system::runCommand(command, options, &result);
+   if (error)
+      return error;
+   if (result.exitStatus != EXIT_SUCCESS)
+      return systemError(boost::system::errc::operation_not_permitted, ERROR_LOCATION);
+
+   if (pOutput)
+      *pOutput = result.stdOut;
+   return Success();
+}
+
+// date the repository's files (and index) into the past, so that they
+// aren't taken to be changing
+void settle(const FilePath& root)
+{
+   std::time_t now = std::time(nullptr);
+   root.getChildrenRecursive([&](int, const FilePath& filePath) {
+      filePath.setLastWriteTime(now - 100);
+      return true;
+   });
+   runCommand("git update-index -q --refresh", root);
+   root.getChildrenRecursive([&](int, const FilePath& filePath) {
+      if (filePath.isWithin(root.completeChildPath(".git")))
+         filePath.setLastWriteTime(now - 50);
+      return true;
+   });
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionGitDiffCache")
+{
+   SECTION("Diffs are split into the patches of each file")
+   {
+      std::string first =
+            "diff --git a/R/a b.R b/R/a b.R\n"
+            "index 1111111..2222222 100644\n"
+            "--- a/R/a b.R\n"
+            "+++ b/R/a b.R\n"
+            "@@ -1 +1 @@\n"
+            "-diff --git a/x b/x\n"
+            "+y\n";
+      std::string second =
+            "diff --git a/R/c.R b/R/c.R\n"
+            "deleted file mode 100644\n";
+      std::string quoted =
+            "diff --git \"a/R/\\303\\251.R\" \"b/R/\\303\\251.R\"\n"
+            "deleted file mode 100644\n";
+
+      std::map<std::string, std::string> patches = splitDiff(first + quoted + second);
+      REQUIRE(patches.size() == 2);
+      CHECK(patches["R/a b.R"] == first);
+      CHECK(patches["R/c.R"] == second);
+   }
+
+   FilePath root;
+   REQUIRE_FALSE(FilePath::tempFilePath(root));
+   REQUIRE_FALSE(root.ensureDirectory());
+   REQUIRE_FALSE(runCommand("git init -q .", root));
+
+   std::vector<std::string> paths = { "R/a.R", "R/b.R", "R/c.R", "tests/d.R" };
+   for (const std::string& path : paths)
+   {
+      FilePath filePath = root.completeChildPath(path);
+      REQUIRE_FALSE(filePath.getParent().ensureDirectory());
+      REQUIRE_FALSE(writeStringToFile(filePath, "x <- 1\ny <- 2\n"));
+   }
+   REQUIRE_FALSE(runCommand("git add -A && "
+                            "git -c user.name=Test -c user.email=test@example.com commit -q -m init",
+                            root));
+   for (const std::string& path : paths)
+      REQUIRE_FALSE(writeStringToFile(root.completeChildPath(path), "x <- 1\ny <- 3\n" + path + "\n"));
+   settle(root);
+
+   int diffs = 0;
+   DiffCache cache([&](const shell_utils::ShellArgs& args, std::string* pOutput) {
+      std::string command = "git";
+      for (const std::string& arg : args.args())
+      {
+         command += " " + shell_utils::escape(arg);
+         if (arg == "diff")
+            diffs++;
+      }
+      return runCommand(command, root, pOutput);
+   });
+   cache.setRoot(root);
+
+   SECTION("Patches are read together")
+   {
+      for (const std::string& path : paths)
+      {
+         std::string expected;
+         REQUIRE_FALSE(runCommand("git diff -U3 -- " + path, root, &expected));
+
+         std::string patch;
+         REQUIRE_FALSE(cache.diff(path, paths, false, 3, false, &patch));
+         CHECK(patch == expected);
+      }
+      CHECK(diffs == 1);
+   }
+
+   SECTION("Changed files are read again")
+   {
+      std::string patch;
+      REQUIRE_FALSE(cache.diff("R/a.R", paths, false, 3, false, &patch));
+
+      FilePath filePath = root.completeChildPath("R/b.R");
+      REQUIRE_FALSE(writeStringToFile(filePath, "x <- 2\ny <- 2\n"));
+      filePath.setLastWriteTime(std::time(nullptr) - 10);
+
+      std::string expected;
+      REQUIRE_FALSE(runCommand("git diff -U3 -- R/b.R", root, &expected));
+      REQUIRE_FALSE(cache.diff("R/b.R", paths, false, 3, false, &patch));
+      CHECK(patch == expected);
+      CHECK(diffs == 2);
+   }
+
+   SECTION("Patches are kept for the options they were read with")
+   {
+      std::string patch;
+      REQUIRE_FALSE(cache.diff("R/a.R", paths, false, 3, false, &patch));
+      REQUIRE_FALSE(cache.diff("R/b.R", paths, false, 0, false, &patch));
+
+      std::string expected;
+      REQUIRE_FALSE(runCommand("git diff -U0 -- R/b.R", root, &expected));
+      CHECK(patch == expected);
+      CHECK(diffs == 2);
+   }
+
+   root.removeIfExists();
+}
+
+} // end namespace tests
+} // end namespace git
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
@@ -0,0 +1,218 @@
+/*
+ * SessionGitObjectReader.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitObjectReader.hpp"
+
+#include <boost/thread/thread.hpp>
+
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+namespace {
+
+// give up on (and stop) a process which hasn't answered in this long
+const int kResponseTimeoutSeconds = 30;
+
+// how long to wait for a process being stopped to exit
+const int kExitTimeoutMs = 1000;
+
+} // anonymous namespace
+
+ObjectReader::ObjectReader(const CreateProcess& createProcess)
+   : createProcess_(createProcess),
+     exited_(false)
+{
+}
+
+ObjectReader::~ObjectReader()
+{
+   try
+   {
+      stop();
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+Error ObjectReader::read(const std::string& name,
+                         std::string* pType,
+                         std::string* pContents)
+{
+   pType->clear();
+   pContents->clear();
+
+   // names are given one per line
+   if (name.empty() || name.find_first_of("\r\n") != std::string::npos)
+      return systemError(boost::system::errc::invalid_argument, ERROR_LOCATION);
+
+   // a process which has been idle may have exited (e.g. if the repository
+   // was removed), so if writing to it fails we try once more with another
+   Error error;
+   for (int attempt = 0; attempt < 2; attempt++)
+   {
+      if (!pProcess_ || exited_)
+      {
+         error = start();
+         if (error)
+            return error;
+      }
+
+      output_.clear();
+      error = pProcess_->writeToStdin(name + "\n", false);
+      if (!error)
+         error = readResponse(name, pType, pContents);
+      if (!error)
+         return Success();
+
+      stop();
+   }
+
+   return error;
+}
+
+void ObjectReader::stop()
+{
+   if (pProcess_ && !exited_)
+   {
+      // the process exits at the end of its input; it's polled until it
+      // does so that it's reaped
+      Error error = pProcess_->writeToStdin(std::string(), true);
+      if (error)
+         LOG_ERROR(error);
+
+      for (int i = 0; i < 2 && !exited_; i++)
+      {
+         if (i == 1)
+         {
+            error = pProcess_->terminate();
+            if (error)
+               LOG_ERROR(error);
+         }
+
+         for (int ms = 0; ms < kExitTimeoutMs && !exited_; ms++)
+         {
+            pProcess_->poll();
+            if (!exited_)
+               boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+         }
+      }
+   }
+
+   pProcess_.reset();
+   output_.clear();
+   exited_ = false;
+}
+
+Error ObjectReader::start()
+{
+   stop();
+
+   pProcess_ = createProcess_();
+   if (!pProcess_)
+      return systemError(boost::system::errc::operation_not_permitted, ERROR_LOCATION);
+
+   core::system::ProcessCallbacks callbacks;
+   callbacks.onStdout = [this](core::system::ProcessOperations&, const std::string& output) {
+      output_.append(output);
+   };
+   callbacks.onExit = [this](int) {
+      exited_ = true;
+   };
+
+   Error error = pProcess_->run(callbacks);
+   if (error)
+   {
+      pProcess_.reset();
+      return error;
+   }
+
+   // the first poll readies the process's output for reading
+   pProcess_->poll();
+   return Success();
+}
+
+Error ObjectReader::readResponse(const std::string& name,
+                                 std::string* pType,
+                                 std::string* pContents)
+{
+   boost::posix_time::ptime deadline =
+         boost::posix_time::microsec_clock::universal_time() +
+         boost::posix_time::seconds(kResponseTimeoutSeconds);
+
+   while (true)
+   {
+      pProcess_->poll();
+
+      // the response is either "<name> missing" (or "ambiguous"), or
+      // "<id> <type> <size>" followed by the object's contents
+      std::string::size_type pos = output_.find('\n');
+      if (pos != std::string::npos)
+      {
+         std::string header = output_.substr(0, pos);
+         if (header == name + " missing" || header == name + " ambiguous")
+            return Success();
+
+         std::vector<std::string> fields;
+         std::string::size_type begin = 0;
+         while (fields.size() < 3)
+         {
+            std::string::size_type end = header.find(' ', begin);
+            fields.push_back(header.substr(begin, end - begin));
+            if (end == std::string::npos)
+               break;
+            begin = end + 1;
+         }
+
+         std::size_t size = fields.size() == 3 ?
+                  safe_convert::stringTo<std::size_t>(fields[2], std::string::npos) :
+                  std::string::npos;
+         if (size == std::string::npos)
+         {
+            Error error = systemError(boost::system::errc::protocol_error, ERROR_LOCATION);
+            error.addProperty("response", header);
+            return error;
+         }
+
+         // the contents are followed by a newline
+         if (output_.size() >= pos + 1 + size + 1)
+         {
+            *pType = fields[1];
+            *pContents = output_.substr(pos + 1, size);
+            output_.erase(0, pos + 1 + size + 1);
+            return Success();
+         }
+      }
+
+      if (exited_)
+         return systemError(boost::system::errc::broken_pipe, ERROR_LOCATION);
+
+      if (boost::posix_time::microsec_clock::universal_time() > deadline)
+         return systemError(boost::system::errc::timed_out, ERROR_LOCATION);
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+   }
+}
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,73 @@
+/*
+ * SessionGitObjectReader.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_GIT_OBJECT_READER_HPP
+#define SESSION_GIT_OBJECT_READER_HPP
+
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <shared_core/Error.hpp>
+
+#include <core/system/ChildProcess.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+// Reads objects from a repository through a long-lived `git cat-file
+// --batch` process, rather than running git for each one. The process is
+// started when first needed and again if it exits.
+class ObjectReader : boost::noncopyable
+{
+public:
+   // creates a (not yet running) `git cat-file --batch` process for the
+   // repository
+   typedef boost::function<boost::shared_ptr<core::system::AsyncChildProcess>()>
+                                                               CreateProcess;
+
+   explicit ObjectReader(const CreateProcess& createProcess);
+   ~ObjectReader();
+
+   // read the object with the given name (e.g. "HEAD:R/file.R"); *pType is
+   // its type ("blob", "tree", etc.) or empty if there's no such object
+   core::Error read(const std::string& name,
+                    std::string* pType,
+                    std::string* pContents);
+
+   void stop();
+
+private:
+   core::Error start();
+   core::Error readResponse(const std::string& name,
+                            std::string* pType,
+                            std::string* pContents);
+
+   CreateProcess createProcess_;
+   boost::shared_ptr<core::system::AsyncChildProcess> pProcess_;
+   std::string output_;
+   bool exited_;
+};
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_GIT_OBJECT_READER_HPP
@@ -0,0 +1,126 @@
+/*
+ * SessionGitObjectReaderTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitObjectReader.hpp"
+
+#include <boost/make_shared.hpp>
+
+#include <core/FileSerializer.hpp>
+#include <core/system/Process.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+Error runCommand(const std::string& command, const FilePath& workingDir)
+{
+   system::ProcessOptions options;
+   options.workingDir = workingDir;
+
+   system::ProcessResult result;
+   Error error = system::runCommand(command, options, &result);
+   if (error)
+      return error;
+   if (result.exitStatus != EXIT_SUCCESS)
+      return systemError(boost::system::errc::operation_not_permitted, ERROR_LOCATION);
+   return Success();
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionGitObjectReader")
+{
+   FilePath root;
+   REQUIRE_FALSE(FilePath::tempFilePath(root));
+   REQUIRE_FALSE(root.ensureDirectory());
+   REQUIRE_FALSE(runCommand("git init -q .", root));
+   REQUIRE_FALSE(writeStringToFile(root.completeChildPath("a.R"), "x <- 1\n"));
+   REQUIRE_FALSE(writeStringToFile(root.completeChildPath("b.R"), std::string(100000, 'b')));
+   REQUIRE_FALSE(runCommand("git add -A && "
+                            "git -c user.name=Test -c user.email=test@example.com commit -q -m init",
+                            root));
+
+   int processes = 0;
+   ObjectReader reader([&]() {
+      processes++;
+      system::ProcessOptions options;
+      options.workingDir = root;
+      return boost::make_shared<system::AsyncChildProcess>("git cat-file --batch", options);
+   });
+
+   SECTION("Objects are read by one process")
+   {
+      std::string type, contents;
+      REQUIRE_FALSE(reader.read("HEAD:a.R", &type, &contents));
+      CHECK(type == "blob");
+      CHECK(contents == "x <- 1\n");
+
+      REQUIRE_FALSE(reader.read("HEAD:b.R", &type, &contents));
+      CHECK(type == "blob");
+      CHECK(contents == std::string(100000, 'b'));
+
+      REQUIRE_FALSE(reader.read("HEAD:", &type, &contents));
+      CHECK(type == "tree");
+
+      CHECK(processes == 1);
+   }
+
+   SECTION("Missing objects have no type")
+   {
+      std::string type, contents;
+      REQUIRE_FALSE(reader.read("HEAD:missing.R", &type, &contents));
+      CHECK(type.empty());
+      CHECK(contents.empty());
+
+      // the process carries on
+      REQUIRE_FALSE(reader.read("HEAD:a.R", &type, &contents));
+      CHECK(contents == "x <- 1\n");
+      CHECK(processes == 1);
+   }
+
+   SECTION("Stopped processes are started again")
+   {
+      std::string type, contents;
+      REQUIRE_FALSE(reader.read("HEAD:a.R", &type, &contents));
+      reader.stop();
+      REQUIRE_FALSE(reader.read("HEAD:a.R", &type, &contents));
+      CHECK(contents == "x <- 1\n");
+      CHECK(processes == 2);
+   }
+
+   SECTION("Names spanning lines are rejected")
+   {
+      std::string type, contents;
+      CHECK(reader.read("HEAD:a.R\nHEAD:b.R", &type, &contents));
+   }
+
+   reader.stop();
+   root.removeIfExists();
+}
+
+} // end namespace tests
+} // end namespace git
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
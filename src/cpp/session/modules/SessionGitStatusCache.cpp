@@ -0,0 +1,474 @@
+/*
+ * SessionGitStatusCache.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitStatusCache.hpp"
+
+#include <ctime>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/Algorithm.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::shell_utils;
+using namespace rstudio::session::modules::source_control;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+namespace {
+
+// beyond this many changed paths the status is read in full
+const std::size_t kMaxChangedPaths = 1000;
+
+// changed paths are read this many at a time (keeping command lines short)
+const std::size_t kPathBatchSize = 100;
+
+// the status is read in full again after this many seconds, picking up
+// changes the file monitor doesn't report (hidden files within the
+// repository's directories, and files it filters out such as src/*.o)
+const std::time_t kMaxStatusAge = 60;
+
+// (as in SessionGit.cpp) git understands UTF-8 paths natively
+ShellArgs gitArgs()
+{
+   return ShellArgs() << DefaultEncoding;
+}
+
+// the directory containing a path relative to the root ("" for the root)
+std::string parentOf(const std::string& path)
+{
+   std::string::size_type pos = path.rfind('/');
+   return pos == std::string::npos ? std::string() : path.substr(0, pos);
+}
+
+bool isWithin(const std::string& path, const std::string& dir)
+{
+   return path.size() > dir.size() &&
+          path[dir.size()] == '/' &&
+          boost::algorithm::starts_with(path, dir);
+}
+
+} // anonymous namespace
+
+void parseStatus(const std::string& output,
+                 const FilePath& root,
+                 const boost::function<void(const std::string&,
+                                            const FileWithStatus&)>& onFile)
+{
+   // split and parse each piece of status output
+   std::vector<std::string> pieces = core::algorithm::split(output, "\0");
+
+   for (std::vector<std::string>::iterator it = pieces.begin();
+        it != pieces.end();
+        it++)
+   {
+      std::string line = *it;
+      if (line.length() < 4)
+         continue;
+      FileWithStatus file;
+
+      std::string status = line.substr(0, 2);
+      std::string filePath = line.substr(3);
+      file.status = status;
+
+      // remove trailing slashes
+      if (filePath.length() > 1 && filePath[filePath.length() - 1] == '/')
+         filePath = filePath.substr(0, filePath.size() - 1);
+      std::string path = filePath;
+
+      // if this was a git rename or copy, we need to capture the rename target from the next
+      // field. note that Git flips the order of filenames when running with '-z'
+      if ((status[0] == 'R' || status[0] == 'C') && it + 1 != pieces.end())
+         filePath = *(++it) + " -> " + filePath;
+
+      // file paths are returned as UTF-8 encoded paths,
+      // so no need to re-encode here
+      file.path = root.completeChildPath(filePath);
+
+      onFile(path, file);
+   }
+}
+
+StatusCache::StatusCache(const RunGit& runGit)
+   : runGit_(runGit),
+     valid_(false),
+     readTime_(0),
+     tooManyChanges_(false),
+     trackedDirsRead_(false)
+{
+}
+
+void StatusCache::setRoot(const FilePath& root)
+{
+   root_ = root;
+   gitDir_ = FilePath();
+   invalidate();
+}
+
+void StatusCache::invalidate()
+{
+   valid_ = false;
+   stamp_.clear();
+   changedPaths_.clear();
+   tooManyChanges_ = false;
+   entries_.clear();
+   trackedDirs_.clear();
+   trackedDirsRead_ = false;
+}
+
+void StatusCache::onFilesChanged(const std::vector<system::FileChangeEvent>& events)
+{
+   if (!valid_)
+      return;
+
+   for (const system::FileChangeEvent& event : events)
+   {
+      FilePath filePath(event.fileInfo().absolutePath());
+      if (filePath == root_ || !filePath.isWithin(root_))
+         continue;
+
+      std::string path = filePath.getRelativePath(root_);
+      if (path == ".git" || boost::algorithm::starts_with(path, ".git/"))
+         continue;
+
+      // a change to what's ignored may change the status of any file
+      if (filePath.getFilename() == ".gitignore")
+      {
+         invalidate();
+         return;
+      }
+
+      changedPaths_.insert(path);
+   }
+
+   if (changedPaths_.size() > kMaxChangedPaths)
+   {
+      tooManyChanges_ = true;
+      changedPaths_.clear();
+   }
+}
+
+Error StatusCache::status(const FilePath& dir, std::vector<FileWithStatus>* pFiles)
+{
+   pFiles->clear();
+
+   Error error;
+   if (!valid_ ||
+       tooManyChanges_ ||
+       std::time(nullptr) - readTime_ >= kMaxStatusAge ||
+       stamp_.empty() ||
+       readStamp() != stamp_)
+   {
+      error = refresh();
+   }
+   else
+      error = update();
+
+   if (error)
+   {
+      invalidate();
+      return error;
+   }
+
+   std::string path = (dir == root_) ? std::string() : dir.getRelativePath(root_);
+   if (!path.empty())
+   {
+      // git reports directories within untracked directories as untracked
+      if (untrackedAncestor(path) != path)
+      {
+         FileWithStatus file;
+         file.status = VCSStatus("??");
+         file.path = dir;
+         pFiles->push_back(file);
+         return Success();
+      }
+   }
+
+   for (auto it = entries_.lower_bound(path);
+        it != entries_.end() && boost::algorithm::starts_with(it->first, path);
+        it++)
+   {
+      if (path.empty() || it->first == path || isWithin(it->first, path))
+         pFiles->push_back(it->second);
+   }
+
+   return Success();
+}
+
+Error StatusCache::refresh()
+{
+   invalidate();
+
+   if (gitDir_.isEmpty())
+   {
+      std::string output;
+      Error error = runGit_(gitArgs() << "rev-parse" << "--git-dir", &output);
+      if (error)
+         return error;
+      gitDir_ = root_.completePath(boost::algorithm::trim_copy(output));
+   }
+
+   // the stamp is taken after the status is read (git may itself update
+   // the index), so what's changed since we started is considered changing
+   std::time_t started = std::time(nullptr);
+
+   std::string output;
+   Error error = runGit_(gitArgs() << "status" << "-z" << "--porcelain", &output);
+   if (error)
+      return error;
+   readTime_ = started;
+
+   parseStatus(output, root_, [&](const std::string& path, const FileWithStatus& file) {
+      entries_[path] = file;
+   });
+
+   stamp_ = readStamp();
+   for (const std::string& part : core::algorithm::split(stamp_, ";"))
+   {
+      std::string time = part.substr(0, part.find(':'));
+      std::time_t lastWriteTime = safe_convert::stringTo<std::time_t>(time, 0);
+      if (lastWriteTime >= started - 1)
+      {
+         stamp_.clear();
+         break;
+      }
+   }
+
+   valid_ = true;
+   return Success();
+}
+
+Error StatusCache::update()
+{
+   std::set<std::string> paths = changedPaths_;
+
+   // git only detects a staged rename (or copy) when both its paths are
+   // read, so while there are any the status is read in full (the changed
+   // path may be the rename's source, or its target read without it)
+   if (!paths.empty() && hasRenames())
+      return refresh();
+
+   // the file monitor doesn't report hidden files, so those at the top of
+   // the repository (e.g. .github, .Rbuildignore) are always read again
+   std::vector<FilePath> children;
+   Error error = root_.getChildren(children);
+   if (error)
+      LOG_ERROR(error);
+   for (const FilePath& child : children)
+   {
+      if (child.isHidden() && child.getFilename() != ".git")
+         paths.insert(child.getFilename());
+   }
+   for (const auto& entry : entries_)
+   {
+      if (boost::algorithm::starts_with(entry.first, "."))
+         paths.insert(entry.first.substr(0, entry.first.find('/')));
+   }
+
+   // git reports untracked directories as a whole, so changes within them
+   // are read for the (highest) untracked directory
+   std::set<std::string> targets;
+   for (const std::string& path : paths)
+      targets.insert(untrackedAncestor(path));
+
+   std::vector<std::string> batch;
+   for (const std::string& target : targets)
+   {
+      bool covered = false;
+      for (std::string dir = parentOf(target); !dir.empty() && !covered; dir = parentOf(dir))
+         covered = targets.count(dir) > 0;
+      if (covered)
+         continue;
+
+      batch.push_back(target);
+      if (batch.size() == kPathBatchSize)
+      {
+         error = updatePaths(batch);
+         if (error)
+            return error;
+         batch.clear();
+      }
+   }
+
+   if (!batch.empty())
+   {
+      error = updatePaths(batch);
+      if (error)
+         return error;
+   }
+
+   changedPaths_.clear();
+   return Success();
+}
+
+Error StatusCache::updatePaths(const std::vector<std::string>& paths)
+{
+   ShellArgs args = gitArgs() << "--literal-pathspecs" << "status" << "-z" << "--porcelain" << "--";
+   for (const std::string& path : paths)
+      args << path;
+
+   std::string output;
+   Error error = runGit_(args, &output);
+   if (error)
+      return error;
+
+   std::vector<std::pair<std::string, FileWithStatus> > files;
+   bool untracked = false;
+   parseStatus(output, root_, [&](const std::string& path, const FileWithStatus& file) {
+      files.push_back(std::make_pair(path, file));
+      untracked = untracked || file.status.status() == "??";
+   });
+
+   if (untracked && !trackedDirsRead_)
+   {
+      error = readTrackedDirs();
+      if (error)
+         return error;
+   }
+
+   for (const std::string& path : paths)
+      removeEntries(path);
+
+   for (auto& entry : files)
+   {
+      std::string path = entry.first;
+      FileWithStatus& file = entry.second;
+
+      // an untracked file read alone is reported as part of the highest
+      // directory containing it with no tracked files
+      if (file.status.status() == "??")
+      {
+         std::string top = path;
+         for (std::string dir = parentOf(path);
+              !dir.empty() && trackedDirs_.count(dir) == 0;
+              dir = parentOf(dir))
+         {
+            top = dir;
+         }
+
+         if (top != path)
+         {
+            removeEntries(top);
+            path = top;
+            file.path = root_.completeChildPath(top);
+         }
+      }
+
+      entries_[path] = file;
+   }
+
+   return Success();
+}
+
+Error StatusCache::readTrackedDirs()
+{
+   std::string output;
+   Error error = runGit_(gitArgs() << "ls-files" << "-z", &output);
+   if (error)
+      return error;
+
+   trackedDirs_.clear();
+   for (const std::string& path : core::algorithm::split(output, "\0"))
+   {
+      for (std::string dir = parentOf(path);
+           !dir.empty() && trackedDirs_.insert(dir).second;
+           dir = parentOf(dir))
+      {
+      }
+   }
+
+   trackedDirsRead_ = true;
+   return Success();
+}
+
+bool StatusCache::hasRenames() const
+{
+   for (const auto& entry : entries_)
+   {
+      char indexStatus = entry.second.status.status()[0];
+      if (indexStatus == 'R' || indexStatus == 'C')
+         return true;
+   }
+   return false;
+}
+
+std::string StatusCache::untrackedAncestor(const std::string& path) const
+{
+   std::string::size_type pos = 0;
+   while (true)
+   {
+      pos = path.find('/', pos);
+      std::string dir = path.substr(0, pos);
+
+      auto it = entries_.find(dir);
+      if (it != entries_.end() && it->second.status.status() == "??")
+         return dir;
+
+      if (pos == std::string::npos)
+         return path;
+      pos++;
+   }
+}
+
+void StatusCache::removeEntries(const std::string& path)
+{
+   entries_.erase(path);
+
+   std::string prefix = path + "/";
+   auto it = entries_.lower_bound(prefix);
+   while (it != entries_.end() && boost::algorithm::starts_with(it->first, prefix))
+      it = entries_.erase(it);
+}
+
+std::string StatusCache::readStamp()
+{
+   std::vector<FilePath> filePaths;
+   filePaths.push_back(gitDir_.completeChildPath("index"));
+   filePaths.push_back(gitDir_.completeChildPath("HEAD"));
+   filePaths.push_back(gitDir_.completeChildPath("packed-refs"));
+   filePaths.push_back(gitDir_.completeChildPath("info/exclude"));
+   filePaths.push_back(root_.completeChildPath(".gitignore"));
+
+   // the branch HEAD refers to moves on commits, resets, etc.
+   std::string head;
+   Error error = readStringFromFile(filePaths[1], &head);
+   if (!error && boost::algorithm::starts_with(head, "ref: "))
+      filePaths.push_back(gitDir_.completeChildPath(boost::algorithm::trim_copy(head.substr(5))));
+
+   std::string stamp;
+   for (const FilePath& filePath : filePaths)
+   {
+      if (filePath.exists())
+      {
+         stamp += safe_convert::numberToString(filePath.getLastWriteTime()) + ":" +
+                  safe_convert::numberToString(filePath.getSize());
+      }
+      stamp += ";";
+   }
+   return stamp;
+}
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
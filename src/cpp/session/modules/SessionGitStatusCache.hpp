@@ -0,0 +1,116 @@
+/*
+ * SessionGitStatusCache.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_GIT_STATUS_CACHE_HPP
+#define SESSION_GIT_STATUS_CACHE_HPP
+
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+
+#include <core/system/FileChangeEvent.hpp>
+#include <core/system/ShellUtils.hpp>
+
+#include "vcs/SessionVCSCore.hpp"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+
+// parses the output of `git status -z --porcelain` (run within root),
+// calling onFile with each file's path relative to root (its new path, for
+// renames and copies) and its status
+void parseStatus(const std::string& output,
+                 const core::FilePath& root,
+                 const boost::function<void(const std::string&,
+                                            const source_control::FileWithStatus&)>& onFile);
+
+// The status of the files of a repository. The status is read in full once
+// and then kept up to date with the changes reported by the file monitor:
+// only the paths which have changed are read again (with `git status --
+// <paths>`), and the status is read in full again only when the index, HEAD
+// or the repository's ignores change, while there are staged renames, or
+// once it's a minute old.
+class StatusCache : boost::noncopyable
+{
+public:
+   // runs git within the repository, failing if it does
+   typedef boost::function<core::Error(const core::shell_utils::ShellArgs&,
+                                       std::string*)> RunGit;
+
+   explicit StatusCache(const RunGit& runGit);
+
+   void setRoot(const core::FilePath& root);
+
+   // forget the status read (e.g. when changes may have gone unreported)
+   void invalidate();
+
+   void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events);
+
+   // the status of the files within dir
+   core::Error status(const core::FilePath& dir,
+                      std::vector<source_control::FileWithStatus>* pFiles);
+
+private:
+   core::Error refresh();
+   core::Error update();
+   core::Error updatePaths(const std::vector<std::string>& paths);
+   core::Error readTrackedDirs();
+   bool hasRenames() const;
+   std::string untrackedAncestor(const std::string& path) const;
+   void removeEntries(const std::string& path);
+   std::string readStamp();
+
+   RunGit runGit_;
+   core::FilePath root_;
+   core::FilePath gitDir_;
+   bool valid_;
+
+   // when the status was last read in full
+   std::time_t readTime_;
+
+   // identifies the state of the index, HEAD and ignores when the status
+   // was read in full (empty if they were changing at the time)
+   std::string stamp_;
+
+   // the paths (relative to root) changed since they were last read
+   std::set<std::string> changedPaths_;
+   bool tooManyChanges_;
+
+   // the files with a status, by path relative to root
+   std::map<std::string, source_control::FileWithStatus> entries_;
+
+   // the directories containing tracked files (git reports untracked
+   // directories which don't as a whole), read when first needed
+   std::unordered_set<std::string> trackedDirs_;
+   bool trackedDirsRead_;
+};
+
+} // namespace git
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_GIT_STATUS_CACHE_HPP
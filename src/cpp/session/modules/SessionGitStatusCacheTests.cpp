@@ -0,0 +1,299 @@
+/*
+ * SessionGitStatusCacheTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionGitStatusCache.hpp"
+
+#include <ctime>
+
+#include <core/FileSerializer.hpp>
+#include <core/system/Process.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace git {
+namespace tests {
+
+using namespace rstudio::core;
+using namespace rstudio::session::modules::source_control;
+
+namespace {
+
+typedef std::map<std::string, std::string> Statuses;
+
+// a scratch repository, with a record of the files changed in it
+class TestRepository
+{
+public:
+   TestRepository() : fullReads(0), pathReads(0)
+   {
+      Error error = FilePath::tempFilePath(root);
+      if (!error)
+         error = root.ensureDirectory();
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   ~TestRepository()
+   {
+      root.removeIfExists();
+   }
+
+   Error run(const std::string& command, std::string* pOutput = nullptr)
+   {
+      system::ProcessOptions options;
+      options.workingDir = root;
+
+      system::ProcessResult result;
+      Error error = system::runCommand(command, options, &result);
+      if (error)
+         return error;
+      if (result.exitStatus != EXIT_SUCCESS)
+         return systemError(boost::system::errc::operation_not_permitted, ERROR_LOCATION);
+
+      if (pOutput)
+         *pOutput = result.stdOut;
+      return Success();
+   }
+
+   Error runGit(const shell_utils::ShellArgs& args, std::string* pOutput)
+   {
+      std::string command = "git";
+      bool status = false;
+      bool paths = false;
+      for (const std::string& arg : args.args())
+      {
+         command += " " + shell_utils::escape(arg);
+         status = status || arg == "status";
+         paths = paths || arg == "--";
+      }
+
+      if (status)
+         paths ? pathReads++ : fullReads++;
+
+      return run(command, pOutput);
+   }
+
+   void write(const std::string& path, const std::string& contents = "x\n")
+   {
+      FilePath filePath = root.completeChildPath(path);
+      filePath.getParent().ensureDirectory();
+      writeStringToFile(filePath, contents);
+      changed(path);
+   }
+
+   void remove(const std::string& path)
+   {
+      root.completeChildPath(path).removeIfExists();
+      changed(path);
+   }
+
+   void changed(const std::string& path)
+   {
+      FilePath filePath = root.completeChildPath(path);
+      events.push_back(system::FileChangeEvent(system::FileChangeEvent::FileModified,
+                                               FileInfo(filePath)));
+   }
+
+   // date what's been written so far (including the index) into the past,
+   // so that it isn't taken to be changing
+   void settle()
+   {
+      std::time_t now = std::time(nullptr);
+      root.getChildrenRecursive([&](int, const FilePath& filePath) {
+         filePath.setLastWriteTime(now - 100);
+         return true;
+      });
+      run("git update-index -q --refresh");
+      root.getChildrenRecursive([&](int, const FilePath& filePath) {
+         if (filePath.isWithin(root.completeChildPath(".git")))
+            filePath.setLastWriteTime(now - 50);
+         return true;
+      });
+   }
+
+   // the status as read in full by git
+   Statuses expected()
+   {
+      std::string output;
+      run("git status -z --porcelain", &output);
+
+      Statuses statuses;
+      parseStatus(output, root, [&](const std::string&, const FileWithStatus& file) {
+         statuses[file.path.getRelativePath(root)] = file.status.status();
+      });
+      return statuses;
+   }
+
+   FilePath root;
+   std::vector<system::FileChangeEvent> events;
+   int fullReads;
+   int pathReads;
+};
+
+StatusCache::RunGit runGit(TestRepository* pRepo)
+{
+   return [=](const shell_utils::ShellArgs& args, std::string* pOutput) {
+      return pRepo->runGit(args, pOutput);
+   };
+}
+
+Statuses status(StatusCache& cache, TestRepository& repo, const FilePath& dir)
+{
+   cache.onFilesChanged(repo.events);
+   repo.events.clear();
+
+   std::vector<FileWithStatus> files;
+   Error error = cache.status(dir, &files);
+   if (error)
+      LOG_ERROR(error);
+
+   Statuses statuses;
+   for (const FileWithStatus& file : files)
+      statuses[file.path.getRelativePath(repo.root)] = file.status.status();
+   return statuses;
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionGitStatusCache")
+{
+   TestRepository repo;
+   REQUIRE_FALSE(repo.run("git init -q ."));
+   repo.write("README.md");
+   repo.write("R/a.R");
+   repo.write("R/b.R");
+   repo.write("tests/testthat/test-a.R");
+   repo.write(".gitignore", "*.o\n");
+   REQUIRE_FALSE(repo.run("git add -A && "
+                          "git -c user.name=Test -c user.email=test@example.com commit -q -m init"));
+   repo.settle();
+   repo.events.clear();
+
+   StatusCache cache(runGit(&repo));
+   cache.setRoot(repo.root);
+   REQUIRE(status(cache, repo, repo.root) == repo.expected());
+   CHECK(repo.fullReads == 1);
+
+   SECTION("Only changed paths are read again")
+   {
+      repo.write("R/a.R", "y\n");
+      repo.remove("R/b.R");
+      repo.write("R/c.R");
+      repo.write("src/a.o");
+
+      Statuses statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses["R/a.R"] == " M");
+      CHECK(statuses["R/b.R"] == " D");
+      CHECK(statuses["R/c.R"] == "??");
+      CHECK(repo.fullReads == 1);
+      CHECK(repo.pathReads > 0);
+
+      // reverting a change clears its status
+      repo.write("R/a.R", "x\n");
+      statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses.count("R/a.R") == 0);
+      CHECK(repo.fullReads == 1);
+   }
+
+   SECTION("Untracked directories are reported as a whole")
+   {
+      repo.write("data/raw/one.csv");
+      Statuses statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses["data"] == "??");
+
+      repo.write("data/raw/two.csv");
+      repo.write("tests/testthat/helpers/setup.R");
+      CHECK(status(cache, repo, repo.root) == repo.expected());
+
+      repo.remove("data/raw/one.csv");
+      repo.remove("data/raw/two.csv");
+      CHECK(status(cache, repo, repo.root) == repo.expected());
+      CHECK(repo.fullReads == 1);
+   }
+
+   SECTION("Hidden files are read without being reported")
+   {
+      repo.root.completeChildPath(".github").ensureDirectory();
+      writeStringToFile(repo.root.completeChildPath(".github/ci.yml"), "x\n");
+      Statuses statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses[".github"] == "??");
+   }
+
+   SECTION("Changes to the index are read in full")
+   {
+      repo.write("R/a.R", "y\n");
+      status(cache, repo, repo.root);
+
+      REQUIRE_FALSE(repo.run("git add R/a.R"));
+      Statuses statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses["R/a.R"] == "M ");
+      CHECK(repo.fullReads == 2);
+   }
+
+   SECTION("Staged renames are read in full")
+   {
+      REQUIRE_FALSE(repo.run("git mv R/b.R R/d.R"));
+      repo.settle();
+      Statuses statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses["R/b.R -> R/d.R"] == "R ");
+      CHECK(repo.fullReads == 2);
+
+      // read alone, the rename's target would be reported as added
+      repo.write("R/d.R", "y\n");
+      statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses["R/b.R -> R/d.R"] == "RM");
+      CHECK(repo.fullReads == 3);
+
+      // and its source as deleted
+      repo.write("R/b.R");
+      statuses = status(cache, repo, repo.root);
+      CHECK(statuses == repo.expected());
+      CHECK(statuses["R/b.R"] == "??");
+      CHECK(repo.fullReads == 4);
+   }
+
+   SECTION("The status of directories is given")
+   {
+      repo.write("R/a.R", "y\n");
+      repo.write("README.md", "y\n");
+      repo.write("data/raw/one.csv");
+
+      Statuses statuses = status(cache, repo, repo.root.completeChildPath("R"));
+      REQUIRE(statuses.size() == 1);
+      CHECK(statuses["R/a.R"] == " M");
+
+      // directories within untracked directories are themselves untracked
+      statuses = status(cache, repo, repo.root.completeChildPath("data/raw"));
+      REQUIRE(statuses.size() == 1);
+      CHECK(statuses["data/raw"] == "??");
+   }
+}
+
+} // end namespace tests
+} // end namespace git
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
@@ -104,23 +104,6 @@ Error setJsonResultFromHistory(int startIndex,
    return Success();
 }
    
-bool matches(const HistoryEntry& entry,
-             const std::vector<std::string>& searchTerms)
-{   
-   // look for each search term in the input
-   for (std::vector<std::string>::const_iterator it = searchTerms.begin();
-        it != searchTerms.end();
-        ++it)
-   {
-      if (!boost::algorithm::contains(entry.command, *it))
-         return false;
-   }
-   
-   // had all of the search terms, return true
-   return true;
-}
-
-
 void historyRangeAsJson(int startIndex,
                         int endIndex,
                         json::Object* pHistoryJson)
@@ -320,24 +303,14 @@ Error searchHistoryArchive(const json::JsonRpcRequest& request,
    boost::tokenizer<boost::char_separator<char> > tok(query, sep);
    std::copy(tok.begin(), tok.end(), std::back_inserter(searchTerms));
    
-   // examine the items in the history for matches
-   const std::vector<HistoryEntry>& allEntries = historyArchive().entries();
+   // find the most recent entries containing all of the terms
    std::vector<HistoryEntry> matchingEntries;
-   for (std::vector<HistoryEntry>::const_reverse_iterator 
-            it = allEntries.rbegin();
-            it != allEntries.rend();
-            ++it)
+   if (maxEntries > 0)
    {
-      // check limit
-      if (matchingEntries.size() >= static_cast<std::size_t>(maxEntries))
-         break;
-
-      // look for match
-      if (matches(*it, searchTerms))
-      {
-         // add entry
-         matchingEntries.push_back(*it);
-      }
+      historyArchive().search(searchTerms, [&](const HistoryEntry& entry) {
+         matchingEntries.push_back(entry);
+         return matchingEntries.size() < static_cast<std::size_t>(maxEntries);
+      });
    }
 
    // return json
@@ -362,28 +335,29 @@ Error searchHistoryArchiveByPrefix(const json::JsonRpcRequest& request,
    // trim the prefix
    boost::algorithm::trim(prefix);
    
-   // examine the items in the history for matches
-   const std::vector<HistoryEntry>& allEntries = historyArchive().entries();
+   // examine the entries containing the prefix for matches
+   std::vector<std::string> searchTerms;
+   if (!prefix.empty())
+      searchTerms.push_back(prefix);
+
    std::set<std::string> matchedCommands;
    std::vector<HistoryEntry> matchingEntries;
-   for (std::vector<HistoryEntry>::const_reverse_iterator 
-        it = allEntries.rbegin();
-        it != allEntries.rend();
-        ++it)
+   if (maxEntries > 0)
    {
-      // check limit
-      if (matchingEntries.size() >= static_cast<std::size_t>(maxEntries))
-         break;
-      
-      // look for match 
-      if (boost::algorithm::starts_with(it->command, prefix))
-      {
-         if (!uniqueOnly || (matchedCommands.count(it->command) == 0))
+      historyArchive().search(searchTerms, [&](const HistoryEntry& entry) {
+         // look for match
+         if (boost::algorithm::starts_with(entry.command, prefix))
          {
-            matchingEntries.push_back(*it);
-            matchedCommands.insert(it->command);
+            if (!uniqueOnly || (matchedCommands.count(entry.command) == 0))
+            {
+               matchingEntries.push_back(entry);
+               matchedCommands.insert(entry.command);
+            }
          }
-      }
+
+         // check limit
+         return matchingEntries.size() < static_cast<std::size_t>(maxEntries);
+      });
    }
    
    // return json
@@ -15,8 +15,15 @@
 
 #include "SessionHistoryArchive.hpp"
 
+#include <algorithm>
+#include <set>
 #include <string>
 
+#include <gsl/gsl>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
 #include <shared_core/Error.hpp>
 #include <core/Log.hpp>
 #include <shared_core/FilePath.hpp>
@@ -30,6 +37,7 @@
 
 #define kHistoryDatabase "history_database"
 #define kHistoryMaxBytes (750*1024)  // rotate/remove every 750K
+#define kTrigramSize 3
 
 using namespace rstudio::core;
 
@@ -119,8 +127,85 @@ ReadCollectionAction readHistoryEntry(const std::string& line,
    }
 }
 
+uint32_t trigramAt(const std::string& str, std::size_t pos)
+{
+   return (static_cast<uint32_t>(static_cast<unsigned char>(str[pos])) << 16) |
+          (static_cast<uint32_t>(static_cast<unsigned char>(str[pos + 1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(str[pos + 2]));
+}
+
 } // anonymous namespace
 
+void HistoryIndex::add(int index, const std::string& command)
+{
+   for (std::size_t i = 0; i + kTrigramSize <= command.size(); i++)
+   {
+      std::vector<int>& postings = postings_[trigramAt(command, i)];
+      if (postings.empty() || postings.back() != index)
+         postings.push_back(index);
+   }
+}
+
+void HistoryIndex::clear()
+{
+   postings_.clear();
+}
+
+void HistoryIndex::findCandidates(const std::vector<std::string>& terms,
+                                  int entryCount,
+                                  const boost::function<bool(int)>& onCandidate) const
+{
+   // an entry containing a term contains each of its trigrams
+   std::set<uint32_t> trigrams;
+   for (const std::string& term : terms)
+   {
+      for (std::size_t i = 0; i + kTrigramSize <= term.size(); i++)
+         trigrams.insert(trigramAt(term, i));
+   }
+
+   std::vector<const std::vector<int>*> postings;
+   for (uint32_t trigram : trigrams)
+   {
+      Postings::const_iterator it = postings_.find(trigram);
+
+      // no entry contains this trigram (so none can match)
+      if (it == postings_.end())
+         return;
+
+      postings.push_back(&it->second);
+   }
+
+   // with nothing to narrow by every entry is a candidate
+   if (postings.empty())
+   {
+      for (int index = entryCount - 1; index >= 0; index--)
+      {
+         if (!onCandidate(index))
+            return;
+      }
+      return;
+   }
+
+   // walk the shortest postings list, looking up its entries in the others
+   std::sort(postings.begin(), postings.end(),
+             [](const std::vector<int>* pLhs, const std::vector<int>* pRhs) {
+      return pLhs->size() < pRhs->size();
+   });
+
+   const std::vector<int>& shortest = *postings.front();
+   for (std::vector<int>::const_reverse_iterator it = shortest.rbegin();
+        it != shortest.rend();
+        ++it)
+   {
+      bool inAll = true;
+      for (std::size_t i = 1; inAll && i < postings.size(); i++)
+         inAll = std::binary_search(postings[i]->begin(), postings[i]->end(), *it);
+
+      if (inAll && !onCandidate(*it))
+         return;
+   }
+}
+
 HistoryArchive& historyArchive()
 {
    static HistoryArchive instance;
@@ -129,15 +214,11 @@ HistoryArchive& historyArchive()
 
 Error HistoryArchive::add(const std::string& command)
 {
-   // reset the cache (since this write will invalidate the current one,
-   // no sense in keeping our cache around in memory)
-   entries_.clear();
-   entryCacheLastWriteTime_ = -1;
-
    // rotate if necessary
    rotateHistoryDatabase();
 
-   // write the entry to the file
+   // write the entry to the file (our cache picks it up from there, along
+   // with entries written by other sessions)
    std::ostringstream ostrEntry;
    double currentTime = core::date_time::millisecondsSinceEpoch();
    writeEntry(currentTime, command, &ostrEntry);
@@ -153,54 +234,108 @@ const std::vector<HistoryEntry>& HistoryArchive::entries() const
    // if the file doesn't exist then clear the collection
    if (!historyDBPath.exists())
    {
-      entries_.clear();
+      clearEntries();
+      return entries_;
    }
 
-   // otherwise check for divergent lastWriteTime and read the file
-   // if our internal list isn't up to date
-   else if (historyDBPath.getLastWriteTime() != entryCacheLastWriteTime_)
+   // if the history db has been rotated since we read it then start over,
+   // reading the rotated file first
+   FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
+   std::uintmax_t rotatedSize = rotatedHistoryDBPath.getSize();
+   time_t rotatedLastWriteTime = rotatedHistoryDBPath.getLastWriteTime();
+   if (rotatedSize != rotatedSize_ ||
+       rotatedLastWriteTime != rotatedLastWriteTime_ ||
+       historyDBPath.getSize() < entryCacheOffset_)
    {
-      entries_.clear();
-
-      // establish a next index counter
-      int nextIndex = 0;
+      clearEntries();
+      rotatedSize_ = rotatedSize;
+      rotatedLastWriteTime_ = rotatedLastWriteTime;
 
-      // first read from rotated file if it exists
-      FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
       if (rotatedHistoryDBPath.exists())
       {
-         Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           rotatedHistoryDBPath,
-                           &entries_,
-                           boost::bind(readHistoryEntry, _1, _2, &nextIndex));
+         std::uintmax_t offset = 0;
+         Error error = readEntries(rotatedHistoryDBPath, &offset);
          if (error)
             LOG_ERROR(error);
       }
+   }
 
-
-      // now read from main history db
-      std::vector<HistoryEntry> entries;
-      Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           historyDBPath,
-                           &entries,
-                           boost::bind(readHistoryEntry, _1, _2, &nextIndex));
+   // now read whatever has been appended to the main history db
+   if (historyDBPath.getSize() > entryCacheOffset_)
+   {
+      Error error = readEntries(historyDBPath, &entryCacheOffset_);
       if (error)
-      {
          LOG_ERROR(error);
-      }
-      else
-      {
-         std::copy(entries.begin(),
-                   entries.end(),
-                   std::back_inserter(entries_));
+   }
+
+   // return entries
+   return entries_;
+}
 
-         entryCacheLastWriteTime_ = historyDBPath.getLastWriteTime();
+void HistoryArchive::search(
+      const std::vector<std::string>& terms,
+      const boost::function<bool(const HistoryEntry&)>& onMatch) const
+{
+   const std::vector<HistoryEntry>& allEntries = entries();
+   index_.findCandidates(
+            terms,
+            gsl::narrow_cast<int>(allEntries.size()),
+            [&](int index) {
+      const HistoryEntry& entry = allEntries[index];
+      for (const std::string& term : terms)
+      {
+         if (!boost::algorithm::contains(entry.command, term))
+            return true;
       }
+      return onMatch(entry);
+   });
+}
 
+void HistoryArchive::clearEntries() const
+{
+   entries_.clear();
+   index_.clear();
+   entryCacheOffset_ = 0;
+   rotatedSize_ = 0;
+   rotatedLastWriteTime_ = -1;
+}
+
+Error HistoryArchive::readEntries(const FilePath& filePath,
+                                  std::uintmax_t* pOffset) const
+{
+   std::shared_ptr<std::istream> pIfs;
+   Error error = filePath.openForRead(pIfs);
+   if (error)
+      return error;
+
+   pIfs->seekg(static_cast<std::streamoff>(*pOffset));
+   if (pIfs->fail())
+      return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+
+   std::string line;
+   while (std::getline(*pIfs, line))
+   {
+      // leave a line which is still being written for next time
+      if (pIfs->eof())
+         break;
+
+      *pOffset += line.size() + 1;
+
+      boost::algorithm::trim(line);
+      if (line.empty())
+         continue;
+
+      // (entries are indexed by their position)
+      HistoryEntry entry;
+      int nextIndex = gsl::narrow_cast<int>(entries_.size());
+      if (readHistoryEntry(line, &entry, &nextIndex) == ReadCollectionAddLine)
+      {
+         index_.add(entry.index, entry.command);
+         entries_.push_back(entry);
+      }
    }
 
-   // return entries
-   return entries_;
+   return Success();
 }
 
 void HistoryArchive::migrateRhistoryIfNecessary()
@@ -16,9 +16,13 @@
 #ifndef SESSION_HISTORY_ARCHIVE_HPP
 #define SESSION_HISTORY_ARCHIVE_HPP
 
+#include <cstdint>
+#include <ctime>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <boost/function.hpp>
 #include <boost/utility.hpp>
 
 namespace rstudio {
@@ -45,13 +49,41 @@ struct HistoryEntry
    std::string command;
 };
 
+// Index of the trigrams (three byte sequences) occurring in the commands of
+// history entries, used to find the entries which contain a set of search
+// terms without examining every entry
+class HistoryIndex
+{
+public:
+   // entries must be added in order
+   void add(int index, const std::string& command);
+   void clear();
+
+   // calls onCandidate with the index of each entry which might contain
+   // all of the terms (most recent first) until it returns false; terms
+   // shorter than a trigram don't narrow the candidates, so these must be
+   // checked for by the caller
+   void findCandidates(const std::vector<std::string>& terms,
+                       int entryCount,
+                       const boost::function<bool(int)>& onCandidate) const;
+
+private:
+   typedef std::unordered_map<uint32_t, std::vector<int> > Postings;
+   Postings postings_;
+};
+
 class HistoryArchive;
 HistoryArchive& historyArchive();
 
 class HistoryArchive : boost::noncopyable
 {
 private:
-   HistoryArchive() : entryCacheLastWriteTime_(-1) {}
+   HistoryArchive()
+      : entryCacheOffset_(0),
+        rotatedSize_(0),
+        rotatedLastWriteTime_(-1)
+   {
+   }
    friend HistoryArchive& historyArchive();
 
 public:
@@ -61,9 +93,24 @@ public:
    core::Error add(const std::string& command);
    const std::vector<HistoryEntry>& entries() const;
 
+   // calls onMatch for each entry containing all of the terms (most
+   // recent first) until it returns false
+   void search(const std::vector<std::string>& terms,
+               const boost::function<bool(const HistoryEntry&)>& onMatch) const;
+
 private:
-   mutable time_t entryCacheLastWriteTime_;
+   void clearEntries() const;
+   core::Error readEntries(const core::FilePath& filePath,
+                           std::uintmax_t* pOffset) const;
+
+   // the entries are read incrementally: those appended to the history
+   // database (by any session) since it was last read are added, and it
+   // is only re-read in full once it has been rotated
+   mutable std::uintmax_t entryCacheOffset_;
+   mutable std::uintmax_t rotatedSize_;
+   mutable time_t rotatedLastWriteTime_;
    mutable std::vector<HistoryEntry> entries_;
+   mutable HistoryIndex index_;
 };
                        
 } // namespace history
@@ -0,0 +1,134 @@
+/*
+ * SessionHistoryArchiveTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionHistoryArchive.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace history {
+namespace tests {
+
+namespace {
+
+const char* const kCommands[] = {
+   "library(ggplot2)",
+   "ggplot(mtcars, aes(mpg, wt)) + geom_point()",
+   "x <- 1",
+   "plot(x)",
+   "summary(mtcars)",
+   "qplot(mpg, wt, data = mtcars)"
+};
+
+const int kCommandCount = sizeof(kCommands) / sizeof(kCommands[0]);
+
+// the entries matching all of the terms, found with the index
+std::vector<int> search(const HistoryIndex& index,
+                        const std::vector<std::string>& terms,
+                        std::size_t maxEntries = 100)
+{
+   std::vector<int> matches;
+   index.findCandidates(terms, kCommandCount, [&](int candidate) {
+      for (const std::string& term : terms)
+      {
+         if (!boost::algorithm::contains(kCommands[candidate], term))
+            return true;
+      }
+
+      matches.push_back(candidate);
+      return matches.size() < maxEntries;
+   });
+   return matches;
+}
+
+// the entries matching all of the terms, found by examining all of them
+std::vector<int> scan(const std::vector<std::string>& terms)
+{
+   std::vector<int> matches;
+   for (int i = kCommandCount - 1; i >= 0; i--)
+   {
+      bool matched = true;
+      for (const std::string& term : terms)
+         matched = matched && boost::algorithm::contains(kCommands[i], term);
+
+      if (matched)
+         matches.push_back(i);
+   }
+   return matches;
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionHistoryArchive")
+{
+   HistoryIndex index;
+   for (int i = 0; i < kCommandCount; i++)
+      index.add(i, kCommands[i]);
+
+   SECTION("Matches are found most recent first")
+   {
+      std::vector<std::string> terms = { "plot" };
+      std::vector<int> expected = { 5, 3, 1, 0 };
+      CHECK(search(index, terms) == expected);
+   }
+
+   SECTION("Matches contain all of the terms")
+   {
+      std::vector<std::string> terms = { "mtcars", "wt" };
+      std::vector<int> expected = { 5, 1 };
+      CHECK(search(index, terms) == expected);
+   }
+
+   SECTION("Results are the same as those of a scan")
+   {
+      std::vector<std::vector<std::string> > queries = {
+         { "gg" },
+         { "x" },
+         { "(", "mtcars" },
+         { "mpg", "wt", "data" },
+         { "aes(mpg" },
+         { "dplyr" },
+         {}
+      };
+
+      for (const std::vector<std::string>& terms : queries)
+         CHECK(search(index, terms) == scan(terms));
+   }
+
+   SECTION("Searches stop once enough matches are found")
+   {
+      std::vector<std::string> terms = { "plot" };
+      std::vector<int> expected = { 5, 3 };
+      CHECK(search(index, terms, 2) == expected);
+   }
+
+   SECTION("Cleared indexes have no candidates")
+   {
+      index.clear();
+      std::vector<std::string> terms = { "summary" };
+      CHECK(search(index, terms).empty());
+   }
+}
+
+} // end namespace tests
+} // end namespace history
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
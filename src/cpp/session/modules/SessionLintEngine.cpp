@@ -0,0 +1,163 @@
+/*
+ * SessionLintEngine.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionLintEngine.hpp"
+
+#include <algorithm>
+
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <shared_core/FilePath.hpp>
+
+#include <core/FileSerializer.hpp>
+#include <core/StringUtils.hpp>
+#include <core/Thread.hpp>
+
+#include "SessionDiagnostics.hpp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace diagnostics {
+
+namespace {
+
+// linting leaves most cores free for R (and everything else)
+const unsigned int kMaxLintThreads = 4;
+
+} // anonymous namespace
+
+boost::shared_ptr<LintEngine> LintEngine::create()
+{
+   return boost::shared_ptr<LintEngine>(new LintEngine());
+}
+
+LintEngine::LintEngine()
+   : threads_(0),
+     stopped_(false)
+{
+   maxThreads_ = boost::thread::hardware_concurrency() / 2;
+   maxThreads_ = std::max(1u, std::min(maxThreads_, kMaxLintThreads));
+}
+
+void LintEngine::enqueue(const Job& job)
+{
+   // jobs are parsed without R, so they must use background options
+   if (!job.options.isBackground())
+   {
+      LOG_ERROR_MESSAGE("Lint job for " + job.path + " doesn't use background options");
+      return;
+   }
+
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   if (stopped_)
+      return;
+
+   jobs_.push_back(job);
+
+   // start another thread if all of those running are busy
+   if (threads_ < maxThreads_ && threads_ < jobs_.size())
+   {
+      threads_++;
+      core::thread::safeLaunchThread(
+               boost::bind(&LintEngine::lintFiles, shared_from_this()));
+   }
+}
+
+bool LintEngine::takeResults(std::vector<Result>* pResults)
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   pResults->clear();
+   pResults->swap(results_);
+   return !stopped_ && (threads_ > 0 || !jobs_.empty());
+}
+
+void LintEngine::stop()
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   stopped_ = true;
+   jobs_.clear();
+   results_.clear();
+}
+
+void LintEngine::process(const Job& job, Result* pResult)
+{
+   pResult->job = job;
+   pResult->options = job.options;
+
+   std::string contents;
+   Error error = readStringFromFile(FilePath(job.path),
+                                    &contents,
+                                    string_utils::LineEndingPosix);
+   if (error)
+   {
+      pResult->error = error;
+      return;
+   }
+
+   std::wstring rCode = string_utils::utf8ToWide(contents, job.path);
+   setFileLocalParseOptions(rCode, &pResult->options, &pResult->noLint);
+   if (pResult->noLint)
+      return;
+
+   pResult->results = rparser::parse(FilePath(job.path), rCode, pResult->options);
+}
+
+void LintEngine::lintFiles()
+{
+   try
+   {
+      for (;;)
+      {
+         Job job;
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            if (stopped_ || jobs_.empty())
+            {
+               threads_--;
+               break;
+            }
+
+            job = jobs_.front();
+            jobs_.pop_front();
+         }
+
+         // a file which can't be parsed is reported (rather than taking
+         // the session down with it)
+         Result result;
+         try
+         {
+            process(job, &result);
+         }
+         catch (const std::exception& e)
+         {
+            result.error = unknownError(e.what(), ERROR_LOCATION);
+         }
+
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         if (!stopped_)
+            results_.push_back(result);
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+} // namespace diagnostics
+} // namespace modules
+} // namespace session
+} // namespace rstudio
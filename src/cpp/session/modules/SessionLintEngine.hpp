@@ -0,0 +1,106 @@
+/*
+ * SessionLintEngine.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_LINT_ENGINE_HPP
+#define SESSION_LINT_ENGINE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <shared_core/Error.hpp>
+
+#include "SessionRParser.hpp"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace diagnostics {
+
+// Reads and parses R source files on a pool of background threads (which
+// run only while there are jobs queued); results are collected by the
+// caller, on the main thread. Files are parsed with background parse
+// options (see rparser::ParseOptions::setBackgroundNseFunctions), so checks
+// which need R -- such as whether referenced symbols are available -- are
+// left for the caller to run on the results.
+class LintEngine : public boost::enable_shared_from_this<LintEngine>,
+                   boost::noncopyable
+{
+public:
+   struct Job
+   {
+      Job() : id(0) {}
+
+      // identifies the job to the caller
+      uint64_t id;
+
+      std::string path;
+      rparser::ParseOptions options;
+   };
+
+   struct Result
+   {
+      Result() : noLint(false) {}
+
+      Job job;
+      core::Error error;
+
+      // the file turns diagnostics off
+      bool noLint;
+
+      // (the options with any given within the file applied)
+      rparser::ParseOptions options;
+      rparser::ParseResults results;
+   };
+
+   static boost::shared_ptr<LintEngine> create();
+
+   void enqueue(const Job& job);
+
+   // returns true while there are jobs yet to be processed (so that
+   // there will be more results to take)
+   bool takeResults(std::vector<Result>* pResults);
+
+   // stop linting (jobs not yet started are discarded)
+   void stop();
+
+   // process a job (on the calling thread)
+   static void process(const Job& job, Result* pResult);
+
+private:
+   LintEngine();
+
+   void lintFiles();
+
+   boost::mutex mutex_;
+   std::deque<Job> jobs_;
+   std::vector<Result> results_;
+   unsigned int maxThreads_;
+   unsigned int threads_;
+   bool stopped_;
+};
+
+} // namespace diagnostics
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_LINT_ENGINE_HPP
@@ -0,0 +1,174 @@
+/*
+ * SessionLintEngineTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionLintEngine.hpp"
+
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+
+#include <shared_core/FilePath.hpp>
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/FileSerializer.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace diagnostics {
+namespace tests {
+
+using namespace rstudio::core;
+using namespace rparser;
+
+namespace {
+
+ParseOptions backgroundOptions()
+{
+   boost::shared_ptr<std::set<std::string> > pNseFunctions(new std::set<std::string>());
+   pNseFunctions->insert("with");
+
+   ParseOptions options(true, true, true, true, true, true);
+   options.setBackgroundNseFunctions(pNseFunctions);
+   return options;
+}
+
+std::vector<std::string> unresolvedSymbols(const ParseResults& results)
+{
+   std::vector<ParseItem> items;
+   results.parseTree()->findAllUnresolvedSymbols(&items);
+
+   std::vector<std::string> symbols;
+   for (const ParseItem& item : items)
+      symbols.push_back(item.symbol);
+   return symbols;
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionLintEngine")
+{
+   FilePath testDir;
+   REQUIRE_FALSE(FilePath::tempFilePath(testDir));
+   REQUIRE_FALSE(testDir.ensureDirectory());
+
+   SECTION("Files are parsed with the background options")
+   {
+      FilePath filePath = testDir.completeChildPath("nse.R");
+      REQUIRE_FALSE(writeStringToFile(filePath,
+                                      "with(data, x)\n"
+                                      "transform(data, y)\n"));
+
+      LintEngine::Job job;
+      job.path = filePath.getAbsolutePath();
+      job.options = backgroundOptions();
+
+      LintEngine::Result result;
+      LintEngine::process(job, &result);
+      REQUIRE_FALSE(result.error);
+      CHECK_FALSE(result.noLint);
+
+      // only calls to the functions given are taken to perform NSE
+      std::vector<std::string> symbols = unresolvedSymbols(result.results);
+      CHECK(std::count(symbols.begin(), symbols.end(), "x") == 0);
+      CHECK(std::count(symbols.begin(), symbols.end(), "y") == 1);
+   }
+
+   SECTION("Options given within files are applied")
+   {
+      FilePath filePath = testDir.completeChildPath("off.R");
+      REQUIRE_FALSE(writeStringToFile(filePath, "# !diagnostics off\nx <- (\n"));
+
+      LintEngine::Job job;
+      job.path = filePath.getAbsolutePath();
+      job.options = backgroundOptions();
+
+      LintEngine::Result result;
+      LintEngine::process(job, &result);
+      REQUIRE_FALSE(result.error);
+      CHECK(result.noLint);
+
+      filePath = testDir.completeChildPath("syntax.R");
+      REQUIRE_FALSE(writeStringToFile(filePath, "# !diagnostics level=syntax\nf(x)\n"));
+      job.path = filePath.getAbsolutePath();
+      LintEngine::process(job, &result);
+      REQUIRE_FALSE(result.error);
+      CHECK_FALSE(result.noLint);
+      CHECK_FALSE(result.options.warnIfNoSuchVariableInScope());
+      CHECK(result.options.isBackground());
+   }
+
+   SECTION("Missing files are reported")
+   {
+      LintEngine::Job job;
+      job.path = testDir.completeChildPath("missing.R").getAbsolutePath();
+      job.options = backgroundOptions();
+
+      LintEngine::Result result;
+      LintEngine::process(job, &result);
+      CHECK(isPathNotFoundError(result.error));
+   }
+
+   SECTION("Files are parsed in the background")
+   {
+      const int fileCount = 200;
+      boost::shared_ptr<LintEngine> pEngine = LintEngine::create();
+      for (int i = 0; i < fileCount; i++)
+      {
+         std::string n = safe_convert::numberToString(i);
+         FilePath filePath = testDir.completeChildPath("file" + n + ".R");
+         REQUIRE_FALSE(writeStringToFile(filePath, "f <- function() x" + n + "\n"));
+
+         LintEngine::Job job;
+         job.id = i;
+         job.path = filePath.getAbsolutePath();
+         job.options = backgroundOptions();
+         pEngine->enqueue(job);
+      }
+
+      std::vector<LintEngine::Result> results;
+      std::vector<bool> parsed(fileCount, false);
+      bool more = true;
+      for (int tries = 0; more && tries < 1000; tries++)
+      {
+         more = pEngine->takeResults(&results);
+         for (const LintEngine::Result& result : results)
+         {
+            REQUIRE_FALSE(result.error);
+            std::string n = safe_convert::numberToString(result.job.id);
+            std::vector<std::string> symbols = unresolvedSymbols(result.results);
+            REQUIRE(symbols.size() == 1);
+            CHECK(symbols[0] == "x" + n);
+            parsed[result.job.id] = true;
+         }
+         boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      }
+
+      CHECK_FALSE(more);
+      CHECK(std::count(parsed.begin(), parsed.end(), true) == fileCount);
+      pEngine->stop();
+   }
+
+   testDir.removeIfExists();
+}
+
+} // end namespace tests
+} // end namespace diagnostics
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
@@ -20,6 +20,9 @@
 // simple accessors (which we know will not longjmp)
 #define R_INTERNAL_FUNCTIONS
 
+#include <algorithm>
+#include <limits>
+
 #include <core/Debug.hpp>
 #include <core/Macros.hpp>
 #include <core/algorithm/Set.hpp>
@@ -370,6 +373,10 @@ bool mightPerformNonstandardEvaluation(const RTokenCursor& origin,
             return true;
    }
    
+   // In the background, we only know of the functions resolved up front.
+   if (status.parseOptions().isBackground())
+      return status.parseOptions().isBackgroundNseFunction(cursor.contentAsUtf8());
+   
    // Search the R source index if this is a simple call, and
    // we're within a package project.
    const std::string& symbol = cursor.contentAsUtf8();
@@ -1639,6 +1646,10 @@ void checkBinaryOperatorWhitespace(RTokenCursor& cursor,
 void addExtraScopedSymbolsForCall(RTokenCursor startCursor,
                                   ParseStatus& status)
 {
+   // (the symbols are discovered by evaluating the call in R)
+   if (status.parseOptions().isBackground())
+      return;
+   
    if (startCursor.isType(RToken::LPAREN))
       if (!startCursor.moveToPreviousSignificantToken())
          return;
@@ -2365,6 +2376,16 @@ START:
          DEBUG("-- Identifier -- " << cursor);
          if (cursor.isAtEndOfDocument())
          {
+            // an expression parsed alone is followed by the rest of the
+            // document, so its last identifier is handled as usual
+            if (status.isParsingExpression())
+            {
+               if (cursor.isType(RToken::ID))
+                  handleIdentifier(cursor, status);
+               else if (cursor.isType(RToken::STRING))
+                  handleString(cursor, status);
+            }
+            
             while (status.isInControlFlowStatement())
                status.popState();
             return;
@@ -2508,7 +2529,8 @@ BINARY_OPERATOR:
 ARGUMENT_LIST:
       
       DEBUG("-- Begin argument list " << cursor);
-      if (status.parseOptions().checkArgumentsToRFunctionCalls())
+      if (status.parseOptions().checkArgumentsToRFunctionCalls() &&
+          !status.parseOptions().isBackground())
          validateFunctionCall(cursor, status);
       
       addExtraScopedSymbolsForCall(cursor, status);
@@ -2540,7 +2562,8 @@ ARGUMENT_LIST:
       }
       
       // Skip over data.table `[` calls
-      if (isDataTableSingleBracketCall(cursor))
+      if (!status.parseOptions().isBackground() &&
+          isDataTableSingleBracketCall(cursor))
          makeSymbolsAvailableInCallFromObjectNames(cursor, status);
       
       status.pushBracket(cursor);
@@ -2803,6 +2826,524 @@ INVALID_TOKEN:
    return;
 }
 
+struct IncrementalParser::Expression
+{
+   std::wstring code;
+   
+   // the rows spanned by the expression (and any whitespace following)
+   std::size_t row;
+   std::size_t endRow;
+   
+   // holds the symbols and scopes the expression adds to the root
+   // of the document's parse tree
+   boost::shared_ptr<ParseNode> pNode;
+   std::vector<LintItem> lint;
+   
+   // the top-level definitions made by the expression
+   std::string signature;
+   
+   // whether the expression made symbols available within a range
+   // (those ranges can't be moved along with the expression)
+   bool hasSymbolRanges;
+};
+
+namespace {
+
+typedef boost::shared_ptr<IncrementalParser::Expression> ExpressionPtr;
+
+bool isControlFlowKeyword(const RToken& token)
+{
+   return token.isType(RToken::ID) && (
+            token.contentEquals(L"if") ||
+            token.contentEquals(L"else") ||
+            token.contentEquals(L"for") ||
+            token.contentEquals(L"while") ||
+            token.contentEquals(L"repeat") ||
+            token.contentEquals(L"function") ||
+            token.contentEquals(L"\\"));
+}
+
+bool closesBracket(const RToken& token, RToken::TokenType open)
+{
+   switch (open)
+   {
+   case RToken::LPAREN:    return token.isType(RToken::RPAREN);
+   case RToken::LBRACKET:  return token.isType(RToken::RBRACKET);
+   case RToken::LDBRACKET: return token.isType(RToken::RDBRACKET);
+   case RToken::LBRACE:    return token.isType(RToken::RBRACE);
+   default:                return false;
+   }
+}
+
+// Find the offsets of the tokens starting each top-level expression. This
+// only needs to be conservative: code that can't be split confidently is
+// kept within a single expression (and a document with mismatched brackets
+// isn't split at all).
+std::vector<std::size_t> findTopLevelExpressions(const RTokens& rTokens)
+{
+   std::vector<std::size_t> starts;
+   starts.push_back(0);
+   
+   std::vector<RToken::TokenType> brackets;
+   bool sawNewline = false;
+   const RToken* pPrevious = nullptr;
+   
+   // set while the condition of a control flow statement (or the formals
+   // of a function) is open at the top level, and once it has closed,
+   // until the body begins
+   bool inHeader = false;
+   bool awaitingBody = false;
+   
+   for (std::size_t i = 0, n = rTokens.size(); i < n; ++i)
+   {
+      const RToken& token = rTokens.atUnsafe(i);
+      if (isWhitespaceOrComment(token))
+      {
+         sawNewline = sawNewline || token.contentContains(L'\n');
+         continue;
+      }
+      
+      std::size_t depth = brackets.size();
+      if (depth == 0 && sawNewline && pPrevious != nullptr &&
+          !awaitingBody &&
+          !isBinaryOp(*pPrevious) &&
+          !isComma(*pPrevious) &&
+          !isControlFlowKeyword(*pPrevious) &&
+          !token.contentEquals(L"else") &&
+          !(isBinaryOp(token) && !isValidAsUnaryOperator(token)))
+      {
+         starts.push_back(i);
+      }
+      
+      if (depth == 0 && !inHeader)
+         awaitingBody = false;
+      
+      if (isLeftBracket(token))
+      {
+         if (depth == 0 && token.isType(RToken::LPAREN) &&
+             pPrevious != nullptr && isControlFlowKeyword(*pPrevious))
+         {
+            inHeader = true;
+         }
+         brackets.push_back(token.type());
+      }
+      else if (isRightBracket(token))
+      {
+         if (brackets.empty() || !closesBracket(token, brackets.back()))
+            return std::vector<std::size_t>(1, 0);
+         
+         brackets.pop_back();
+         if (brackets.empty() && inHeader)
+         {
+            inHeader = false;
+            awaitingBody = true;
+         }
+      }
+      
+      pPrevious = &token;
+      sawNewline = false;
+   }
+   
+   return starts;
+}
+
+// The parts of a function definition which other expressions can depend
+// on: its name, and its formals. The function is defined within the
+// expression starting at 'offset'.
+std::string functionSignature(const RTokens& rTokens,
+                              std::size_t offset,
+                              const ParseNode& node)
+{
+   std::string signature = node.name();
+   
+   while (offset < rTokens.size() &&
+          rTokens.atUnsafe(offset).position() < node.position())
+   {
+      ++offset;
+   }
+   
+   if (offset == rTokens.size())
+      return signature;
+   
+   RTokenCursor cursor(rTokens, offset);
+   while (!cursor.isType(RToken::LPAREN))
+      if (!cursor.moveToNextSignificantToken())
+         return signature;
+   
+   RTokenCursor endCursor = cursor.clone();
+   if (endCursor.fwdToMatchingToken())
+      signature += string_utils::wideToUtf8(std::wstring(cursor.begin(), endCursor.end()));
+   
+   return signature;
+}
+
+std::string expressionSignature(const RTokens& rTokens,
+                                std::size_t offset,
+                                const ParseNode& node)
+{
+   std::string signature;
+   for (const auto& symbol : node.getDefinedSymbols())
+      signature += symbol.first + ";";
+   
+   for (const boost::shared_ptr<ParseNode>& pChild : node.getChildren())
+      signature += functionSignature(rTokens, offset, *pChild) + ";";
+   
+   return signature;
+}
+
+std::string optionsKey(const FilePath& filePath,
+                       const ParseOptions& parseOptions)
+{
+   std::string key = filePath.getAbsolutePath();
+   key += parseOptions.lintRFunctions() ? "1" : "0";
+   key += parseOptions.checkArgumentsToRFunctionCalls() ? "1" : "0";
+   key += parseOptions.checkUnexpectedAssignmentInFunctionCall() ? "1" : "0";
+   key += parseOptions.warnIfNoSuchVariableInScope() ? "1" : "0";
+   key += parseOptions.warnIfVariableIsDefinedButNotUsed() ? "1" : "0";
+   key += parseOptions.recordStyleLint() ? "1" : "0";
+   for (const std::string& global : parseOptions.globals())
+      key += ";" + global;
+   return key;
+}
+
+bool isWithinRows(std::size_t row, const IncrementalParser::Expression& expression)
+{
+   return row >= expression.row && row < expression.endRow;
+}
+
+// Move the symbols and scopes at the root of a parse tree which lie within
+// the rows of the expression to the expression's node. Returns false if any
+// of the root's other symbols didn't come from 'seeded'.
+bool takeExpressionNodes(ParseNode* pRoot,
+                         std::size_t seededChildren,
+                         IncrementalParser::Expression* pExpression)
+{
+   pExpression->pNode = ParseNode::createRootNode();
+   ParseNode* pNode = pExpression->pNode.get();
+   
+   for (const auto& symbol : pRoot->getDefinedSymbols())
+      for (const Position& position : symbol.second)
+         if (isWithinRows(position.row, *pExpression))
+            pNode->addDefinedSymbol(position.row, position.column, symbol.first);
+   
+   for (const auto& symbol : pRoot->getReferencedSymbols())
+      for (const Position& position : symbol.second)
+         if (isWithinRows(position.row, *pExpression))
+            pNode->addReferencedSymbol(position.row, position.column, symbol.first);
+         else if (seededChildren != std::string::npos)
+            return false;
+   
+   for (const auto& symbol : pRoot->getNseReferencedSymbols())
+      for (const Position& position : symbol.second)
+         if (isWithinRows(position.row, *pExpression))
+            pNode->addNseReferencedSymbol(position.row, position.column, symbol.first);
+         else if (seededChildren != std::string::npos)
+            return false;
+   
+   const ParseNode::Children& children = pRoot->getChildren();
+   for (std::size_t i = 0; i < children.size(); ++i)
+   {
+      boost::shared_ptr<ParseNode> pChild = children[i];
+      if (isWithinRows(pChild->position().row, *pExpression))
+         pNode->addChild(pChild, pChild->position());
+      else if (seededChildren != std::string::npos && i >= seededChildren)
+         return false;
+   }
+   
+   return true;
+}
+
+// Did the parse end cleanly, at the top level, with all of the code consumed?
+bool parsedToEnd(const RTokenCursor& cursor, ParseStatus& status)
+{
+   if (status.node()->getParent() != nullptr || status.hasOpenBrackets())
+      return false;
+   
+   RTokenCursor clone = cursor.clone();
+   return clone.isAtEndOfDocument() || !clone.moveToNextSignificantToken();
+}
+
+// Parse a single (changed) expression, with the top-level symbols and scopes
+// of the document's other expressions already in the parse tree.
+bool parseExpression(const FilePath& filePath,
+                     const RTokens& rTokens,
+                     std::size_t begin,
+                     std::size_t end,
+                     const ParseOptions& parseOptions,
+                     const std::vector<ExpressionPtr>& expressions,
+                     IncrementalParser::Expression* pExpression)
+{
+   ParseStatus status(filePath, parseOptions);
+   status.setParsingExpression(end < rTokens.size());
+   
+   ParseNode* pRoot = status.root().get();
+   for (const ExpressionPtr& pOther : expressions)
+   {
+      if (!pOther || !pOther->pNode)
+         continue;
+      
+      for (const auto& symbol : pOther->pNode->getDefinedSymbols())
+         for (const Position& position : symbol.second)
+            pRoot->addDefinedSymbol(position.row, position.column, symbol.first);
+      
+      for (boost::shared_ptr<ParseNode> pChild : pOther->pNode->getChildren())
+         pRoot->addChild(pChild, pChild->position());
+   }
+   
+   std::size_t seededChildren = pRoot->getChildren().size();
+   
+   RTokenCursor cursor(rTokens, begin, end);
+   doParse(cursor, status);
+   
+   // the expression must have ended where we expected it to
+   if (!parsedToEnd(cursor, status) || !status.isAtTopLevel())
+      return false;
+   
+   for (const LintItem& item : status.lint())
+   {
+      if (!isWithinRows(item.startRow, *pExpression))
+         return false;
+      pExpression->lint.push_back(item);
+   }
+   
+   pExpression->hasSymbolRanges = !status.symbolRanges().empty();
+   return takeExpressionNodes(pRoot, seededChildren, pExpression);
+}
+
+// Parse the whole document, and divide the results among its expressions.
+// Returns false if the parse didn't end cleanly, in which case the results
+// for each expression depend on the rest of the document.
+bool parseDocument(const FilePath& filePath,
+                   const RTokens& rTokens,
+                   const ParseOptions& parseOptions,
+                   const std::vector<ExpressionPtr>& expressions)
+{
+   RTokenCursor cursor(rTokens);
+   ParseStatus status(filePath, parseOptions);
+   
+   doParse(cursor, status);
+   
+   bool clean = parsedToEnd(cursor, status);
+   
+   if (status.node()->getParent() != nullptr)
+      status.lint().unexpectedEndOfDocument(cursor.currentToken());
+   
+   status.addLintIfBracketStackNotEmpty();
+   
+   std::vector<std::size_t> rows;
+   for (const ExpressionPtr& pExpression : expressions)
+   {
+      takeExpressionNodes(status.root().get(), std::string::npos, pExpression.get());
+      
+      pExpression->lint.clear();
+      pExpression->hasSymbolRanges = false;
+      for (const auto& range : status.symbolRanges())
+         if (isWithinRows(range.first.begin().row, *pExpression))
+            pExpression->hasSymbolRanges = true;
+      
+      rows.push_back(pExpression->row);
+   }
+   
+   // (the rows of the expressions cover the whole document)
+   for (const LintItem& item : status.lint())
+   {
+      std::size_t row = static_cast<std::size_t>(std::max(item.startRow, 0));
+      std::size_t index = std::upper_bound(rows.begin(), rows.end(), row) - rows.begin();
+      expressions[index - 1]->lint.push_back(item);
+   }
+   
+   return clean;
+}
+
+// Assemble the document's parse tree from those of its expressions.
+ParseResults mergeExpressions(const std::vector<ExpressionPtr>& expressions,
+                              const ParseOptions& parseOptions)
+{
+   boost::shared_ptr<ParseNode> pRoot = ParseNode::createRootNode();
+   LintItems lint(parseOptions);
+   for (const ExpressionPtr& pExpression : expressions)
+   {
+      const ParseNode& node = *pExpression->pNode;
+      for (const auto& symbol : node.getDefinedSymbols())
+         for (const Position& position : symbol.second)
+            pRoot->addDefinedSymbol(position.row, position.column, symbol.first);
+      
+      for (const auto& symbol : node.getReferencedSymbols())
+         for (const Position& position : symbol.second)
+            pRoot->addReferencedSymbol(position.row, position.column, symbol.first);
+      
+      for (const auto& symbol : node.getNseReferencedSymbols())
+         for (const Position& position : symbol.second)
+            pRoot->addNseReferencedSymbol(position.row, position.column, symbol.first);
+      
+      for (boost::shared_ptr<ParseNode> pChild : node.getChildren())
+         pRoot->addChild(pChild, pChild->position());
+      
+      for (const LintItem& item : pExpression->lint)
+         lint.push_back(item);
+   }
+   
+   return ParseResults(pRoot, lint, parseOptions.globals());
+}
+
+} // anonymous namespace
+
+IncrementalParser::IncrementalParser()
+   : expressionsParsed_(0)
+{
+}
+
+IncrementalParser::~IncrementalParser()
+{
+}
+
+void IncrementalParser::clear()
+{
+   optionsKey_.clear();
+   code_.clear();
+   context_.clear();
+   expressions_.clear();
+}
+
+ParseResults IncrementalParser::parse(const FilePath& filePath,
+                                      const std::wstring& rCode,
+                                      const ParseOptions& parseOptions)
+{
+   expressionsParsed_ = 0;
+   
+   // results for unchanged expressions can be used only with the same options
+   std::string key = optionsKey(filePath, parseOptions);
+   if (key != optionsKey_)
+   {
+      clear();
+      optionsKey_ = key;
+   }
+   
+   if (!expressions_.empty() && rCode == code_)
+      return mergeExpressions(expressions_, parseOptions);
+   
+   if (rCode.empty() || rCode.find_first_not_of(L" \r\n\t\v") == std::string::npos)
+   {
+      clear();
+      return ParseResults();
+   }
+   
+   RTokens rTokens(rCode, RTokens::StripComments);
+   if (rTokens.empty())
+   {
+      clear();
+      return ParseResults();
+   }
+   
+   std::vector<std::size_t> starts = findTopLevelExpressions(rTokens);
+   starts.push_back(rTokens.size());
+   
+   std::multimap<std::wstring, ExpressionPtr> previous;
+   for (const ExpressionPtr& pExpression : expressions_)
+      previous.insert(std::make_pair(pExpression->code, pExpression));
+   
+   // match the document's expressions with those previously parsed
+   std::size_t count = starts.size() - 1;
+   std::vector<ExpressionPtr> expressions(count);
+   std::vector<ExpressionPtr> changed(count);
+   for (std::size_t i = 0; i < count; ++i)
+   {
+      const RToken& first = rTokens.atUnsafe(starts[i]);
+      const RToken& last = rTokens.atUnsafe(starts[i + 1] - 1);
+      
+      ExpressionPtr pExpression(new Expression());
+      pExpression->code.assign(first.begin(), last.end());
+      pExpression->row = i == 0 ? 0 : first.row();
+      pExpression->endRow = i == count - 1 ?
+               std::numeric_limits<std::size_t>::max() :
+               rTokens.atUnsafe(starts[i + 1]).row();
+      
+      auto it = previous.find(pExpression->code);
+      if (it != previous.end() &&
+          (it->second->row == pExpression->row || !it->second->hasSymbolRanges))
+      {
+         ExpressionPtr pPrevious = it->second;
+         previous.erase(it);
+         
+         int delta = static_cast<int>(pExpression->row) - static_cast<int>(pPrevious->row);
+         if (delta != 0)
+         {
+            pPrevious->pNode->shiftRows(delta);
+            for (LintItem& item : pPrevious->lint)
+            {
+               item.startRow += delta;
+               item.endRow += delta;
+            }
+         }
+         
+         pPrevious->row = pExpression->row;
+         pPrevious->endRow = pExpression->endRow;
+         expressions[i] = pPrevious;
+      }
+      else
+      {
+         changed[i] = pExpression;
+      }
+   }
+   
+   // parse the expressions which have changed; if they don't change the
+   // document's top-level definitions, we're done
+   bool parsed = !expressions_.empty();
+   for (std::size_t i = 0; parsed && i < count; ++i)
+   {
+      if (!changed[i])
+         continue;
+      
+      parsed = parseExpression(filePath,
+                               rTokens,
+                               starts[i],
+                               starts[i + 1],
+                               parseOptions,
+                               expressions,
+                               changed[i].get());
+      
+      expressions[i] = changed[i];
+      ++expressionsParsed_;
+   }
+   
+   std::string context;
+   if (parsed)
+   {
+      for (std::size_t i = 0; i < count; ++i)
+      {
+         if (changed[i])
+            expressions[i]->signature = expressionSignature(rTokens, starts[i], *expressions[i]->pNode);
+         context += expressions[i]->signature + "\n";
+      }
+   }
+   
+   if (!parsed || context != context_)
+   {
+      for (std::size_t i = 0; i < count; ++i)
+         if (!expressions[i])
+            expressions[i] = changed[i];
+      
+      parsed = parseDocument(filePath, rTokens, parseOptions, expressions);
+      expressionsParsed_ = count;
+      
+      context.clear();
+      for (std::size_t i = 0; i < count; ++i)
+      {
+         expressions[i]->signature = expressionSignature(rTokens, starts[i], *expressions[i]->pNode);
+         context += expressions[i]->signature + "\n";
+      }
+   }
+   
+   // (a document which didn't parse cleanly is parsed whole next time)
+   expressions_.clear();
+   if (parsed)
+      expressions_ = expressions;
+   context_ = context;
+   code_ = rCode;
+   
+   return mergeExpressions(expressions, parseOptions);
+}
+
 } // namespace rparser
 } // namespace modules
 } // namespace session
@@ -163,6 +163,28 @@ public:
    
    std::set<std::string>& globals() { return globals_; }
    const std::set<std::string>& globals() const { return globals_; }
+   
+   // When set, the parser neither calls into R nor consults the session's
+   // source indexes (and so can run on a background thread). Calls are then
+   // taken to perform non-standard evaluation only when they're to functions
+   // found to do so in the code being parsed, or to one of these functions;
+   // R function calls aren't validated, and symbols made available by
+   // evaluating code (e.g. R6 classes) are not discovered.
+   void setBackgroundNseFunctions(
+         const boost::shared_ptr<const std::set<std::string> >& pNseFunctions)
+   {
+      pBackgroundNseFunctions_ = pNseFunctions;
+   }
+   
+   bool isBackground() const
+   {
+      return pBackgroundNseFunctions_ != nullptr;
+   }
+   
+   bool isBackgroundNseFunction(const std::string& name) const
+   {
+      return pBackgroundNseFunctions_ && pBackgroundNseFunctions_->count(name);
+   }
 
 private:
    bool lintRFunctions_;
@@ -173,6 +195,7 @@ private:
    bool recordStyleLint_;
    
    std::set<std::string> globals_;
+   boost::shared_ptr<const std::set<std::string> > pBackgroundNseFunctions_;
 };
 
 struct ParseItem;
@@ -601,6 +624,11 @@ public:
    {
       return referencedSymbols_;
    }
+   
+   const SymbolPositions& getNseReferencedSymbols() const
+   {
+      return nseReferencedSymbols_;
+   }
 
    void addDefinedSymbol(int row,
                          int column,
@@ -634,6 +662,13 @@ public:
       referencedSymbols_[name].push_back(rToken.position());
    }
    
+   void addNseReferencedSymbol(int row,
+                               int column,
+                               const std::string& name)
+   {
+      nseReferencedSymbols_[name].push_back(Position(row, column));
+   }
+   
    void addNseReferencedSymbol(const RToken& rToken)
    {
       std::string name = token_utils::getSymbolName(rToken);
@@ -686,6 +721,18 @@ public:
       children_.push_back(pChild);
    }
    
+   // move this node, its symbols and its children down 'delta' rows
+   // (used when the code it was parsed from moves within a document)
+   void shiftRows(int delta)
+   {
+      position_.row += delta;
+      shiftRows(&definedSymbols_, delta);
+      shiftRows(&referencedSymbols_, delta);
+      shiftRows(&nseReferencedSymbols_, delta);
+      for (const boost::shared_ptr<ParseNode>& pChild : children_)
+         pChild->shiftRows(delta);
+   }
+   
    void findAllUnresolvedSymbols(std::vector<ParseItem>* pItems) const
    {
       // Get the unresolved symbols at this node
@@ -987,6 +1034,13 @@ public:
    
 private:
    
+   static void shiftRows(SymbolPositions* pSymbols, int delta)
+   {
+      for (auto& symbol : *pSymbols)
+         for (Position& position : symbol.second)
+            position.row += delta;
+   }
+   
    // tree reference -- children and parent
    ParseNode* pParent_;
    
@@ -1033,7 +1087,8 @@ public:
         pNode_(pRoot_.get()),
         lint_(parseOptions),
         parseOptions_(parseOptions),
-        filePath_(filePath)
+        filePath_(filePath),
+        parsingExpression_(false)
    {
       parseStateStack_.push(ParseStateTopLevel);
       functionNames_.push(std::wstring(L""));
@@ -1390,6 +1445,11 @@ public:
       }
    }
    
+   bool hasOpenBrackets() const
+   {
+      return !bracketStack_.empty();
+   }
+   
    template <typename Container>
    void makeSymbolsAvailableInRange(
          const Container& symbols,
@@ -1400,12 +1460,35 @@ public:
                symbols,
                begin,
                end);
+      
+      core::algorithm::insert(
+               symbolRanges_[Range(begin, end)],
+               symbols.begin(),
+               symbols.end());
+   }
+   
+   // the ranges made available during this parse
+   const std::map< Range, std::set<std::string> >& symbolRanges() const
+   {
+      return symbolRanges_;
    }
    
    const FilePath& filePath() const
    {
       return filePath_;
    }
+   
+   // set when parsing a single top-level expression within a document
+   // (so the end of the code parsed isn't the end of the document)
+   void setParsingExpression(bool parsingExpression)
+   {
+      parsingExpression_ = parsingExpression;
+   }
+   
+   bool isParsingExpression() const
+   {
+      return parsingExpression_;
+   }
 
 private:
    boost::shared_ptr<ParseNode> pRoot_;
@@ -1433,6 +1516,7 @@ private:
    SymbolRanges symbolRanges_;
    
    FilePath filePath_;
+   bool parsingExpression_;
 };
 
 class ParseResults {
@@ -1491,6 +1575,39 @@ ParseResults parse(const std::string& rCode,
 ParseResults parse(const std::wstring& rCode,
                    const ParseOptions& parseOptions = ParseOptions());
 
+// Parses successive versions of a document, such as one being edited. The
+// code is split into its top-level expressions, and those which haven't
+// changed since the previous parse keep their parse trees and lint; only the
+// rest are parsed again, within the context of the document's other top-level
+// definitions. The whole document is parsed when those definitions (or the
+// parse options) change, or when an edited expression can't be parsed alone.
+class IncrementalParser : boost::noncopyable
+{
+public:
+   
+   IncrementalParser();
+   ~IncrementalParser();
+   
+   ParseResults parse(const core::FilePath& filePath,
+                      const std::wstring& rCode,
+                      const ParseOptions& parseOptions = ParseOptions());
+   
+   // the number of top-level expressions parsed by the last call to parse()
+   std::size_t expressionsParsed() const { return expressionsParsed_; }
+   
+   void clear();
+   
+   // the results for a top-level expression
+   struct Expression;
+   
+private:
+   std::string optionsKey_;
+   std::wstring code_;
+   std::string context_;
+   std::vector< boost::shared_ptr<Expression> > expressions_;
+   std::size_t expressionsParsed_;
+};
+
 } // namespace rparser
 } // namespace modules
 } // namespace session
@@ -50,6 +50,7 @@
 #include "SessionAskPass.hpp"
 #include "SessionWorkbench.hpp"
 #include "SessionGit.hpp"
+#include "SessionSVNCache.hpp"
 
 using namespace rstudio::core;
 using namespace rstudio::core::shell_utils;
@@ -81,6 +82,35 @@ bool s_isSvnSshRepository = false;
 /** GLOBAL STATE **/
 FilePath s_workingDir;
 
+// the output of `svn status` for the working copy, and of `svn log` as
+// asked for by the history viewer, which are refreshed in the background
+boost::scoped_ptr<CommandCache> s_pStatusCache;
+boost::scoped_ptr<CommandCache> s_pLogCache;
+
+// the cached outputs are refreshed after svn operations, which change the
+// status of the working copy (and, e.g. commits and updates, its log)
+void invalidateCaches(bool includeLog)
+{
+   if (s_pStatusCache)
+      s_pStatusCache->invalidate();
+   if (includeLog && s_pLogCache)
+      s_pLogCache->invalidate();
+}
+
+struct RefreshStatusOnExit : public RefreshOnExit
+{
+   ~RefreshStatusOnExit()
+   {
+      try
+      {
+         invalidateCaches(false);
+      }
+      catch(...)
+      {
+      }
+   }
+};
+
 FilePath resolveAliasedPath(const std::string& path)
 {
    if (boost::algorithm::starts_with(path, "~/"))
@@ -280,7 +310,10 @@ core::Error createConsoleProc(const ShellArgs& args,
    *ppCP = ConsoleProcess::create(command, options, pCPI);
 
    if (enqueueRefreshOnExit)
+   {
+      (*ppCP)->onExit().connect(boost::bind(&invalidateCaches, true));
       (*ppCP)->onExit().connect(boost::bind(&enqueueRefreshEvent));
+   }
 
    return Success();
 }
@@ -372,6 +405,41 @@ void runSvnAsync(const ShellArgs& args,
    module_context::enqueClientEvent(event);
 }
 
+void onBackgroundSvnExit(const CommandCache::OnOutput& onOutput,
+                         const core::system::ProcessResult& result)
+{
+   if (result.exitStatus != EXIT_SUCCESS)
+   {
+      Error error = systemError(boost::system::errc::operation_not_permitted,
+                                ERROR_LOCATION);
+      error.addProperty("stderr", result.stdErr);
+      onOutput(error, std::string());
+      return;
+   }
+
+   onOutput(Success(), result.stdOut);
+}
+
+// runs svn without a console, and so without prompting for credentials
+// (for refreshing the cached outputs)
+void runSvnInBackground(const ShellArgs& args,
+                        const CommandCache::OnOutput& onOutput)
+{
+   // (svn's options follow its subcommand)
+   std::vector<std::string> svnArgs = args.args();
+   svnArgs.insert(svnArgs.begin() + (svnArgs.empty() ? 0 : 1), "--non-interactive");
+
+   core::system::ProcessOptions options = procOptions();
+   options.workingDir = s_workingDir;
+
+   Error error = module_context::processSupervisor().runCommand(
+            svn() << svnArgs,
+            options,
+            boost::bind(onBackgroundSvnExit, onOutput, _1));
+   if (error)
+      onOutput(error, std::string());
+}
+
 #ifdef _WIN32
 bool detectSvnExeOnPath(FilePath* pPath)
 {
@@ -650,7 +718,7 @@ FilePath resolveAliasedJsonPath(const json::Value& value)
 Error svnAdd(const json::JsonRpcRequest& request,
              json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array files;
    Error error = json::readParams(request.params, &files);
@@ -675,7 +743,7 @@ Error svnAdd(const json::JsonRpcRequest& request,
 Error svnDelete(const json::JsonRpcRequest& request,
                 json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array files;
    Error error = json::readParams(request.params, &files);
@@ -703,7 +771,7 @@ Error status(const FilePath& filePath,
 Error svnRevert(const json::JsonRpcRequest& request,
                 json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array files;
    Error error = json::readParams(request.params, &files);
@@ -790,7 +858,7 @@ Error svnRevert(const json::JsonRpcRequest& request,
 Error svnResolve(const json::JsonRpcRequest& request,
                  json::JsonRpcResponse* pResponse)
  {
-    RefreshOnExit refreshOnExit;
+    RefreshStatusOnExit refreshOnExit;
 
     std::string accept;
     json::Array files;
@@ -829,36 +897,21 @@ Error statusToJson(const core::FilePath &path,
    return Success();
 }
 
-Error status(const FilePath& filePath,
-             std::vector<source_control::FileWithStatus>* pFiles)
+ShellArgs statusArgs()
 {
-   using namespace source_control;
-
-   ShellArgs args;
-   args << "status" << globalArgs() << "--xml" << "--ignore-externals";
-   if (!filePath.isEmpty())
-      args << "--" << filePath;
-
-   std::string stdOut, stdErr;
-   int exitCode;
-   Error error = runSvn(
-         args,
-         &stdOut,
-         &stdErr,
-         &exitCode);
-   if (error)
-      return error;
+   return ShellArgs() << "status" << globalArgs() << "--xml" << "--ignore-externals";
+}
 
-   if (exitCode != EXIT_SUCCESS)
-   {
-      LOG_ERROR_MESSAGE(stdErr);
-      return Success();
-   }
+// parses the output of `svn status --xml`
+Error parseStatus(const std::string& output,
+                  std::vector<source_control::FileWithStatus>* pFiles)
+{
+   using namespace source_control;
 
    std::vector<char> xmlData;
    using namespace rapidxml;
    xml_document<> doc;
-   error = parseXml(stdOut, &xmlData, &doc);
+   Error error = parseXml(output, &xmlData, &doc);
    if (error)
       return error;
 
@@ -933,35 +986,83 @@ Error status(const FilePath& filePath,
 }
 
 Error status(const FilePath& filePath,
-             json::Array* pResults)
+             std::vector<source_control::FileWithStatus>* pFiles)
 {
-   std::vector<source_control::FileWithStatus> files;
-   Error error = status(filePath, &files);
+   ShellArgs args = statusArgs();
+   if (!filePath.isEmpty())
+      args << "--" << filePath;
+
+   std::string stdOut, stdErr;
+   int exitCode;
+   Error error = runSvn(
+         args,
+         &stdOut,
+         &stdErr,
+         &exitCode);
    if (error)
       return error;
 
-   for (source_control::FileWithStatus file : files)
+   if (exitCode != EXIT_SUCCESS)
    {
-      json::Object fileObj;
-      error = statusToJson(file.path, file.status, &fileObj);
-      if (error)
-         return error;
-      pResults->push_back(fileObj);
+      LOG_ERROR_MESSAGE(stdErr);
+      return Success();
    }
-   return Success();
+
+   return parseStatus(stdOut, pFiles);
 }
 
-Error svnStatus(const json::JsonRpcRequest& request,
-                json::JsonRpcResponse* pResponse)
+void svnStatusEnd(const json::JsonRpcFunctionContinuation& cont,
+                  const Error& statusError,
+                  const std::string& output,
+                  bool stale)
 {
+   json::JsonRpcResponse response;
+
+   // (as when svn status fails, the error is logged and no files given)
+   std::vector<source_control::FileWithStatus> files;
+   if (statusError)
+   {
+      LOG_ERROR(statusError);
+   }
+   else
+   {
+      Error error = parseStatus(output, &files);
+      if (error)
+      {
+         cont(error, &response);
+         return;
+      }
+   }
+
    json::Array results;
-   Error error = status(FilePath(), &results);
-   if (error)
-      return error;
+   for (const source_control::FileWithStatus& file : files)
+   {
+      json::Object fileObj;
+      Error error = statusToJson(file.path, file.status, &fileObj);
+      if (error)
+      {
+         cont(error, &response);
+         return;
+      }
+      results.push_back(fileObj);
+   }
+
+   json::Object result;
+   result["files"] = results;
+   result["stale"] = stale;
+   response.setResult(result);
+   cont(Success(), &response);
+}
 
-   pResponse->setResult(results);
+void svnStatus(const json::JsonRpcRequest& request,
+               const json::JsonRpcFunctionContinuation& cont)
+{
+   // without the file monitor changes to the working copy go unseen, so
+   // the status is refreshed whenever it's asked for
+   if (!projects::projectContext().isMonitoringDirectory(s_workingDir))
+      s_pStatusCache->invalidate();
 
-   return Success();
+   s_pStatusCache->get(statusArgs(), boost::bind(svnStatusEnd, cont, _1, _2, _3));
 }
 
 Error svnUpdate(const json::JsonRpcRequest& request,
@@ -988,7 +1089,7 @@ Error svnUpdate(const json::JsonRpcRequest& request,
 Error svnCleanup(const json::JsonRpcRequest& request,
                 json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    core::system::ProcessResult result;
    Error error = runSvn(ShellArgs() << "cleanup" << globalArgs(),
@@ -1119,7 +1220,7 @@ Error svnDiffFile(const json::JsonRpcRequest& request,
 Error svnApplyPatch(const json::JsonRpcRequest& request,
                     json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    std::string path, patch, sourceEncoding;
    Error error = json::readParams(request.params,
@@ -1282,7 +1383,7 @@ Error parseHistoryXml(int skip,
    return Success();
 }
 
-void historyEnd(boost::function<void(Error, const std::string&)> callback,
+void historyEnd(const CommandCache::OnOutput& callback,
                 const Error& error,
                 const core::system::ProcessResult& result)
 {
@@ -1295,10 +1396,19 @@ void historyEnd(boost::function<void(Error, const std::string&)> callback,
    callback(error, result.stdOut);
 }
 
+// runs svn log in a console (where svn can prompt for credentials)
+void runHistory(const ShellArgs& args, const CommandCache::OnOutput& onOutput)
+{
+   runSvnAsync(args,
+               "SVN History",
+               false,
+               boost::bind(historyEnd, onOutput, _1, _2));
+}
+
 void history(int rev,
              FilePath fileFilter,
              ShellArgs options,
-             boost::function<void(Error, const std::string&)> callback)
+             const CommandCache::OnResult& callback)
 {
    ShellArgs args;
    args << "log";
@@ -1314,10 +1424,7 @@ void history(int rev,
    if (!fileFilter.isEmpty())
       args << fileFilter;
 
-   runSvnAsync(args,
-               "SVN History",
-               false,
-               boost::bind(historyEnd, callback, _1, _2));
+   s_pLogCache->get(args, callback);
 }
 
 Error svnHistoryCountEnd_CommitCallback(int* pCount, const CommitInfo&)
@@ -1328,7 +1435,7 @@ Error svnHistoryCountEnd_CommitCallback(int* pCount, const CommitInfo&)
 
 void svnHistoryCountEnd(const std::string& searchText,
                         const json::JsonRpcFunctionContinuation& cont,
-                        Error error, const std::string& output)
+                        Error error, const std::string& output, bool stale)
 {
    using namespace rapidxml;
 
@@ -1376,6 +1483,7 @@ void svnHistoryCountEnd(const std::string& searchText,
 
    json::Object result;
    result["count"] = count;
+   result["stale"] = stale;
    response.setResult(result);
 
    cont(Success(), &response);
@@ -1404,7 +1512,7 @@ void svnHistoryCount(const json::JsonRpcRequest& request,
    options << "-q";
    FilePath fileFilter = fileFilterPath(fileFilterJson);
    history(rev, fileFilter, options,
-           boost::bind(svnHistoryCountEnd, searchText, cont, _1, _2));
+           boost::bind(svnHistoryCountEnd, searchText, cont, _1, _2, _3));
 }
 
 Error svnHistoryEnd_CommitCallback(json::Array *pIds,
@@ -1427,7 +1535,8 @@ void svnHistoryEnd(int skip,
                    const std::string& searchText,
                    const json::JsonRpcFunctionContinuation& cont,
                    Error error,
-                   const std::string& output)
+                   const std::string& output,
+                   bool stale)
 {
    using namespace boost::posix_time;
    using namespace rapidxml;
@@ -1466,6 +1575,7 @@ void svnHistoryEnd(int skip,
    result["subject"] = subjects;
    result["description"] = descriptions;
    result["date"] = dates;
+   result["stale"] = stale;
 
    response.setResult(result);
    cont(Success(), &response);
@@ -1507,7 +1617,8 @@ void svnHistory(const json::JsonRpcRequest& request,
                        searchText,
                        cont,
                        _1,
-                       _2));
+                       _2,
+                       _3));
 }
 
 void svnShowEnd(bool noSizeWarning,
@@ -1662,7 +1773,7 @@ Error setIgnores(const FilePath& filePath,
 Error svnSetIgnores(const json::JsonRpcRequest& request,
                     json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    // get the params
    std::string path, ignores;
@@ -1757,7 +1868,25 @@ SvnFileDecorationContext::SvnFileDecorationContext(
 {
    using namespace source_control;
 
+   // the status of the working copy is used if it's been read
    std::vector<FileWithStatus> results;
+   std::string output;
+   bool stale;
+   if (s_pStatusCache &&
+       rootDir.isWithin(s_workingDir) &&
+       s_pStatusCache->peek(statusArgs(), &output, &stale))
+   {
+      Error error = parseStatus(output, &results);
+      if (error)
+         LOG_ERROR(error);
+      else
+      {
+         vcsResult_ = StatusResult(results);
+         return;
+      }
+   }
+
+   results.clear();
    Error error = status(rootDir, &results);
    if (error)
       return;
@@ -1836,10 +1965,58 @@ Error augmentSvnIgnore()
    return Success();
 }
 
+void refreshHistory(const ShellArgs& args, const CommandCache::OnOutput& onOutput)
+{
+   // (svn+ssh repositories can need credentials, given in a console)
+   if (s_isSvnSshRepository)
+      runHistory(args, onOutput);
+   else
+      runSvnInBackground(args, onOutput);
+}
+
+bool refreshCaches()
+{
+   // the working copy can change in ways the file monitor doesn't see
+   // (e.g. `svn add` in a terminal), and the repository with others'
+   // commits (though logs needing credentials are left until asked for)
+   if (!s_workingDir.isEmpty())
+      invalidateCaches(!s_isSvnSshRepository);
+   return true;
+}
+
+void onFileMonitorEnabled(const tree<core::FileInfo>&)
+{
+   invalidateCaches(false);
+}
+
+void onFilesChanged(const std::vector<core::system::FileChangeEvent>&)
+{
+   invalidateCaches(false);
+}
+
+void onFileMonitorDisabled()
+{
+   invalidateCaches(false);
+}
+
 Error initialize()
 {
    initEnvironment();
 
+   s_pStatusCache.reset(new CommandCache(runSvnInBackground,
+                                         runSvnInBackground,
+                                         enqueueRefreshEvent));
+   s_pLogCache.reset(new CommandCache(runHistory,
+                                      refreshHistory,
+                                      enqueueRefreshEvent));
+
+   // keep the status up to date with changes to the project's files
+   projects::FileMonitorCallbacks cb;
+   cb.onMonitoringEnabled = onFileMonitorEnabled;
+   cb.onFilesChanged = onFilesChanged;
+   cb.onMonitoringDisabled = onFileMonitorDisabled;
+   projects::projectContext().subscribeToFileMonitor("SVN status", cb);
+
    initSvnBin();
 
    // initialize password manager
@@ -1856,7 +2033,7 @@ Error initialize()
       (bind(registerRpcMethod, "svn_delete", svnDelete))
       (bind(registerRpcMethod, "svn_revert", svnRevert))
       (bind(registerRpcMethod, "svn_resolve", svnResolve))
-      (bind(registerRpcMethod, "svn_status", svnStatus))
+      (bind(registerAsyncRpcMethod, "svn_status", svnStatus))
       (bind(registerRpcMethod, "svn_update", svnUpdate))
       (bind(registerRpcMethod, "svn_cleanup", svnCleanup))
       (bind(registerRpcMethod, "svn_commit", svnCommit))
@@ -1889,6 +2066,12 @@ Error initializeSvn(const core::FilePath& workingDir)
 
    prefs::userPrefs().onChanged.connect(onUserSettingsChanged);
 
+   module_context::schedulePeriodicWork(
+            boost::posix_time::minutes(1),
+            refreshCaches,
+            true,
+            false);
+
    return Success();
 }
 
@@ -0,0 +1,215 @@
+/*
+ * SessionSVNCache.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSVNCache.hpp"
+
+#include <boost/algorithm/string/join.hpp>
+
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::shell_utils;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace svn {
+
+namespace {
+
+// the outputs of this many commands are kept (e.g. the pages of the
+// history of several files)
+const std::size_t kMaxEntries = 16;
+
+std::string commandKey(const ShellArgs& args)
+{
+   return boost::algorithm::join(args.args(), "\n");
+}
+
+} // anonymous namespace
+
+CommandCache::CommandCache(const RunSvn& run,
+                           const RunSvn& refresh,
+                           const boost::function<void()>& onRefreshed)
+   : run_(run),
+     refresh_(refresh),
+     onRefreshed_(onRefreshed),
+     generation_(0),
+     uses_(0)
+{
+}
+
+void CommandCache::get(const ShellArgs& args, const OnResult& onResult)
+{
+   std::string key = commandKey(args);
+   std::map<std::string, Entry>::iterator it = entries_.find(key);
+   if (it == entries_.end())
+   {
+      it = entries_.insert(std::make_pair(key, Entry())).first;
+      it->second.args = args;
+      it->second.generation = ++generation_;
+   }
+
+   Entry& entry = it->second;
+   entry.used = true;
+   entry.lastUsed = ++uses_;
+
+   if (entry.hasOutput)
+   {
+      std::string output = entry.output;
+      bool stale = entry.stale;
+      if (stale && !entry.running)
+         run(key);
+
+      onResult(Success(), output, stale);
+   }
+   else
+   {
+      entry.waiting.push_back(onResult);
+      if (!entry.running)
+         run(key);
+   }
+
+   evict();
+}
+
+bool CommandCache::peek(const ShellArgs& args,
+                        std::string* pOutput,
+                        bool* pStale) const
+{
+   std::map<std::string, Entry>::const_iterator it = entries_.find(commandKey(args));
+   if (it == entries_.end() || !it->second.hasOutput)
+      return false;
+
+   *pOutput = it->second.output;
+   *pStale = it->second.stale;
+   return true;
+}
+
+void CommandCache::invalidate()
+{
+   std::vector<std::string> keys;
+   for (auto& entry : entries_)
+   {
+      // (the output of a command which is running may already be stale, so
+      // it's marked as such when it completes)
+      entry.second.stale = true;
+      entry.second.generation = ++generation_;
+      if (entry.second.running)
+         continue;
+
+      if (entry.second.used && entry.second.hasOutput)
+         keys.push_back(entry.first);
+      entry.second.used = false;
+   }
+
+   for (const std::string& key : keys)
+      run(key);
+}
+
+void CommandCache::clear()
+{
+   // (the outputs of commands which are running are then dropped)
+   entries_.clear();
+}
+
+void CommandCache::run(const std::string& key)
+{
+   Entry& entry = entries_[key];
+   entry.running = true;
+
+   int generation = entry.generation;
+   const RunSvn& runSvn = entry.hasOutput ? refresh_ : run_;
+   runSvn(entry.args, [this, key, generation](const Error& error,
+                                              const std::string& output) {
+      onOutput(key, generation, error, output);
+   });
+}
+
+void CommandCache::onOutput(const std::string& key,
+                            int generation,
+                            const Error& error,
+                            const std::string& output)
+{
+   std::map<std::string, Entry>::iterator it = entries_.find(key);
+   if (it == entries_.end())
+      return;
+
+   Entry& entry = it->second;
+   entry.running = false;
+
+   std::vector<OnResult> waiting;
+   waiting.swap(entry.waiting);
+
+   if (error)
+   {
+      // with no output to give the error is passed on (and the command is
+      // run afresh when next asked for); otherwise the stale output is
+      // kept, and refreshed when next asked for
+      if (!entry.hasOutput)
+      {
+         entries_.erase(it);
+         for (const OnResult& onResult : waiting)
+            onResult(error, std::string(), false);
+      }
+      else
+      {
+         LOG_ERROR(error);
+      }
+      return;
+   }
+
+   bool changed = entry.hasOutput && output != entry.output;
+   entry.output = output;
+   entry.hasOutput = true;
+   entry.stale = generation != entry.generation;
+
+   // the working copy changed as the command ran
+   bool stale = entry.stale;
+   if (stale && entry.used)
+      run(key);
+
+   for (const OnResult& onResult : waiting)
+      onResult(Success(), output, stale);
+
+   if (changed && onRefreshed_)
+      onRefreshed_();
+}
+
+void CommandCache::evict()
+{
+   while (entries_.size() > kMaxEntries)
+   {
+      std::map<std::string, Entry>::iterator oldest = entries_.end();
+      for (auto it = entries_.begin(); it != entries_.end(); ++it)
+      {
+         if (it->second.running)
+            continue;
+
+         if (oldest == entries_.end() || it->second.lastUsed < oldest->second.lastUsed)
+            oldest = it;
+      }
+
+      if (oldest == entries_.end())
+         return;
+
+      entries_.erase(oldest);
+   }
+}
+
+} // namespace svn
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,115 @@
+/*
+ * SessionSVNCache.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SVN_CACHE_HPP
+#define SESSION_SVN_CACHE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <shared_core/Error.hpp>
+
+#include <core/system/ShellUtils.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace svn {
+
+// The output of svn commands (e.g. `svn status` and `svn log`), kept so
+// that requests for it are answered at once rather than waiting on svn
+// (and, for remote repositories, the network). Outputs are marked stale
+// when the working copy may have changed, and are then read again in the
+// background; until that completes, the stale output is given (and is
+// marked as such).
+class CommandCache : boost::noncopyable
+{
+public:
+   typedef boost::function<void(const core::Error&, const std::string&)> OnOutput;
+
+   // runs svn asynchronously, calling back with its output (or an error
+   // if it fails)
+   typedef boost::function<void(const core::shell_utils::ShellArgs&,
+                                const OnOutput&)> RunSvn;
+
+   // called back with the output and whether it's stale
+   typedef boost::function<void(const core::Error&,
+                                const std::string&,
+                                bool)> OnResult;
+
+   // commands are first run with run (e.g. in a console, where svn can
+   // prompt for credentials) and then refreshed with refresh; onRefreshed
+   // is called when a refresh gives a different output
+   CommandCache(const RunSvn& run,
+                const RunSvn& refresh,
+                const boost::function<void()>& onRefreshed);
+
+   // calls onResult with the output of the command: at once if it's been
+   // run (refreshing it if it's stale), otherwise once it has been
+   void get(const core::shell_utils::ShellArgs& args, const OnResult& onResult);
+
+   // the output of the command, if it's been run
+   bool peek(const core::shell_utils::ShellArgs& args,
+             std::string* pOutput,
+             bool* pStale) const;
+
+   // marks the outputs stale, refreshing those asked for since they were
+   // last marked stale (those that aren't are refreshed when next asked for)
+   void invalidate();
+
+   void clear();
+
+private:
+   struct Entry
+   {
+      Entry() : hasOutput(false), stale(false), running(false),
+                used(false), generation(0), lastUsed(0) {}
+
+      core::shell_utils::ShellArgs args;
+      std::string output;
+      bool hasOutput;
+      bool stale;
+      bool running;
+      bool used;
+      int generation;
+      int lastUsed;
+      std::vector<OnResult> waiting;
+   };
+
+   void run(const std::string& key);
+   void onOutput(const std::string& key,
+                 int generation,
+                 const core::Error& error,
+                 const std::string& output);
+   void evict();
+
+   RunSvn run_;
+   RunSvn refresh_;
+   boost::function<void()> onRefreshed_;
+   std::map<std::string, Entry> entries_;
+   int generation_;
+   int uses_;
+};
+
+} // namespace svn
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SVN_CACHE_HPP
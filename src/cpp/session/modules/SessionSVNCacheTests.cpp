@@ -0,0 +1,208 @@
+/*
+ * SessionSVNCacheTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSVNCache.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace svn {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+// runs commands when told to, giving the current output
+class FakeSvn
+{
+public:
+   FakeSvn() : output("v1"), runs(0), refreshes(0), refreshed(0) {}
+
+   CommandCache::RunSvn runner(bool refresh)
+   {
+      return [=](const shell_utils::ShellArgs&, const CommandCache::OnOutput& onOutput) {
+         if (refresh)
+            refreshes++;
+         else
+            runs++;
+         pending_.push_back(onOutput);
+      };
+   }
+
+   // completes the commands which are running
+   void complete(const Error& error = Success())
+   {
+      std::vector<CommandCache::OnOutput> pending;
+      pending.swap(pending_);
+      for (const CommandCache::OnOutput& onOutput : pending)
+         onOutput(error, error ? std::string() : output);
+   }
+
+   std::string output;
+   int runs;
+   int refreshes;
+   int refreshed;
+
+private:
+   std::vector<CommandCache::OnOutput> pending_;
+};
+
+struct Result
+{
+   Result() : calls(0), stale(false) {}
+
+   CommandCache::OnResult callback()
+   {
+      return [this](const Error& error, const std::string& result, bool isStale) {
+         calls++;
+         this->error = error;
+         output = result;
+         stale = isStale;
+      };
+   }
+
+   int calls;
+   Error error;
+   std::string output;
+   bool stale;
+};
+
+} // anonymous namespace
+
+TEST_CASE("SessionSVNCache")
+{
+   FakeSvn svn;
+   CommandCache cache(svn.runner(false), svn.runner(true), [&]() {
+      svn.refreshed++;
+   });
+   shell_utils::ShellArgs status = shell_utils::ShellArgs() << "status" << "--xml";
+
+   SECTION("Outputs are given once the command has run, and then at once")
+   {
+      Result first, second;
+      cache.get(status, first.callback());
+      cache.get(status, second.callback());
+      CHECK(first.calls == 0);
+      CHECK(svn.runs == 1);
+
+      svn.complete();
+      CHECK(first.output == "v1");
+      CHECK(second.output == "v1");
+      CHECK_FALSE(first.stale);
+
+      Result third;
+      cache.get(status, third.callback());
+      CHECK(third.calls == 1);
+      CHECK(third.output == "v1");
+      CHECK(svn.runs == 1);
+   }
+
+   SECTION("Stale outputs are given while they're refreshed")
+   {
+      Result result;
+      cache.get(status, result.callback());
+      svn.complete();
+
+      // outputs asked for are refreshed as soon as they're stale
+      svn.output = "v2";
+      cache.invalidate();
+      CHECK(svn.refreshes == 1);
+
+      cache.get(status, result.callback());
+      CHECK(result.output == "v1");
+      CHECK(result.stale);
+      CHECK(svn.refreshes == 1);
+
+      svn.complete();
+      CHECK(svn.refreshed == 1);
+      cache.get(status, result.callback());
+      CHECK(result.output == "v2");
+      CHECK_FALSE(result.stale);
+
+      // others are refreshed when next asked for
+      cache.invalidate();
+      cache.invalidate();
+      CHECK(svn.refreshes == 2);
+      svn.complete();
+      cache.invalidate();
+      CHECK(svn.refreshes == 2);
+      cache.get(status, result.callback());
+      CHECK(result.stale);
+      CHECK(svn.refreshes == 3);
+
+      // (refreshes with the same output aren't reported)
+      svn.complete();
+      CHECK(svn.refreshed == 1);
+   }
+
+   SECTION("Outputs read as the working copy changes are read again")
+   {
+      Result result;
+      cache.get(status, result.callback());
+      cache.invalidate();
+      svn.complete();
+      CHECK(result.output == "v1");
+      CHECK(result.stale);
+      CHECK(svn.refreshes == 1);
+
+      svn.complete();
+      cache.get(status, result.callback());
+      CHECK_FALSE(result.stale);
+   }
+
+   SECTION("Failures are passed on until there's an output")
+   {
+      Result result;
+      cache.get(status, result.callback());
+      svn.complete(systemError(boost::system::errc::operation_not_permitted, ERROR_LOCATION));
+      CHECK(result.error);
+
+      cache.get(status, result.callback());
+      CHECK(svn.runs == 2);
+      svn.complete();
+      CHECK_FALSE(result.error);
+
+      // failed refreshes leave the stale output
+      cache.invalidate();
+      svn.complete(systemError(boost::system::errc::operation_not_permitted, ERROR_LOCATION));
+      cache.get(status, result.callback());
+      CHECK(result.output == "v1");
+      CHECK(result.stale);
+   }
+
+   SECTION("Outputs are only peeked at once they've been read")
+   {
+      std::string output;
+      bool stale;
+      CHECK_FALSE(cache.peek(status, &output, &stale));
+
+      Result result;
+      cache.get(status, result.callback());
+      svn.complete();
+      REQUIRE(cache.peek(status, &output, &stale));
+      CHECK(output == "v1");
+      CHECK_FALSE(stale);
+   }
+}
+
+} // end namespace tests
+} // end namespace svn
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
@@ -0,0 +1,255 @@
+/*
+ * SessionSourceIndexCache.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceIndexCache.hpp"
+
+#include <cstring>
+
+#include <core/BinarySerializer.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::binary;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+namespace {
+
+const char kCacheMagic[] = "RSSRCIX1";
+
+// sanity limits for strings and counts read from the cache
+const uint64_t kMaxStringSize = 64 * 1024;
+const uint64_t kMaxItemCount = 1024 * 1024;
+
+bool readItem(std::istream& istr, r_util::RSourceItem* pItem)
+{
+   uint64_t type, braceLevel, line, column, signatureSize;
+   std::string name;
+   if (!readUInt(istr, 1, &type) ||
+       !readString(istr, kMaxStringSize, &name) ||
+       !readUInt(istr, 4, &braceLevel) ||
+       !readUInt(istr, 4, &line) ||
+       !readUInt(istr, 4, &column) ||
+       !readUInt(istr, 4, &signatureSize) ||
+       type > r_util::RSourceItem::Variable ||
+       signatureSize > kMaxItemCount)
+   {
+      return false;
+   }
+
+   std::vector<r_util::RS4MethodParam> signature;
+   for (uint64_t i = 0; i < signatureSize; i++)
+   {
+      std::string paramName, paramType;
+      if (!readString(istr, kMaxStringSize, &paramName) ||
+          !readString(istr, kMaxStringSize, &paramType))
+      {
+         return false;
+      }
+      signature.push_back(r_util::RS4MethodParam(paramName, paramType));
+   }
+
+   *pItem = r_util::RSourceItem(static_cast<int>(type),
+                                name,
+                                signature,
+                                static_cast<int32_t>(braceLevel),
+                                static_cast<std::size_t>(line),
+                                static_cast<std::size_t>(column));
+   return true;
+}
+
+void writeItem(std::ostream& ostr, const r_util::RSourceItem& item)
+{
+   writeUInt(ostr, static_cast<uint64_t>(item.type()), 1);
+   writeString(ostr, item.name());
+   writeUInt(ostr, static_cast<uint32_t>(item.braceLevel()), 4);
+   writeUInt(ostr, static_cast<uint32_t>(item.line()), 4);
+   writeUInt(ostr, static_cast<uint32_t>(item.column()), 4);
+   writeUInt(ostr, item.signature().size(), 4);
+   for (const r_util::RS4MethodParam& param : item.signature())
+   {
+      writeString(ostr, param.name());
+      writeString(ostr, param.type());
+   }
+}
+
+Error invalidCacheError(const FilePath& cachePath, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::illegal_byte_sequence,
+                             "Invalid source index cache",
+                             location);
+   error.addProperty("path", cachePath.getAbsolutePath());
+   return error;
+}
+
+} // anonymous namespace
+
+Error SourceIndexCache::read(const FilePath& cachePath, const std::string& encoding)
+{
+   clear();
+
+   std::shared_ptr<std::istream> pIfs;
+   Error error = cachePath.openForRead(pIfs);
+   if (error)
+      return error;
+
+   std::istream& istr = *pIfs;
+   char magic[sizeof(kCacheMagic) - 1];
+   if (!istr.read(magic, sizeof(magic)) ||
+       std::memcmp(magic, kCacheMagic, sizeof(magic)) != 0)
+   {
+      return invalidCacheError(cachePath, ERROR_LOCATION);
+   }
+
+   // indexes for files read with another encoding can't be used
+   std::string cacheEncoding;
+   if (!readString(istr, kMaxStringSize, &cacheEncoding))
+      return invalidCacheError(cachePath, ERROR_LOCATION);
+   if (cacheEncoding != encoding)
+      return Success();
+
+   uint64_t fileCount;
+   if (!readUInt(istr, 4, &fileCount))
+      return invalidCacheError(cachePath, ERROR_LOCATION);
+
+   for (uint64_t i = 0; i < fileCount; i++)
+   {
+      std::string path;
+      uint64_t lastWriteTime, size, packageCount, itemCount;
+      if (!readString(istr, kMaxStringSize, &path) ||
+          !readUInt(istr, 8, &lastWriteTime) ||
+          !readUInt(istr, 8, &size) ||
+          !readUInt(istr, 4, &packageCount) ||
+          packageCount > kMaxItemCount)
+      {
+         clear();
+         return invalidCacheError(cachePath, ERROR_LOCATION);
+      }
+
+      File& file = files_[path];
+      file.lastWriteTime = static_cast<std::time_t>(lastWriteTime);
+      file.size = static_cast<uintmax_t>(size);
+      file.inferredPackages.resize(static_cast<std::size_t>(packageCount));
+      for (std::string& package : file.inferredPackages)
+      {
+         if (!readString(istr, kMaxStringSize, &package))
+         {
+            clear();
+            return invalidCacheError(cachePath, ERROR_LOCATION);
+         }
+      }
+
+      if (!readUInt(istr, 4, &itemCount) || itemCount > kMaxItemCount)
+      {
+         clear();
+         return invalidCacheError(cachePath, ERROR_LOCATION);
+      }
+
+      file.items.resize(static_cast<std::size_t>(itemCount));
+      for (r_util::RSourceItem& item : file.items)
+      {
+         if (!readItem(istr, &item))
+         {
+            clear();
+            return invalidCacheError(cachePath, ERROR_LOCATION);
+         }
+      }
+   }
+
+   return Success();
+}
+
+Error SourceIndexCache::write(const FilePath& cachePath,
+                              const std::string& encoding,
+                              const std::vector<CachedFile>& files)
+{
+   // write to a temporary file and then move it into place, so that a
+   // session which exits mid-write doesn't leave a truncated cache
+   FilePath tempPath(cachePath.getAbsolutePath() + ".tmp");
+   std::shared_ptr<std::ostream> pOfs;
+   Error error = tempPath.openForWrite(pOfs);
+   if (error)
+      return error;
+
+   std::ostream& ostr = *pOfs;
+   ostr.write(kCacheMagic, sizeof(kCacheMagic) - 1);
+   writeString(ostr, encoding);
+
+   writeUInt(ostr, files.size(), 4);
+   for (const CachedFile& file : files)
+   {
+      writeString(ostr, file.fileInfo.absolutePath());
+      writeUInt(ostr, static_cast<uint64_t>(file.fileInfo.lastWriteTime()), 8);
+      writeUInt(ostr, file.fileInfo.size(), 8);
+
+      const std::vector<std::string>& packages = file.pIndex->getInferredPackages();
+      writeUInt(ostr, packages.size(), 4);
+      for (const std::string& package : packages)
+         writeString(ostr, package);
+
+      const std::vector<r_util::RSourceItem>& items = file.pIndex->items();
+      writeUInt(ostr, items.size(), 4);
+      for (const r_util::RSourceItem& item : items)
+         writeItem(ostr, item);
+   }
+
+   ostr.flush();
+   if (ostr.fail())
+   {
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", tempPath.getAbsolutePath());
+      return error;
+   }
+   pOfs.reset();
+
+   return tempPath.move(cachePath, FilePath::MoveCrossDevice, true);
+}
+
+boost::shared_ptr<r_util::RSourceIndex> SourceIndexCache::take(const FileInfo& fileInfo,
+                                                               const std::string& context)
+{
+   auto it = files_.find(fileInfo.absolutePath());
+   if (it == files_.end())
+      return boost::shared_ptr<r_util::RSourceIndex>();
+
+   boost::shared_ptr<r_util::RSourceIndex> pIndex;
+   const File& file = it->second;
+   if (file.lastWriteTime == fileInfo.lastWriteTime() && file.size == fileInfo.size())
+   {
+      // (there's no code to tokenize; the index is populated from the cache)
+      pIndex.reset(new r_util::RSourceIndex(context, std::string()));
+      for (const std::string& package : file.inferredPackages)
+         pIndex->addInferredPackage(package);
+      for (const r_util::RSourceItem& item : file.items)
+         pIndex->addSourceItem(item);
+   }
+
+   // each cached index is used at most once; the file is re-indexed
+   // should it change
+   files_.erase(it);
+   return pIndex;
+}
+
+void SourceIndexCache::clear()
+{
+   files_.clear();
+}
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
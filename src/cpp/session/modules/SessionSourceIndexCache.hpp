@@ -0,0 +1,84 @@
+/*
+ * SessionSourceIndexCache.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SOURCE_INDEX_CACHE_HPP
+#define SESSION_SOURCE_INDEX_CACHE_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+
+#include <core/FileInfo.hpp>
+#include <core/r_util/RSourceIndex.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+// R source indexes saved by a previous session, so that at startup only
+// files which have changed since (by size or modification time) need to be
+// tokenized again. Indexes are written for a particular source encoding,
+// and the whole cache is discarded should that change.
+class SourceIndexCache : boost::noncopyable
+{
+public:
+   struct CachedFile
+   {
+      core::FileInfo fileInfo;
+      boost::shared_ptr<core::r_util::RSourceIndex> pIndex;
+   };
+
+   core::Error read(const core::FilePath& cachePath, const std::string& encoding);
+
+   static core::Error write(const core::FilePath& cachePath,
+                            const std::string& encoding,
+                            const std::vector<CachedFile>& files);
+
+   // take the cached index for the file, if there is one and the file
+   // hasn't changed since it was indexed (null otherwise)
+   boost::shared_ptr<core::r_util::RSourceIndex> take(const core::FileInfo& fileInfo,
+                                                      const std::string& context);
+
+   bool empty() const { return files_.empty(); }
+
+   void clear();
+
+private:
+   struct File
+   {
+      std::time_t lastWriteTime;
+      uintmax_t size;
+      std::vector<core::r_util::RSourceItem> items;
+      std::vector<std::string> inferredPackages;
+   };
+
+   std::unordered_map<std::string, File> files_;
+};
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SOURCE_INDEX_CACHE_HPP
@@ -0,0 +1,135 @@
+/*
+ * SessionSourceIndexCacheTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceIndexCache.hpp"
+
+#include <core/FileSerializer.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+const char* const kCode =
+      "library(stats)\n"
+      "add <- function(x, y) x + y\n"
+      "setGeneric(\"area\", function(shape) standardGeneric(\"area\"))\n"
+      "setMethod(\"area\", signature(shape = \"Circle\"), function(shape) pi)\n"
+      "answer <- 42\n";
+
+FileInfo fileInfoFor(const FilePath& filePath, std::time_t lastWriteTime)
+{
+   return FileInfo(filePath.getAbsolutePath(),
+                   false,
+                   filePath.getSize(),
+                   lastWriteTime);
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionSourceIndexCache")
+{
+   FilePath testDir;
+   REQUIRE_FALSE(FilePath::tempFilePath(testDir));
+   REQUIRE_FALSE(testDir.ensureDirectory());
+
+   FilePath sourcePath = testDir.completeChildPath("source.R");
+   REQUIRE_FALSE(writeStringToFile(sourcePath, kCode));
+   FileInfo fileInfo = fileInfoFor(sourcePath, 1000);
+
+   boost::shared_ptr<r_util::RSourceIndex> pIndex(
+            new r_util::RSourceIndex("~/source.R", kCode));
+   REQUIRE(pIndex->items().size() > 0);
+
+   std::vector<SourceIndexCache::CachedFile> files;
+   SourceIndexCache::CachedFile file;
+   file.fileInfo = fileInfo;
+   file.pIndex = pIndex;
+   files.push_back(file);
+
+   FilePath cachePath = testDir.completeChildPath("source-index");
+   REQUIRE_FALSE(SourceIndexCache::write(cachePath, "UTF-8", files));
+
+   SECTION("Unchanged files are restored from the cache")
+   {
+      SourceIndexCache cache;
+      REQUIRE_FALSE(cache.read(cachePath, "UTF-8"));
+      CHECK_FALSE(cache.empty());
+
+      boost::shared_ptr<r_util::RSourceIndex> pCached =
+            cache.take(fileInfo, "~/source.R");
+      REQUIRE(pCached);
+      CHECK(pCached->context() == "~/source.R");
+      CHECK(pCached->getInferredPackages() == pIndex->getInferredPackages());
+
+      REQUIRE(pCached->items().size() == pIndex->items().size());
+      for (std::size_t i = 0; i < pIndex->items().size(); i++)
+      {
+         const r_util::RSourceItem& expected = pIndex->items()[i];
+         const r_util::RSourceItem& actual = pCached->items()[i];
+         CHECK(actual.type() == expected.type());
+         CHECK(actual.name() == expected.name());
+         CHECK(actual.braceLevel() == expected.braceLevel());
+         CHECK(actual.line() == expected.line());
+         CHECK(actual.column() == expected.column());
+         CHECK(actual.signature().size() == expected.signature().size());
+         CHECK(actual.context() == expected.context());
+      }
+
+      // each cached index is used once
+      CHECK(cache.empty());
+      CHECK_FALSE(cache.take(fileInfo, "~/source.R"));
+   }
+
+   SECTION("Changed files are not restored")
+   {
+      SourceIndexCache cache;
+      REQUIRE_FALSE(cache.read(cachePath, "UTF-8"));
+      CHECK_FALSE(cache.take(fileInfoFor(sourcePath, 2000), "~/source.R"));
+   }
+
+   SECTION("The cache is discarded when the encoding changes")
+   {
+      SourceIndexCache cache;
+      REQUIRE_FALSE(cache.read(cachePath, "ISO-8859-1"));
+      CHECK(cache.empty());
+   }
+
+   SECTION("Invalid caches are rejected")
+   {
+      FilePath invalidPath = testDir.completeChildPath("invalid");
+      REQUIRE_FALSE(writeStringToFile(invalidPath, "RSSRCIX1\x05"));
+
+      SourceIndexCache cache;
+      CHECK(cache.read(invalidPath, "UTF-8"));
+      CHECK(cache.empty());
+   }
+
+   testDir.removeIfExists();
+}
+
+} // end namespace tests
+} // end namespace code_search
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
@@ -0,0 +1,239 @@
+/*
+ * SessionSourceIndexer.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceIndexer.hpp"
+
+#include <algorithm>
+
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <shared_core/FilePath.hpp>
+
+#include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+namespace {
+
+// indexing leaves most cores free for R (and everything else)
+const unsigned int kMaxIndexingThreads = 4;
+
+bool isGlobalFunction(const r_util::RSourceItem& item)
+{
+   return item.braceLevel() == 0 && (item.isFunction() || item.isMethod());
+}
+
+} // anonymous namespace
+
+boost::shared_ptr<SourceIndexer> SourceIndexer::create()
+{
+   return boost::shared_ptr<SourceIndexer>(new SourceIndexer());
+}
+
+SourceIndexer::SourceIndexer()
+   : threads_(0),
+     stopped_(false)
+{
+   maxThreads_ = boost::thread::hardware_concurrency() / 2;
+   maxThreads_ = std::max(1u, std::min(maxThreads_, kMaxIndexingThreads));
+}
+
+void SourceIndexer::enqueue(const Job& job)
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   if (stopped_)
+      return;
+
+   jobs_.push_back(job);
+
+   // start another thread if all of those running are busy
+   if (threads_ < maxThreads_ && threads_ < jobs_.size())
+   {
+      threads_++;
+      core::thread::safeLaunchThread(
+               boost::bind(&SourceIndexer::indexFiles, shared_from_this()));
+   }
+}
+
+void SourceIndexer::takeResults(std::vector<Result>* pResults)
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   pResults->clear();
+   pResults->swap(results_);
+}
+
+void SourceIndexer::stop()
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   stopped_ = true;
+   jobs_.clear();
+   results_.clear();
+}
+
+bool SourceIndexer::canDecode(const std::string& encoding)
+{
+   // (as with the conversion done by R, an empty encoding is UTF-8)
+   return encoding.empty() || encoding == "UTF-8";
+}
+
+void SourceIndexer::process(const Job& job, Result* pResult)
+{
+   pResult->job = job;
+
+   std::string code;
+   if (job.decoded)
+   {
+      code = job.code;
+   }
+   else
+   {
+      Error error = readStringFromFile(FilePath(job.path), &code, job.lineEnding);
+      if (error)
+      {
+         pResult->error = error;
+         return;
+      }
+
+      if (!canDecode(job.encoding))
+      {
+         pResult->needsDecoding = true;
+         pResult->contents.swap(code);
+         return;
+      }
+
+      stripBOM(&code);
+      error = string_utils::utf8Clean(code.begin(), code.end(), '?');
+      if (error)
+      {
+         pResult->error = error;
+         return;
+      }
+   }
+
+   pResult->job.code.clear();
+   pResult->pIndex.reset(new r_util::RSourceIndex(job.context, code, false));
+}
+
+void SourceIndexer::indexFiles()
+{
+   try
+   {
+      for (;;)
+      {
+         Job job;
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            if (stopped_ || jobs_.empty())
+            {
+               threads_--;
+               break;
+            }
+
+            job = jobs_.front();
+            jobs_.pop_front();
+         }
+
+         // a file which can't be indexed has no index (rather than taking
+         // the session down with it)
+         Result result;
+         try
+         {
+            process(job, &result);
+         }
+         catch (const std::exception& e)
+         {
+            LOG_WARNING_MESSAGE("Error indexing " + job.path + ": " + e.what());
+            result.pIndex.reset();
+         }
+
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         if (!stopped_)
+            results_.push_back(result);
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+SourceIndexSnapshot::SourceIndexSnapshot(
+      const std::vector<boost::shared_ptr<r_util::RSourceIndex> >& indexes)
+   : indexes_(indexes)
+{
+   for (std::size_t i = 0; i < indexes_.size(); i++)
+   {
+      const std::vector<r_util::RSourceItem>& items = indexes_[i]->items();
+      for (std::size_t j = 0; j < items.size(); j++)
+      {
+         if (isGlobalFunction(items[j]))
+            globalFunctions_[items[j].name()].push_back(std::make_pair(i, j));
+      }
+   }
+}
+
+bool SourceIndexSnapshot::findGlobalFunction(const std::string& functionName,
+                                             const std::set<std::string>& excludeContexts,
+                                             r_util::RSourceItem* pFunctionItem) const
+{
+   auto it = globalFunctions_.find(functionName);
+   if (it == globalFunctions_.end())
+      return false;
+
+   for (const std::pair<std::size_t, std::size_t>& position : it->second)
+   {
+      const r_util::RSourceIndex& index = *indexes_[position.first];
+      if (excludeContexts.count(index.context()))
+         continue;
+
+      *pFunctionItem = index.items()[position.second].withContext(index.context());
+      return true;
+   }
+
+   return false;
+}
+
+void SourceIndexSnapshot::search(const std::string& term,
+                                 std::size_t maxResults,
+                                 bool prefixOnly,
+                                 const std::set<std::string>& excludeContexts,
+                                 std::vector<r_util::RSourceItem>* pItems) const
+{
+   for (const boost::shared_ptr<r_util::RSourceIndex>& pIndex : indexes_)
+   {
+      // bail if this is an excluded context
+      if (excludeContexts.count(pIndex->context()))
+         continue;
+
+      // scan the next index
+      pIndex->search(term, prefixOnly, false, std::back_inserter(*pItems));
+
+      // return if we are past maxResults
+      if (pItems->size() >= maxResults)
+      {
+         pItems->resize(maxResults);
+         return;
+      }
+   }
+}
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
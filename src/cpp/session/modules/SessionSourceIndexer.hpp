@@ -0,0 +1,154 @@
+/*
+ * SessionSourceIndexer.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SOURCE_INDEXER_HPP
+#define SESSION_SOURCE_INDEXER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <shared_core/Error.hpp>
+
+#include <core/StringUtils.hpp>
+#include <core/r_util/RSourceIndex.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+// Reads and indexes R source files on a pool of background threads (which
+// run only while there are jobs queued); results are collected by the
+// caller, on the main thread. Indexes are built without registering their
+// inferred packages, which the caller should do as it collects them. Files
+// in encodings other than UTF-8 are returned undecoded, for the caller to
+// decode (using R) and queue again.
+class SourceIndexer : public boost::enable_shared_from_this<SourceIndexer>,
+                      boost::noncopyable
+{
+public:
+   struct Job
+   {
+      Job()
+         : id(0),
+           lineEnding(core::string_utils::LineEndingPassthrough),
+           decoded(false)
+      {
+      }
+
+      // identifies the job to the caller
+      uint64_t id;
+
+      std::string path;
+      std::string context;
+      std::string encoding;
+      core::string_utils::LineEnding lineEnding;
+
+      // set once the file has been read and decoded (into code)
+      bool decoded;
+      std::string code;
+   };
+
+   struct Result
+   {
+      Result() : needsDecoding(false) {}
+
+      Job job;
+      core::Error error;
+
+      // the file's contents, still to be decoded
+      bool needsDecoding;
+      std::string contents;
+
+      boost::shared_ptr<core::r_util::RSourceIndex> pIndex;
+   };
+
+   static boost::shared_ptr<SourceIndexer> create();
+
+   void enqueue(const Job& job);
+
+   void takeResults(std::vector<Result>* pResults);
+
+   // stop indexing (jobs not yet started are discarded)
+   void stop();
+
+   // can files in this encoding be decoded by the indexer
+   static bool canDecode(const std::string& encoding);
+
+   // process a job (on the calling thread)
+   static void process(const Job& job, Result* pResult);
+
+private:
+   SourceIndexer();
+
+   void indexFiles();
+
+   boost::mutex mutex_;
+   std::deque<Job> jobs_;
+   std::vector<Result> results_;
+   unsigned int maxThreads_;
+   unsigned int threads_;
+   bool stopped_;
+};
+
+// An immutable view of the indexes of a project's R source files, which
+// can be shared with (and searched from) any thread. Global functions are
+// found by name without scanning every index.
+class SourceIndexSnapshot : boost::noncopyable
+{
+public:
+   explicit SourceIndexSnapshot(
+         const std::vector<boost::shared_ptr<core::r_util::RSourceIndex> >& indexes);
+
+   const std::vector<boost::shared_ptr<core::r_util::RSourceIndex> >& indexes() const
+   {
+      return indexes_;
+   }
+
+   // find the first global function (or method) with the given name
+   bool findGlobalFunction(const std::string& functionName,
+                           const std::set<std::string>& excludeContexts,
+                           core::r_util::RSourceItem* pFunctionItem) const;
+
+   void search(const std::string& term,
+               std::size_t maxResults,
+               bool prefixOnly,
+               const std::set<std::string>& excludeContexts,
+               std::vector<core::r_util::RSourceItem>* pItems) const;
+
+private:
+   std::vector<boost::shared_ptr<core::r_util::RSourceIndex> > indexes_;
+
+   // (index, item) positions of global functions, in index order
+   typedef std::vector<std::pair<std::size_t, std::size_t> > Positions;
+   std::unordered_map<std::string, Positions> globalFunctions_;
+};
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SOURCE_INDEXER_HPP
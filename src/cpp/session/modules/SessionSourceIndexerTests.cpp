@@ -0,0 +1,188 @@
+/*
+ * SessionSourceIndexerTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceIndexer.hpp"
+
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+
+#include <shared_core/FilePath.hpp>
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/FileSerializer.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+boost::shared_ptr<r_util::RSourceIndex> makeIndex(const std::string& context,
+                                                  const std::string& code)
+{
+   return boost::shared_ptr<r_util::RSourceIndex>(
+            new r_util::RSourceIndex(context, code));
+}
+
+} // anonymous namespace
+
+TEST_CASE("SessionSourceIndexer")
+{
+   FilePath testDir;
+   REQUIRE_FALSE(FilePath::tempFilePath(testDir));
+   REQUIRE_FALSE(testDir.ensureDirectory());
+
+   SECTION("UTF-8 files are read and indexed")
+   {
+      FilePath filePath = testDir.completeChildPath("utf8.R");
+      REQUIRE_FALSE(writeStringToFile(filePath,
+                                      "\xEF\xBB\xBFlibrary(indexerTestPackage)\n"
+                                      "f <- function() 1\n"));
+
+      SourceIndexer::Job job;
+      job.path = filePath.getAbsolutePath();
+      job.context = "~/utf8.R";
+      job.encoding = "UTF-8";
+
+      SourceIndexer::Result result;
+      SourceIndexer::process(job, &result);
+      REQUIRE_FALSE(result.error);
+      REQUIRE(result.pIndex);
+      CHECK(result.pIndex->context() == "~/utf8.R");
+      REQUIRE(result.pIndex->items().size() == 1);
+      CHECK(result.pIndex->items()[0].name() == "f");
+
+      // packages are left for the caller to register
+      REQUIRE(result.pIndex->getInferredPackages().size() == 1);
+      CHECK(r_util::RSourceIndex::getAllInferredPackages().count("indexerTestPackage") == 0);
+   }
+
+   SECTION("Files in other encodings are returned for decoding")
+   {
+      FilePath filePath = testDir.completeChildPath("latin1.R");
+      REQUIRE_FALSE(writeStringToFile(filePath, "caf\xE9 <- function() 1\n"));
+
+      SourceIndexer::Job job;
+      job.path = filePath.getAbsolutePath();
+      job.encoding = "ISO-8859-1";
+
+      SourceIndexer::Result result;
+      SourceIndexer::process(job, &result);
+      REQUIRE_FALSE(result.error);
+      CHECK(result.needsDecoding);
+      CHECK(result.contents == "caf\xE9 <- function() 1\n");
+      CHECK_FALSE(result.pIndex);
+
+      // once decoded, the code is indexed
+      job.decoded = true;
+      job.code = "caf\xC3\xA9 <- function() 1\n";
+      SourceIndexer::process(job, &result);
+      REQUIRE(result.pIndex);
+      REQUIRE(result.pIndex->items().size() == 1);
+      CHECK(result.pIndex->items()[0].name() == "caf\xC3\xA9");
+   }
+
+   SECTION("Missing files are reported")
+   {
+      SourceIndexer::Job job;
+      job.path = testDir.completeChildPath("missing.R").getAbsolutePath();
+
+      SourceIndexer::Result result;
+      SourceIndexer::process(job, &result);
+      CHECK(isPathNotFoundError(result.error));
+   }
+
+   SECTION("Files are indexed in the background")
+   {
+      const int fileCount = 200;
+      boost::shared_ptr<SourceIndexer> pIndexer = SourceIndexer::create();
+      for (int i = 0; i < fileCount; i++)
+      {
+         std::string n = safe_convert::numberToString(i);
+         FilePath filePath = testDir.completeChildPath("file" + n + ".R");
+         REQUIRE_FALSE(writeStringToFile(filePath, "f" + n + " <- function(x) x\n"));
+
+         SourceIndexer::Job job;
+         job.id = i;
+         job.path = filePath.getAbsolutePath();
+         pIndexer->enqueue(job);
+      }
+
+      std::vector<SourceIndexer::Result> results;
+      std::vector<bool> indexed(fileCount, false);
+      for (int collected = 0, tries = 0; collected < fileCount && tries < 1000; tries++)
+      {
+         pIndexer->takeResults(&results);
+         for (const SourceIndexer::Result& result : results)
+         {
+            REQUIRE(result.pIndex);
+            std::string n = safe_convert::numberToString(result.job.id);
+            CHECK(result.pIndex->items()[0].name() == "f" + n);
+            indexed[result.job.id] = true;
+            collected++;
+         }
+         boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      }
+
+      CHECK(std::count(indexed.begin(), indexed.end(), true) == fileCount);
+      pIndexer->stop();
+   }
+
+   SECTION("Snapshots find global functions by name")
+   {
+      std::vector<boost::shared_ptr<r_util::RSourceIndex> > indexes;
+      indexes.push_back(makeIndex("~/a.R", "g <- function() { h <- function() 1 }\nx <- 1\n"));
+      indexes.push_back(makeIndex("~/b.R", "f <- function() 1\nh <- function() 2\n"));
+      indexes.push_back(makeIndex("~/c.R", "f <- function() 3\n"));
+      SourceIndexSnapshot snapshot(indexes);
+
+      r_util::RSourceItem item;
+      REQUIRE(snapshot.findGlobalFunction("f", std::set<std::string>(), &item));
+      CHECK(item.context() == "~/b.R");
+
+      std::set<std::string> excluded;
+      excluded.insert("~/b.R");
+      REQUIRE(snapshot.findGlobalFunction("f", excluded, &item));
+      CHECK(item.context() == "~/c.R");
+
+      // nested functions and variables aren't global functions
+      REQUIRE(snapshot.findGlobalFunction("h", std::set<std::string>(), &item));
+      CHECK(item.context() == "~/b.R");
+      CHECK(item.line() == 2);
+      CHECK_FALSE(snapshot.findGlobalFunction("x", std::set<std::string>(), &item));
+      CHECK_FALSE(snapshot.findGlobalFunction("missing", std::set<std::string>(), &item));
+
+      std::vector<r_util::RSourceItem> items;
+      snapshot.search("f", 10, true, excluded, &items);
+      REQUIRE(items.size() == 1);
+      CHECK(items[0].context() == "~/c.R");
+   }
+
+   testDir.removeIfExists();
+}
+
+} // end namespace tests
+} // end namespace code_search
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
@@ -16,12 +16,18 @@
 #include "DefinitionIndex.hpp"
 
 #include <deque>
+#include <unordered_map>
 #include <gsl/gsl>
 
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
 #include <shared_core/FilePath.hpp>
+#include <core/BinarySerializer.hpp>
 #include <core/DateTime.hpp>
 #include <core/PerformanceTimer.hpp>
-#include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
 #include <core/libclang/LibClang.hpp>
 #include <core/system/ProcessArgs.hpp>
 #include <session/IncrementalFileChangeHandler.hpp>
@@ -45,17 +51,50 @@ namespace {
 // flag indicating whether we are initialized
 bool s_initialized = false;
 
-struct CppDefinitions
-{
-   std::string file;
-   std::time_t fileLastWrite;
-   std::deque<CppDefinition> definitions;
-};
-
 // store definitions by file
-typedef std::map<std::string,CppDefinitions> DefinitionsByFile;
 DefinitionsByFile s_definitionsByFile;
 
+// the locations of the definitions of each USR, by file (where several
+// files define a USR, the definition in the first of them is used)
+typedef std::map<std::string,FileLocation> LocationsByFile;
+std::unordered_map<std::string,LocationsByFile> s_locationsByUSR;
+
+void removeDefinitions(const std::string& file)
+{
+   DefinitionsByFile::iterator it = s_definitionsByFile.find(file);
+   if (it == s_definitionsByFile.end())
+      return;
+
+   for (const CppDefinition& definition : it->second.definitions)
+   {
+      auto locationsIt = s_locationsByUSR.find(definition.USR);
+      if (locationsIt == s_locationsByUSR.end())
+         continue;
+
+      locationsIt->second.erase(file);
+      if (locationsIt->second.empty())
+         s_locationsByUSR.erase(locationsIt);
+   }
+
+   s_definitionsByFile.erase(it);
+}
+
+void addDefinitions(const CppDefinitions& definitions)
+{
+   removeDefinitions(definitions.file);
+   s_definitionsByFile[definitions.file] = definitions;
+
+   // (the first definition of a USR within the file is the one found)
+   for (const CppDefinition& definition : definitions.definitions)
+   {
+      if (!definition.USR.empty())
+      {
+         s_locationsByUSR[definition.USR].insert(
+                  std::make_pair(definitions.file, definition.location));
+      }
+   }
+}
+
 // visitor used to populate deque
 bool insertDefinition(const CppDefinition& definition,
                       CppDefinitions* pDefinitions)
@@ -172,6 +211,195 @@ CXChildVisitResult cursorVisitor(CXCursor cxCursor,
    }
 }
 
+// indexing leaves most cores free for R (and everything else)
+const unsigned int kMaxIndexingThreads = 4;
+
+// Parses translation units and collects their definitions on a pool of
+// background threads (which run only while there are files queued), each
+// with its own libclang index. The compilation arguments are determined
+// by the caller, and results are collected on the main thread.
+class DefinitionIndexer : public boost::enable_shared_from_this<DefinitionIndexer>,
+                          boost::noncopyable
+{
+public:
+   struct Job
+   {
+      Job() : fileLastWrite(0), generation(0) {}
+
+      std::string file;
+      std::time_t fileLastWrite;
+      std::vector<std::string> compileArgs;
+
+      // identifies the job (results for superseded jobs are discarded)
+      uint64_t generation;
+   };
+
+   struct Result
+   {
+      Job job;
+      CppDefinitions definitions;
+   };
+
+   static boost::shared_ptr<DefinitionIndexer> create(bool verbose)
+   {
+      return boost::shared_ptr<DefinitionIndexer>(new DefinitionIndexer(verbose));
+   }
+
+   void enqueue(const Job& job)
+   {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      if (stopped_)
+         return;
+
+      jobs_.push_back(job);
+
+      // start another thread if all of those running are busy
+      if (threads_ < maxThreads_ && threads_ < jobs_.size())
+      {
+         threads_++;
+         core::thread::safeLaunchThread(
+                  boost::bind(&DefinitionIndexer::indexFiles, shared_from_this()));
+      }
+   }
+
+   // returns true while there are jobs yet to be processed
+   bool takeResults(std::vector<Result>* pResults)
+   {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      pResults->clear();
+      pResults->swap(results_);
+      return !stopped_ && (threads_ > 0 || !jobs_.empty());
+   }
+
+   // stop indexing (jobs not yet started are discarded)
+   void stop()
+   {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      stopped_ = true;
+      jobs_.clear();
+      results_.clear();
+   }
+
+private:
+   explicit DefinitionIndexer(bool verbose)
+      : verbose_(verbose),
+        threads_(0),
+        stopped_(false)
+   {
+      maxThreads_ = boost::thread::hardware_concurrency() / 2;
+      maxThreads_ = std::max(1u, std::min(maxThreads_, kMaxIndexingThreads));
+   }
+
+   static void indexTranslationUnit(CXIndex index, const Job& job, Result* pResult)
+   {
+      pResult->job = job;
+      pResult->definitions.file = job.file;
+      pResult->definitions.fileLastWrite = job.fileLastWrite;
+
+      // get args in form clang expects
+      core::system::ProcessArgs argsArray(job.compileArgs);
+
+      // parse the translation unit
+      CXTranslationUnit tu = libclang::clang().parseTranslationUnit(
+                            index,
+                            job.file.c_str(),
+                            argsArray.args(),
+                            gsl::narrow_cast<int>(argsArray.argCount()),
+                            nullptr, 0, // no unsaved files
+                            CXTranslationUnit_None |
+                            CXTranslationUnit_Incomplete);
+      if (tu == nullptr)
+         return;
+
+      // wire visitor to the definitions
+      DefinitionVisitor visitor =
+         boost::bind(insertDefinition, _1, &pResult->definitions);
+
+      // visit the cursors
+      libclang::clang().visitChildren(
+           libclang::clang().getTranslationUnitCursor(tu),
+           cursorVisitor,
+           (CXClientData)&visitor);
+
+      // dispose translation unit
+      libclang::clang().disposeTranslationUnit(tu);
+   }
+
+   void indexFiles()
+   {
+      // (an index can't be shared between threads)
+      CXIndex index = libclang::clang().createIndex(
+                1 /* Exclude PCH */,
+                verbose_ ? 1 : 0);
+
+      try
+      {
+         for (;;)
+         {
+            Job job;
+            {
+               boost::unique_lock<boost::mutex> lock(mutex_);
+               if (stopped_ || jobs_.empty())
+               {
+                  threads_--;
+                  break;
+               }
+
+               job = jobs_.front();
+               jobs_.pop_front();
+            }
+
+            Result result;
+            indexTranslationUnit(index, job, &result);
+
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            if (!stopped_)
+               results_.push_back(result);
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+
+      libclang::clang().disposeIndex(index);
+   }
+
+   bool verbose_;
+   boost::mutex mutex_;
+   std::deque<Job> jobs_;
+   std::vector<Result> results_;
+   unsigned int maxThreads_;
+   unsigned int threads_;
+   bool stopped_;
+};
+
+boost::shared_ptr<DefinitionIndexer> s_pIndexer;
+
+// the generation of the latest job queued for each file being indexed
+std::map<std::string,uint64_t> s_pendingFiles;
+uint64_t s_generation = 0;
+bool s_collecting = false;
+
+bool collectDefinitions()
+{
+   std::vector<DefinitionIndexer::Result> results;
+   bool more = s_pIndexer->takeResults(&results);
+
+   for (const DefinitionIndexer::Result& result : results)
+   {
+      // ignore results for files which have since changed again (or
+      // been removed)
+      std::map<std::string,uint64_t>::iterator it =
+            s_pendingFiles.find(result.job.file);
+      if (it == s_pendingFiles.end() || it->second != result.job.generation)
+         continue;
+
+      s_pendingFiles.erase(it);
+      addDefinitions(result.definitions);
+   }
+
+   s_collecting = more;
+   return more;
+}
+
 void fileChangeHandler(const core::system::FileChangeEvent& event)
 {
    // alias the filename
@@ -193,57 +421,43 @@ void fileChangeHandler(const core::system::FileChangeEvent& event)
       }
    }
 
-   // always remove existing definitions
-   s_definitionsByFile.erase(file);
-
-   // if this is an add or an update then re-index
+   // if this is an add or an update then re-index (the existing
+   // definitions are kept until the new ones are collected)
+   std::vector<std::string> compileArgs;
    if (event.type() == core::system::FileChangeEvent::FileAdded ||
        event.type() == core::system::FileChangeEvent::FileModified)
-   {    
-      // get the compilation arguments for this file and use them to
-      // create a translation unit
-      std::vector<std::string> compileArgs =
-         rCompilationDatabase().compileArgsForTranslationUnit(file, true);
+   {
+      // get the compilation arguments for this file (which are used to
+      // create a translation unit in the background)
+      compileArgs = rCompilationDatabase().compileArgsForTranslationUnit(file, true);
+   }
 
-      if (!compileArgs.empty())
-      {
-         // create index
-         CXIndex index = libclang::clang().createIndex(
-                   1 /* Exclude PCH */,
-                   (rSourceIndex().verbose() > 0) ? 1 : 0);
-
-         // get args in form clang expects
-         core::system::ProcessArgs argsArray(compileArgs);
-
-         // parse the translation unit
-         CXTranslationUnit tu = libclang::clang().parseTranslationUnit(
-                               index,
-                               file.c_str(),
-                               argsArray.args(),
-                               gsl::narrow_cast<int>(argsArray.argCount()),
-                               nullptr, 0, // no unsaved files
-                               CXTranslationUnit_None |
-                               CXTranslationUnit_Incomplete);
-
-
-         // create definitions and wire visitor to it
-         CppDefinitions definitions;
-         definitions.file = file;
-         definitions.fileLastWrite = event.fileInfo().lastWriteTime();
-         s_definitionsByFile[file] = definitions;
-         DefinitionVisitor visitor =
-            boost::bind(insertDefinition, _1, &s_definitionsByFile[file]);
+   if (compileArgs.empty())
+   {
+      removeDefinitions(file);
+      s_pendingFiles.erase(file);
+      return;
+   }
 
-         // visit the cursors
-         libclang::clang().visitChildren(
-              libclang::clang().getTranslationUnitCursor(tu),
-              cursorVisitor,
-              (CXClientData)&visitor);
+   DefinitionIndexer::Job job;
+   job.file = file;
+   job.fileLastWrite = event.fileInfo().lastWriteTime();
+   job.compileArgs = compileArgs;
+   job.generation = ++s_generation;
+   s_pendingFiles[file] = job.generation;
 
-         // dispose translation unit and index
-         libclang::clang().disposeTranslationUnit(tu);
-         libclang::clang().disposeIndex(index);
-      }
+   if (!s_pIndexer)
+      s_pIndexer = DefinitionIndexer::create(rSourceIndex().verbose() > 0);
+   s_pIndexer->enqueue(job);
+
+   if (!s_collecting)
+   {
+      s_collecting = true;
+      module_context::schedulePeriodicWork(
+               boost::posix_time::milliseconds(100),
+               collectDefinitions,
+               false /* collect definitions even when non-idle */,
+               false /* not immediately */);
    }
 }
 
@@ -359,14 +573,9 @@ FileLocation findDefinitionLocation(const FileLocation& location)
 
       // if we didn't find it there then look for it in our index
       // of all saved files
-      for (const DefinitionsByFile::value_type& defs : s_definitionsByFile)
-      {
-         for (const CppDefinition& def : defs.second.definitions)
-         {
-            if (def.USR == USR)
-               return def.location;
-         }
-      }
+      auto it = s_locationsByUSR.find(USR);
+      if (it != s_locationsByUSR.end() && !it->second.empty())
+         return it->second.begin()->second;
    }
 
    // see if we can resolve the cursor to a definition (if we can't
@@ -409,156 +618,204 @@ bool insertMatching(const std::string& term,
 }
 
 
-json::Object cppDefinitionToJson(const CppDefinition& definition)
+const char kIndexMagic[] = "RSCPPDF1";
+
+// sanity limits for strings and counts read from the index
+const uint64_t kMaxStringSize = 64 * 1024;
+const uint64_t kMaxCount = 16 * 1024 * 1024;
+
+void writeDefinition(std::ostream& ostr,
+                     const std::string& file,
+                     const CppDefinition& definition)
 {
-   using namespace safe_convert;
-   json::Object definitionJson;
-   definitionJson["usr"] = definition.USR;
-   definitionJson["kind"] = numberTo<int>(definition.kind, 0);
-   definitionJson["parent_name"] = definition.parentName;
-   definitionJson["name"] = definition.name;
-   definitionJson["file"] = definition.location.filePath.getAbsolutePath();
-   definitionJson["line"] = numberTo<int>(definition.location.line, 1);
-   definitionJson["column"] = numberTo<int>(definition.location.column, 1);
-   return definitionJson;
+   using namespace core::binary;
+
+   writeString(ostr, definition.USR);
+   writeUInt(ostr, static_cast<uint64_t>(definition.kind), 1);
+   writeString(ostr, definition.parentName);
+   writeString(ostr, definition.name);
+
+   // (definitions are almost always located in the file that was indexed,
+   // in which case the location's file is left empty)
+   std::string locationFile = definition.location.filePath.getAbsolutePath();
+   writeString(ostr, locationFile == file ? std::string() : locationFile);
+   writeUInt(ostr, definition.location.line, 4);
+   writeUInt(ostr, definition.location.column, 4);
 }
 
-CppDefinition cppDefinitionFromJson(const json::Object& object)
+bool readDefinition(std::istream& istr,
+                    const std::string& file,
+                    CppDefinition* pDefinition)
 {
-   // read json
-   int kind;
-   int line, column;
-   std::string file;
-   CppDefinition definition;
-   Error error = json::readObject(object,
-                                  "usr", definition.USR,
-                                  "kind", kind,
-                                  "parent_name", definition.parentName,
-                                  "name", definition.name,
-                                  "file", file,
-                                  "line", line,
-                                  "column", column);
-   if (error)
+   using namespace core::binary;
+
+   uint64_t kind, line, column;
+   std::string locationFile;
+   if (!readString(istr, kMaxStringSize, &pDefinition->USR) ||
+       !readUInt(istr, 1, &kind) ||
+       !readString(istr, kMaxStringSize, &pDefinition->parentName) ||
+       !readString(istr, kMaxStringSize, &pDefinition->name) ||
+       !readString(istr, kMaxStringSize, &locationFile) ||
+       !readUInt(istr, 4, &line) ||
+       !readUInt(istr, 4, &column) ||
+       kind > CppTypedefDefinition)
    {
-      LOG_ERROR(error);
-      return CppDefinition();
+      return false;
    }
 
-   // required data transforms
-   using namespace safe_convert;
-   definition.kind = static_cast<CppDefinitionKind>(kind);
-   definition.location.filePath = FilePath(file);
-   definition.location.line = numberTo<unsigned>(line, 1);
-   definition.location.column = numberTo<unsigned>(column, 1);
+   pDefinition->kind = static_cast<CppDefinitionKind>(kind);
+   pDefinition->location.filePath = FilePath(locationFile.empty() ? file : locationFile);
+   pDefinition->location.line = static_cast<unsigned>(line);
+   pDefinition->location.column = static_cast<unsigned>(column);
+   return true;
+}
+
+} // anonymous namespace
+
+void writeDefinitionIndex(std::ostream& ostr, const DefinitionsByFile& definitionsByFile)
+{
+   using namespace core::binary;
+
+   ostr.write(kIndexMagic, sizeof(kIndexMagic) - 1);
+   writeUInt(ostr, definitionsByFile.size(), 4);
+   for (const DefinitionsByFile::value_type& defs : definitionsByFile)
+   {
+      const CppDefinitions& definitions = defs.second;
+      writeString(ostr, definitions.file);
+      writeUInt(ostr, static_cast<uint64_t>(definitions.fileLastWrite), 8);
+      writeUInt(ostr, definitions.definitions.size(), 4);
+      for (const CppDefinition& definition : definitions.definitions)
+         writeDefinition(ostr, definitions.file, definition);
+   }
+}
+
+bool readDefinitionIndex(std::istream& istr, std::vector<CppDefinitions>* pIndex)
+{
+   using namespace core::binary;
+
+   char magic[sizeof(kIndexMagic) - 1];
+   uint64_t fileCount;
+   if (!istr.read(magic, sizeof(magic)) ||
+       std::string(magic, sizeof(magic)) != std::string(kIndexMagic, sizeof(magic)) ||
+       !readUInt(istr, 4, &fileCount) ||
+       fileCount > kMaxCount)
+   {
+      return false;
+   }
+
+   std::vector<CppDefinitions> index;
+   for (uint64_t i = 0; i < fileCount; i++)
+   {
+      CppDefinitions definitions;
+      uint64_t fileLastWrite, definitionCount;
+      bool valid = readString(istr, kMaxStringSize, &definitions.file) &&
+                   readUInt(istr, 8, &fileLastWrite) &&
+                   readUInt(istr, 4, &definitionCount) &&
+                   definitionCount <= kMaxCount;
+
+      for (uint64_t j = 0; valid && j < definitionCount; j++)
+      {
+         CppDefinition definition;
+         valid = readDefinition(istr, definitions.file, &definition);
+         if (valid && !definition.empty())
+            definitions.definitions.push_back(definition);
+      }
+
+      // (a truncated or corrupt index is discarded entirely)
+      if (!valid)
+         return false;
+
+      definitions.fileLastWrite = static_cast<std::time_t>(fileLastWrite);
+      index.push_back(definitions);
+   }
 
-   // return definition
-   return definition;
+   pIndex->swap(index);
+   return true;
 }
 
+namespace {
+
 FilePath definitionIndexFilePath()
+{
+   return module_context::scopedScratchPath().completeChildPath("cpp-definition-index");
+}
+
+// the index was previously saved as JSON
+FilePath legacyDefinitionIndexFilePath()
 {
    return module_context::scopedScratchPath().completeChildPath("cpp-definition-cache");
 }
 
 void loadDefinitionIndex()
 {
-   using namespace safe_convert;
+   Error error = legacyDefinitionIndexFilePath().removeIfExists();
+   if (error)
+      LOG_ERROR(error);
 
    FilePath indexFilePath = definitionIndexFilePath();
    if (!indexFilePath.exists())
       return;
 
-   std::string contents;
-   Error error = readStringFromFile(indexFilePath, &contents);
+   std::shared_ptr<std::istream> pIfs;
+   error = indexFilePath.openForRead(pIfs);
    if (error)
    {
       LOG_ERROR(error);
       return;
    }
 
-   json::Value indexValueJson;
-   if (indexValueJson.parse(contents) ||
-       !json::isType<json::Array>(indexValueJson))
+   std::vector<CppDefinitions> index;
+   if (!readDefinitionIndex(*pIfs, &index))
    {
-      LOG_ERROR_MESSAGE("Error parsing definition index: " + contents);
+      LOG_ERROR_MESSAGE("Error reading definition index " +
+                        indexFilePath.getAbsolutePath());
       return;
    }
 
-   const json::Array& indexJson = indexValueJson.getArray();
-   for (const json::Value& definitionsJson : indexJson)
+   for (const CppDefinitions& definitions : index)
    {
-      if (!json::isType<json::Object>(definitionsJson))
-      {
-         LOG_ERROR_MESSAGE("Unexpected non-object type in definition index");
-         continue;
-      }
-
-      json::Array defsArrayJson;
-      double fileLastWrite;
-      CppDefinitions definitions;
-      Error error = json::readObject(definitionsJson.getObject(),
-                                     "file", definitions.file,
-                                     "file_last_write", fileLastWrite,
-                                     "definitions", defsArrayJson);
-      if (error)
-      {
-         LOG_ERROR(error);
-         continue;
-      }
-      definitions.fileLastWrite = numberTo<double, std::time_t>(fileLastWrite, 0);
-
-      // if the file doesn't exist then bail
-      if (!FilePath::exists(definitions.file))
-         continue;
-
-      for (const json::Value& defJson : defsArrayJson)
-      {
-         if (!json::isType<json::Object>(defJson))
-         {
-            LOG_ERROR_MESSAGE("Unexpected non-object type in definition index");
-            continue;
-         }
-
-         CppDefinition definition = cppDefinitionFromJson(defJson.getObject());
-         if (!definition.empty())
-            definitions.definitions.push_back(definition);
-      }
-
-      s_definitionsByFile[definitions.file] = definitions;
+      // if the file doesn't exist then skip it
+      if (FilePath::exists(definitions.file))
+         addDefinitions(definitions);
    }
 }
 
-
 void saveDefinitionIndex()
 {
-   using namespace safe_convert;
+   // write to a temporary file and then move it into place, so that a
+   // session which exits mid-write doesn't leave a truncated index
+   FilePath indexFilePath = definitionIndexFilePath();
+   FilePath tempPath(indexFilePath.getAbsolutePath() + ".tmp");
+   std::shared_ptr<std::ostream> pOfs;
+   Error error = tempPath.openForWrite(pOfs);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
 
-   json::Array indexJson;
-   for (const DefinitionsByFile::value_type& defs : s_definitionsByFile)
+   std::ostream& ostr = *pOfs;
+   writeDefinitionIndex(ostr, s_definitionsByFile);
+   ostr.flush();
+   if (ostr.fail())
    {
-      const CppDefinitions& definitions = defs.second;
-      json::Object definitionsJson;
-      definitionsJson["file"] = definitions.file;
-      definitionsJson["file_last_write"] = numberTo<std::time_t, double>(
-                                               definitions.fileLastWrite, 0);
-      json::Array defsArrayJson;
-      std::transform(definitions.definitions.begin(),
-                     definitions.definitions.end(),
-                     std::back_inserter(defsArrayJson),
-                     cppDefinitionToJson);
-      definitionsJson["definitions"] = defsArrayJson;
-
-      indexJson.push_back(definitionsJson);
-   }
-
-   ;
-   Error error = writeStringToFile(definitionIndexFilePath(), indexJson.writeFormatted());
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", tempPath.getAbsolutePath());
+      LOG_ERROR(error);
+      return;
+   }
+   pOfs.reset();
+
+   error = tempPath.move(indexFilePath, FilePath::MoveCrossDevice, true);
    if (error)
       LOG_ERROR(error);
 }
 
 void onShutdown(bool terminatedNormally)
 {
+   if (s_pIndexer)
+      s_pIndexer->stop();
+
    if (terminatedNormally)
       saveDefinitionIndex();
 }
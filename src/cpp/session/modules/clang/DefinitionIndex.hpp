@@ -16,8 +16,12 @@
 #ifndef SESSION_MODULES_CLANG_DEFINITION_INDEX_HPP
 #define SESSION_MODULES_CLANG_DEFINITION_INDEX_HPP
 
+#include <ctime>
+#include <deque>
+#include <map>
 #include <string>
 #include <iosfwd>
+#include <vector>
 
 #include <shared_core/FilePath.hpp>
 #include <core/libclang/LibClang.hpp>
@@ -79,6 +83,22 @@ struct CppDefinition
 
 std::ostream& operator<<(std::ostream& os, const CppDefinition& definition);
 
+// the definitions found in a file
+struct CppDefinitions
+{
+   std::string file;
+   std::time_t fileLastWrite;
+   std::deque<CppDefinition> definitions;
+};
+
+typedef std::map<std::string,CppDefinitions> DefinitionsByFile;
+
+// the index is saved between sessions as a binary store ("RSCPPDF1"
+// followed by the definitions of each file); reading fails (returning
+// false) if the store is truncated or corrupt
+void writeDefinitionIndex(std::ostream& ostr, const DefinitionsByFile& definitionsByFile);
+bool readDefinitionIndex(std::istream& istr, std::vector<CppDefinitions>* pIndex);
+
 core::libclang::FileLocation findDefinitionLocation(
                      const core::libclang::FileLocation& location);
 
@@ -0,0 +1,116 @@
+/*
+ * DefinitionIndexTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DefinitionIndex.hpp"
+
+#include <sstream>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+namespace tests {
+
+using namespace rstudio::core;
+using namespace rstudio::core::libclang;
+
+namespace {
+
+DefinitionsByFile makeDefinitions()
+{
+   DefinitionsByFile definitionsByFile;
+
+   CppDefinitions& a = definitionsByFile["/project/src/a.cpp"];
+   a.file = "/project/src/a.cpp";
+   a.fileLastWrite = 1600000000;
+   a.definitions.push_back(CppDefinition(
+         "c:@N@ns@S@Widget", CppClassDefinition, "ns", "Widget",
+         FileLocation(FilePath("/project/src/a.cpp"), 12, 7)));
+   a.definitions.push_back(CppDefinition(
+         "c:@N@ns@S@Widget@F@draw#", CppMemberFunctionDefinition, "Widget", "draw",
+         FileLocation(FilePath("/project/src/widget.h"), 40, 9)));
+
+   CppDefinitions& b = definitionsByFile["/project/src/b.cpp"];
+   b.file = "/project/src/b.cpp";
+   b.fileLastWrite = 1600000001;
+
+   return definitionsByFile;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Definition Index Store")
+{
+   DefinitionsByFile definitionsByFile = makeDefinitions();
+   std::ostringstream ostr;
+   writeDefinitionIndex(ostr, definitionsByFile);
+   std::string data = ostr.str();
+
+   SECTION("The index is written and read back")
+   {
+      std::istringstream istr(data);
+      std::vector<CppDefinitions> index;
+      REQUIRE(readDefinitionIndex(istr, &index));
+      REQUIRE(index.size() == 2);
+
+      const CppDefinitions& a = index[0];
+      CHECK(a.file == "/project/src/a.cpp");
+      CHECK(a.fileLastWrite == 1600000000);
+      REQUIRE(a.definitions.size() == 2);
+
+      const CppDefinitions& expected = definitionsByFile["/project/src/a.cpp"];
+      for (std::size_t i = 0; i < a.definitions.size(); i++)
+      {
+         CHECK(a.definitions[i].USR == expected.definitions[i].USR);
+         CHECK(a.definitions[i].kind == expected.definitions[i].kind);
+         CHECK(a.definitions[i].parentName == expected.definitions[i].parentName);
+         CHECK(a.definitions[i].name == expected.definitions[i].name);
+         CHECK(a.definitions[i].location == expected.definitions[i].location);
+      }
+
+      CHECK(index[1].file == "/project/src/b.cpp");
+      CHECK(index[1].definitions.empty());
+   }
+
+   SECTION("An index with the wrong magic isn't read")
+   {
+      std::string badMagic = data;
+      badMagic[7] = '2';
+      std::istringstream istr(badMagic);
+      std::vector<CppDefinitions> index;
+      CHECK_FALSE(readDefinitionIndex(istr, &index));
+      CHECK(index.empty());
+   }
+
+   SECTION("A truncated index isn't read")
+   {
+      for (std::size_t size : { std::size_t(0), std::size_t(6), std::size_t(10), data.size() - 1 })
+      {
+         std::istringstream istr(data.substr(0, size));
+         std::vector<CppDefinitions> index;
+         CHECK_FALSE(readDefinitionIndex(istr, &index));
+         CHECK(index.empty());
+      }
+   }
+}
+
+} // namespace tests
+} // namespace clang
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -25,6 +25,7 @@
 
 #include <core/Debug.hpp>
 #include <shared_core/Hash.hpp>
+#include <shared_core/SafeConvert.hpp>
 #include <core/Algorithm.hpp>
 #include <core/PerformanceTimer.hpp>
 #include <core/FileSerializer.hpp>
@@ -35,6 +36,7 @@
 #include <core/system/FileScanner.hpp>
 
 #include <core/libclang/LibClang.hpp>
+#include <core/libclang/Utils.hpp>
 
 #include <r/RExec.hpp>
 #include <r/RVersionInfo.hpp>
@@ -355,7 +357,6 @@ std::vector<std::string> includesForLinkingTo(const std::string& linkingTo)
 
 RCompilationDatabase::RCompilationDatabase()
    : usePrecompiledHeaders_(true),
-     forceRebuildPrecompiledHeaders_(false),
      restoredCompilationConfig_(false)
 {
 }
@@ -380,9 +381,6 @@ void RCompilationDatabase::updateForCurrentPackage()
    if (isCurrent)
       return;
 
-   // compilation config has changed; rebuild pch
-   forceRebuildPrecompiledHeaders_ = true;
-   
    // start with base args
    bool isCpp = true;
    core::r_util::RPackageInfo pkgInfo;
@@ -1151,27 +1149,251 @@ core::system::Options RCompilationDatabase::compilationEnvironment() const
 
 namespace {
 
-FilePath precompiledHeaderDir(const std::string& pkgName)
+// precompiled headers are shared by all of the user's sessions; as each
+// can take ~25MB, only the most recently used are kept
+const std::size_t kMaxPrecompiledHeaders = 8;
+
+// how often the headers a precompiled header was created from are checked
+// for changes (e.g. due to a package being re-installed)
+const std::time_t kPrecompiledHeaderCheckSeconds = 30;
+
+FilePath precompiledHeadersDir()
+{
+   return module_context::userScratchPath().completeChildPath(
+      "libclang/precompiled");
+}
+
+void collectInclusion(CXFile file,
+                      CXSourceLocation* /* inclusionStack */,
+                      unsigned includeLength,
+                      CXClientData clientData)
 {
-   return module_context::tempDir().completeChildPath(
-      "rstudio/libclang/precompiled/"
-      + pkgName);
+   // skip the main file
+   if (includeLength == 0)
+      return;
+
+   std::map<std::string, std::time_t>* pHeaders =
+         static_cast<std::map<std::string, std::time_t>*>(clientData);
+
+   FilePath headerPath(toStdString(clang().getFileName(file)));
+   (*pHeaders)[headerPath.getAbsolutePath()] = headerPath.getLastWriteTime();
+}
+
+bool createPrecompiledHeader(const std::string& pkgName,
+                             const std::vector<std::string>& args,
+                             const FilePath& precompiledDir,
+                             std::map<std::string, std::time_t>* pHeaders)
+{
+   Error error = precompiledDir.ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   // state cpp file for creating precompiled headers
+   FilePath cppPath = precompiledDir.completeChildPath(pkgName + ".cpp");
+   boost::format fmt("#include <%1%.h>\n");
+   std::string contents = boost::str(fmt % pkgName);
+   error = core::writeStringToFile(cppPath, contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   // create args array
+   if (rSourceIndex().verbose() > 0)
+   {
+      std::cerr << "# GENERATING PRECOMPILED HEADERS ----" << std::endl;
+      core::debug::print(args);
+      std::cerr << std::endl;
+   }
+
+   core::system::ProcessArgs argsArray(args);
+
+   int verboseCompile = (rSourceIndex().verbose() > 1) ? 1 : 0;
+   CXIndex index = clang().createIndex(0, verboseCompile);
+
+   CXTranslationUnit tu = clang().parseTranslationUnit(
+                         index,
+                         cppPath.getAbsolutePath().c_str(),
+                         argsArray.args(),
+                         gsl::narrow_cast<int>(argsArray.argCount()),
+                         nullptr,
+                         0,
+                         CXTranslationUnit_ForSerialization);
+   if (tu == nullptr)
+   {
+      LOG_ERROR_MESSAGE("Error parsing translation unit " +
+                           cppPath.getAbsolutePath());
+      clang().disposeIndex(index);
+      return false;
+   }
+
+   // note the headers (and their modification times) it was created from
+   clang().getInclusions(tu, collectInclusion, pHeaders);
+
+   // save to a temporary file first, as other sessions may be using
+   // (or creating) the same precompiled header
+   FilePath pchPath = precompiledDir.completeChildPath(pkgName + ".pch");
+   FilePath tempPath;
+   error = FilePath::uniqueFilePath(precompiledDir.getAbsolutePath(), ".tmp", tempPath);
+   if (error)
+   {
+      LOG_ERROR(error);
+      clang().disposeTranslationUnit(tu);
+      clang().disposeIndex(index);
+      return false;
+   }
+
+   int ret = clang().saveTranslationUnit(tu,
+                                         tempPath.getAbsolutePath().c_str(),
+                                         clang().defaultSaveOptions(tu));
+
+   clang().disposeTranslationUnit(tu);
+
+   clang().disposeIndex(index);
+
+   if (ret != CXSaveError_None)
+   {
+      boost::format fmt("Error %1% saving translation unit %2%");
+      std::string msg = boost::str(fmt % ret % pchPath.getAbsolutePath());
+      LOG_ERROR_MESSAGE(msg);
+      tempPath.removeIfExists();
+      return false;
+   }
+
+   error = tempPath.move(pchPath, FilePath::MoveCrossDevice, true);
+   if (!error)
+      error = writeHeaderTimes(precompiledDir.completeChildPath("headers"), *pHeaders);
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempPath.removeIfExists();
+      return false;
+   }
+
+   return true;
 }
 
 } // anonymous namespace
 
+Error writeHeaderTimes(const FilePath& headersPath,
+                       const std::map<std::string, std::time_t>& headers)
+{
+   std::vector<std::string> lines;
+   for (const auto& header : headers)
+   {
+      lines.push_back(safe_convert::numberToString(header.second) + " " +
+                      header.first);
+   }
+
+   return writeStringVectorToFile(headersPath, lines);
+}
+
+Error readHeaderTimes(const FilePath& headersPath,
+                      std::map<std::string, std::time_t>* pHeaders)
+{
+   std::vector<std::string> lines;
+   Error error = readStringVectorFromFile(headersPath, &lines);
+   if (error)
+      return error;
+
+   for (const std::string& line : lines)
+   {
+      std::size_t pos = line.find(' ');
+      if (pos == std::string::npos)
+         continue;
+
+      (*pHeaders)[line.substr(pos + 1)] =
+            safe_convert::stringTo<std::time_t>(line.substr(0, pos), 0);
+   }
+
+   return Success();
+}
+
+bool headersUnchanged(const std::map<std::string, std::time_t>& headers)
+{
+   if (headers.empty())
+      return false;
+
+   for (const auto& header : headers)
+   {
+      if (FilePath(header.first).getLastWriteTime() != header.second)
+         return false;
+   }
+
+   return true;
+}
+
+void removeStalePrecompiledHeaders(const FilePath& precompiledHeadersDir,
+                                   const FilePath& currentDir)
+{
+   std::vector<FilePath> children;
+   Error error = precompiledHeadersDir.getChildren(children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   core::algorithm::expel_if(children, [&](const FilePath& child) {
+      return !child.isDirectory() || child == currentDir;
+   });
+
+   if (children.size() < kMaxPrecompiledHeaders)
+      return;
+
+   // remove the least recently used (other than the current one)
+   std::sort(children.begin(), children.end(),
+             [](const FilePath& lhs, const FilePath& rhs) {
+      return lhs.getLastWriteTime() > rhs.getLastWriteTime();
+   });
+
+   for (std::size_t i = kMaxPrecompiledHeaders - 1; i < children.size(); i++)
+   {
+      if (rSourceIndex().verbose() > 0)
+         std::cerr << "REMOVING PCH: " << children[i] << std::endl;
+
+      error = children[i].removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+   }
+}
+
 std::vector<std::string> RCompilationDatabase::precompiledHeaderArgs(
       const CompilationConfig& config)
 {
-   // args to return
-   std::vector<std::string> args;
-
-   // precompiled header dir
    std::string pkgName = config.PCH;
-   FilePath precompiledDir = precompiledHeaderDir(pkgName);
+   std::time_t now = ::time(nullptr);
+
+   // re-use the precompiled header already in use for these args as long
+   // as the headers it was created from are unchanged (this is checked
+   // periodically rather than each time, as args are requested whenever
+   // a translation unit is used)
+   std::string signature = pkgName + "\n" + boost::algorithm::join(config.args, "\n");
+   PrecompiledHeaders::iterator it = precompiledHeaders_.find(signature);
+   if (it != precompiledHeaders_.end())
+   {
+      PrecompiledHeader& pch = it->second;
+      if (pch.pchPath.exists())
+      {
+         if (now - pch.lastChecked < kPrecompiledHeaderCheckSeconds)
+            return pch.args;
+
+         if (headersUnchanged(pch.headers))
+         {
+            pch.lastChecked = now;
+            return pch.args;
+         }
+      }
+
+      precompiledHeaders_.erase(it);
+   }
 
-   // further scope to actual path of package (as the locations of the
-   // header files must be stable)
+   // scope to actual path of package (as the locations of the header
+   // files must be stable)
    std::string pkgPath;
    Error error = r::exec::RFunction("find.package")
          .addParam(pkgName)
@@ -1183,11 +1405,8 @@ std::vector<std::string> RCompilationDatabase::precompiledHeaderArgs(
       LOG_ERROR(error);
       return std::vector<std::string>();
    }
-   
-   pkgPath = core::hash::crc32HexHash(pkgPath);
-   precompiledDir = precompiledDir.completeChildPath(pkgPath);
 
-   // platform/rcpp version specific directory name
+   // platform/rcpp version specific name
    std::string clangVersion = clang().version().asString();
    std::string platformDir;
    error = r::exec::RFunction(".rs.clangPCHPath")
@@ -1201,121 +1420,68 @@ std::vector<std::string> RCompilationDatabase::precompiledHeaderArgs(
       return std::vector<std::string>();
    }
 
-   // if this path doesn't exist then blow away all precompiled paths
-   // and re-create this one. this enforces only storing precompiled headers
-   // for the current version of R/Rcpp/pkg -- if we didn't do this then the
-   // storage cost could really pile up over time (~25MB per PCH)
-   FilePath platformPath = precompiledDir.completeChildPath(platformDir);
-   if (!platformPath.exists())
-   {
-      // delete root directory
-      Error error = precompiledDir.removeIfExists();
-      if (error)
-      {
-         LOG_ERROR(error);
-         return std::vector<std::string>();
-      }
+   // get common compilation args
+   std::vector<std::string> args = config.args;
 
-      // create platform directory
-      error = platformPath.ensureDirectory();
-      if (error)
-      {
-         LOG_ERROR(error);
-         return std::vector<std::string>();
-      }
-   }
+   // add this package's path to the args
+   std::vector<std::string> pkgArgs = includesForLinkingTo(pkgName);
+   std::copy(pkgArgs.begin(), pkgArgs.end(), std::back_inserter(args));
 
-   // now create the PCH if we need to
+   // enforce compilation with requested standard
    std::string stdArg = extractStdArg(config.args);
-   FilePath pchPath = platformPath.completeChildPath(pkgName + stdArg + ".pch");
-   if (forceRebuildPrecompiledHeaders_ || !pchPath.exists())
+   core::algorithm::expel_if(args, [](const std::string& arg) {
+      return arg.find("-std=") == 0;
+   });
+
+   // add in '-std' argument (if any)
+   if (!stdArg.empty())
+      args.push_back(stdArg);
+
+   // precompiled headers are keyed by everything which determines their
+   // contents, so those for each package / argument set can be shared
+   // by all of the user's sessions
+   std::string key = core::hash::crc32HexHash(
+            pkgPath + "\n" + platformDir + "\n" + boost::algorithm::join(args, "\n"));
+   FilePath precompiledDir = precompiledHeadersDir().completeChildPath(pkgName + "-" + key);
+   FilePath pchPath = precompiledDir.completeChildPath(pkgName + ".pch");
+
+   PrecompiledHeader pch;
+   pch.pchPath = pchPath;
+   pch.lastChecked = now;
+
+   // use one created previously (by any session) if it is still current
+   FilePath headersPath = precompiledDir.completeChildPath("headers");
+   bool isCurrent = false;
+   if (pchPath.exists() && headersPath.exists())
    {
-      forceRebuildPrecompiledHeaders_ = false;
-      
-      // state cpp file for creating precompiled headers
-      FilePath cppPath = platformPath.completeChildPath(pkgName + stdArg + ".cpp");
-      boost::format fmt("#include <%1%.h>\n");
-      std::string contents = boost::str(fmt % pkgName);
-      error = core::writeStringToFile(cppPath, contents);
+      error = readHeaderTimes(headersPath, &pch.headers);
       if (error)
-      {
          LOG_ERROR(error);
-         return std::vector<std::string>();
-      }
-
-      // get common compilation args
-      std::vector<std::string> args = config.args;
-      
-      // add this package's path to the args
-      std::vector<std::string> pkgArgs = includesForLinkingTo(pkgName);
-      std::copy(pkgArgs.begin(), pkgArgs.end(), std::back_inserter(args));
-
-      // enforce compilation with requested standard
-      core::algorithm::expel_if(args, [](const std::string& arg) {
-         return arg.find("-std=") == 0;
-      });
-
-      // add in '-std' argument (if any)
-      if (!stdArg.empty())
-         args.push_back(stdArg);
-
-      // create args array
-      if (rSourceIndex().verbose() > 0)
-      {
-         std::cerr << "# GENERATING PRECOMPILED HEADERS ----" << std::endl;
-         core::debug::print(args);
-         std::cerr << std::endl;
-      }
-
-      core::system::ProcessArgs argsArray(args);
-
-      int verboseCompile = (rSourceIndex().verbose() > 1) ? 1 : 0;
-      CXIndex index = clang().createIndex(0, verboseCompile);
-
-      CXTranslationUnit tu = clang().parseTranslationUnit(
-                            index,
-                            cppPath.getAbsolutePath().c_str(),
-                            argsArray.args(),
-                            gsl::narrow_cast<int>(argsArray.argCount()),
-                            nullptr,
-                            0,
-                            CXTranslationUnit_ForSerialization);
-      if (tu == nullptr)
-      {
-         LOG_ERROR_MESSAGE("Error parsing translation unit " +
-                              cppPath.getAbsolutePath());
-         clang().disposeIndex(index);
-
-         Error removeError = precompiledDir.removeIfExists();
-         if (removeError)
-            LOG_ERROR(removeError);
+      else
+         isCurrent = headersUnchanged(pch.headers);
+   }
 
+   if (isCurrent)
+   {
+      // mark as recently used
+      precompiledDir.setLastWriteTime(now);
+   }
+   else
+   {
+      pch.headers.clear();
+      // (the directory is left alone on failure, as other sessions may be
+      // using it; it's removed in time if it isn't used)
+      if (!createPrecompiledHeader(pkgName, args, precompiledDir, &pch.headers))
          return std::vector<std::string>();
-      }
-
-      int ret = clang().saveTranslationUnit(tu,
-                                            pchPath.getAbsolutePath().c_str(),
-                                            clang().defaultSaveOptions(tu));
-      if (ret != CXSaveError_None)
-      {
-         boost::format fmt("Error %1% saving translation unit %2%");
-         std::string msg = boost::str(fmt % ret % pchPath.getAbsolutePath());
-         LOG_ERROR_MESSAGE(msg);
-
-         Error removeError = precompiledDir.removeIfExists();
-         if (removeError)
-            LOG_ERROR(removeError);
-      }
-
-      clang().disposeTranslationUnit(tu);
 
-      clang().disposeIndex(index);
+      removeStalePrecompiledHeaders(precompiledHeadersDir(), precompiledDir);
    }
 
    // return the pch header file args
-   args.push_back("-include-pch");
-   args.push_back(pchPath.getAbsolutePath());
-   return args;
+   pch.args.push_back("-include-pch");
+   pch.args.push_back(pchPath.getAbsolutePath());
+   precompiledHeaders_[signature] = pch;
+   return pch.args;
 }
 
 core::libclang::CompilationDatabase rCompilationDatabase()
@@ -16,6 +16,7 @@
 #ifndef SESSION_MODULES_CLANG_R_COMPILATION_DATABASE_HPP
 #define SESSION_MODULES_CLANG_R_COMPILATION_DATABASE_HPP
 
+#include <ctime>
 #include <map>
 #include <string>
 #include <vector>
@@ -127,12 +128,36 @@ private:
    std::string compilerHash_;
    CompilationConfig packageCompilationConfig_;
    bool usePrecompiledHeaders_;
-   bool forceRebuildPrecompiledHeaders_;
+
+   // precompiled headers in use (keyed by package and compilation args),
+   // along with the headers they were created from
+   struct PrecompiledHeader
+   {
+      std::vector<std::string> args;
+      core::FilePath pchPath;
+      std::map<std::string, std::time_t> headers;
+      std::time_t lastChecked;
+   };
+   typedef std::map<std::string, PrecompiledHeader> PrecompiledHeaders;
+   PrecompiledHeaders precompiledHeaders_;
    bool restoredCompilationConfig_;
 };
 
 core::libclang::CompilationDatabase rCompilationDatabase();
 
+// the modification times of the headers a precompiled header was created
+// from (it's current as long as they're unchanged), saved alongside it
+core::Error writeHeaderTimes(const core::FilePath& headersPath,
+                             const std::map<std::string, std::time_t>& headers);
+core::Error readHeaderTimes(const core::FilePath& headersPath,
+                            std::map<std::string, std::time_t>* pHeaders);
+bool headersUnchanged(const std::map<std::string, std::time_t>& headers);
+
+// removes the least recently used precompiled headers (other than those
+// in currentDir) beyond the number kept
+void removeStalePrecompiledHeaders(const core::FilePath& precompiledHeadersDir,
+                                   const core::FilePath& currentDir);
+
 
 } // namespace clang
 } // namepace handlers
@@ -0,0 +1,121 @@
+/*
+ * RCompilationDatabaseTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RCompilationDatabase.hpp"
+
+#include <core/FileSerializer.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+namespace tests {
+
+using namespace rstudio::core;
+
+TEST_CASE("Precompiled Header Cache")
+{
+   FilePath testDir;
+   REQUIRE_FALSE(FilePath::tempFilePath(testDir));
+   REQUIRE_FALSE(testDir.ensureDirectory());
+
+   std::time_t now = std::time(nullptr);
+
+   // headers dated into the past, so that their times are settled
+   std::map<std::string, std::time_t> headers;
+   for (const std::string& name : { "Rcpp.h", "RcppCommon.h", "Rinternals.h" })
+   {
+      FilePath headerPath = testDir.completeChildPath(name);
+      REQUIRE_FALSE(writeStringToFile(headerPath, "// " + name + "\n"));
+      headerPath.setLastWriteTime(now - 100);
+      headers[headerPath.getAbsolutePath()] = headerPath.getLastWriteTime();
+   }
+
+   SECTION("Header times are written and read back")
+   {
+      FilePath headersPath = testDir.completeChildPath("headers");
+      REQUIRE_FALSE(writeHeaderTimes(headersPath, headers));
+
+      std::map<std::string, std::time_t> read;
+      REQUIRE_FALSE(readHeaderTimes(headersPath, &read));
+      CHECK(read == headers);
+      CHECK(headersUnchanged(read));
+   }
+
+   SECTION("A changed header is detected")
+   {
+      REQUIRE(headersUnchanged(headers));
+      testDir.completeChildPath("RcppCommon.h").setLastWriteTime(now - 50);
+      CHECK_FALSE(headersUnchanged(headers));
+   }
+
+   SECTION("A missing header is detected")
+   {
+      REQUIRE_FALSE(testDir.completeChildPath("Rinternals.h").remove());
+      CHECK_FALSE(headersUnchanged(headers));
+   }
+
+   SECTION("Headers with no times aren't current")
+   {
+      CHECK_FALSE(headersUnchanged(std::map<std::string, std::time_t>()));
+
+      std::map<std::string, std::time_t> read;
+      CHECK(readHeaderTimes(testDir.completeChildPath("missing"), &read));
+      CHECK(read.empty());
+   }
+
+   SECTION("The least recently used precompiled headers are removed")
+   {
+      FilePath precompiledDir = testDir.completeChildPath("precompiled");
+      std::vector<FilePath> dirs;
+      for (int i = 0; i < 12; i++)
+      {
+         FilePath dir = precompiledDir.completeChildPath("Rcpp-" + std::to_string(i));
+         REQUIRE_FALSE(dir.ensureDirectory());
+         REQUIRE_FALSE(writeStringToFile(dir.completeChildPath("Rcpp.pch"), "pch"));
+         dir.setLastWriteTime(now - 1000 + i);
+         dirs.push_back(dir);
+      }
+
+      // the current one is kept however long ago it was used
+      removeStalePrecompiledHeaders(precompiledDir, dirs[0]);
+
+      std::vector<FilePath> remaining;
+      REQUIRE_FALSE(precompiledDir.getChildren(remaining));
+      CHECK(remaining.size() == 8);
+      CHECK(dirs[0].exists());
+      for (int i = 1; i < 5; i++)
+         CHECK_FALSE(dirs[i].exists());
+      for (int i = 5; i < 12; i++)
+         CHECK(dirs[i].exists());
+
+      // and nothing more is removed while there are few enough
+      removeStalePrecompiledHeaders(precompiledDir, dirs[11]);
+      remaining.clear();
+      REQUIRE_FALSE(precompiledDir.getChildren(remaining));
+      CHECK(remaining.size() == 8);
+   }
+
+   REQUIRE_FALSE(testDir.removeIfExists());
+}
+
+} // namespace tests
+} // namespace clang
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,337 @@
+/*
+ * JobOutputLog.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "JobOutputLog.hpp"
+
+#include <istream>
+#include <ostream>
+
+#include <core/BinarySerializer.hpp>
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace jobs {
+
+namespace {
+
+// buffered output is written once there's this much of it
+const std::size_t kFlushSize = 64 * 1024;
+
+// the offset of every this many lines is indexed
+const int kIndexStride = 64;
+
+// the size of the chunks the output is scanned in
+const std::size_t kScanChunkSize = 64 * 1024;
+
+Error ioError(const FilePath& path, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::io_error, location);
+   error.addProperty("path", path.getAbsolutePath());
+   return error;
+}
+
+} // anonymous namespace
+
+JobOutputLog::JobOutputLog(const FilePath& path)
+   : path_(path),
+     indexed_(false),
+     indexedOffsets_(0),
+     size_(0),
+     lines_(0)
+{
+}
+
+JobOutputLog::~JobOutputLog()
+{
+   try
+   {
+      close();
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+bool JobOutputLog::append(int type, const std::string& output)
+{
+   // (an existing file, e.g. of a job which is run again, is added to)
+   loadIndex();
+
+   json::Array contents;
+   contents.push_back(type);
+   contents.push_back(output);
+
+   if (lines_ % kIndexStride == 0)
+      offsets_.push_back(size_);
+
+   bool buffered = !buffer_.empty();
+   std::string line = contents.write() + "\n";
+   buffer_.append(line);
+   size_ += line.size();
+   lines_++;
+
+   if (buffer_.size() >= kFlushSize)
+   {
+      Error error = flush();
+      if (error)
+         LOG_ERROR(error);
+      return false;
+   }
+
+   return !buffered;
+}
+
+Error JobOutputLog::flush()
+{
+   if (buffer_.empty())
+      return Success();
+
+   std::string buffer;
+   buffer.swap(buffer_);
+
+   if (!pOutput_)
+   {
+      Error error = path_.getParent().ensureDirectory();
+      if (!error)
+         error = path_.openForWrite(pOutput_, false /* don't truncate */);
+      if (error)
+      {
+         // (the output is lost, and the index re-created from the file)
+         indexed_ = false;
+         return error;
+      }
+   }
+
+   pOutput_->write(buffer.data(), buffer.size());
+   pOutput_->flush();
+   if (pOutput_->fail())
+   {
+      pOutput_.reset();
+      indexed_ = false;
+      return ioError(path_, ERROR_LOCATION);
+   }
+
+   return writeIndex();
+}
+
+void JobOutputLog::close()
+{
+   Error error = flush();
+   if (error)
+      LOG_ERROR(error);
+
+   pOutput_.reset();
+   pIndex_.reset();
+}
+
+json::Array JobOutputLog::read(int position)
+{
+   json::Array output;
+
+   Error error = flush();
+   if (error)
+      LOG_ERROR(error);
+
+   loadIndex();
+   position = std::max(position, 0);
+   if (position >= lines_)
+      return output;
+
+   std::shared_ptr<std::istream> pIfs;
+   error = path_.openForRead(pIfs);
+   if (error)
+   {
+      // path not found is expected if the job hasn't produced any output yet
+      if (!isPathNotFoundError(error))
+         LOG_ERROR(error);
+      return output;
+   }
+
+   try
+   {
+      // reading eof can trigger a failbit
+      pIfs->exceptions(std::istream::badbit);
+
+      // seek to the indexed line before the position
+      std::size_t entry = static_cast<std::size_t>(position / kIndexStride);
+      int line = static_cast<int>(entry) * kIndexStride;
+      pIfs->seekg(static_cast<std::streamoff>(offsets_[entry]));
+
+      // read each line; parse it as JSON and add it to the output array if
+      // it's past the sought position
+      std::string content;
+      json::Value val;
+      while (!pIfs->eof())
+      {
+         std::getline(*pIfs, content);
+         if (line++ >= position)
+         {
+            if (!val.parse(content))
+               output.push_back(val);
+         }
+      }
+   }
+   catch(const std::exception& e)
+   {
+      error = ioError(path_, ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      LOG_ERROR(error);
+   }
+
+   return output;
+}
+
+void JobOutputLog::remove()
+{
+   buffer_.clear();
+   pOutput_.reset();
+   pIndex_.reset();
+   indexed_ = false;
+
+   Error error = path_.removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+   error = indexPath().removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+}
+
+FilePath JobOutputLog::indexPath() const
+{
+   return FilePath(path_.getAbsolutePath() + ".idx");
+}
+
+void JobOutputLog::loadIndex()
+{
+   if (indexed_)
+      return;
+
+   indexed_ = true;
+   offsets_.clear();
+   indexedOffsets_ = 0;
+   size_ = 0;
+   lines_ = 0;
+   pIndex_.reset();
+
+   if (!path_.exists())
+      return;
+
+   boost::uint64_t fileSize = static_cast<boost::uint64_t>(path_.getSize());
+   readIndexFile(fileSize);
+
+   // the lines after those indexed (all of them, if there's no index) are
+   // scanned for
+   boost::uint64_t offset = 0;
+   if (!offsets_.empty())
+   {
+      offset = offsets_.back();
+      lines_ = static_cast<int>(offsets_.size() - 1) * kIndexStride;
+      offsets_.pop_back();
+   }
+
+   std::shared_ptr<std::istream> pIfs;
+   Error error = path_.openForRead(pIfs);
+   if (error)
+   {
+      LOG_ERROR(error);
+      offsets_.clear();
+      lines_ = 0;
+      return;
+   }
+
+   pIfs->seekg(static_cast<std::streamoff>(offset));
+   bool lineStart = true;
+   std::vector<char> chunk(kScanChunkSize);
+   while (*pIfs)
+   {
+      pIfs->read(chunk.data(), chunk.size());
+      std::streamsize count = pIfs->gcount();
+      for (std::streamsize i = 0; i < count; i++, offset++)
+      {
+         if (lineStart && lines_ % kIndexStride == 0)
+            offsets_.push_back(offset);
+
+         lineStart = chunk[i] == '\n';
+         if (lineStart)
+            lines_++;
+      }
+   }
+   size_ = offset;
+
+   // a line left unfinished (e.g. by a session which exited as it wrote) is
+   // ended, so that it doesn't run into the next
+   if (!lineStart)
+   {
+      buffer_ = "\n" + buffer_;
+      size_++;
+      lines_++;
+   }
+}
+
+void JobOutputLog::readIndexFile(boost::uint64_t fileSize)
+{
+   using namespace core::binary;
+
+   std::shared_ptr<std::istream> pIfs;
+   if (!indexPath().exists() || indexPath().openForRead(pIfs))
+      return;
+
+   // the offsets are valid if they're increasing and within the file (or
+   // from the first which isn't)
+   boost::uint64_t offset;
+   while (readUInt(*pIfs, 8, &offset))
+   {
+      bool valid = offsets_.empty() ?
+               offset == 0 :
+               offset > offsets_.back() && offset < fileSize;
+      if (!valid)
+         break;
+      offsets_.push_back(offset);
+   }
+}
+
+Error JobOutputLog::writeIndex()
+{
+   using namespace core::binary;
+
+   // the sidecar is written afresh when it's opened (so it matches the
+   // offsets found when the log was loaded)
+   if (!pIndex_)
+   {
+      Error error = indexPath().openForWrite(pIndex_, true);
+      if (error)
+         return error;
+      indexedOffsets_ = 0;
+   }
+
+   for (; indexedOffsets_ < offsets_.size(); indexedOffsets_++)
+      writeUInt(*pIndex_, offsets_[indexedOffsets_], 8);
+
+   pIndex_->flush();
+   if (pIndex_->fail())
+   {
+      pIndex_.reset();
+      return ioError(indexPath(), ERROR_LOCATION);
+   }
+
+   return Success();
+}
+
+} // namespace jobs
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,91 @@
+/*
+ * JobOutputLog.hpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_JOBS_JOB_OUTPUT_LOG_HPP
+#define SESSION_JOBS_JOB_OUTPUT_LOG_HPP
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+#include <shared_core/json/Json.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace jobs {
+
+// The output of a job, saved as newline-delimited JSON (a [type, output]
+// array per line). Output is buffered, and written when enough of it has
+// been added or when the log is flushed (which the owner does shortly after
+// output is first buffered); the file is kept open while the job runs. A
+// sidecar file indexes the offsets of the lines, so reading the output from
+// a given line seeks to it rather than reading all of the lines before it.
+class JobOutputLog : boost::noncopyable
+{
+public:
+   explicit JobOutputLog(const core::FilePath& path);
+   ~JobOutputLog();
+
+   // adds a line of output; returns true if the log now needs flushing
+   // (that is, output is buffered and wasn't before)
+   bool append(int type, const std::string& output);
+
+   // writes the buffered output
+   core::Error flush();
+
+   // writes the buffered output and closes the files (they're reopened if
+   // there's more output)
+   void close();
+
+   // the output from the given line on
+   core::json::Array read(int position);
+
+   // discards the output and removes the files
+   void remove();
+
+private:
+   core::FilePath indexPath() const;
+   void loadIndex();
+   void readIndexFile(boost::uint64_t fileSize);
+   core::Error writeIndex();
+
+   core::FilePath path_;
+   std::shared_ptr<std::ostream> pOutput_;
+   std::shared_ptr<std::ostream> pIndex_;
+   std::string buffer_;
+
+   // the offsets of every kIndexStride-th line (those written to the
+   // sidecar first), and the size and line count of the output (including
+   // that buffered)
+   bool indexed_;
+   std::vector<boost::uint64_t> offsets_;
+   std::size_t indexedOffsets_;
+   boost::uint64_t size_;
+   int lines_;
+};
+
+} // namespace jobs
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_JOBS_JOB_OUTPUT_LOG_HPP
@@ -0,0 +1,160 @@
+/*
+ * JobOutputLogTests.cpp
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "JobOutputLog.hpp"
+
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/FileSerializer.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace jobs {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+std::string line(int i)
+{
+   return "line " + safe_convert::numberToString(i) + "\n";
+}
+
+// are the entries the lines from begin to end?
+bool hasLines(const json::Array& output, int begin, int end)
+{
+   if (output.getSize() != static_cast<std::size_t>(end - begin))
+      return false;
+
+   for (int i = begin; i < end; i++)
+   {
+      json::Array entry = output[i - begin].getArray();
+      if (entry.getSize() != 2 || entry[1].getString() != line(i))
+         return false;
+   }
+
+   return true;
+}
+
+} // anonymous namespace
+
+TEST_CASE("JobOutputLog")
+{
+   FilePath dir;
+   REQUIRE_FALSE(FilePath::tempFilePath(dir));
+   FilePath path = dir.completeChildPath("job-output.json");
+
+   SECTION("Output is buffered until it's flushed")
+   {
+      JobOutputLog log(path);
+      CHECK(log.append(0, line(0)));
+      CHECK_FALSE(log.append(1, line(1)));
+      CHECK_FALSE(path.exists());
+
+      REQUIRE_FALSE(log.flush());
+      CHECK(path.exists());
+      CHECK(log.append(0, line(2)));
+
+      // (reading gives the output buffered)
+      json::Array output = log.read(0);
+      CHECK(hasLines(output, 0, 3));
+      CHECK(output[1].getArray()[0].getInt() == 1);
+
+      // lots of output is written at once
+      CHECK_FALSE(log.append(0, std::string(100 * 1024, 'x')));
+   }
+
+   SECTION("Output is read from a given line")
+   {
+      JobOutputLog log(path);
+      for (int i = 0; i < 200; i++)
+         log.append(0, line(i));
+
+      CHECK(hasLines(log.read(0), 0, 200));
+      CHECK(hasLines(log.read(64), 64, 200));
+      CHECK(hasLines(log.read(130), 130, 200));
+      CHECK(hasLines(log.read(199), 199, 200));
+      CHECK(log.read(200).isEmpty());
+   }
+
+   SECTION("Saved output is indexed for other logs")
+   {
+      {
+         JobOutputLog log(path);
+         for (int i = 0; i < 150; i++)
+            log.append(0, line(i));
+      }
+
+      JobOutputLog log(path);
+      CHECK(hasLines(log.read(100), 100, 150));
+      for (int i = 150; i < 200; i++)
+         log.append(0, line(i));
+      CHECK(hasLines(log.read(140), 140, 200));
+   }
+
+   SECTION("Output is read without a (valid) index")
+   {
+      {
+         JobOutputLog log(path);
+         for (int i = 0; i < 150; i++)
+            log.append(0, line(i));
+      }
+
+      FilePath indexPath(path.getAbsolutePath() + ".idx");
+      REQUIRE(indexPath.exists());
+      REQUIRE_FALSE(writeStringToFile(indexPath, std::string(24, '\x7f')));
+      CHECK(hasLines(JobOutputLog(path).read(70), 70, 150));
+
+      REQUIRE_FALSE(indexPath.remove());
+      CHECK(hasLines(JobOutputLog(path).read(130), 130, 150));
+   }
+
+   SECTION("Unfinished lines are ended")
+   {
+      REQUIRE_FALSE(dir.ensureDirectory());
+      REQUIRE_FALSE(writeStringToFile(path, "[0,\"line 0\\n\"]\n[0,\"li"));
+
+      JobOutputLog log(path);
+      log.append(0, line(2));
+      json::Array output = log.read(0);
+      REQUIRE(output.getSize() == 2);
+      CHECK(output[1].getArray()[1].getString() == line(2));
+   }
+
+   SECTION("Removed logs are empty")
+   {
+      JobOutputLog log(path);
+      log.append(0, line(0));
+      log.remove();
+      CHECK(log.read(0).isEmpty());
+      CHECK_FALSE(path.exists());
+
+      log.append(0, line(0));
+      CHECK(hasLines(log.read(0), 0, 1));
+   }
+
+   dir.removeIfExists();
+}
+
+} // end namespace tests
+} // end namespace jobs
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
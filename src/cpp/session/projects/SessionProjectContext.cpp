@@ -598,14 +598,15 @@ void ProjectContext::fileMonitorRegistered(
 void ProjectContext::fileMonitorFilesChanged(
                    const std::vector<core::system::FileChangeEvent>& events)
 {
-   // notify client (gwt)
-   module_context::enqueFileChangedEvents(directory(), events);
-
    // own handler
    onProjectFilesChanged(events);
 
-   // notify subscribers
+   // notify subscribers (before the client, so that e.g. the git status
+   // the changed files are decorated with reflects the changes)
    onFilesChanged_(events);
+
+   // notify client (gwt)
+   module_context::enqueFileChangedEvents(directory(), events);
 }
 
 void ProjectContext::fileMonitorTermination(const Error& error)
@@ -52,7 +52,15 @@ public class Websocket {
         $wnd[s].onopen = function() { ws.@com.sksamuel.gwt.websockets.Websocket::onOpen()(); };
         $wnd[s].onclose = function(evt) { ws.@com.sksamuel.gwt.websockets.Websocket::onClose(SLjava/lang/String;Z)(evt.code, evt.reason, evt.wasClean); };
         $wnd[s].onerror = function() { ws.@com.sksamuel.gwt.websockets.Websocket::onError()(); };
-        $wnd[s].onmessage = function(msg) { ws.@com.sksamuel.gwt.websockets.Websocket::onMessage(Ljava/lang/String;)(msg.data); }
+        // binary messages are delivered as the UTF-8 text they hold
+        $wnd[s].binaryType = "arraybuffer";
+        var decoder = new TextDecoder("utf-8");
+        $wnd[s].onmessage = function(msg) {
+            var data = msg.data;
+            if (data instanceof ArrayBuffer)
+                data = decoder.decode(data);
+            ws.@com.sksamuel.gwt.websockets.Websocket::onMessage(Ljava/lang/String;)(data);
+        };
     }-*/;
 
     private native void _send(String s, String msg) /*-{
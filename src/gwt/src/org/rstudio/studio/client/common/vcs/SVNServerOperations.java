@@ -14,7 +14,6 @@
  */
 package org.rstudio.studio.client.common.vcs;
 
-import com.google.gwt.core.client.JsArray;
 import org.rstudio.core.client.files.FileSystemItem;
 import org.rstudio.core.client.jsonrpc.RpcObjectList;
 import org.rstudio.studio.client.common.console.ConsoleProcess;
@@ -40,8 +39,7 @@ public interface SVNServerOperations extends VCSServerOperations
                    ArrayList<String> paths,
                    ServerRequestCallback<ProcessResult> requestCallback);
 
-   void svnStatus(
-         ServerRequestCallback<JsArray<StatusAndPathInfo>> requestCallback);
+   void svnStatus(ServerRequestCallback<SVNStatusResult> requestCallback);
 
    void svnUpdate(ServerRequestCallback<ConsoleProcess> requestCallback);
 
@@ -0,0 +1,32 @@
+/*
+ * SVNStatusResult.java
+ *
+ * Copyright (C) 2021 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+package org.rstudio.studio.client.common.vcs;
+
+import com.google.gwt.core.client.JavaScriptObject;
+import com.google.gwt.core.client.JsArray;
+
+public class SVNStatusResult extends JavaScriptObject
+{
+   protected SVNStatusResult() {}
+
+   public final native JsArray<StatusAndPathInfo> getFiles() /*-{
+      return this.files;
+   }-*/;
+
+   // is this the last status read, which is being read again?
+   public final native boolean isStale() /*-{
+      return this.stale;
+   }-*/;
+}
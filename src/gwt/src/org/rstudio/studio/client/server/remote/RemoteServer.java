@@ -75,6 +75,7 @@ import org.rstudio.studio.client.common.vcs.CreateKeyResult;
 import org.rstudio.studio.client.common.vcs.DiffResult;
 import org.rstudio.studio.client.common.vcs.ProcessResult;
 import org.rstudio.studio.client.common.vcs.RemotesInfo;
+import org.rstudio.studio.client.common.vcs.SVNStatusResult;
 import org.rstudio.studio.client.common.vcs.StatusAndPathInfo;
 import org.rstudio.studio.client.common.vcs.VcsCloneOptions;
 import org.rstudio.studio.client.events.GetEditorContextEvent;
@@ -1530,6 +1531,33 @@ public class RemoteServer implements Server
                   requestCallback);
    }
 
+   public void listFilesPage(
+                  FileSystemItem directory,
+                  boolean monitor,
+                  boolean showHidden,
+                  String sortBy,
+                  boolean ascending,
+                  int offset,
+                  int count,
+                  String after,
+                  ServerRequestCallback<DirectoryListing> requestCallback)
+   {
+      JSONArray paramArray = new JSONArray();
+      paramArray.set(0, new JSONString(directory.getPath()));
+      paramArray.set(1, JSONBoolean.getInstance(monitor));
+      paramArray.set(2, JSONBoolean.getInstance(showHidden));
+      paramArray.set(3, new JSONString(sortBy));
+      paramArray.set(4, JSONBoolean.getInstance(ascending));
+      paramArray.set(5, new JSONNumber(offset));
+      paramArray.set(6, new JSONNumber(count));
+      paramArray.set(7, new JSONString(StringUtil.notNull(after)));
+
+      sendRequest(RPC_SCOPE,
+                  LIST_FILES_PAGE,
+                  paramArray,
+                  requestCallback);
+   }
+
    public void listAllFiles(String path,
                             String pattern,
                             ServerRequestCallback<JsArrayString> requestCallback)
@@ -3898,7 +3926,7 @@ public class RemoteServer implements Server
    }
 
    @Override
-   public void svnStatus(ServerRequestCallback<JsArray<StatusAndPathInfo>> requestCallback)
+   public void svnStatus(ServerRequestCallback<SVNStatusResult> requestCallback)
    {
       sendRequest(RPC_SCOPE, SVN_STATUS, requestCallback);
    }
@@ -6599,6 +6627,7 @@ public class RemoteServer implements Server
    private static final String IS_GIT_DIRECTORY = "is_git_directory";
    private static final String IS_PACKAGE_DIRECTORY = "is_package_directory";
    private static final String LIST_FILES = "list_files";
+   private static final String LIST_FILES_PAGE = "list_files_page";
    private static final String LIST_ALL_FILES = "list_all_files";
    private static final String CREATE_FOLDER = "create_folder";
    private static final String DELETE_FILES = "delete_files";
@@ -41,6 +41,7 @@ import org.rstudio.studio.client.application.events.EventBus;
 import org.rstudio.studio.client.common.ConsoleDispatcher;
 import org.rstudio.studio.client.common.FilePathUtils;
 import org.rstudio.studio.client.common.GlobalDisplay;
+import org.rstudio.studio.client.common.SimpleRequestCallback;
 import org.rstudio.studio.client.common.fileexport.FileExport;
 import org.rstudio.studio.client.common.filetypes.FileTypeRegistry;
 import org.rstudio.studio.client.common.filetypes.TextFileType;
@@ -68,6 +69,7 @@ import org.rstudio.studio.client.workbench.views.files.model.DirectoryListing;
 import org.rstudio.studio.client.workbench.views.files.model.FileChange;
 import org.rstudio.studio.client.workbench.views.files.model.FilesServerOperations;
 import org.rstudio.studio.client.workbench.views.files.model.PendingFileUpload;
+import org.rstudio.studio.client.workbench.views.files.ui.FilesList;
 import org.rstudio.studio.client.workbench.views.source.SourceColumnManager;
 import org.rstudio.studio.client.workbench.views.source.events.SourcePathChangedEvent;
 import org.rstudio.studio.client.workbench.views.source.model.SourceDocumentResult;
@@ -99,6 +101,7 @@ public class Files
       {
          void onFileSelectionChanged();
          void onColumnSortOrderChanaged(JsArray<ColumnSortInfo> sortOrder);
+         void onShowMoreFiles();
       }
 
       void setObserver(Observer observer);
@@ -109,6 +112,15 @@ public class Files
       void listDirectory(FileSystemItem directory,
                          ServerDataSource<DirectoryListing> filesDS);
 
+      // add the next page of a partial listing of the current directory
+      void appendDirectoryListing(DirectoryListing listing);
+
+      // where the next page of a partial listing starts (the server's offset
+      // and the last file it sent), and whether there is a next page
+      int getNextPageOffset();
+      String getLastPagedPath();
+      boolean isPartialListing();
+
       void updateDirectoryListing(FileChange action);
 
       void renameFile(FileSystemItem from, FileSystemItem to);
@@ -362,7 +374,55 @@ public class Files
                                     JsArray<ColumnSortInfo> sortOrder)
       {
          columnSortOrder_ = sortOrder;
+
+         // a partial listing is re-read in the new order, since sorting the
+         // files we have wouldn't bring in the ones which now come first
+         if (view_.isPartialListing() &&
+             (!getSortKey(sortOrder).equals(listedSortKey_) ||
+              getSortAscending(sortOrder) != listedSortAscending_))
+         {
+            view_.listDirectory(currentPath_, currentPathFilesDS_);
+         }
       }
+
+      public void onShowMoreFiles()
+      {
+         final FileSystemItem directory = currentPath_;
+         server_.listFilesPage(
+               directory,
+               true,
+               pPrefs_.get().showHiddenFiles().getValue(),
+               listedSortKey_,
+               listedSortAscending_,
+               view_.getNextPageOffset(),
+               FILES_PAGE_SIZE,
+               view_.getLastPagedPath(),
+               new SimpleRequestCallback<DirectoryListing>("File Listing Error")
+               {
+                  @Override
+                  public void onResponseReceived(DirectoryListing listing)
+                  {
+                     // ignore pages of a directory we've since left
+                     if (directory.equalTo(currentPath_))
+                        view_.appendDirectoryListing(listing);
+                  }
+               });
+      }
+   }
+
+   // the list_files_page sort key and direction for the primary sort column
+   private static String getSortKey(JsArray<ColumnSortInfo> sortOrder)
+   {
+      if (sortOrder == null || sortOrder.length() == 0)
+         return "name";
+      return FilesList.getSortKey(sortOrder.get(0).getColumnIndex());
+   }
+
+   private static boolean getSortAscending(JsArray<ColumnSortInfo> sortOrder)
+   {
+      if (sortOrder == null || sortOrder.length() == 0)
+         return true;
+      return sortOrder.get(0).getAscending();
    }
 
 
@@ -1209,17 +1269,25 @@ public class Files
    }
 
    // data source for listing files on the current path which can
-   // be passed to the files view
+   // be passed to the files view (the first page, in the current sort order,
+   // of the server's cached listing; more are read as they're asked for)
    ServerDataSource<DirectoryListing> currentPathFilesDS_ =
       new ServerDataSource<DirectoryListing>()
       {
          public void requestData(
                ServerRequestCallback<DirectoryListing> requestCallback)
          {
+            listedSortKey_ = getSortKey(columnSortOrder_);
+            listedSortAscending_ = getSortAscending(columnSortOrder_);
 
-            server_.listFiles(currentPath_,
-                  true, // pass true to enable monitoring for all calls to list_files
+            server_.listFilesPage(currentPath_,
+                  true, // pass true to enable monitoring for all calls to list_files_page
                   pPrefs_.get().showHiddenFiles().getValue(), // respect user pref for showing hidden
+                  listedSortKey_,
+                  listedSortAscending_,
+                  0,
+                  FILES_PAGE_SIZE,
+                  null,
                   requestCallback);
          }
       };
@@ -1244,6 +1312,9 @@ public class Files
    private static final String KEY_PATH = "path";
    private static final String KEY_SORT_ORDER = "sortOrder";
    private JsArray<ColumnSortInfo> columnSortOrder_ = null;
+   private String listedSortKey_ = "name";
+   private boolean listedSortAscending_ = true;
+   private static final int FILES_PAGE_SIZE = 2000;
    private DataImportPresenter dataImportPresenter_;
    private boolean inputPending_ = false;
 
@@ -21,16 +21,20 @@ import com.google.gwt.dom.client.Style.Unit;
 import com.google.gwt.user.client.Command;
 import com.google.gwt.user.client.Event;
 import com.google.gwt.user.client.ui.DockLayoutPanel;
+import com.google.gwt.user.client.ui.FlowPanel;
+import com.google.gwt.user.client.ui.InlineLabel;
 import com.google.gwt.user.client.ui.MenuItem;
 import com.google.gwt.user.client.ui.Widget;
 import com.google.gwt.user.client.ui.PopupPanel.PositionCallback;
 import com.google.inject.Inject;
 import com.google.inject.Provider;
 
+import org.rstudio.core.client.StringUtil;
 import org.rstudio.core.client.cellview.ColumnSortInfo;
 import org.rstudio.core.client.command.AppCommand;
 import org.rstudio.core.client.files.FileSystemItem;
 import org.rstudio.core.client.resources.ImageResource2x;
+import org.rstudio.core.client.widget.HyperlinkLabel;
 import org.rstudio.core.client.widget.Operation;
 import org.rstudio.core.client.widget.OperationWithInput;
 import org.rstudio.core.client.widget.ProgressOperationWithInput;
@@ -113,6 +117,12 @@ public class FilesPane extends WorkbenchPane implements Files.Display
          if (observer_ != null)
             observer_.onColumnSortOrderChanaged(sortOrder);
       }
+
+      public void onShowMoreFiles()
+      {
+         if (observer_ != null)
+            observer_.onShowMoreFiles();
+      }
    }
    
    @Override
@@ -151,7 +161,10 @@ public class FilesPane extends WorkbenchPane implements Files.Display
             }
                
             filePathToolbar_.setPath(directory.getPath(), lastBrowseable);
-            filesList_.displayFiles(directory, response.getFiles()); 
+            filesList_.displayFiles(directory,
+                                    response.getFiles(),
+                                    response.getTotalCount());
+            updateMoreFiles();
          }
          public void onError(ServerError error)
          {
@@ -169,13 +182,53 @@ public class FilesPane extends WorkbenchPane implements Files.Display
       });
    }
    
+   public void appendDirectoryListing(DirectoryListing listing)
+   {
+      filesList_.appendFiles(listing.getFiles(),
+                             listing.getOffset(),
+                             listing.getTotalCount());
+      updateMoreFiles();
+   }
+
+   public int getNextPageOffset()
+   {
+      return filesList_ != null ? filesList_.getNextPageOffset() : 0;
+   }
+
+   public String getLastPagedPath()
+   {
+      return filesList_ != null ? filesList_.getLastPagedPath() : null;
+   }
+
+   public boolean isPartialListing()
+   {
+      return filesList_ != null && filesList_.isPartialListing();
+   }
+
    public void updateDirectoryListing(FileChange fileAction)
    {
       if (filesList_ != null) // can be called by file_changed event
                              // prior to widget creation
       {
          filesList_.updateWithAction(fileAction);
+         updateMoreFiles();
+      }
+   }
+
+   // show how much of a partial listing we have (and a link for more)
+   private void updateMoreFiles()
+   {
+      boolean partial = filesList_.isPartialListing();
+      if (partial)
+      {
+         moreFilesLabel_.setText(
+               "Showing " +
+               StringUtil.formatGeneralNumber(filesList_.getFileCount()) +
+               " of " +
+               StringUtil.formatGeneralNumber(filesList_.getTotalCount()) +
+               " files. ");
       }
+      dockPanel_.setWidgetHidden(moreFilesPanel_, !partial);
    }
    
    public void renameFile(FileSystemItem from, FileSystemItem to)
@@ -307,13 +360,26 @@ public class FilesPane extends WorkbenchPane implements Files.Display
                FilesList.SortOrder.Natural :
                FilesList.SortOrder.Lexicographic);
 
-      DockLayoutPanel dockPanel = new DockLayoutPanel(Unit.PX);
-      dockPanel.addNorth(filePathToolbar_, filePathToolbar_.getHeight());
-      dockPanel.add(filesList_);
-      dockPanel.addStyleName("ace_editor_theme");
+      // status line (and link) for directories with more files than we list
+      moreFilesLabel_ = new InlineLabel();
+      moreFilesPanel_ = new FlowPanel();
+      moreFilesPanel_.getElement().getStyle().setPadding(3, Unit.PX);
+      moreFilesPanel_.add(moreFilesLabel_);
+      moreFilesPanel_.add(new HyperlinkLabel("Show more", () ->
+      {
+         if (observer_ != null)
+            observer_.onShowMoreFiles();
+      }));
+
+      dockPanel_ = new DockLayoutPanel(Unit.PX);
+      dockPanel_.addNorth(filePathToolbar_, filePathToolbar_.getHeight());
+      dockPanel_.addSouth(moreFilesPanel_, MORE_FILES_HEIGHT_PIXELS);
+      dockPanel_.add(filesList_);
+      dockPanel_.addStyleName("ace_editor_theme");
+      dockPanel_.setWidgetHidden(moreFilesPanel_, true);
       
       // return container
-      return dockPanel;
+      return dockPanel_;
    }
 
    @Override
@@ -347,6 +413,10 @@ public class FilesPane extends WorkbenchPane implements Files.Display
    private boolean needsInit = false;
    private FilesList filesList_;
    private FilePathToolbar filePathToolbar_;
+   private DockLayoutPanel dockPanel_;
+   private FlowPanel moreFilesPanel_;
+   private InlineLabel moreFilesLabel_;
+   private static final int MORE_FILES_HEIGHT_PIXELS = 24;
    private final GlobalDisplay globalDisplay_;
    private final FileDialogs fileDialogs_;
    private Files.Display.Observer observer_;
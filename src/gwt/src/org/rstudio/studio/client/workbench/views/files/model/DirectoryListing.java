@@ -32,4 +32,14 @@ public class DirectoryListing extends JavaScriptObject
    public final native JsArray<FileSystemItem> getFiles() /*-{
       return this.files;
    }-*/;
+
+   // total number of files in the directory (paged listings only)
+   public final native int getTotalCount() /*-{
+      return this.total_count;
+   }-*/;
+
+   // offset of the first file returned (paged listings only)
+   public final native int getOffset() /*-{
+      return this.offset;
+   }-*/;
 }
@@ -47,6 +47,18 @@ public interface FilesServerOperations
                   boolean showHidden,
                   ServerRequestCallback<DirectoryListing> requestCallback);
 
+   // get a window of a (server-side cached) sorted file listing, starting
+   // after the file with path 'after' (if it's still listed) or at 'offset'
+   void listFilesPage(FileSystemItem directory,
+                      boolean monitor,
+                      boolean showHidden,
+                      String sortBy,
+                      boolean ascending,
+                      int offset,
+                      int count,
+                      String after,
+                      ServerRequestCallback<DirectoryListing> requestCallback);
+
    void listAllFiles(String path,
                      String pattern,
                      ServerRequestCallback<JsArrayString> requestCallback);
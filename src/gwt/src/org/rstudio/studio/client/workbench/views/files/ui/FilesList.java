@@ -16,6 +16,7 @@ package org.rstudio.studio.client.workbench.views.files.ui;
 
 import java.util.ArrayList;
 import java.util.Comparator;
+import java.util.HashSet;
 import java.util.List;
 import java.util.Set;
 
@@ -375,8 +376,26 @@ public class FilesList extends Composite
    }
 
 
+   // the list_files_page sort key for the column at the given index (the
+   // columns are added in this order by the constructor)
+   public static String getSortKey(int columnIndex)
+   {
+      switch (columnIndex)
+      {
+      case 1:
+         return "type";
+      case 3:
+         return "size";
+      case 4:
+         return "modified";
+      default:
+         return "name";
+      }
+   }
+
    public void displayFiles(FileSystemItem containingPath,
-                            JsArray<FileSystemItem> files)
+                            JsArray<FileSystemItem> files,
+                            int totalCount)
    {
       // clear the selection
       selectNone();
@@ -384,6 +403,8 @@ public class FilesList extends Composite
       // set containing path
       containingPath_ = containingPath;
       parentPath_ = containingPath_.getParentPath();
+      totalCount_ = totalCount;
+      onPageListed(files, 0, totalCount);
 
       // set page size (+1 for parent path)
       filesDataGrid_.setPageSize(files.length() + 1);
@@ -407,6 +428,77 @@ public class FilesList extends Composite
       observer_.onFileSelectionChanged();
    }
 
+   // add files from the next page of a partial listing
+   public void appendFiles(JsArray<FileSystemItem> files,
+                           int offset,
+                           int totalCount)
+   {
+      onPageListed(files, offset, totalCount);
+
+      // skip files we already have (pages overlap when files which sort
+      // ahead of them are added between requests)
+      List<FileSystemItem> fileList = getFiles();
+      Set<String> listedPaths = new HashSet<>();
+      for (FileSystemItem file : fileList)
+         listedPaths.add(file.getPath());
+
+      for (int i=0; i<files.length(); i++)
+      {
+         FileSystemItem file = files.get(i);
+         if (!listedPaths.contains(file.getPath()))
+            fileList.add(file);
+      }
+
+      filesDataGrid_.setPageSize(fileList.size() + 1);
+      applyColumnSortList();
+
+      // (files added since the listing are already counted)
+      totalCount_ = Math.max(totalCount, getFileCount());
+   }
+
+   // note where the next page starts. this is tracked apart from the files
+   // we list, which also include those added since the listing (which may
+   // sort anywhere in it)
+   private void onPageListed(JsArray<FileSystemItem> files,
+                             int offset,
+                             int totalCount)
+   {
+      nextPageOffset_ = offset + files.length();
+      if (files.length() > 0)
+         lastPagedPath_ = files.get(files.length() - 1).getPath();
+      else if (offset == 0)
+         lastPagedPath_ = null;
+      hasNextPage_ = files.length() > 0 && nextPageOffset_ < totalCount;
+   }
+
+   public int getNextPageOffset()
+   {
+      return nextPageOffset_;
+   }
+
+   public String getLastPagedPath()
+   {
+      return lastPagedPath_;
+   }
+
+   // number of files listed (not counting the parent path)
+   public int getFileCount()
+   {
+      return getFiles().size() - (parentPath_ != null ? 1 : 0);
+   }
+
+   // number of files in the directory (as of the last listing and changes)
+   public int getTotalCount()
+   {
+      return totalCount_;
+   }
+
+   // whether the directory has more files than are listed
+   public boolean isPartialListing()
+   {
+      return hasNextPage_ && getFileCount() < totalCount_;
+   }
+
    public void selectAll()
    {
       for (FileSystemItem item : dataProvider_.getList())
@@ -445,6 +537,7 @@ public class FilesList extends Composite
             {
                files.add(file);
                filesDataGrid_.setPageSize(files.size() + 1);
+               totalCount_++;
             }
             else
             {
@@ -475,9 +568,19 @@ public class FilesList extends Composite
       case FileChange.DELETE:
          {
             int row = rowForFile(file);
-            if (row != -1)
+            if (row == -1)
+            {
+               // a file we haven't listed yet (in a later page)
+               if (isPartialListing() &&
+                   file.getParentPath().equalTo(containingPath_))
+               {
+                  totalCount_ = Math.max(totalCount_ - 1, getFileCount());
+               }
+            }
+            else
             {
                files.remove(row);
+               totalCount_ = Math.max(totalCount_ - 1, getFileCount());
 
                // if a file is deleted and then re-added within the same
                // event loop (as occurs when gedit saves a text file) the
@@ -681,6 +784,10 @@ public class FilesList extends Composite
 
    private FileSystemItem containingPath_ = null;
    private FileSystemItem parentPath_ = null;
+   private int totalCount_ = 0;
+   private int nextPageOffset_ = 0;
+   private String lastPagedPath_ = null;
+   private boolean hasNextPage_ = false;
 
    private final DataGrid<FileSystemItem> filesDataGrid_;
    private final LinkColumn<FileSystemItem> nameColumn_;
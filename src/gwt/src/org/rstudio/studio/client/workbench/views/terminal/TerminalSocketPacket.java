@@ -27,6 +27,7 @@ import org.rstudio.core.client.StringUtil;
  *    "b" = ping/pong, e.g. "b"
  *
  * Only the "send text" method has a payload (everything after the "a").
+ * Text sent by the server comes in binary frames, which the Websocket decodes.
  *
  * See SessionConsoleProcessSocketPacket in session code for C++ side of this sophisticated
  * wire format.
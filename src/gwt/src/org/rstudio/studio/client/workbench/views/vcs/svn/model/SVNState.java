@@ -14,7 +14,7 @@
  */
 package org.rstudio.studio.client.workbench.views.vcs.svn.model;
 
-import com.google.gwt.core.client.JsArray;
+import com.google.gwt.user.client.Timer;
 import com.google.inject.Inject;
 import com.google.inject.Singleton;
 import org.rstudio.core.client.Debug;
@@ -22,6 +22,7 @@ import org.rstudio.core.client.files.FileSystemItem;
 import org.rstudio.studio.client.application.events.EventBus;
 import org.rstudio.studio.client.common.GlobalDisplay;
 import org.rstudio.studio.client.common.vcs.SVNServerOperations;
+import org.rstudio.studio.client.common.vcs.SVNStatusResult;
 import org.rstudio.studio.client.common.vcs.StatusAndPath;
 import org.rstudio.studio.client.common.vcs.StatusAndPathInfo;
 import org.rstudio.studio.client.server.ServerError;
@@ -59,13 +60,19 @@ public class SVNState extends VcsState
    @Override
    public void refresh(final boolean showError)
    {
-      server_.svnStatus(new ServerRequestCallback<JsArray<StatusAndPathInfo>>()
+      staleRefreshTimer_.cancel();
+      server_.svnStatus(new ServerRequestCallback<SVNStatusResult>()
       {
          @Override
-         public void onResponseReceived(JsArray<StatusAndPathInfo> response)
+         public void onResponseReceived(SVNStatusResult response)
          {
-            status_ = StatusAndPath.fromInfos(response);
+            status_ = StatusAndPath.fromInfos(response.getFiles());
             handlers_.fireEvent(new VcsRefreshEvent(Reason.VcsOperation));
+
+            // a stale status is being read again in the background; ask
+            // for it again once that's likely to have finished
+            if (response.isStale())
+               staleRefreshTimer_.schedule(STALE_REFRESH_DELAY_MS);
          }
 
          @Override
@@ -86,4 +93,15 @@ public class SVNState extends VcsState
    }
 
    private final SVNServerOperations server_;
+
+   private final Timer staleRefreshTimer_ = new Timer()
+   {
+      @Override
+      public void run()
+      {
+         refresh(false);
+      }
+   };
+
+   private static final int STALE_REFRESH_DELAY_MS = 2000;
 }